@@ -3,12 +3,15 @@
 
 #include "UAV_Defines.h"
 #include "MPU9250.h"
+#if UAV_IMU_FILTER_BANK
+#include "filter_bank.h"
+#endif
 
 /*
  * Defines
  */
 
-#define USE_INTERRUPT (0)
+#define USE_INTERRUPT (UAV_IMU_PIPELINE)
 
 typedef void (*DataReadyCb)(void);
 
@@ -30,6 +33,20 @@ private:
     bool mGyroAccDataRdyFlag;
     bool mMagCalibrateFlag;
     bool mMagEnabled;
+    bool mCalibLoaded; // LoadCalibration() took the stored record
+    int mCalibCount;   // samples PollSensorBiasCalibration() summed up
+    uint32_t mCalibLastMs;
+#if UAV_IMU_DMP
+    bool mDmpActive;
+    uint32_t mDmpLoadUs;
+    float mDmpAccBias[3]; // what StartDmp() moved into the chip's offset registers
+#endif
+
+#if UAV_IMU_FILTER_BANK
+    // on the FIFO records, in counts shifted by FILTER_BANK_Q_SAMPLE_SHIFT
+    FilterBankQType mGyroFilter;
+    FilterBankQType mAccFilter;
+#endif
 
     // for Low pass filter
     float mPrevAccX;
@@ -46,6 +63,15 @@ private:
 
     // private constructor, singleton paradigm
     IMU();
+
+    // counts to dps/g with sensitivity and bias applied, fractional once filtered
+    void ConvertGyroData(float gx, float gy, float gz, FCSensorDataType* pGyroData);
+    void ConvertAccelData(float ax, float ay, float az, FCSensorDataType* pAccData);
+    // adjusted, calibrated and turned into the gyro/accel frame
+    void ConvertMagData(int16_t mx, int16_t my, int16_t mz, FCSensorDataType* pMagData);
+#if UAV_IMU_DMP
+    bool StartDmp();
+#endif
 public:
     static IMU& GetInstance();
 
@@ -53,13 +79,59 @@ public:
     bool EnableMag(bool enable);
     bool Start();
     void CalibrateSensorBias();
+    // the same without waiting: each poll takes the sample that is ready, if
+    // any, and true once the calibration is complete
+    void BeginSensorBiasCalibration();
+    bool PollSensorBiasCalibration();
     void CalibrateAccBias();
     void CalibrateMag();
+    // the calibration of the last boot from flash (calib_store.h), after
+    // Init() and before Start(); false if there is none or a few samples
+    // disagree with it, CalibrateSensorBias() has to run then
+    bool LoadCalibration();
+    bool IsCalibrationLoaded();
+    // what the Calibrate*() above measured, for the next boot
+    bool SaveCalibration();
+    // die temperature, degC
+    float GetTemperature();
     void GetGravityVector(float* pGravity);
     void GetMagConstVector(float* pMagConst);
     bool GetCompassData(FCSensorDataType* pMagData);
     void GetAccelData(FCSensorDataType* pAccData);
     void GetGyroData(FCSensorDataType* pGyroData);
+    // one burst for both, what the sample path uses
+    void GetMotionData(FCSensorDataType* pGyroData, FCSensorDataType* pAccData);
+    // the same without waiting: the burst goes to pData, MPU9250_MOTION6_LEN
+    // bytes, and the overload below converts it once cb reported success
+    bool StartMotionRead(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    void GetMotionData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData);
+#if UAV_IMU_MAG_AUX
+    // nine axes of one sample, the mag as the MPU9250's I2C master last read
+    // it; false if the mag part is not valid, gyro and accel are set anyway.
+    // StartMotion9Read() reads MPU9250_MOTION9_LEN bytes to pData.
+    bool GetMotion9Data(FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCSensorDataType* pMagData);
+    bool StartMotion9Read(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    bool GetMotion9Data(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCSensorDataType* pMagData);
+#endif
+#if UAV_IMU_FIFO
+    // the FIFO Start() enabled, drained on the I2C queue: FIFO_COUNT, then
+    // whole records, MPU9250_FIFO_MOTION6_LEN bytes each, that
+    // GetFifoMotionData() converts one by one; a reset after an overflow
+    bool StartFifoCountRead(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    bool StartFifoRead(uint8_t* pData, uint16_t len, ImuBusDoneCb cb, void* pArg);
+    bool StartFifoReset(ImuBusDoneCb cb, void* pArg);
+    void GetFifoMotionData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData);
+#endif
+#if UAV_IMU_DMP
+    // Start() got the DMP running: the FIFO holds its packets at
+    // UAV_IMU_DMP_RATE_HZ, MPU9250_FIFO_DMP_LEN bytes each, which
+    // GetFifoDmpData() converts; false if it fell back to raw records
+    bool IsDmpActive();
+    // how long the DMP firmware took to load and verify
+    uint32_t GetDmpLoadUs();
+    // false if the packet is corrupt, nothing is set then
+    bool GetFifoDmpData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCQuaternionType* pQuat);
+#endif
     bool GetDataReady(uint8_t* pDataReady);
 
     bool GetRawCompassData(FCSensorDataType* pMagData);
@@ -73,6 +145,8 @@ public:
     bool SetDataReadyCb(DataReadyCb cb);
     void ClearInterrupt();
     void SetGyroAccDataReadyFlg();
+    // Clock_GetCycles() at the last data-ready edge, one word so the EXTI never tears it
+    volatile uint32_t mDataReadyCycles;
 #endif
 };
 
@@ -6,6 +6,27 @@
 
 #include "stm32f1xx_hal.h"
 
+#include "imu_bus.h"
+
+// ACCEL_XOUT_H to GYRO_ZOUT_L, temperature in between
+#define MPU9250_MOTION6_LEN (14)
+// FIFO with accel and gyro enabled: a record is ACCEL_XOUT_H to ACCEL_ZOUT_L
+// followed by GYRO_XOUT_H to GYRO_ZOUT_L, once per sample
+#define MPU9250_FIFO_SIZE (512)
+#define MPU9250_FIFO_MOTION6_LEN (12)
+// a packet of the DMP with 6-axis quaternion, raw accel, calibrated gyro and
+// gesture output: quaternion w, x, y, z as big endian Q30, then the accel
+// and gyro as in a motion6 record, then 4 bytes of gesture data
+#define MPU9250_FIFO_DMP_LEN (32)
+// with the magnetometer on the aux I2C master: ACCEL_XOUT_H to
+// EXT_SENS_DATA_07, the motion6 registers followed by the AK8963's ST1, HXL
+// to HZH and ST2 as the master last read them
+#define MPU9250_MOTION9_LEN (22)
+// configuration registers the driver keeps a copy of: SMPLRT_DIV to
+// ACCEL_CONFIG2, FIFO_EN and I2C_MST_CTRL, INT_PIN_CFG and INT_ENABLE,
+// USER_CTRL and PWR_MGMT_1
+#define MPU9250_SHADOW_LEN (11)
+
 typedef struct {
     uint8_t activeLvl;
     uint8_t intMode;
@@ -28,7 +49,34 @@ public:
 
     MPU9250();
 
-    void Init();
+    // magAux: the MPU9250's I2C master reads the AK8963 into EXT_SENS_DATA
+    // on every sample, instead of the host reaching it through the bypass;
+    // accDlpfMode: the accel's A_DLPFCFG, 4 is 21 Hz / 8.5 ms, 2 99 Hz / 2.9 ms
+    void Init(bool magAux = false, uint8_t accDlpfMode = 4);
+    // after inv_mpu.c started the DMP: the INT pin and the magnetometer back
+    // to what Init() set, the rest as the DMP driver left it
+    bool adoptDmpConfig();
+    // back to power-on register values; Init() again afterwards
+    bool reset();
+
+    // Shadow of the configuration registers. Setters and getters of those
+    // work on the copy: a getter does not touch the bus, a setter writes the
+    // register only if its value changed. Between beginConfig() and
+    // commitConfig() setters only mark registers dirty, commitConfig() writes
+    // them with one burst per run of adjacent registers. Whatever writes the
+    // chip behind the driver's back (the DMP driver, a reset) must call
+    // invalidateShadow(), the next access reloads it.
+    bool loadShadow();
+    void invalidateShadow();
+    void beginConfig();
+    bool commitConfig();
+    // re-read the registers and compare them with the copy, which then
+    // follows the chip; commitConfig() does it too with setShadowVerify(true)
+    bool verifyShadow();
+    void setShadowVerify(bool verify);
+
+    // SMPLRT_DIV register
+    void setRate(uint8_t rate);
 
     // CONFIG register
     uint8_t getGyroDLPFMode();
@@ -53,6 +101,21 @@ public:
     // ACCEL_*OUT_* registers
     void getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz, int16_t* mx, int16_t* my, int16_t* mz);
     void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+    // with the magnetometer on the aux I2C master, all nine axes in one burst
+    // of MPU9250_MOTION9_LEN bytes; parseMotion9() is false if the mag part
+    // is not valid (the AK8963 overflowed)
+    bool readMotion9Async(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    bool readMotion9(uint8_t* pData);
+    static bool parseMotion9(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz,
+                             int16_t* mx, int16_t* my, int16_t* mz);
+    // getMotion6() on the I2C queue: the burst lands in pData, which is
+    // MPU9250_MOTION6_LEN long, and parseMotion6() decodes it after cb
+    bool readMotion6Async(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    static void parseMotion6(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+    static void parseFifoMotion6(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+    // one MPU9250_FIFO_DMP_LEN packet, false if the quaternion is not a unit
+    // one, the FIFO is out of step then
+    static bool parseFifoDmp(const uint8_t* pData, int32_t* pQuat, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
     void getAcceleration(int16_t* x, int16_t* y, int16_t* z);
     int16_t getAccelerationX();
     int16_t getAccelerationY();
@@ -95,6 +158,10 @@ public:
     //check whether mag data is ready.
     uint8_t getCompassDataReady();
 
+    // the latest magnetometer sample: on the aux I2C master one read of
+    // EXT_SENS_DATA, through the bypass only once the AK8963 has a new one
+    bool readMag(int16_t* mx, int16_t* my, int16_t* mz);
+
     // get Mag Sensitivity Adjustment Data
     bool GetMagSensitivityAdjData(float* pAdj);
 
@@ -102,10 +169,42 @@ public:
     void readIntStatus();
     bool GetDataReady(uint8_t* pDataReady);
 
+    // FIFO_EN, USER_CTRL and FIFO_COUNT registers
+    // accel and gyro into the FIFO at the sample rate, starting empty; with
+    // dmp the DMP's packets instead
+    bool enableFifo(bool enable, bool dmp = false);
+    // the FIFO on the I2C queue: FIFO_COUNT goes to pData, 2 bytes that
+    // parseFifoCount() decodes; readFifoAsync() pops len bytes of records;
+    // resetFifoAsync() empties it, e.g. after an overflow
+    bool readFifoCountAsync(uint8_t* pData, ImuBusDoneCb cb, void* pArg);
+    static uint16_t parseFifoCount(const uint8_t* pData);
+    bool readFifoAsync(uint8_t* pData, uint16_t len, ImuBusDoneCb cb, void* pArg);
+    bool resetFifoAsync(ImuBusDoneCb cb, void* pArg);
+
 private:
     uint8_t devAddr;
     uint8_t ID;
-    uint8_t buffer[14];
+    uint8_t buffer[MPU9250_MOTION6_LEN];
+    // USER_CTRL with FIFO_RESET set, resetFifoAsync() writes it from here
+    uint8_t mFifoResetCtrl;
+    uint8_t mShadow[MPU9250_SHADOW_LEN];
+    uint16_t mShadowDirty; // one bit per mShadow entry
+    bool mShadowValid;
+    bool mShadowBatch;
+    bool mShadowVerify;
+    bool mMagAux;
+
+    bool readReg(uint8_t reg, uint8_t* pValue);
+    bool writeReg(uint8_t reg, uint8_t value);
+    bool writeShadowRun(int first, int last);
+    // AK8963 registers, through the bypass or the aux I2C master's slave 4
+    bool magRead(uint8_t reg, uint8_t* pData, uint16_t size);
+    bool magWrite(uint8_t reg, uint8_t value);
+    bool magAuxTransfer(uint8_t reg, uint8_t* pValue, bool read);
+    bool startMagAux();
+    void configInterface();
+    void configMagPath();
+    void startMag();
 };
 
 #endif /* _MPU9250_H_ */
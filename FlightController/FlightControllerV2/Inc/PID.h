@@ -59,6 +59,9 @@ public:
    float GetKd();						  // where it's important to know what is actually
    int GetMode();						  //  inside the PID.
    int GetDirection();					  //
+   float GetPTerm();                     // terms of the last Compute(), for logging
+   float GetITerm();
+   float GetDTerm();
 
 private:
    void Initialize();
@@ -82,6 +85,7 @@ private:
    // unsigned long lastTime;
 
    float outputSum, lastInput;
+   float pTerm, iTerm, dTerm;
 
    unsigned long SampleTime;
    float outMin, outMax;
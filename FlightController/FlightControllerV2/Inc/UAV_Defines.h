@@ -1,6 +1,8 @@
 #ifndef _UAV_DEFINES_
 #define _UAV_DEFINES_
 
+#include <stdint.h>
+
 /*
  * This file defines global constants that all files need to use.
  */
@@ -9,8 +11,129 @@
  * Defines
  */
 
+#ifndef UAV_Debug
 #define UAV_Debug (0)
+#endif
+// LOGx/PRINT send a token and the raw arguments instead of text, which the
+// host decoder formats, see log_token.h
+#ifndef UAV_LOG_TOKENIZED
+#define UAV_LOG_TOKENIZED (0)
+#endif
+// the debug UART answers the stats queries ('p', 'r', 'c') without UAV_Debug
+// too; only the replies go out then, not the logs around them
+#ifndef UAV_DEBUG_CMD
+#define UAV_DEBUG_CMD (1)
+#endif
 #define UAV_ENABLE_MOTORS (1)
+#define UAV_PROFILE (1) // collect cycle counts of tasks and hot calls, see profiler.h
+
+// IMU data-ready interrupt drives read -> estimate -> rate control -> motors
+// in one chain, instead of independent 100/50/100hz tasks
+#ifndef UAV_IMU_PIPELINE
+#define UAV_IMU_PIPELINE (1)
+#endif
+#define UAV_IMU_SAMPLE_RATE_HZ (100) // data-ready rate in pipeline mode
+
+// with UAV_IMU_PIPELINE, the MPU9250 samples at UAV_IMU_FIFO_RATE_HZ into its
+// FIFO, which is drained in one burst per pipeline cycle; the samples go
+// through an anti-alias low pass and are decimated to UAV_IMU_SAMPLE_RATE_HZ.
+// Off by default: the drain takes the I2C load from 4% to 27% and the
+// data-ready to motor latency from 0.4 to 2.9 ms at 400 kHz. It keeps motor
+// vibration out of the estimate (0.11 instead of 0.37 deg rms at 150 Hz in
+// the SIL) but does not track the sticks any better.
+#ifndef UAV_IMU_FIFO
+#define UAV_IMU_FIFO (0)
+#endif
+#define UAV_IMU_FIFO_RATE_HZ (1000)
+#define UAV_IMU_DECIMATOR_CUTOFF_HZ (40.0f)
+#define UAV_IMU_DECIMATOR_STAGES (1) // second order sections, see decimator.h
+
+#if UAV_IMU_FIFO && !UAV_IMU_PIPELINE
+#error "UAV_IMU_FIFO needs UAV_IMU_PIPELINE"
+#endif
+
+// the FIFO samples go through a fixed point notch at UAV_IMU_NOTCH_HZ, the
+// motor noise, before they are converted, see filter_bank.h. With it the
+// accel DLPF is at 99 Hz (2.9 ms) instead of 21 Hz (8.5 ms) and the gyro has
+// no dead-band; the decimator's low pass takes what is left above its cutoff.
+#ifndef UAV_IMU_FILTER_BANK
+#define UAV_IMU_FILTER_BANK (UAV_IMU_FIFO)
+#endif
+#define UAV_IMU_NOTCH_HZ (150.0f)
+#define UAV_IMU_NOTCH_Q (3.0f)
+
+#if UAV_IMU_FILTER_BANK && !UAV_IMU_FIFO
+#error "UAV_IMU_FILTER_BANK needs UAV_IMU_FIFO"
+#endif
+
+// the MPU9250's DMP fuses gyro and accel into an orientation quaternion, 6-axis
+// low power quaternion packets go to the FIFO at UAV_IMU_DMP_RATE_HZ and
+// StateEstimator takes the attitude from them instead of running Madgwick.
+// If the DMP firmware does not load, the FIFO carries raw samples as with
+// UAV_IMU_FIFO alone and the MCU fuses them.
+#ifndef UAV_IMU_DMP
+#define UAV_IMU_DMP (0)
+#endif
+#define UAV_IMU_DMP_RATE_HZ (200)
+
+#if UAV_IMU_DMP && !UAV_IMU_FIFO
+#error "UAV_IMU_DMP needs UAV_IMU_FIFO"
+#endif
+
+// I2C1 to the MPU9250 in fast mode, 400 kHz instead of 100 kHz, I2C_Init()
+// sets it over what MX_I2C1_Init() configured
+#ifndef UAV_I2C_FAST_MODE
+#define UAV_I2C_FAST_MODE (1)
+#endif
+
+// bus to the MPU9250, see imu_bus.h: 0 I2C1, 1 SPI2 with DMA. Without
+// UAV_IMU_MAG_AUX the magnetometer is only reachable on I2C.
+// ImuBus_SetBackend() overrides it before init.
+#ifndef UAV_IMU_BUS
+#define UAV_IMU_BUS (0)
+#endif
+
+// a FIFO drain per cycle at 100 kHz takes longer than the cycle itself
+#if UAV_IMU_FIFO && UAV_IMU_BUS == 0 && !UAV_I2C_FAST_MODE
+#error "UAV_IMU_FIFO on I2C needs UAV_I2C_FAST_MODE"
+#endif
+
+// the MPU9250's own I2C master reads the AK8963 into EXT_SENS_DATA on every
+// sample, so one burst has all nine axes and the magnetometer works on SPI
+// too; 0 reaches the AK8963 directly through the I2C bypass
+#ifndef UAV_IMU_MAG_AUX
+#define UAV_IMU_MAG_AUX (1)
+#endif
+
+// record a frame of sensor, state, setpoint, PID and motor data on every
+// rate control cycle, see blackbox.h
+#ifndef UAV_BLACKBOX
+#define UAV_BLACKBOX (1)
+#endif
+// delta/varint encode the blackbox frames, ~3x less bandwidth at quantised
+// resolution, see blackbox.h
+#ifndef UAV_BLACKBOX_ENCODED
+#define UAV_BLACKBOX_ENCODED (1)
+#endif
+
+// shape the stick setpoints between receiver frames, see rc_smoothing.h:
+// 0 steps on every frame, 1 interpolates between frames, 2 low passes at
+// UAV_RC_SMOOTHING_CUTOFF_HZ
+#ifndef UAV_RC_SMOOTHING
+#define UAV_RC_SMOOTHING (1)
+#endif
+#define UAV_RC_SMOOTHING_CUTOFF_HZ (15.0f)
+
+// receiver protocol on USART3: 0 detects it at start, 1 SBUS, 2 CRSF, see
+// receiver.h. Receiver::SetProtocol() changes it at run time.
+#ifndef UAV_RECEIVER_PROTOCOL
+#define UAV_RECEIVER_PROTOCOL (0)
+#endif
+// the receiver link counts as lost after this long without a new frame,
+// SBUS_Read() and CRSF_Read() report it as failsafe
+#ifndef UAV_RC_LINK_TIMEOUT_MS
+#define UAV_RC_LINK_TIMEOUT_MS (250)
+#endif
 
 // toggle whether the RC value controls attitude or acceleration
 #define UAV_CMD_ATT_RATE (0) // in this mode, uesr directly control UAV's attitude rate
@@ -134,6 +257,10 @@ typedef struct {
     FCSensorDataType gyroData;
     FCSensorDataType accData;
     // FCSensorDataType magData;
+#if UAV_IMU_DMP
+    FCQuaternionType quat; // the DMP's orientation, sensor frame, if quatValid
+    bool quatValid;
+#endif
 } FCSensorMeasType;
 
 typedef struct {
@@ -141,6 +268,12 @@ typedef struct {
     FCAttRateType attRate;
 } FCStateType;
 
+typedef struct {
+    float p;
+    float i;
+    float d;
+} FCPIDTermsType;
+
 #if UAV_CMD_ATT
 typedef struct {
     float desiredAccZ;
@@ -148,6 +281,8 @@ typedef struct {
     float desiredRoll;
     float desiredYawRate;
     bool toTunePID;
+    uint32_t frameSeq;    // receiver frame the command came from
+    uint64_t frameTimeUs; // its arrival, Clock_GetUs()
 } FCCmdType;
 #endif
 
@@ -156,6 +291,8 @@ typedef struct {
     float desiredAccZ;
     FCAttRateType desiredAttRate;
     bool toTunePID;
+    uint32_t frameSeq;    // receiver frame the command came from
+    uint64_t frameTimeUs; // its arrival, Clock_GetUs()
 } FCCmdType;
 #endif
 
@@ -164,6 +301,8 @@ typedef struct {
     FCAccDataType desiredAcc;
     float desiredYawRate;
     bool toTunePID;
+    uint32_t frameSeq;    // receiver frame the command came from
+    uint64_t frameTimeUs; // its arrival, Clock_GetUs()
 } FCCmdType;
 #endif
 
@@ -0,0 +1,63 @@
+#ifndef _LIB_BIP_BUFFER_H_
+#define _LIB_BIP_BUFFER_H_
+
+#include <stdint.h>
+
+/*
+ * Bipartite buffer: a byte FIFO that only ever hands out contiguous spans.
+ *
+ * The producer reserves a span, fills it (memcpy, vsnprintf, a DMA
+ * transfer) and commits how much of it was used. The consumer peeks the
+ * oldest contiguous span, uses it in place (e.g. as the source of a TX DMA
+ * transfer) and releases it. When a reservation does not fit before the end
+ * of the storage, the producer wraps to the start and the unused tail is
+ * skipped, so nothing is ever split or copied to straighten it out. The
+ * price is that a reservation can fail while the total free space would
+ * fit it.
+ *
+ *     |--- B ---|...free...|----- A -----|skipped|
+ *     0       write       read          last    size
+ *
+ * One producer and one consumer, e.g. an ISR and the main loop, may run
+ * concurrently without locking: write and last are only written by the
+ * producer, read only by the consumer, and each index is published with a
+ * barrier after the data it covers. Several producers or consumers need
+ * their own lock around the calls.
+ */
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint8_t* pBuf;
+    uint32_t size;
+    volatile uint32_t write;  // producer: end of the committed data
+    volatile uint32_t last;   // producer: end of the data before write wrapped
+    volatile uint32_t read;   // consumer: start of the oldest data
+    uint32_t reserveStart;    // producer: the outstanding reservation
+    uint32_t reserveLen;
+} BipBufferType;
+
+/*
+ * Prototype
+ */
+
+// pStorage stays owned by the caller, typically a static array
+bool BipBuffer_Init(BipBufferType* pBip, uint8_t* pStorage, uint32_t size);
+void BipBuffer_Reset(BipBufferType* pBip);
+
+// producer: contiguous span of len bytes, NULL if there is none
+uint8_t* BipBuffer_Reserve(BipBufferType* pBip, uint32_t len);
+// producer: publishes the first len bytes of the reservation, 0 cancels it
+void BipBuffer_Commit(BipBufferType* pBip, uint32_t len);
+
+// consumer: oldest contiguous committed span, NULL and *pLen 0 if empty
+uint8_t* BipBuffer_Peek(BipBufferType* pBip, uint32_t* pLen);
+// consumer: frees the first len bytes of the peeked span
+void BipBuffer_Release(BipBufferType* pBip, uint32_t len);
+
+// either side, committed bytes not released yet
+uint32_t BipBuffer_GetUsed(const BipBufferType* pBip);
+
+#endif
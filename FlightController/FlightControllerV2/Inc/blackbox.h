@@ -0,0 +1,176 @@
+#ifndef _BLACKBOX_H_
+#define _BLACKBOX_H_
+
+#include <stdint.h>
+
+#include "UAV_Defines.h"
+#include "frame_codec.h"
+#include "spsc_ring.h"
+
+/*
+ * Flight data recorder.
+ *
+ * Record() runs in the control loop and only copies one fixed layout frame
+ * into a single producer / single consumer ring, dropping (and counting) the
+ * frame if the ring is full. Flush() runs as a background task and hands
+ * complete frames to the backend, by default the USART2 TX DMA queue; the
+ * SIL swaps in a file. A frame that the backend can not take yet stays in
+ * the ring for the next Flush().
+ *
+ * Frames are little endian and self-delimiting (sync, version, size,
+ * Fletcher-16 checksum), so a decoder can pick them out of a stream that
+ * also carries log output. Tools/BlackboxDecoder turns a recording into CSV.
+ *
+ * With UAV_BLACKBOX_ENCODED, Flush() instead quantises each frame to
+ * BLACKBOX_NUM_OF_FIELDS integers (see the scales below) and sends it
+ * through the frame codec (frame_codec.h) as an encoded packet:
+ *
+ *     sync0 | sync1 encoded | version | count | len | codec frame[len] | checksum
+ *
+ * The checksum covers version to the last codec byte. count increments per
+ * packet; a decoder that sees a gap lost a packet on the way and waits for
+ * the next keyframe. An encoded packet that the backend rejects is kept and
+ * retried as is, and frames dropped from the full ring never reach the
+ * encoder, so the firmware itself never causes a gap.
+ *
+ * The format functions at the end only depend on the codec, the host tools
+ * share them with the firmware.
+ */
+
+/*
+ * Defines
+ */
+
+#define BLACKBOX_NUM_OF_FRAMES (8) // power of two
+#define BLACKBOX_SYNC_0 (0xBB)
+#define BLACKBOX_SYNC_1 (0x42)
+#define BLACKBOX_SYNC_1_ENCODED (0x43)
+#define BLACKBOX_FRAME_VERSION (1)
+#define BLACKBOX_ENCODED_VERSION (1)   // bump when the fields or scales change
+#define BLACKBOX_ENCODED_HEADER_LEN (5)
+#define BLACKBOX_KEYFRAME_INTERVAL (32)
+
+// resolution of the encoded fields
+#define BLACKBOX_SCALE_GYRO (100.0f)   // 0.01 dps
+#define BLACKBOX_SCALE_ACC (10000.0f)  // 0.1 mg
+#define BLACKBOX_SCALE_ANGLE (100.0f)  // 0.01 deg and deg/s
+#define BLACKBOX_SCALE_PID (10000.0f)
+
+#define BLACKBOX_FLAG_ARMED (0x0001)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint8_t sync[2];
+    uint8_t version;
+    uint8_t size;                   // sizeof(BlackboxFrameType)
+    uint32_t seq;                   // gaps are dropped frames
+    uint32_t timeUs;
+    struct {
+        FCSensorDataType gyroData;
+        FCSensorDataType accData;
+    } meas;                         // of FCSensorMeasType, whose other fields depend on the build
+    FCStateType state;
+    FCAttType attSetpoint;
+    FCAttRateType attRateSetpoint;
+    FCPIDTermsType attRatePID[3];   // pitch, roll, yaw
+    uint16_t motorPWM[4];
+    uint16_t flags;
+    uint16_t checksum;              // Fletcher-16 from version to flags
+} BlackboxFrameType;
+
+static_assert(sizeof(BlackboxFrameType) == 132, "blackbox frame layout changed, bump BLACKBOX_FRAME_VERSION");
+
+enum {
+    BLACKBOX_FIELD_TIME_US,
+    BLACKBOX_FIELD_SEQ,
+    BLACKBOX_FIELD_GYRO,                             // x, y, z
+    BLACKBOX_FIELD_ACC = BLACKBOX_FIELD_GYRO + 3,    // x, y, z
+    BLACKBOX_FIELD_ATT = BLACKBOX_FIELD_ACC + 3,     // yaw, pitch, roll
+    BLACKBOX_FIELD_ATT_RATE = BLACKBOX_FIELD_ATT + 3,
+    BLACKBOX_FIELD_ATT_SETPOINT = BLACKBOX_FIELD_ATT_RATE + 3,
+    BLACKBOX_FIELD_ATT_RATE_SETPOINT = BLACKBOX_FIELD_ATT_SETPOINT + 3,
+    BLACKBOX_FIELD_PID = BLACKBOX_FIELD_ATT_RATE_SETPOINT + 3, // p, i, d of pitch, roll, yaw
+    BLACKBOX_FIELD_MOTOR = BLACKBOX_FIELD_PID + 9,
+    BLACKBOX_FIELD_FLAGS = BLACKBOX_FIELD_MOTOR + 4,
+    BLACKBOX_NUM_OF_FIELDS,
+};
+
+#define BLACKBOX_ENCODED_MAX_LEN (BLACKBOX_ENCODED_HEADER_LEN + FRAME_CODEC_MAX_LEN(BLACKBOX_NUM_OF_FIELDS) + 2)
+
+typedef enum {
+    BLACKBOX_PARSE_FRAME,          // a frame was decoded
+    BLACKBOX_PARSE_NO_FRAME,       // no packet starts here, skip a byte
+    BLACKBOX_PARSE_NEED_MORE,      // the packet is cut off
+    BLACKBOX_PARSE_NO_KEYFRAME,    // valid encoded packet, waiting for a keyframe
+} BlackboxParseResultType;
+
+// encoder or decoder side of the encoded packets
+typedef struct {
+    FrameCodecStateType codec;
+    uint8_t count; // next packet count
+} BlackboxCodecType;
+
+typedef struct {
+    const char* name;
+    // false if the backend can not take the frame now, it is retried later
+    bool (*write)(const uint8_t* pData, int size);
+} BlackboxBackendType;
+
+typedef struct {
+    uint32_t recorded;
+    uint32_t dropped;
+    uint32_t written;
+    uint32_t backendBusy;
+    uint32_t writtenBytes;
+} BlackboxStatsType;
+
+/*
+ * Class
+ */
+
+class Blackbox
+{
+public:
+    static Blackbox& GetInstance();
+
+    bool SetBackend(const BlackboxBackendType* pBackend);
+    // control loop side, seq, header and checksum are filled in here
+    bool Record(BlackboxFrameType& frame);
+    // background side, returns the number of frames handed to the backend
+    int Flush();
+    bool GetStats(BlackboxStatsType& stats);
+    bool ResetStats();
+
+private:
+    Blackbox(); // private constructor, singleton
+
+    SpscRing<BlackboxFrameType, BLACKBOX_NUM_OF_FRAMES> mFrames; // Record() produces, Flush() consumes
+    uint32_t mSeq;
+    const BlackboxBackendType* mBackend;
+    BlackboxStatsType mStats;
+#if UAV_BLACKBOX_ENCODED
+    BlackboxCodecType mCodec;
+    uint8_t mPacket[BLACKBOX_ENCODED_MAX_LEN];
+    int mPacketLen; // encoded packet waiting for the backend, 0 if none
+#endif
+};
+
+/*
+ * Prototype
+ */
+
+uint16_t Blackbox_Checksum(const uint8_t* pData, int size);
+const FrameCodecConfigType* Blackbox_GetCodecConfig();
+bool Blackbox_InitCodec(BlackboxCodecType* pCodec);
+void Blackbox_FrameToFields(const BlackboxFrameType& frame, int32_t* pFields);
+void Blackbox_FieldsToFrame(const int32_t* pFields, BlackboxFrameType& frame);
+// returns the packet length, 0 if it does not fit into outSize
+int Blackbox_EncodePacket(BlackboxCodecType* pCodec, const BlackboxFrameType& frame, uint8_t* pOut, int outSize);
+// raw and encoded packets, pCodec is the decoder state for the latter
+BlackboxParseResultType Blackbox_ParsePacket(BlackboxCodecType* pCodec, const uint8_t* pData, int size,
+                                             BlackboxFrameType& frame, int* pLen);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _LIB_BOOT_SEQ_H_
+#define _LIB_BOOT_SEQ_H_
+
+#include <stdint.h>
+
+/*
+ * Table-driven boot sequencer.
+ *
+ * A step starts once the steps it depends on are done and is then polled
+ * until it is done, fails or runs past its timeout. A step that waits on the
+ * hardware, e.g. for the receiver's first frame, only starts the wait, so
+ * independent steps wait in parallel; a start that blocks, e.g. the IMU
+ * setup, holds the others up while it runs.
+ *
+ * A step that failed or timed out starts again after its retry delay, the
+ * steps that made it are left alone. Once a step is out of retries the boot
+ * fails, and the steps that depend on it never start.
+ *
+ * Per step the sequencer records the attempts, when the first one started
+ * and when the step was done, from BootSeq_Init() on.
+ */
+
+/*
+ * Defines
+ */
+
+#define BOOT_SEQ_MAX_STEPS (16)
+#define BOOT_STEP_BIT(id) (1u << (id))
+#define BOOT_STEP_RETRY_FOREVER (0xFF)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    BOOT_STEP_PENDING,
+    BOOT_STEP_DONE,
+    BOOT_STEP_FAILED
+} BootStepStatusType;
+
+typedef enum {
+    BOOT_STEP_WAITING,  // for the steps it depends on
+    BOOT_STEP_RUNNING,
+    BOOT_STEP_BACKOFF,  // failed, starts again after retryDelayMs
+    BOOT_STEP_COMPLETE,
+    BOOT_STEP_ABORTED   // out of retries
+} BootStepStateType;
+
+// start kicks the step off, false if that failed already; poll reports how it
+// goes on from there, NULL if start did all of it
+typedef bool (*BootStepStartFunc)(void);
+typedef BootStepStatusType (*BootStepPollFunc)(void);
+
+typedef struct {
+    const char* name;
+    BootStepStartFunc start;
+    BootStepPollFunc poll;
+    uint32_t timeoutMs;    // from a start to done, 0 means unchecked
+    uint16_t retryDelayMs;
+    uint8_t maxRetries;    // BOOT_STEP_RETRY_FOREVER to never give up
+    uint32_t dependsOn;    // BOOT_STEP_BIT mask of step ids
+} BootStepConfigType;
+
+typedef struct {
+    BootStepStateType state;
+    uint32_t attempts;
+    uint32_t timeouts;     // attempts that ran past timeoutMs
+    uint32_t startUs;      // first start, from BootSeq_Init()
+    uint32_t doneUs;       // from BootSeq_Init(), 0 while not complete
+    uint32_t lastAttemptUs; // start to done of the attempt that made it
+} BootStepStatsType;
+
+/*
+ * Prototype
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool BootSeq_Init(const BootStepConfigType* pSteps, int numOfSteps);
+// one pass over the steps, DONE once all are complete, FAILED once one is
+// out of retries
+BootStepStatusType BootSeq_Poll();
+// polls until the boot is done or failed, sleeping until the next interrupt
+// in between
+bool BootSeq_Run();
+// BootSeq_Init() to the last step done, 0 before
+uint32_t BootSeq_GetReadyUs();
+int BootSeq_GetNumOfSteps();
+const char* BootSeq_GetStepName(int stepId);
+bool BootSeq_GetStats(int stepId, BootStepStatsType* pStats);
+void BootSeq_PrintStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _LIB_CALIB_STORE_H_
+#define _LIB_CALIB_STORE_H_
+
+#include <stdint.h>
+
+/*
+ * IMU calibration record in the flash data page (flash.h), so a boot can
+ * take the calibration over instead of measuring it again.
+ *
+ * The record is a header with CALIB_STORE_MAGIC, CALIB_STORE_VERSION and the
+ * size of CalibDataType, then the data and a CRC-32 over both. A blank page,
+ * another version or size, or a CRC mismatch, e.g. after a power cut during
+ * CalibStore_Save(), all read as no record; bump CALIB_STORE_VERSION whenever
+ * CalibDataType or the meaning of a field changes.
+ */
+
+/*
+ * Defines
+ */
+
+#define CALIB_STORE_MAGIC   (0x4C434346) // "FCCL"
+#define CALIB_STORE_VERSION (1)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    float gyroBias[3];   // dps
+    float gravity[3];    // g, the accel at rest when calibrated
+    float accBias[3];    // g
+    float magOffset[3];  // hard iron, in the units ConvertMagData() applies it
+    float magScale[3];   // soft iron, per axis
+    float tempDegC;      // die temperature when calibrated
+} CalibDataType;
+
+/*
+ * Prototype
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// false if there is no valid record, pData is untouched then
+bool CalibStore_Load(CalibDataType* pData);
+// erases the page and writes the record, stalls the CPU for ~20 ms
+bool CalibStore_Save(const CalibDataType* pData);
+// the next CalibStore_Load() finds nothing
+bool CalibStore_Erase();
+uint32_t CalibStore_Crc32(const void* pData, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef DRIVER_CLOCK_H_
+#define DRIVER_CLOCK_H_
+
+#include <stdint.h>
+
+/*
+ * Monotonic high resolution clock backed by the DWT cycle counter.
+ *
+ * Clock_GetCycles() wraps every 2^32 cycles (~67 s at 64 MHz); differences
+ * of two readings are valid across one wrap. Clock_GetUs() is extended to
+ * 64 bits internally and must be called at least once per wrap, which the
+ * scheduler tick does.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool Clock_Init();
+uint32_t Clock_GetCycles();
+uint32_t Clock_GetCyclesPerUs();
+uint32_t Clock_CyclesToUs(uint32_t cycles);
+uint64_t Clock_GetUs();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,17 +3,61 @@
 
 #include "UAV_Defines.h"
 #include "receiver.h"
+#include "rc_smoothing.h"
+
+/*
+ * Defines
+ */
+
+#define CMD_LATENCY_QUEUE_LEN (16) // frames waiting for a motor output, > frames per attitude loop period
+
+/*
+ * Struct
+ */
+
+// receiver frame arrival to the first motor output that acted on it or a
+// later frame, i.e. how long a stick move takes to reach the motors
+typedef struct {
+    uint32_t samples;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+} CmdLatencyStatsType;
 
 class CmdListener {
 private:
     CmdListener(); // private constructor, singleton
 
-    FCCmdType mCmd;
+    void CmdToChannels(const FCCmdType& cmd, float* pChannels);
+    void ChannelsToCmd(const float* pChannels, FCCmdType& cmd);
+
+    FCCmdType mCmd;              // target of the setpoint
+    RcSmoothingType mSmoothing;
+    uint64_t mLatencyQueue[CMD_LATENCY_QUEUE_LEN]; // arrival of the frames no output acted on yet
+    int mLatencyHead;
+    int mLatencyCnt;
+    CmdLatencyStatsType mLatency;
 public:
     static CmdListener& GetInstance();
     bool Init();
+    // waits until the receiver is found
     bool Start();
+    // one search for the receiver without waiting, see Receiver::PollStart()
+    bool BeginStart();
+    ReceiverStartStatusType PollStart();
+    bool SetFrameCb(ReceiverFrameCb cb);
     ReceiverStatus GetCmd(FCCmdType& cmd);
+
+    // the stick setpoint between frames, see UAV_RC_SMOOTHING
+    void SetSetpointTarget(const FCCmdType& cmd);
+    void ResetSetpoint();
+    // false before the first target. frameSeq/frameTimeUs are the target's.
+    bool GetSetpoint(FCCmdType& cmd, uint64_t nowUs);
+
+    // a motor output acted on the setpoint from the frame at frameTimeUs
+    void RecordLatency(uint64_t frameTimeUs, uint64_t nowUs);
+    void GetLatencyStats(CmdLatencyStatsType& stats);
+    void ResetLatencyStats();
 };
 
-#endif
\ No newline at end of file
+#endif
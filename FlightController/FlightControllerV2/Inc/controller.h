@@ -35,6 +35,10 @@ public:
     bool SetCurAtt(FCAttType& att);
     bool SetCurAttRate(FCAttType& att);
 
+    bool GetAttSetpoint(FCAttType& attSetpoint);
+    bool GetAttRateSetpoint(FCAttRateType& attRateSetpoint);
+    bool GetAttRatePIDTerms(FCPIDTermsType& pitch, FCPIDTermsType& roll, FCPIDTermsType& yaw);
+
     bool RunAttCtrl();
     bool RunAttRateCtrl();
     bool RunAccCtrl();
@@ -3,6 +3,8 @@
 
 #include <PID.h>
 
+#include "UAV_Defines.h"
+
 /*
  * Defines
  */
@@ -21,6 +23,7 @@ public:
    float GetKp();
    float GetKd();
    float GetKi();
+   bool GetPIDTerms(FCPIDTermsType& terms);
    bool SetPeriodMs(int periodMs);
 private:
    PID mAttRatePID;
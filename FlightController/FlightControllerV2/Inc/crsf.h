@@ -0,0 +1,44 @@
+#ifndef DRIVER_CRSF_H_
+#define DRIVER_CRSF_H_
+
+#include "stm32f1xx_hal.h"
+
+#include "crsf_decoder.h"
+
+typedef struct {
+    int channels[CRSF_NUM_OF_CHANNELS]; // val between CRSF_CHANNEL_MIN and CRSF_CHANNEL_MAX
+    bool failsafe;        // the receiver reports no uplink (link quality 0), or stale
+    bool stale;           // no new RC frame for UAV_RC_LINK_TIMEOUT_MS, or none yet
+    uint32_t frameSeq;    // counts received RC frames from 1, unchanged if CRSF_Read() saw no new frame
+    uint64_t frameTimeUs; // Clock_GetUs() when the frame was complete
+    CRSFLinkStatsType link; // from the latest link statistics frame
+    uint32_t linkSeq;     // counts link statistics frames, 0 before the first
+} CRSFDataType;
+
+// interrupt context, after an RC channels frame is ready for CRSF_Read()
+typedef void (*CRSFFrameCb)(void);
+
+typedef struct {
+    CRSFDecoderStatsType decoder;
+    uint32_t uartErrors; // RcUart_GetErrors(), parity, framing, noise or overrun
+} CRSFStatsType;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool CRSF_Init();
+// takes over the receiver UART, CRSF_IsReceiving() once the first RC frame is in
+bool CRSF_Start();
+void CRSF_Stop();
+bool CRSF_IsReceiving();
+bool CRSF_Read(CRSFDataType* pCRSFData);
+// the link statistics as the last CRSF_Read() took them, leaves the frames to it
+void CRSF_GetLinkStats(CRSFLinkStatsType* pLinkStats);
+void CRSF_SetFrameCb(CRSFFrameCb cb);
+void CRSF_GetStats(CRSFStatsType* pStats);
+void CRSF_ResetStats();
+#ifdef __cplusplus
+}
+#endif
+#endif
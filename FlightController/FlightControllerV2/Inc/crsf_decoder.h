@@ -0,0 +1,113 @@
+#ifndef _LIB_CRSF_DECODER_H_
+#define _LIB_CRSF_DECODER_H_
+
+#include <stdint.h>
+
+/*
+ * Streaming CRSF (Crossfire / ExpressLRS receiver link) frame decoder.
+ *
+ *     address | length | type | payload | crc8
+ *
+ * length counts type, payload and crc (2..62). The CRC is CRC-8/DVB-S2
+ * (poly 0xD5) over type and payload, so unlike SBUS a frame is accepted as
+ * soon as its last byte is in. A bad CRC, or a length out of range or wrong
+ * for the frame type, drops the frame and rescans it from the next address
+ * byte, so the decoder falls back into step right after corruption. A frame
+ * cut short by an idle line is dropped.
+ *
+ * The receiver sends RC channels (16 channels of 11 bits, 172..1811 like
+ * SBUS) at the link's packet rate, 50..500 Hz, and link statistics in
+ * between. Other frame types are counted and returned as well.
+ *
+ * No HAL dependencies, the host tools feed it recorded byte streams and the
+ * SIL receiver model builds its frames with CRSF_BuildFrame().
+ */
+
+/*
+ * Defines
+ */
+
+#define CRSF_BAUDRATE (420000)
+#define CRSF_ADDRESS_FLIGHT_CONTROLLER (0xC8)
+#define CRSF_ADDRESS_TRANSMITTER (0xEE)  // some receivers address the FC as the module
+#define CRSF_MAX_FRAME_LEN (64)          // address and length included
+#define CRSF_MIN_LENGTH (2)              // type and crc
+#define CRSF_MAX_LENGTH (CRSF_MAX_FRAME_LEN - 2)
+#define CRSF_FRAME_TYPE_INDEX (2)
+#define CRSF_FRAME_PAYLOAD_INDEX (3)
+
+#define CRSF_FRAMETYPE_LINK_STATISTICS (0x14)
+#define CRSF_FRAMETYPE_RC_CHANNELS_PACKED (0x16)
+#define CRSF_LINK_STATISTICS_PAYLOAD_LEN (10)
+#define CRSF_RC_CHANNELS_PAYLOAD_LEN (22)
+
+#define CRSF_NUM_OF_CHANNELS (16)
+#define CRSF_CHANNEL_BITS (11)
+#define CRSF_CHANNEL_MIN (172)
+#define CRSF_CHANNEL_MID (992)
+#define CRSF_CHANNEL_MAX (1811)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint8_t uplinkRssi1;         // -dBm
+    uint8_t uplinkRssi2;         // -dBm
+    uint8_t uplinkLinkQuality;   // %, 0 is failsafe
+    int8_t uplinkSnr;            // dB
+    uint8_t activeAntenna;
+    uint8_t rfMode;              // packet rate index, receiver specific
+    uint8_t uplinkTxPower;       // enum, 0 = 0 mW .. 8 = 250 mW
+    uint8_t downlinkRssi;        // -dBm
+    uint8_t downlinkLinkQuality; // %
+    int8_t downlinkSnr;          // dB
+} CRSFLinkStatsType;
+
+typedef struct {
+    uint32_t frames;          // frames with a valid CRC, any type
+    uint32_t rcFrames;
+    uint32_t linkStatsFrames;
+    uint32_t crcErrors;
+    uint32_t badLengths;      // length byte out of range or wrong for the type
+    uint32_t partialFrames;   // frames cut short by an idle line
+    uint32_t skippedBytes;    // bytes dropped while looking for an address byte
+    uint32_t minPeriodUs;     // between consecutive RC frames
+    uint32_t maxPeriodUs;
+    uint64_t firstRcFrameUs;
+    uint64_t lastRcFrameUs;
+} CRSFDecoderStatsType;
+
+typedef struct {
+    uint8_t frame[CRSF_MAX_FRAME_LEN]; // being received
+    uint8_t out[CRSF_MAX_FRAME_LEN];   // returned last
+    uint8_t len;
+    CRSFDecoderStatsType stats;
+} CRSFDecoderType;
+
+/*
+ * Prototype
+ */
+
+void CRSFDecoder_Init(CRSFDecoderType* pDec);
+void CRSFDecoder_ResetStats(CRSFDecoderType* pDec);
+
+// a frame with a valid CRC (address first), or NULL. Valid until the next call.
+const uint8_t* CRSFDecoder_PutByte(CRSFDecoderType* pDec, uint8_t byte, uint64_t timeUs);
+// after a frame, the next complete one already in the buffer, or NULL; a
+// rescan can leave several. Call it until NULL before the next byte.
+const uint8_t* CRSFDecoder_Next(CRSFDecoderType* pDec, uint64_t timeUs);
+// the line went idle (or the stream ended)
+void CRSFDecoder_OnIdle(CRSFDecoderType* pDec);
+
+// average over the RC frames so far, 0 before the second one
+float CRSFDecoder_GetRcFrameRateHz(const CRSFDecoderStatsType* pStats);
+
+uint8_t CRSF_Crc8(const uint8_t* pData, int len);
+void CRSF_UnpackChannels(const uint8_t* pPayload, uint16_t channels[CRSF_NUM_OF_CHANNELS]);
+void CRSF_PackChannels(const uint16_t channels[CRSF_NUM_OF_CHANNELS], uint8_t* pPayload);
+void CRSF_ParseLinkStats(const uint8_t* pPayload, CRSFLinkStatsType* pLink);
+// address, length, type, payload and crc into pFrame, returns the frame length
+int CRSF_BuildFrame(uint8_t type, const uint8_t* pPayload, int payloadLen, uint8_t* pFrame);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _LIB_DECIMATOR_H_
+#define _LIB_DECIMATOR_H_
+
+#include <stdint.h>
+
+/*
+ * Anti-alias low pass and decimator for a multi-channel sample stream.
+ *
+ * Every input goes through numOfStages cascaded second order low pass
+ * sections at cutoffHz, which together form a Butterworth filter of order
+ * 2 * numOfStages. Decimator_Put() returns the filtered channels on every
+ * factor-th input, the others only advance the filter, so the output rate is
+ * inputRateHz / factor. cutoffHz should be below half of that.
+ *
+ * The filter starts from the first input as if it had been there forever, so
+ * there is no step response at the start or after Decimator_Reset().
+ *
+ * No HAL dependencies.
+ */
+
+/*
+ * Defines
+ */
+
+#define DECIMATOR_MAX_CHANNELS (6)
+#define DECIMATOR_MAX_STAGES (4)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    float b0, b1, b2;
+    float a1, a2;
+} DecimatorCoeffType;
+
+typedef struct {
+    int numOfChannels;
+    int numOfStages;
+    int factor;
+    int phase;                // inputs since the last output
+    bool primed;
+    DecimatorCoeffType coeff[DECIMATOR_MAX_STAGES];
+    // direct form II transposed state per stage and channel
+    float z1[DECIMATOR_MAX_STAGES][DECIMATOR_MAX_CHANNELS];
+    float z2[DECIMATOR_MAX_STAGES][DECIMATOR_MAX_CHANNELS];
+} DecimatorType;
+
+/*
+ * Prototype
+ */
+
+bool Decimator_Init(DecimatorType* pDec, int numOfChannels, float inputRateHz, int factor, float cutoffHz, int numOfStages);
+// the next input primes the filter again and starts a new group of factor inputs
+void Decimator_Reset(DecimatorType* pDec);
+// numOfChannels values in; true and numOfChannels values in pOut on every
+// factor-th call
+bool Decimator_Put(DecimatorType* pDec, const float* pIn, float* pOut);
+
+#endif
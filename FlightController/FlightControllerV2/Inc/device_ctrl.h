@@ -48,6 +48,7 @@
 #define RMII_TXD0_Pin GPIO_PIN_13
 #define RMII_TXD0_GPIO_Port GPIOG
 
+// drivers and services, the steps in parallel where they can, see boot_seq.h
 bool DeviceInit();
 
 #endif
\ No newline at end of file
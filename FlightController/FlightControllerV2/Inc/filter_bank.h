@@ -0,0 +1,116 @@
+#ifndef _LIB_FILTER_BANK_H_
+#define _LIB_FILTER_BANK_H_
+
+#include <stdint.h>
+
+/*
+ * Cascade of filter stages over the three axes of a sensor.
+ *
+ * Every call filters one sample of all FILTER_BANK_AXES axes. The state is
+ * kept per stage as an array over the axes, so a stage runs one tight loop
+ * with its coefficients in registers. The stage kinds:
+ *  - FILTER_PT1: first order low pass at hz,
+ *  - FILTER_PT2: two PT1 whose cascade has its -3 dB point at hz,
+ *  - FILTER_BIQUAD_LPF: second order low pass at hz, q 0 for Butterworth,
+ *  - FILTER_NOTCH: second order notch at hz, q is the centre frequency over
+ *    the -3 dB width.
+ *
+ * The coefficients are worked out when a stage is added. FilterBank_SetStage()
+ * retunes a stage and keeps its state, e.g. to follow the motor speed with a
+ * notch. The filter starts from the first sample as if it had been there
+ * forever, so there is no step response at the start or after a reset.
+ *
+ * FilterBankType works in float. FilterBankQType is the same in fixed point
+ * for a target without an FPU: coefficients in Q FILTER_BANK_Q_BITS, int32
+ * samples and a 64 bit accumulator. Raw int16 counts shifted up by
+ * FILTER_BANK_Q_SAMPLE_SHIFT leave room for a notch's ringing and keep the
+ * state of a low cutoff from rounding down to nothing. Its coefficients are
+ * still worked out in float, only the sample path is integer.
+ *
+ * No HAL dependencies.
+ */
+
+/*
+ * Defines
+ */
+
+#define FILTER_BANK_AXES (3)
+#define FILTER_BANK_MAX_STAGES (4)
+#define FILTER_BANK_Q_BITS (28) // biquad coefficients stay within +-2
+#define FILTER_BANK_Q_SAMPLE_SHIFT (8)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    FILTER_PT1,
+    FILTER_PT2,
+    FILTER_BIQUAD_LPF,
+    FILTER_NOTCH,
+} FilterKindType;
+
+typedef struct {
+    FilterKindType kind;
+    // PT1/PT2: k in b0, the rest unused
+    float b0, b1, b2;
+    float a1, a2;
+    // direct form II transposed per axis; PT1 and PT2 keep their outputs
+    float z1[FILTER_BANK_AXES];
+    float z2[FILTER_BANK_AXES];
+} FilterStageType;
+
+typedef struct {
+    float sampleRateHz;
+    int numOfStages;
+    bool primed;
+    FilterStageType stage[FILTER_BANK_MAX_STAGES];
+} FilterBankType;
+
+typedef struct {
+    FilterKindType kind;
+    int32_t b0, b1, b2;
+    int32_t a1, a2;
+    // direct form I per axis, which cannot overflow inside the section;
+    // PT1 and PT2 keep their outputs in y1 and y2
+    int32_t x1[FILTER_BANK_AXES];
+    int32_t x2[FILTER_BANK_AXES];
+    int32_t y1[FILTER_BANK_AXES];
+    int32_t y2[FILTER_BANK_AXES];
+} FilterStageQType;
+
+typedef struct {
+    float sampleRateHz;
+    int numOfStages;
+    bool primed;
+    FilterStageQType stage[FILTER_BANK_MAX_STAGES];
+} FilterBankQType;
+
+/*
+ * Prototype
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool FilterBank_Init(FilterBankType* pBank, float sampleRateHz);
+// id of the new stage, -1 if the bank is full or hz is not below Nyquist
+int FilterBank_AddStage(FilterBankType* pBank, FilterKindType kind, float hz, float q);
+bool FilterBank_SetStage(FilterBankType* pBank, int stageId, float hz, float q);
+// the next sample primes the filter again
+void FilterBank_Reset(FilterBankType* pBank);
+// FILTER_BANK_AXES values in and out, pOut may be pIn
+void FilterBank_Apply(FilterBankType* pBank, const float* pIn, float* pOut);
+
+bool FilterBankQ_Init(FilterBankQType* pBank, float sampleRateHz);
+int FilterBankQ_AddStage(FilterBankQType* pBank, FilterKindType kind, float hz, float q);
+bool FilterBankQ_SetStage(FilterBankQType* pBank, int stageId, float hz, float q);
+void FilterBankQ_Reset(FilterBankQType* pBank);
+void FilterBankQ_Apply(FilterBankQType* pBank, const int32_t* pIn, int32_t* pOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
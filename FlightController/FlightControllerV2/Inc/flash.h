@@ -0,0 +1,36 @@
+#ifndef DRIVER_FLASH_H_
+#define DRIVER_FLASH_H_
+
+#include <stdint.h>
+
+/*
+ * Internal flash pages for data that has to survive a power cycle.
+ *
+ * FLASH_DATA_PAGE_ADDR is the last 1 KB page of the 64 KB STM32F103C8; the
+ * linker file keeps the code out of it. A page erases to 0xFF and is
+ * programmed one half word at a time, so Flash_Write() takes an even size at
+ * an even address. Erasing and programming stall the CPU, an erase for
+ * ~20 ms; only call them while nothing time critical runs.
+ */
+
+/*
+ * Defines
+ */
+
+#define FLASH_DATA_PAGE_ADDR (0x0800FC00)
+#define FLASH_DATA_PAGE_LEN  (1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool Flash_Read(uint32_t addr, void* pData, uint16_t size);
+// the page addr is in
+bool Flash_ErasePage(uint32_t addr);
+bool Flash_Write(uint32_t addr, const void* pData, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef _LIB_FRAME_CODEC_H_
+#define _LIB_FRAME_CODEC_H_
+
+#include <stdint.h>
+
+/*
+ * Keyframe / delta codec for fixed layout frames of int32 fields, shared by
+ * the firmware and the host tools.
+ *
+ * Each field has a predictor. A keyframe codes every field as is, a delta
+ * frame codes the difference between each field and its prediction from the
+ * previous one or two frames. The residuals are zig-zag mapped (0, -1, 1,
+ * -2, ... to 0, 1, 2, 3, ...) and written as little endian base-128
+ * varints, so a field that changes by less than +-64 takes one byte.
+ *
+ *     type | varint[numOfFields]
+ *
+ * type is FRAME_CODEC_KEYFRAME or FRAME_CODEC_DELTA. The encoder sends a
+ * keyframe every keyframeInterval frames so a decoder that starts late or
+ * lost a frame can resynchronise. All arithmetic wraps modulo 2^32, so the
+ * decoder reproduces the encoder's fields bit for bit.
+ *
+ * The encoder and decoder keep separate state, both must be initialised
+ * with the same config.
+ */
+
+/*
+ * Defines
+ */
+
+#define FRAME_CODEC_MAX_FIELDS (40)
+#define FRAME_CODEC_MAX_VARINT_LEN (5)
+#define FRAME_CODEC_MAX_LEN(numOfFields) (1 + (numOfFields) * FRAME_CODEC_MAX_VARINT_LEN)
+
+#define FRAME_CODEC_DELTA (0x00)
+#define FRAME_CODEC_KEYFRAME (0x01)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    FRAME_CODEC_PREDICT_NONE,     // the value itself, for fields without correlation
+    FRAME_CODEC_PREDICT_PREVIOUS, // the previous value, for slowly changing fields
+    FRAME_CODEC_PREDICT_LINEAR,   // 2 * previous - the one before, for ramps such as time
+} FrameCodecPredictorType;
+
+typedef struct {
+    int numOfFields;
+    const uint8_t* pPredictors;   // FrameCodecPredictorType per field
+    uint32_t keyframeInterval;    // 1 codes every frame as a keyframe
+} FrameCodecConfigType;
+
+typedef struct {
+    const FrameCodecConfigType* pConfig;
+    int32_t prev[FRAME_CODEC_MAX_FIELDS];
+    int32_t prev2[FRAME_CODEC_MAX_FIELDS];
+    uint32_t history;             // frames in prev/prev2, 0 until the first keyframe
+    uint32_t framesSinceKeyframe;
+} FrameCodecStateType;
+
+/*
+ * Prototype
+ */
+
+bool FrameCodec_Init(FrameCodecStateType* pState, const FrameCodecConfigType* pConfig);
+// the next frame is a keyframe, e.g. after the encoded output was lost
+void FrameCodec_Reset(FrameCodecStateType* pState);
+// returns the encoded length, 0 if it does not fit into outSize
+int FrameCodec_Encode(FrameCodecStateType* pState, const int32_t* pFields, uint8_t* pOut, int outSize);
+// returns the number of bytes consumed, 0 if the frame is truncated or
+// malformed, or a delta frame arrived before the first keyframe
+int FrameCodec_Decode(FrameCodecStateType* pState, const uint8_t* pIn, int inSize, int32_t* pFields);
+
+#endif
@@ -3,17 +3,68 @@
 
 #include <stdint.h>
 
+/*
+ * I2C1 driver.
+ *
+ * I2C_Read()/I2C_Write() block until the transfer is done. I2C_ReadAsync()/
+ * I2C_WriteAsync() queue a transaction instead and return at once; the
+ * queue runs one transaction after the other on the I2C1 interrupts and
+ * reports each through its callback. pData must stay untouched until then.
+ *
+ * A transaction that does not complete within I2C_ASYNC_TIMEOUT_MS, plus the
+ * time its bytes take on the wire, is aborted from I2C_OnTick(): the
+ * peripheral is reset, with a bus clear of up to 9 SCL pulses and a STOP in
+ * between for a slave that still holds SDA low. Errors, timeouts and
+ * rejected transactions are counted in I2CStatsType, nothing waits on them.
+ * A blocking call waits for the queue to drain, transactions queued while it
+ * runs start when it is done.
+ */
+
+/*
+ * Defines
+ */
+
+#define I2C_QUEUE_LEN (4)
+#define I2C_ASYNC_TIMEOUT_MS (3)
+
+/*
+ * Struct
+ */
+
+// interrupt context, I2C1 or SysTick on a timeout; pData is the caller's again
+typedef void (*I2CDoneCb)(bool ok, void* pArg);
+
+typedef struct {
+    uint32_t transfers;     // queued transactions that completed
+    uint32_t errors;        // NACK, bus or arbitration error, or the start failed
+    uint32_t timeouts;      // aborted, see I2C_ASYNC_TIMEOUT_MS
+    uint32_t queueFull;     // rejected, I2C_QUEUE_LEN transactions waiting
+    uint32_t maxQueued;
+    uint32_t maxTransferUs; // start to completion
+} I2CStatsType;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 bool I2C_Init();
 void I2C_InterruptHandler();
+void I2C_ErrorInterruptHandler();
+// SysTick context, aborts a transaction that is late
+void I2C_OnTick();
 bool I2C_Write(uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *pData, uint16_t size);
 bool I2C_Read(uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *pData, uint16_t size);
+// false if the queue is full, cb is not called then
+bool I2C_WriteAsync(uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *pData, uint16_t size,
+                    I2CDoneCb cb, void* pArg);
+bool I2C_ReadAsync(uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *pData, uint16_t size,
+                   I2CDoneCb cb, void* pArg);
+bool I2C_IsIdle();
+void I2C_GetStats(I2CStatsType* pStats);
+void I2C_ResetStats();
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,86 @@
+#ifndef DRIVER_IMU_BUS_H_
+#define DRIVER_IMU_BUS_H_
+
+#include <stdint.h>
+
+/*
+ * Register access to the MPU9250 and the sensors behind it, over whichever
+ * bus it is wired to.
+ *
+ * MPU9250 and the InvenSense DMP driver (inv_mpu.c) go through ImuBus_*
+ * instead of a bus driver. The calls follow i2c.h: devAddr is the shifted
+ * I2C address, ImuBus_Read()/ImuBus_Write() block and ImuBus_ReadAsync()/
+ * ImuBus_WriteAsync() queue the transaction and report through the callback.
+ *
+ * The backend is UAV_IMU_BUS unless ImuBus_SetBackend() picked another one
+ * before ImuBus_Init():
+ * - "i2c", I2C1 (i2c.h), reaches the MPU9250 and, through the bypass, the
+ *   AK8963.
+ * - "spi", SPI2 with DMA (spi.h), reads the sensor registers at 16 MHz; only
+ *   the MPU9250 itself is on the bus, a transaction for any other address
+ *   fails. The AK8963 is then read by the MPU9250's I2C master, see
+ *   UAV_IMU_MAG_AUX.
+ */
+
+/*
+ * Defines
+ */
+
+#define IMU_BUS_I2C (0)
+#define IMU_BUS_SPI (1)
+
+/*
+ * Struct
+ */
+
+// interrupt context; pData is the caller's again
+typedef void (*ImuBusDoneCb)(bool ok, void* pArg);
+
+typedef struct {
+    uint32_t transfers;     // queued transactions that completed
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t queueFull;
+    uint32_t maxQueued;
+    uint32_t queueLen;
+    uint32_t maxTransferUs; // start to completion
+} ImuBusStatsType;
+
+typedef struct {
+    const char* name;
+    int bus; // IMU_BUS_I2C or IMU_BUS_SPI, the MPU9250 interface it talks to
+    bool (*init)();
+    // SysTick context
+    void (*onTick)();
+    bool (*read)(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+    bool (*write)(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+    bool (*readAsync)(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+    bool (*writeAsync)(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+    void (*getStats)(ImuBusStatsType* pStats);
+    void (*resetStats)();
+} ImuBusBackendType;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// IMU_BUS_I2C or IMU_BUS_SPI, NULL for anything else
+const ImuBusBackendType* ImuBus_GetBuiltinBackend(int bus);
+// before ImuBus_Init(), false if pBackend is incomplete
+bool ImuBus_SetBackend(const ImuBusBackendType* pBackend);
+const ImuBusBackendType* ImuBus_GetBackend();
+bool ImuBus_Init();
+void ImuBus_OnTick();
+bool ImuBus_Write(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+bool ImuBus_Read(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+// false if the transaction could not be queued, cb is not called then
+bool ImuBus_WriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+bool ImuBus_ReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+void ImuBus_GetStats(ImuBusStatsType* pStats);
+void ImuBus_ResetStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef _LIB_LATEST_VALUE_H_
+#define _LIB_LATEST_VALUE_H_
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Wait-free single producer / single consumer channel that only keeps the
+ * latest value of type T, e.g. an ISR handing a sensor sample or a receiver
+ * frame to the main loop.
+ *
+ * Triple buffer: the producer owns one slot, the consumer owns one and the
+ * third holds the latest published value. Publishing and taking a value
+ * each swap a slot index with that third slot in one atomic exchange, so
+ * neither side ever waits, copies, or touches a slot the other side owns.
+ * The producer fills its slot in place (BeginWrite(), even as a DMA target)
+ * and EndWrite() publishes it; the consumer calls Update() and reads
+ * Latest() in place until its next Update().
+ *
+ * A slot cannot be torn. Each published value carries a sequence number,
+ * counting from 1, and the producer's capture time: Update() returning
+ * false means Latest() is stale, a sequence gap of more than one means the
+ * consumer missed values, and the time stamp tells the age.
+ *
+ * Storage is part of the object, so a file scope or member LatestValue
+ * needs no heap.
+ */
+
+template <typename T>
+class LatestValue
+{
+public:
+    typedef struct {
+        T value;
+        uint32_t seq;     // 0 until the first value is published
+        uint64_t timeUs;  // capture time, as passed to EndWrite()
+    } SlotType;
+
+    LatestValue() : mShared(1), mWrite(0), mRead(2), mSeq(0)
+    {
+        for (int i = 0; i < NUM_OF_SLOTS; ++i) {
+            mSlots[i].seq = 0;
+            mSlots[i].timeUs = 0;
+        }
+    }
+
+    /*
+     * Producer
+     */
+
+    // the producer's slot, holds an older value until it is overwritten
+    T* BeginWrite() { return &mSlots[mWrite].value; }
+
+    void EndWrite(uint64_t timeUs)
+    {
+        SlotType& slot = mSlots[mWrite];
+        slot.seq = ++mSeq;
+        slot.timeUs = timeUs;
+        // release: the slot is complete before the consumer can take it
+        uint8_t prev = mShared.exchange((uint8_t) (mWrite | NEW_BIT), std::memory_order_acq_rel);
+        mWrite = prev & INDEX_MASK;
+    }
+
+    void Publish(const T& value, uint64_t timeUs)
+    {
+        *BeginWrite() = value;
+        EndWrite(timeUs);
+    }
+
+    /*
+     * Consumer
+     */
+
+    // takes the latest published value, false if there was none since the last call
+    bool Update()
+    {
+        if (!(mShared.load(std::memory_order_relaxed) & NEW_BIT)) return false;
+        // acquire: pairs with the release in EndWrite()
+        uint8_t prev = mShared.exchange(mRead, std::memory_order_acq_rel);
+        mRead = prev & INDEX_MASK;
+        return true;
+    }
+
+    // the value taken by the last Update(), valid until the next one
+    const SlotType& Latest() const { return mSlots[mRead]; }
+
+private:
+    enum { NUM_OF_SLOTS = 3, INDEX_MASK = 0x03, NEW_BIT = 0x04 };
+
+    SlotType mSlots[NUM_OF_SLOTS];
+    std::atomic<uint8_t> mShared; // index of the latest value, NEW_BIT until the consumer takes it
+    uint8_t mWrite;               // producer only
+    uint8_t mRead;                // consumer only
+    uint32_t mSeq;                // producer only
+};
+
+#endif
@@ -1,26 +1,64 @@
 #ifndef _LED_H_
 #define _LED_H_
 
+#include <stdint.h>
+
+/*
+ * LED patterns, played from SysTick by LED_OnTick(); nothing here waits.
+ *
+ * A pattern is up to LED_PATTERN_MAX_STEPS steps of LED_PATTERN_STEP_MS, step
+ * n lit if bit n is set. What an LED shows, highest priority first:
+ *  - LED_STATE_FAILSAFE, while set,
+ *  - the queued one-shot patterns, LED_Blink() and LED_QueuePattern(), one
+ *    after the other,
+ *  - LED_STATE_ARMED, then LED_STATE_TUNING, while set,
+ *  - the level LED_SetOn() and LED_Toggle() set.
+ * The state patterns repeat and restart whenever they come to the front.
+ */
+
+/*
+ * Defines
+ */
+
+#define LED_PATTERN_STEP_MS (100)
+#define LED_PATTERN_MAX_STEPS (32)
+#define LED_QUEUE_LEN (4) // one-shot patterns waiting per LED
+#define LED_BLINK_TOGGLE_MS (200)
+
 /*
  * Struct
  */
 
 typedef enum {
     LED_ONBOARD,
+    NUM_OF_LEDS
 } LEDType;
 
+// in rising priority
+typedef enum {
+    LED_STATE_TUNING,
+    LED_STATE_ARMED,
+    LED_STATE_FAILSAFE,
+    NUM_OF_LED_STATES
+} LEDStateType;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 bool LED_Init();
+// SysTick context, steps the patterns
+void LED_OnTick();
 bool LED_SetOn(LEDType led, bool on);
 bool LED_Toggle(LEDType led);
+// cnt toggles LED_BLINK_TOGGLE_MS apart, queued; false if the queue is full
 bool LED_Blink(LEDType led, uint8_t cnt);
+bool LED_QueuePattern(LEDType led, uint32_t bits, uint8_t steps);
+bool LED_SetState(LEDType led, LEDStateType state, bool set);
 // bool LED_SetRGBColour(uint32_t colour);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
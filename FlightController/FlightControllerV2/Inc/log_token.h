@@ -0,0 +1,64 @@
+#ifndef _LIB_LOG_TOKEN_H_
+#define _LIB_LOG_TOKEN_H_
+
+#include <stdint.h>
+
+/*
+ * Tokenized log format, shared by the firmware and the host decoder.
+ *
+ * With UAV_LOG_TOKENIZED every LOGx/PRINT call site is identified by a 32 bit
+ * token, the FNV-1a hash of its tag and format string computed by the
+ * compiler. The firmware sends the token and the raw arguments, the host
+ * decoder (Tools/LogDecoder) finds the format string in a table generated
+ * from the sources and does the formatting.
+ *
+ * Frame, little endian:
+ *
+ *     sync | level | len | token[4] | args[len] | checksum
+ *
+ * checksum is the 8 bit sum of level to the last argument byte. Arguments
+ * are packed by conversion:
+ *  - d i u o x X c p and '*' width/precision: 4 bytes, 8 bytes with ll
+ *  - f F e E g G a A: 4 byte float
+ *  - s: length byte followed by the characters, no terminator
+ * Arguments that do not fit into LOG_TOKEN_MAX_ARGS_LEN are cut off.
+ */
+
+/*
+ * Defines
+ */
+
+#define LOG_TOKEN_SYNC (0xA5)
+#define LOG_TOKEN_LEVEL_PRINT (0x0F) // PRINT, no level/tag header
+#define LOG_TOKEN_HEADER_LEN (7)     // sync, level, len, token
+#define LOG_TOKEN_MAX_ARGS_LEN (64)
+#define LOG_TOKEN_MAX_FRAME_LEN (LOG_TOKEN_HEADER_LEN + LOG_TOKEN_MAX_ARGS_LEN + 1)
+#define LOG_TOKEN_MAX_STR_LEN (24)   // longer %s arguments are truncated
+
+#define LOG_TOKEN_FNV_OFFSET (2166136261u)
+#define LOG_TOKEN_FNV_PRIME (16777619u)
+
+#ifdef __cplusplus
+/*
+ * Code
+ */
+
+constexpr uint32_t LogTokenHash(const char* pStr, uint32_t hash)
+{
+    return *pStr ? LogTokenHash(pStr + 1, (hash ^ (uint8_t) *pStr) * LOG_TOKEN_FNV_PRIME) : hash;
+}
+
+// the tag is terminated by a 0 byte so "ab" + "c" and "a" + "bc" differ
+constexpr uint32_t LogToken(const char* pTag, const char* pFmt)
+{
+    return LogTokenHash(pFmt, LogTokenHash(pTag, LOG_TOKEN_FNV_OFFSET) * LOG_TOKEN_FNV_PRIME);
+}
+
+// forces the hash to be evaluated at compile time
+template <uint32_t token>
+struct LogTokenId {
+    static const uint32_t value = token;
+};
+#endif
+
+#endif
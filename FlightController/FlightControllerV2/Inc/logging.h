@@ -6,6 +6,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "UAV_Defines.h"
+#include "log_token.h"
+
 /*
  * Defines
  */
@@ -17,43 +20,49 @@
 
 #define LOG_LEVEL LOG_INFO
 
+#if UAV_LOG_TOKENIZED && defined(__cplusplus)
+// the format string is the first of the macro arguments
+#define LOG_FIRST_ARG(...) LOG_FIRST_ARG_(__VA_ARGS__, 0)
+#define LOG_FIRST_ARG_(first, ...) first
+#define LOG_PRINT(level, tag, ...) LogPrintToken((level), LogTokenId<LogToken(tag, LOG_FIRST_ARG(__VA_ARGS__))>::value, __VA_ARGS__)
+#define LOG_PRINT_RAW(...) LogPrintToken(LOG_TOKEN_LEVEL_PRINT, LogTokenId<LogToken("", LOG_FIRST_ARG(__VA_ARGS__))>::value, __VA_ARGS__)
+#else
+#define LOG_PRINT(level, tag, ...) LogPrint((level), tag, __VA_ARGS__)
+#define LOG_PRINT_RAW(...) Print(__VA_ARGS__)
+#endif
+
 #if LOG_LEVEL >= LOG_ERROR
-#define LOGE(...) LogPrint(LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) LOG_PRINT(LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #else
 #define LOGE(...)
 #endif
 #if LOG_LEVEL >= LOG_INFO
-#define LOGI(...) LogPrint(LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) LOG_PRINT(LOG_INFO, LOG_TAG, __VA_ARGS__)
 #else
 #define LOGI(...)
 #endif
 #if LOG_LEVEL >= LOG_WARNING
-#define LOGW(...) LogPrint(LOG_WARNING, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) LOG_PRINT(LOG_WARNING, LOG_TAG, __VA_ARGS__)
 #else
 #define LOGW(...)
 #endif
 #if LOG_LEVEL >= LOG_VERBOSE
-#define LOGV(...) LogPrint(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
+#define LOGV(...) LOG_PRINT(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
 #else
 #define LOGV(...)
 #endif
-#define PRINT(...) Print(__VA_ARGS__)
-
-/*
- * Static
- */
-
-static char LEVEL_MAP[] = {
-   'E',
-   'W',
-   'I',
-   'V',
-};
+#define PRINT(...) LOG_PRINT_RAW(__VA_ARGS__)
 
 /*
  * Prototype
  */
 void LogPrint(int level, const char* pTag, const char* pFmt, ...);
 void Print(const char* pFmt, ...);
+// token, level and raw arguments only, formatted on the host
+void LogPrintToken(int level, uint32_t token, const char* pFmt, ...);
+// with UAV_DEBUG_CMD, everything logged in between goes out even without
+// UAV_Debug, main loop only
+void LogBeginReply();
+void LogEndReply();
 
 #endif
\ No newline at end of file
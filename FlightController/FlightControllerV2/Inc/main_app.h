@@ -1,8 +1,21 @@
 #ifndef _MAIN_APP_H
 #define _MAIN_APP_H
 
+#include <stdint.h>
+
 void MainApp();
 
+// MainApp() is MainApp_Init() followed by MainApp_Loop() forever. They are
+// exposed separately so a host harness can step the loop itself.
+bool MainApp_Init();
+void MainApp_Loop();
+
 void MainApp_OnCoreTimerTick();
+bool MainApp_IsArmed();
+// times a receiver failsafe disarmed, the receiver flagged it or sent nothing
+uint32_t MainApp_GetFailsafeDisarmCount();
+// times the IMU data-ready edges stopped and the pipeline went on with
+// polled reads, UAV_IMU_PIPELINE only
+uint32_t MainApp_GetImuPolledCount();
 
-#endif
\ No newline at end of file
+#endif
@@ -1,9 +1,12 @@
 #ifndef _MOTOR_CTRL_H_
 #define _MOTOR_CTRL_H_
 
+#include "UAV_Defines.h"
+
 class MotorCtrl {
 private:
     bool mToClampThrust;
+    FCMotorPWMType mMotorPWM; // last output, 0 while stopped
     MotorCtrl(); // private constructor, singleton
 
 public:
@@ -12,6 +15,7 @@ public:
     bool StartMotor();
     bool EnableThrustClamp(bool enable);
     bool OutputMotor(float pitchThrust, float rollThrust, float yawThrust, float heightThrust);
+    bool GetMotorPWM(FCMotorPWMType& motorPWM);
 };
 
 #endif
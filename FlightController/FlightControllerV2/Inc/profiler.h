@@ -0,0 +1,86 @@
+#ifndef _LIB_PROFILER_H_
+#define _LIB_PROFILER_H_
+
+#include <stdint.h>
+
+#include "UAV_Defines.h"
+
+/*
+ * Cycle-count profiler.
+ *
+ * Each profile point keeps count, min/max/total cycles and a log2 histogram:
+ * bucket k counts samples of [2^k, 2^(k+1)) cycles, bucket 0 also takes 0
+ * and the last bucket takes everything above. Points are registered by
+ * name, typically from a file scope static so registration happens once
+ * during static initialisation:
+ *
+ *     static const int sProfileCompute = Profiler_Register("PID::Compute");
+ *
+ *     bool PID::Compute()
+ *     {
+ *         ProfilerScope profile(sProfileCompute);
+ *         ...
+ *
+ * Recording is meant for thread context only. With UAV_PROFILE set to 0
+ * Profiler_Start/Stop and ProfilerScope compile to nothing.
+ */
+
+/*
+ * Defines
+ */
+
+#define PROFILER_MAX_POINTS (16) // the library points plus a scheduler task each
+#define PROFILER_NUM_OF_BUCKETS (24) // last bucket: >= 2^23 cycles, ~131ms at 64MHz
+#define PROFILER_INVALID_ID (-1)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint32_t histogram[PROFILER_NUM_OF_BUCKETS];
+} ProfilerStatsType;
+
+/*
+ * Prototype
+ */
+
+int Profiler_Register(const char* name);
+// cycle source, Clock_GetCycles() unless overridden (the SIL uses host time)
+uint32_t Profiler_GetCycles();
+void Profiler_Record(int id, uint32_t cycles);
+int Profiler_GetNumOfPoints();
+const char* Profiler_GetName(int id);
+bool Profiler_GetStats(int id, ProfilerStatsType* pStats);
+void Profiler_Reset();
+void Profiler_Print();
+
+#if UAV_PROFILE
+#define Profiler_Start() Profiler_GetCycles()
+#define Profiler_Stop(id, startCycles) Profiler_Record((id), Profiler_GetCycles() - (startCycles))
+#else
+#define Profiler_Start() (0)
+#define Profiler_Stop(id, startCycles)
+#endif
+
+#ifdef __cplusplus
+class ProfilerScope
+{
+public:
+#if UAV_PROFILE
+    explicit ProfilerScope(int id) : mId(id), mStartCycles(Profiler_GetCycles()) {}
+    ~ProfilerScope() { Profiler_Record(mId, Profiler_GetCycles() - mStartCycles); }
+private:
+    int mId;
+    uint32_t mStartCycles;
+#else
+    explicit ProfilerScope(int id) {}
+#endif
+};
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _LIB_RC_SMOOTHING_H_
+#define _LIB_RC_SMOOTHING_H_
+
+#include <stdint.h>
+
+/*
+ * Shapes stick setpoints between receiver frames, so the control loops,
+ * which run faster than the receiver sends, see a continuous reference
+ * instead of steps.
+ *
+ * RcSmoothing_SetTarget() takes the values of each frame with its arrival
+ * time, RcSmoothing_Get() returns the reference at the time a loop runs:
+ *  - RC_SMOOTHING_OFF: the latest frame as is,
+ *  - RC_SMOOTHING_INTERPOLATE: a linear ramp from where the reference was
+ *    when the frame arrived to the frame's values, over one frame period
+ *    (measured from the arrival times). Adds up to one frame of lag at the
+ *    end of a stick move, none at its start.
+ *  - RC_SMOOTHING_PT1: a first order low pass at cutoffHz, also filters
+ *    stick and receiver noise.
+ *
+ * No HAL dependencies, times are in the caller's microsecond clock.
+ */
+
+/*
+ * Defines
+ */
+
+#define RC_SMOOTHING_MAX_CHANNELS (4)
+#define RC_SMOOTHING_DEFAULT_PERIOD_US (14000)
+// arrival intervals outside this are gaps or bursts, not the frame period
+#define RC_SMOOTHING_MIN_PERIOD_US (2000)
+#define RC_SMOOTHING_MAX_PERIOD_US (50000)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    RC_SMOOTHING_OFF,
+    RC_SMOOTHING_INTERPOLATE,
+    RC_SMOOTHING_PT1,
+} RcSmoothingModeType;
+
+typedef struct {
+    RcSmoothingModeType mode;
+    int numOfChannels;
+    float cutoffHz;                          // PT1 only
+    float from[RC_SMOOTHING_MAX_CHANNELS];   // reference when the target arrived
+    float target[RC_SMOOTHING_MAX_CHANNELS];
+    float out[RC_SMOOTHING_MAX_CHANNELS];    // PT1 state
+    uint64_t frameUs;                        // arrival of the target
+    uint64_t lastUs;                         // last RcSmoothing_Get(), PT1 only
+    uint32_t framePeriodUs;                  // running average of the arrival intervals
+    bool hasTarget;
+} RcSmoothingType;
+
+/*
+ * Prototype
+ */
+
+bool RcSmoothing_Init(RcSmoothingType* pSmoothing, RcSmoothingModeType mode, int numOfChannels, float cutoffHz);
+// forget the reference, the next target is taken as is, e.g. after arming
+void RcSmoothing_Reset(RcSmoothingType* pSmoothing);
+
+void RcSmoothing_SetTarget(RcSmoothingType* pSmoothing, const float* pTarget, uint64_t frameUs);
+// writes numOfChannels values, false before the first target
+bool RcSmoothing_Get(RcSmoothingType* pSmoothing, uint64_t nowUs, float* pOut);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef DRIVER_RC_UART_H_
+#define DRIVER_RC_UART_H_
+
+#include "stm32f1xx_hal.h"
+
+/*
+ * The receiver's serial input on USART3, shared by the receiver protocols.
+ *
+ * A circular DMA receives continuously. The idle line interrupt and the
+ * DMA half and full transfer interrupts hand whatever it wrote since the
+ * last look to the protocol that started it, so a frame is seen right when
+ * the receiver stops sending and at most half a buffer late otherwise.
+ * RcUart_Start() reconfigures the line for the protocol (SBUS is 100000 8E2,
+ * CRSF 420000 8N1) and can switch between them at run time.
+ *
+ * The line is shared, not the protocol: SBUS is inverted and goes through
+ * the board's inverter, a CRSF receiver must be wired around it.
+ */
+
+// interrupt context, bytes the DMA wrote, stamped when they were handed over
+typedef void (*RcUartRxCb)(const uint8_t* pData, uint32_t len, uint64_t timeUs);
+// interrupt context, the line went idle or a UART error broke the stream
+typedef void (*RcUartIdleCb)(void);
+
+typedef struct {
+    uint32_t baudRate;
+    uint32_t wordLength; // UART_WORDLENGTH_x, parity included
+    uint32_t stopBits;
+    uint32_t parity;
+    RcUartRxCb rxCb;
+    RcUartIdleCb idleCb;
+} RcUartConfigType;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// stops whatever was running and starts receiving with pConfig
+bool RcUart_Start(const RcUartConfigType* pConfig);
+void RcUart_Stop();
+void RcUart_InterruptHandler();
+void RcUart_DMAInterruptHandler();
+// parity, framing, noise or overrun, each restarts the DMA
+uint32_t RcUart_GetErrors();
+void RcUart_ResetErrors();
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -10,17 +10,67 @@ typedef enum {
     RECEIVER_LOST_FRAME
 } ReceiverStatus;
 
+// the serial protocol on the receiver UART. AUTO tries each in turn until
+// one of them decodes a frame.
+typedef enum {
+    RECEIVER_PROTOCOL_AUTO,
+    RECEIVER_PROTOCOL_SBUS,
+    RECEIVER_PROTOCOL_CRSF,
+    NUM_OF_RECEIVER_PROTOCOLS
+} ReceiverProtocolType;
+
+typedef enum {
+    RECEIVER_START_PENDING,
+    RECEIVER_START_DONE,
+    RECEIVER_START_FAILED
+} ReceiverStartStatusType;
+
+// interrupt context, a new frame is ready for GetCmd()
+typedef void (*ReceiverFrameCb)(void);
+
 class Receiver {
 private:
     // private constructor, singleton paradigm
     Receiver();
+
+    // channels of the latest frame, in the protocols' common 172..1811 range
+    typedef struct {
+        int channels[16];
+        bool failsafe;
+        bool lostFrame;
+        uint32_t frameSeq;
+        uint64_t frameTimeUs;
+    } ReceiverDataType;
+
+    bool StartProtocol(ReceiverProtocolType protocol);
+    void StopProtocol(ReceiverProtocolType protocol);
+    bool IsReceiving(ReceiverProtocolType protocol);
+    bool Read(ReceiverDataType& data);
+    bool ProbeNext();
+
+    ReceiverProtocolType mProtocol; // as set
+    ReceiverProtocolType mActive;   // found by Start(), AUTO until then
+    ReceiverProtocolType mProbing;  // waiting for its first frame, AUTO if none
+    uint32_t mProbeStartMs;
 public:
     static Receiver& GetInstance();
 
     bool Init();
+    // waits for the first frame, false if none came
     bool Start();
-    // bool Stop();
+    // the same without waiting: BeginStart() starts the first protocol to
+    // try, PollStart() moves on to the next one when it timed out
+    bool BeginStart();
+    ReceiverStartStatusType PollStart();
+    void Stop();
+    // takes effect with the next Start()
+    bool SetProtocol(ReceiverProtocolType protocol);
+    // the protocol Start() found, AUTO while not receiving
+    ReceiverProtocolType GetProtocol();
+    static const char* GetProtocolName(ReceiverProtocolType protocol);
+    bool SetFrameCb(ReceiverFrameCb cb);
+    // from the latest frame, cmd.frameSeq is unchanged if there was no new one
     ReceiverStatus GetCmd(FCCmdType& cmd);
 };
 
-#endif
\ No newline at end of file
+#endif
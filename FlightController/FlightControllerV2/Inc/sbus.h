@@ -3,28 +3,42 @@
 
 #include "stm32f1xx_hal.h"
 
+#include "sbus_decoder.h"
+
 // empirical
 #define SBUS_CHANNEL_MIN 172
 #define SBUS_CHANNEL_MAX 1811
 
 typedef struct {
     int channels[16]; // val between SBUS_CHANNEL_MIN and SBUS_CHANNEL_MAX
-    bool failsafe;
+    bool failsafe;        // also set when stale
     bool lostFrame;
+    bool stale;           // no new frame for UAV_RC_LINK_TIMEOUT_MS, or none yet
+    uint32_t frameSeq;    // counts received frames from 1, unchanged if SBUS_Read() saw no new frame
+    uint64_t frameTimeUs; // Clock_GetUs() when the frame was complete
 } SBUSDataType;
 
+// interrupt context, after the frame is ready for SBUS_Read()
+typedef void (*SBUSFrameCb)(void);
+
+typedef struct {
+    SBUSDecoderStatsType decoder;
+    uint32_t uartErrors; // RcUart_GetErrors(), parity, framing, noise or overrun
+} SBUSStatsType;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 bool SBUS_Init();
+// takes over the receiver UART, SBUS_IsReceiving() once the first frame is in
 bool SBUS_Start();
-void SBUS_InterruptHandler();
-void SBUS_DMAInterruptHandler();
+void SBUS_Stop();
+bool SBUS_IsReceiving();
 bool SBUS_Read(SBUSDataType* pSBUSData);
-
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void SBUS_SetFrameCb(SBUSFrameCb cb);
+void SBUS_GetStats(SBUSStatsType* pStats);
+void SBUS_ResetStats();
 #ifdef __cplusplus
 }
 #endif
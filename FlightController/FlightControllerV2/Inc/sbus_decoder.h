@@ -0,0 +1,80 @@
+#ifndef _LIB_SBUS_DECODER_H_
+#define _LIB_SBUS_DECODER_H_
+
+#include <stdint.h>
+
+/*
+ * Streaming SBUS frame decoder.
+ *
+ * Takes the received byte stream in any chunking, e.g. whatever a circular
+ * DMA buffer gained since the last look, and returns each complete frame. A
+ * frame is a 0x0F header, 22 bytes of channel data, a flags byte and an end
+ * byte (0x00, or 0x?4 for SBUS2 telemetry slots). SBUS has no checksum, so
+ * a frame is only accepted once what follows it agrees: an idle line, or the
+ * header of the next frame. A lost or stray byte inside a frame would
+ * otherwise pass, since the flags byte is usually a valid end byte too.
+ *
+ * Bytes before a header are skipped. A frame with a bad end byte, or one not
+ * followed by a header, is dropped and rescanned for the next header, so
+ * the decoder falls back into step right after corruption instead of
+ * waiting for the line to go idle. A frame cut short by an idle line is
+ * dropped.
+ *
+ * No HAL dependencies, the host tools feed it recorded byte streams.
+ */
+
+/*
+ * Defines
+ */
+
+#define SBUS_FRAME_LEN (25)
+#define SBUS_FRAME_HEADER (0x0F)
+#define SBUS_FRAME_FLAGS_BYTE (23)
+#define SBUS_FLAG_LOST_FRAME (0x04)
+#define SBUS_FLAG_FAILSAFE (0x08)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t frames;         // accepted frames
+    uint32_t resyncs;        // frames dropped for a bad end byte or no header after them
+    uint32_t partialFrames;  // frames cut short by an idle line
+    uint32_t skippedBytes;   // bytes dropped while looking for a header
+    uint32_t lostFrames;     // accepted frames the receiver flagged as lost
+    uint32_t failsafeFrames; // accepted frames with the failsafe flag
+    uint32_t minPeriodUs;    // between consecutive accepted frames
+    uint32_t maxPeriodUs;
+    uint64_t firstFrameUs;
+    uint64_t lastFrameUs;
+} SBUSDecoderStatsType;
+
+typedef struct {
+    uint8_t frame[SBUS_FRAME_LEN];   // being received
+    uint8_t pending[SBUS_FRAME_LEN]; // complete, waiting for an idle line or the next header
+    uint8_t len;
+    bool hasPending;
+    uint64_t pendingUs;
+    SBUSDecoderStatsType stats;
+} SBUSDecoderType;
+
+/*
+ * Prototype
+ */
+
+void SBUSDecoder_Init(SBUSDecoderType* pDec);
+void SBUSDecoder_ResetStats(SBUSDecoderType* pDec);
+
+// Both return a frame this confirmed, or NULL. The frame stays valid until
+// the next call and is stamped with the time of the byte that completed it.
+const uint8_t* SBUSDecoder_PutByte(SBUSDecoderType* pDec, uint8_t byte, uint64_t timeUs);
+// the line went idle (or the stream ended)
+const uint8_t* SBUSDecoder_OnIdle(SBUSDecoderType* pDec);
+
+// time stamp of the frame returned last
+uint64_t SBUSDecoder_GetFrameTimeUs(const SBUSDecoderType* pDec);
+// average over the accepted frames so far, 0 before the second one
+float SBUSDecoder_GetFrameRateHz(const SBUSDecoderStatsType* pStats);
+
+#endif
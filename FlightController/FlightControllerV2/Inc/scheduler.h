@@ -0,0 +1,81 @@
+#ifndef _LIB_SCHEDULER_H_
+#define _LIB_SCHEDULER_H_
+
+#include <stdint.h>
+
+/*
+ * Table-driven rate-monotonic scheduler.
+ *
+ * Scheduler_OnTick() runs from the core timer interrupt and releases every
+ * task whose period has elapsed. Event tasks (periodMs 0) are released by
+ * Scheduler_Trigger() instead, e.g. from a data-ready interrupt.
+ * Scheduler_RunNext() runs from the main loop
+ * and dispatches the highest priority released task whose dependencies are
+ * not pending, so tasks released on the same tick run in dependency order.
+ * Tasks run to completion; there is no preemption.
+ *
+ * Per task the scheduler records:
+ *  - overruns: a release found the previous job still pending, the new job
+ *    is dropped,
+ *  - deadline misses: a job completed later than release + deadline,
+ *  - budget overruns: a job executed longer than its budget,
+ *  - release-to-start latency, whose spread is the start jitter,
+ *  - release-to-completion response time, for an event task the end-to-end
+ *    latency from the event.
+ */
+
+/*
+ * Defines
+ */
+
+#define SCHEDULER_MAX_TASKS (8)
+#define SCHEDULER_TASK_BIT(id) (1u << (id))
+
+/*
+ * Struct
+ */
+
+typedef void (*SchedulerTaskFunc)(void);
+
+typedef struct {
+    const char* name;
+    SchedulerTaskFunc func;
+    uint16_t periodMs;     // 0 for an event task
+    uint16_t deadlineMs;   // relative to release, 0 means periodMs (unchecked for events)
+    uint32_t budgetUs;     // execution time budget, 0 means unchecked
+    uint8_t priority;      // 0 is highest
+    uint32_t dependsOn;    // SCHEDULER_TASK_BIT mask of task ids
+} SchedulerTaskConfigType;
+
+typedef struct {
+    uint32_t releases;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t deadlineMisses;
+    uint32_t budgetOverruns;
+    uint32_t minLatencyUs;
+    uint32_t maxLatencyUs;
+    uint32_t maxExecUs;
+    uint64_t totalExecUs;
+    uint32_t maxResponseUs;
+    uint64_t totalResponseUs;
+} SchedulerTaskStatsType;
+
+/*
+ * Prototype
+ */
+
+bool Scheduler_Init(const SchedulerTaskConfigType* pTasks, int numOfTasks);
+void Scheduler_OnTick();
+void Scheduler_Trigger(int taskId);
+// released as of an earlier Clock_GetUs(), e.g. the interrupt that started
+// the bus transfer the task waited for, so latency and response count from it
+void Scheduler_TriggerAt(int taskId, uint64_t eventUs);
+bool Scheduler_RunNext();
+int Scheduler_GetNumOfTasks();
+const char* Scheduler_GetTaskName(int taskId);
+bool Scheduler_GetStats(int taskId, SchedulerTaskStatsType* pStats);
+void Scheduler_ResetStats();
+void Scheduler_PrintStats();
+
+#endif
@@ -2,16 +2,137 @@
 #define _SENSOR_READER_H_
 
 #include "UAV_Defines.h"
+#include "IMU.h"
+#include "latest_value.h"
+#if UAV_IMU_FIFO
+#include "decimator.h"
+#endif
+
+#if USE_INTERRUPT
+// IMU bus interrupt context, a sample is ready for ReadSensorMeas(); timeUs is
+// its data-ready time
+typedef void (*SensorReadDoneCb)(uint64_t timeUs);
+
+typedef struct {
+    uint8_t data[MPU9250_MOTION6_LEN];
+} SensorBurstType;
+#endif
+
+#if UAV_IMU_FIFO
+// FIFO samples per pipeline cycle, the decimation factor; a drain reads whole
+// multiples of it and at most SENSOR_FIFO_MAX_SAMPLES, the rest stays for the
+// next one
+#define SENSOR_FIFO_DECIMATION (UAV_IMU_FIFO_RATE_HZ / UAV_IMU_SAMPLE_RATE_HZ)
+#define SENSOR_FIFO_MAX_SAMPLES (2 * SENSOR_FIFO_DECIMATION)
+#define SENSOR_FIFO_SAMPLE_PERIOD_US (1000000 / UAV_IMU_FIFO_RATE_HZ)
+#define SENSOR_FIFO_BURST_LEN (SENSOR_FIFO_MAX_SAMPLES * MPU9250_FIFO_MOTION6_LEN)
+#if UAV_IMU_DMP
+// the same for the DMP's packets, while IMU::IsDmpActive(); they need no
+// decimator, every one of them is published
+#define SENSOR_DMP_DECIMATION (UAV_IMU_DMP_RATE_HZ / UAV_IMU_SAMPLE_RATE_HZ)
+#define SENSOR_DMP_MAX_SAMPLES (2 * SENSOR_DMP_DECIMATION)
+#define SENSOR_DMP_SAMPLE_PERIOD_US (1000000 / UAV_IMU_DMP_RATE_HZ)
+#define SENSOR_DMP_BURST_LEN (SENSOR_DMP_MAX_SAMPLES * MPU9250_FIFO_DMP_LEN)
+#if SENSOR_DMP_BURST_LEN > SENSOR_FIFO_BURST_LEN
+#undef SENSOR_FIFO_BURST_LEN
+#define SENSOR_FIFO_BURST_LEN SENSOR_DMP_BURST_LEN
+#endif
+#endif
+
+typedef struct {
+    uint8_t data[SENSOR_FIFO_BURST_LEN];
+    uint16_t numOfSamples;
+} SensorFifoBurstType;
+
+typedef struct {
+    uint32_t reads;       // drains that brought samples
+    uint32_t samples;     // samples they brought
+    uint16_t minSamples;  // per drain
+    uint16_t maxSamples;
+    uint32_t shortReads;  // less than SENSOR_FIFO_DECIMATION samples in the FIFO, nothing read
+    uint32_t overflows;   // the FIFO filled up and was reset, samples lost
+#if UAV_IMU_DMP
+    uint32_t corrupt;     // DMP packets that failed the quaternion check
+#endif
+} SensorFifoStatsType;
+#endif
 
 class SensorReader {
 private:
     SensorReader(); // private constructor, singleton
 
     FCSensorDataType mSensorData;
+    bool mCalibrated; // the IMU bias, loaded or measured
+#if USE_INTERRUPT
+    // raw bursts from the IMU bus interrupt, converted by ReadSensorMeas(); the
+    // write slot is the transfer's target
+    LatestValue<SensorBurstType> mBursts;
+    volatile bool mReadPending;
+    bool mReadPolled; // started without a data-ready edge, stamped when it starts
+    uint64_t mReadTimeUs;
+    SensorReadDoneCb mReadDoneCb;
+    uint32_t mSkippedReads;
+
+    static void OnReadDone(bool ok, void* pArg);
+#endif
+#if UAV_IMU_FIFO
+    // the drain: FIFO_COUNT, then the records into a burst slot, or a reset
+    // if the FIFO overflowed or a failed drain left it amid a record
+    LatestValue<SensorFifoBurstType> mFifoBursts;
+    uint8_t mFifoCount[2];
+    uint16_t mFifoEdges;         // data-ready edges since the last drain
+    bool mFifoSynced;            // the FIFO starts with a whole record
+#if UAV_IMU_DMP
+    volatile bool mFifoCorrupt;  // a DMP packet was garbage, reset the FIFO
+#endif
+    SensorFifoStatsType mFifoStats;
+    DecimatorType mDecimator;
+    // what a FIFO record is, raw samples or the DMP's packets
+    uint16_t mFifoRecordLen;
+    uint16_t mFifoDecimation;
+    uint16_t mFifoMaxSamples;
+    uint32_t mFifoSamplePeriodUs;
+
+    static void OnFifoCount(bool ok, void* pArg);
+    static void OnFifoReset(bool ok, void* pArg);
+#endif
+#if UAV_IMU_DMP
+    bool ReadDmpMeas(const LatestValue<SensorFifoBurstType>::SlotType& burst);
+#endif
 public:
+    // latest IMU sample, stamped with its capture time. Producer is
+    // ReadSensorMeas(), consumer the tasks of the main loop.
+    LatestValue<FCSensorMeasType> mMeas;
+
     static SensorReader& GetInstance();
+    // brings the IMU up with the stored calibration if it passes the check
     bool Init();
-    bool GetSensorMeas(FCSensorMeasType& cmd);
+    // measures the IMU bias if Init() did not load it and stores it, the IMU
+    // has to be at rest; each poll takes the sample that is ready and returns
+    // true once the calibration is done
+    void BeginCalibration();
+    bool PollCalibration();
+    // with USE_INTERRUPT converts the burst StartRead() brought in, false
+    // if there is none since the last call; otherwise reads the IMU. With
+    // UAV_IMU_FIFO the burst holds several samples, each stamped with its
+    // own sample time, and the decimator's outputs are published
+    bool ReadSensorMeas();
+#if USE_INTERRUPT
+    // data-ready context, queues the burst read of the new sample and
+    // returns; the bus transfer runs while the main loop goes on. With
+    // UAV_IMU_FIFO only every SENSOR_FIFO_DECIMATION-th edge drains the FIFO.
+    // polled reads right away and stamps the sample with the current time,
+    // for a caller that has no data-ready edges and starts one per cycle
+    bool StartRead(bool polled = false);
+    void SetReadDoneCb(SensorReadDoneCb cb);
+    // data-ready edges whose sample was not read, the bus was still busy
+    // with the previous one or the queue was full
+    uint32_t GetSkippedReads();
+#endif
+#if UAV_IMU_FIFO
+    void GetFifoStats(SensorFifoStatsType* pStats);
+    void ResetFifoStats();
+#endif
 };
 
-#endif
\ No newline at end of file
+#endif
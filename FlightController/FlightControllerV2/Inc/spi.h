@@ -0,0 +1,73 @@
+#ifndef DRIVER_SPI_H_
+#define DRIVER_SPI_H_
+
+#include <stdint.h>
+
+/*
+ * SPI2 driver for one register based slave, the MPU9250 (PB13 SCK, PB14
+ * MISO, PB15 MOSI, PB1 chip select, mode 3).
+ *
+ * A transaction selects the slave, sends the register address, with bit 7
+ * set for a read, and moves the data after it. SPI_Read()/SPI_Write() block
+ * like I2C_Read()/I2C_Write(); SPI_ReadAsync()/SPI_WriteAsync() queue the
+ * transaction, which then runs on the DMA1 channel 4/5 interrupts and reports
+ * through its callback. pData must stay untouched until then.
+ *
+ * The MPU9250 takes 1 MHz for every register but up to 20 MHz for the sensor
+ * and interrupt status registers, SPI_SPEED_FAST is for reading those.
+ * Writes always go at SPI_SPEED_SLOW.
+ *
+ * A transaction that does not complete within SPI_ASYNC_TIMEOUT_MS, plus the
+ * time its bytes take on the wire, is aborted from SPI_OnTick().
+ */
+
+/*
+ * Defines
+ */
+
+#define SPI_QUEUE_LEN (4)
+#define SPI_ASYNC_TIMEOUT_MS (2)
+#define SPI_READ_FLAG (0x80)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    SPI_SPEED_SLOW, // 1 MHz, APB1 / 32
+    SPI_SPEED_FAST, // 16 MHz, APB1 / 2
+} SPISpeedType;
+
+// interrupt context, DMA1 or SysTick on a timeout; pData is the caller's again
+typedef void (*SPIDoneCb)(bool ok, void* pArg);
+
+typedef struct {
+    uint32_t transfers;     // queued transactions that completed
+    uint32_t errors;        // DMA or mode fault, or the start failed
+    uint32_t timeouts;      // aborted, see SPI_ASYNC_TIMEOUT_MS
+    uint32_t queueFull;     // rejected, SPI_QUEUE_LEN transactions waiting
+    uint32_t maxQueued;
+    uint32_t maxTransferUs; // start to completion
+} SPIStatsType;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool SPI_Init();
+// SysTick context, aborts a transaction that is late
+void SPI_OnTick();
+bool SPI_Write(uint8_t reg, uint8_t* pData, uint16_t size);
+bool SPI_Read(uint8_t reg, uint8_t* pData, uint16_t size, SPISpeedType speed);
+// false if the queue is full, cb is not called then
+bool SPI_WriteAsync(uint8_t reg, uint8_t* pData, uint16_t size, SPIDoneCb cb, void* pArg);
+bool SPI_ReadAsync(uint8_t reg, uint8_t* pData, uint16_t size, SPISpeedType speed, SPIDoneCb cb, void* pArg);
+bool SPI_IsIdle();
+void SPI_GetStats(SPIStatsType* pStats);
+void SPI_ResetStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
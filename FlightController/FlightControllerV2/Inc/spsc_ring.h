@@ -0,0 +1,164 @@
+#ifndef _LIB_SPSC_RING_H_
+#define _LIB_SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single producer / single consumer ring of N items of type T.
+ *
+ * Storage is part of the object, so a file scope or member SpscRing needs no
+ * heap. N must be a power of two; the head and tail indices run freely and
+ * are masked on access, so all N slots are usable and there is no modulo.
+ *
+ * Exactly one context may call the producer functions and exactly one the
+ * consumer functions, e.g. an ISR and the main loop. Each side only writes
+ * its own index and publishes it with release order after the slot
+ * accesses, and reads the other side's index with acquire order before
+ * them, so neither side ever sees a half written or still needed slot.
+ *
+ * Besides copying Push/Pop there are zero-copy variants: PeekWrite() or
+ * PeekWriteSpan() hand out free slots to fill in place and CommitWrite()
+ * publishes them; Peek() or PeekReadSpan() hand out the oldest items and
+ * CommitRead() releases them. A span stops at the end of the storage, call
+ * again after committing to get the wrapped part.
+ */
+
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : mHead(0), mTail(0) {}
+
+    static uint32_t Capacity() { return N; }
+
+    // either side, a snapshot that may be stale by the time it is used
+    uint32_t Size() const
+    {
+        uint32_t tail = mTail.load(std::memory_order_acquire);
+        uint32_t used = mHead.load(std::memory_order_acquire) - tail;
+        return used < N ? used : N;
+    }
+    bool IsEmpty() const { return Size() == 0; }
+    bool IsFull() const { return Size() == N; }
+
+    // only while neither side is active
+    void Reset()
+    {
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
+    }
+
+    /*
+     * Producer
+     */
+
+    bool Push(const T& item)
+    {
+        T* pSlot = PeekWrite();
+        if (!pSlot) return false;
+        *pSlot = item;
+        CommitWrite(1);
+        return true;
+    }
+
+    // returns the number of items pushed, less than count if the ring fills up
+    uint32_t PushBulk(const T* pItems, uint32_t count)
+    {
+        uint32_t pushed = 0;
+        while (pushed < count) {
+            T* pSlots;
+            uint32_t span = PeekWriteSpan(&pSlots);
+            if (span == 0) break;
+            if (span > count - pushed) span = count - pushed;
+            std::copy(pItems + pushed, pItems + pushed + span, pSlots);
+            CommitWrite(span);
+            pushed += span;
+        }
+        return pushed;
+    }
+
+    // next free slot, NULL if full
+    T* PeekWrite()
+    {
+        T* pSlots;
+        return PeekWriteSpan(&pSlots) ? pSlots : NULL;
+    }
+
+    // contiguous free slots starting at *ppSlots
+    uint32_t PeekWriteSpan(T** ppSlots)
+    {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        uint32_t free = N - (head - mTail.load(std::memory_order_acquire));
+        uint32_t index = head & (N - 1);
+        *ppSlots = &mItems[index];
+        return free < N - index ? free : N - index;
+    }
+
+    void CommitWrite(uint32_t count = 1)
+    {
+        mHead.store(mHead.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /*
+     * Consumer
+     */
+
+    bool Pop(T& item)
+    {
+        T* pItem = Peek();
+        if (!pItem) return false;
+        item = *pItem;
+        CommitRead(1);
+        return true;
+    }
+
+    // returns the number of items popped, less than count if the ring runs empty
+    uint32_t PopBulk(T* pItems, uint32_t count)
+    {
+        uint32_t popped = 0;
+        while (popped < count) {
+            T* pSlots;
+            uint32_t span = PeekReadSpan(&pSlots);
+            if (span == 0) break;
+            if (span > count - popped) span = count - popped;
+            std::copy(pSlots, pSlots + span, pItems + popped);
+            CommitRead(span);
+            popped += span;
+        }
+        return popped;
+    }
+
+    // oldest item, NULL if empty; the consumer may modify it until CommitRead()
+    T* Peek()
+    {
+        T* pSlots;
+        return PeekReadSpan(&pSlots) ? pSlots : NULL;
+    }
+
+    // contiguous items starting at *ppSlots, oldest first
+    uint32_t PeekReadSpan(T** ppSlots)
+    {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        uint32_t used = mHead.load(std::memory_order_acquire) - tail;
+        uint32_t index = tail & (N - 1);
+        *ppSlots = &mItems[index];
+        return used < N - index ? used : N - index;
+    }
+
+    void CommitRead(uint32_t count = 1)
+    {
+        mTail.store(mTail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+private:
+    T mItems[N];
+    std::atomic<uint32_t> mHead; // written by the producer only
+    std::atomic<uint32_t> mTail; // written by the consumer only
+};
+
+#endif
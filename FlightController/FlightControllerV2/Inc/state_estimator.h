@@ -7,6 +7,11 @@
 class StateEstimator {
 private:
     Madgwick mFilter;
+#if UAV_IMU_DMP
+    bool mDmpUsed;
+
+    void ConvertDmpQuat(const FCQuaternionType& quat);
+#endif
 
     StateEstimator(); // private constructor, singleton
 public:
@@ -14,7 +19,11 @@ public:
 
     static StateEstimator& GetInstance();
     bool Init();
-    bool EstimateState(FCSensorMeasType& meas);
+    // with UAV_IMU_DMP the attitude comes from meas.quat when it is valid,
+    // Madgwick fuses gyro and accel otherwise
+    bool EstimateState(const FCSensorMeasType& meas);
+    // what the last estimate came from, "dmp" or "madgwick"
+    const char* GetBackendName();
 };
 
 #endif
\ No newline at end of file
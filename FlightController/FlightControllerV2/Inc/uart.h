@@ -1,14 +1,56 @@
 #ifndef DRIVER_UART_H_
 #define DRIVER_UART_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Debug UART (USART2).
+ *
+ * UART_Send() only copies into a TX bip buffer (bip_buffer.h); DMA sends
+ * straight out of it in the background and the transfer complete interrupt
+ * starts the next span. A message that does not fit is dropped whole and
+ * counted, so a caller never waits for the wire.
+ */
+
+/*
+ * Defines
+ */
+
+#define UART_TX_BUF_SIZE (2048) // ~44ms of output at 460800 baud, holds a full stats dump
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t queuedMsgs;
+    uint32_t queuedBytes;
+    uint32_t droppedMsgs;
+    uint32_t droppedBytes;
+    uint32_t txErrors;
+    uint16_t maxUsedBytes;
+} UartTxStatsType;
+
+/*
+ * Prototype
+ */
+
 bool UART_Init();
-void UART_Send(const char* pData, const int dataSize);
+// non-blocking, false if the message was dropped for lack of space
+bool UART_Send(const char* pData, const int dataSize);
+bool UART_IsTxIdle();
+void UART_GetTxStats(UartTxStatsType* pStats);
+void UART_ResetTxStats();
+// non-blocking, false if no byte has arrived
+bool UART_ReadByte(char* pData);
+// USART2 error callback, dispatched from HAL_UART_ErrorCallback
+void UART_TxErrorHandler();
 
 #ifdef __cplusplus
 }
 #endif
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,22 @@
+#ifndef SIL_CORE_CM3_H_
+#define SIL_CORE_CM3_H_
+
+/*
+ * Host stand-in for the CMSIS Cortex-M3 core header. arm_math.h only needs
+ * the compiler abstraction macros; the DSP functions built for the host use
+ * their generic C paths.
+ */
+
+#include <stdint.h>
+
+#ifndef __INLINE
+#define __INLINE inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+#ifndef __ASM
+#define __ASM __asm
+#endif
+
+#endif
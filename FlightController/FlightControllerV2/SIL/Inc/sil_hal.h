@@ -0,0 +1,102 @@
+#ifndef SIL_HAL_H_
+#define SIL_HAL_H_
+
+#include <stdint.h>
+
+#include "stm32f1xx_hal.h"
+
+/*
+ * Virtual clock and peripheral hooks behind the host HAL stand-in.
+ *
+ * Time only moves when the firmware waits (HAL_Delay), when a bus transfer
+ * is on the wire, or when the harness idles to the next tick. Every 1 ms
+ * boundary that is crossed runs the tick hook, which plays the role of
+ * SysTick_Handler.
+ */
+
+#define SIL_TICK_US (1000)
+#define SIL_CORE_CLOCK (64000000) // matches the target SystemCoreClock
+
+typedef void (*SILTickHook)(void);
+typedef void (*SILIrqHandler)(void);
+typedef void (*SILUartTxHook)(const uint8_t* pData, uint16_t size);
+
+typedef struct {
+    uint16_t devAddr;
+    bool (*read)(uint16_t memAddr, uint8_t* pData, uint16_t size);
+    bool (*write)(uint16_t memAddr, const uint8_t* pData, uint16_t size);
+} SILI2CDeviceType;
+
+// selected by its chip select, a transaction is the register address, with
+// bit 7 set for a read, and the data after it
+typedef struct {
+    SPI_TypeDef* instance;
+    GPIO_TypeDef* csPort;
+    uint16_t csPin;
+    bool (*read)(uint16_t memAddr, uint8_t* pData, uint16_t size);
+    bool (*write)(uint16_t memAddr, const uint8_t* pData, uint16_t size);
+} SILSpiDeviceType;
+
+typedef struct {
+    uint32_t i2cTransfers;
+    uint32_t i2cErrors;
+    uint64_t i2cBusyUs;
+    uint32_t spiTransfers; // chip select windows
+    uint32_t spiErrors;
+    uint64_t spiBusyUs;
+    uint32_t uartTxBytes;
+    uint64_t uartTxBusyUs;
+    uint32_t uartRxBytes;
+    uint32_t uartRxDropped;
+} SILBusStatsType;
+
+// clock
+void SIL_Reset();
+uint64_t SIL_GetTimeUs();
+void SIL_AdvanceUs(uint64_t us);
+void SIL_AdvanceToNextTick();
+// to the next tick or bus completion, whichever interrupt comes first (__WFI)
+void SIL_WaitForInterrupt();
+void SIL_SetTickHook(SILTickHook hook);
+
+// GPIO / EXTI
+void SIL_AttachExtiIrq(IRQn_Type irq, SILIrqHandler handler);
+// short high pulse on an input, e.g. a sensor's data-ready line
+void SIL_GpioPulse(GPIO_TypeDef* port, uint16_t pin);
+
+// I2C
+bool SIL_AttachI2CDevice(const SILI2CDeviceType* pDevice);
+// added to every transfer, e.g. a device stretching the clock
+void SIL_SetI2CLatencyUs(uint32_t us);
+// every n-th interrupt driven transfer fails, alternately NACKed and with
+// the bus hung until the firmware resets the peripheral; 0 for none
+void SIL_SetI2CFaults(uint32_t oneInN);
+
+// SPI, SPI2 on the 32 MHz APB1
+bool SIL_AttachSpiDevice(const SILSpiDeviceType* pDevice);
+// every n-th DMA transfer fails, alternately with a DMA error and with the
+// completion interrupt lost until the firmware aborts it; 0 for none
+void SIL_SetSpiFaults(uint32_t oneInN);
+
+// UART
+void SIL_AttachUartIrq(USART_TypeDef* instance, SILIrqHandler handler);
+void SIL_SetUartTxHook(USART_TypeDef* instance, SILUartTxHook hook);
+void SIL_UartInject(USART_TypeDef* instance, const uint8_t* pData, uint16_t size);
+void SIL_UartLineIdle(USART_TypeDef* instance);
+// as last configured by HAL_UART_Init() or a transfer, 0 before
+uint32_t SIL_UartGetBaudRate(USART_TypeDef* instance);
+
+// TIM
+bool SIL_PwmIsRunning(TIM_TypeDef* instance, uint32_t channel);
+
+void SIL_GetBusStats(SILBusStatsType* pStats);
+
+// FLASH, the data page at FLASH_DATA_PAGE_ADDR. It keeps its content over
+// SIL_Reset() like the part over a power cycle; a file carries it from one run
+// to the next. Erasing and programming take the target's time.
+void SIL_FlashErase();
+// false if the file does not exist or has the wrong size, the page is erased then
+bool SIL_FlashLoad(const char* pPath);
+bool SIL_FlashSave(const char* pPath);
+
+#endif
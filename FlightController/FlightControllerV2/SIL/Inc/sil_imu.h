@@ -0,0 +1,46 @@
+#ifndef SIL_IMU_H_
+#define SIL_IMU_H_
+
+#include <stdint.h>
+
+#include "sil_hal.h"
+
+/*
+ * Register-level model of the MPU9250 and its AK8963 magnetometer on I2C1,
+ * the MPU9250 also on SPI2.
+ *
+ * The truth signals are in sensor axes: gyro in dps, accel in g (specific
+ * force as the chip reports it) and mag in uT. The output registers latch
+ * a new noisy, quantised sample at the configured output data rate. With
+ * USER_CTRL.FIFO_EN set, each sample also goes to the 512 byte FIFO as
+ * FIFO_EN selects it; a full FIFO drops its oldest bytes and flags
+ * FIFO_OFLOW in INT_STATUS.
+ *
+ * The DMP is memory behind BANK_SEL/MEM_START_ADDR/MEM_R_W that the
+ * InvenSense driver loads and configures. With USER_CTRL.DMP_EN set, a
+ * complementary filter stands in for its fusion, and every D_0_22 + 1
+ * samples a packet of quaternion, accel, gyro and gesture word, as the
+ * configuration words in its memory enable them, goes to the FIFO and
+ * raises the DMP interrupt.
+ */
+
+typedef struct {
+    float gyroNoiseDps;
+    float accNoiseG;
+    float gyroBiasDps[3];
+    float accBiasG[3];
+    // frame vibration on every axis, a sine on top of the truth; 0 Hz for none
+    float vibrationHz;
+    float vibrationDps;
+    float vibrationG;
+} SILImuConfigType;
+
+void SILImu_Init(const SILImuConfigType* pConfig, uint32_t seed);
+// called on every new motion sample while INT_ENABLE.RAW_RDY_EN is set,
+// plays the INT pin pulse
+void SILImu_SetIntHook(SILIrqHandler hook);
+void SILImu_SetTruth(const float gyroDps[3], const float accG[3], const float magUT[3]);
+// advance the chip by one 1 ms tick, latches new samples when they are due
+void SILImu_Tick();
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SIL_IMU_BUS_H_
+#define SIL_IMU_BUS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "imu_bus.h"
+
+/*
+ * Recording IMU bus backend. It wraps a real backend, normally the one
+ * ImuBus_GetBackend() returns, passes every transaction through and records
+ * when it started, when it was done, what it was and whether it went
+ * through. With a log file each transaction becomes one CSV line of
+ * "start_us,done_us,op,dev,reg,size,ok", op being r/w for blocking and
+ * ar/aw for queued transactions; a queued transaction that could not be
+ * queued has done_us 0.
+ */
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t asyncTransactions;
+    uint32_t bytes;
+    uint32_t failed;      // reported failed, or not queued
+    uint32_t notQueued;
+    uint64_t asyncLatencyUs; // queued to reported, summed over the queued ones
+    uint32_t maxAsyncLatencyUs;
+} SILImuBusSummaryType;
+
+// the backend to hand to ImuBus_SetBackend(); pLog may be NULL
+const ImuBusBackendType* SILImuBus_Wrap(const ImuBusBackendType* pInner, FILE* pLog);
+void SILImuBus_GetSummary(SILImuBusSummaryType* pSummary);
+
+#endif
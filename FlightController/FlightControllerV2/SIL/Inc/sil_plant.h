@@ -0,0 +1,43 @@
+#ifndef SIL_PLANT_H_
+#define SIL_PLANT_H_
+
+/*
+ * Attitude test-rig model: the frame pivots freely about its centre, so only
+ * roll/pitch/yaw dynamics are simulated (no translation). Each motor follows
+ * its PWM command through a first-order lag; the differential thrust of the
+ * X mixer produces angular acceleration, opposed by linear aerodynamic
+ * damping. Angles are integrated directly from body rates (small-angle).
+ * Below the lift-off thrust the frame rests level on the ground.
+ *
+ * Sign conventions follow the firmware: roll/pitch/yaw and rates are what
+ * StateEstimator reports, motor order is MotorCtrl::OutputMotor's.
+ */
+
+#define SIL_NUM_OF_MOTORS (4)
+
+typedef struct {
+    float motorTau;       // s
+    float torqueGain[3];  // dps/s per unit of mixer output, roll/pitch/yaw
+    float damping[3];     // 1/s
+    float liftOffThrust;  // mean motor output needed to leave the ground
+} SILPlantConfigType;
+
+typedef struct {
+    float att[3];         // deg, roll/pitch/yaw
+    float attRate[3];     // dps
+    float motor[SIL_NUM_OF_MOTORS]; // 0..1000
+} SILPlantStateType;
+
+enum {
+    SIL_AXIS_ROLL,
+    SIL_AXIS_PITCH,
+    SIL_AXIS_YAW,
+};
+
+void SILPlant_Init(const SILPlantConfigType* pConfig);
+void SILPlant_Step(float dt, const float motorCmd[SIL_NUM_OF_MOTORS]);
+void SILPlant_GetState(SILPlantStateType* pState);
+// IMU truth in sensor axes, the IMU is mounted upside down
+void SILPlant_GetImuTruth(float gyroDps[3], float accG[3], float magUT[3]);
+
+#endif
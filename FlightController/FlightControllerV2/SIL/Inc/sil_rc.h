@@ -0,0 +1,56 @@
+#ifndef SIL_RC_H_
+#define SIL_RC_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Receiver model on USART3, SBUS or CRSF. Stick positions come from a
+ * script of keyframes (time, channels) that hold until the next keyframe,
+ * either the built-in manoeuvre script or one loaded from a CSV file with
+ * lines of "time_ms,ch0,ch1,ch2,ch3,ch4". Every period the sticks are
+ * sampled into a frame, which arrives when its last byte is through the
+ * wire and is followed by an idle line, as a real receiver does. A CRSF
+ * receiver also sends link statistics every 100 ms.
+ *
+ * A UART set to another protocol's speed sees noise instead of the frames,
+ * so a firmware probing for the protocol finds only the right one.
+ *
+ * Optionally one in n frames is corrupted on the wire (a flipped bit, a lost
+ * byte or a stray byte) and the bytes as sent are written to a capture
+ * file, which fc_sbus_replay and fc_crsf_replay read.
+ */
+
+#define SIL_RC_NUM_OF_CHANNELS (16)
+#define SIL_RC_SCRIPT_CHANNELS (5)
+#define SIL_RC_FRAME_PERIOD_US (14000)   // SBUS
+#define SIL_RC_CRSF_RATE_HZ (250)        // default CRSF packet rate
+
+typedef enum {
+    SIL_RC_SBUS,
+    SIL_RC_CRSF
+} SILRcProtocolType;
+
+typedef struct {
+    uint32_t timeMs;
+    uint16_t channels[SIL_RC_SCRIPT_CHANNELS];
+} SILRcKeyframeType;
+
+void SILRc_Init();
+// rateHz is the CRSF packet rate, 0 for the default
+void SILRc_SetProtocol(SILRcProtocolType protocol, uint32_t rateHz);
+SILRcProtocolType SILRc_GetProtocol();
+bool SILRc_LoadScript(const char* path);
+void SILRc_SetScript(const SILRcKeyframeType* pKeyframes, int num);
+void SILRc_Tick(uint64_t nowUs);
+void SILRc_GetChannels(uint16_t channels[SIL_RC_NUM_OF_CHANNELS]);
+uint32_t SILRc_GetFrameCnt();
+// time an RC frame spends on the wire, from the stick sample to its last byte
+uint32_t SILRc_GetFrameWireUs();
+// frames that met a UART at another speed
+uint32_t SILRc_GetMismatchedCnt();
+void SILRc_SetCorruption(uint32_t oneInN, uint32_t seed);
+uint32_t SILRc_GetCorruptedCnt();
+void SILRc_SetCapture(FILE* pFile);
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef SIL_STM32F1XX_HAL_H_
+#define SIL_STM32F1XX_HAL_H_
+
+/*
+ * Host stand-in for the STM32F1 HAL.
+ *
+ * Only the types, macros and calls the firmware actually uses are provided.
+ * Peripherals are backed by the SIL models in sil_hal.cpp: time is virtual,
+ * bus transfers consume virtual time according to their wire length, and
+ * register writes (CCRx, CR1, ODR) are plain memory the models can inspect.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Common
+ */
+
+typedef enum {
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+#define __IO volatile
+#define __weak __attribute__((weak))
+
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) ((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+/*
+ * GPIO
+ */
+
+typedef struct {
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+
+#define GPIO_MODE_INPUT      0x00000000U
+#define GPIO_MODE_OUTPUT_PP  0x00000001U
+#define GPIO_MODE_OUTPUT_OD  0x00000011U
+#define GPIO_MODE_IT_RISING  0x10110000U
+#define GPIO_MODE_IT_FALLING 0x10210000U
+#define GPIO_NOPULL          0x00000000U
+#define GPIO_SPEED_FREQ_HIGH 0x00000003U
+
+/*
+ * NVIC
+ */
+
+typedef enum {
+    I2C1_EV_IRQn = 31,
+    I2C1_ER_IRQn = 32,
+    EXTI15_10_IRQn = 40,
+} IRQn_Type;
+
+/*
+ * I2C
+ */
+
+typedef struct {
+    __IO uint32_t DR;
+} I2C_TypeDef;
+
+typedef struct {
+    uint32_t ClockSpeed;
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef struct {
+    I2C_TypeDef* Instance;
+    I2C_InitTypeDef Init;
+    __IO uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT  0x00000001U
+#define I2C_MEMADD_SIZE_16BIT 0x00000010U
+#define I2C_DUTYCYCLE_2       0x00000000U
+
+/*
+ * DMA
+ */
+
+typedef struct {
+    uint32_t Direction;
+    uint32_t Mode;
+} DMA_InitTypeDef;
+
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    DMA_Channel_TypeDef* Instance;
+    DMA_InitTypeDef Init;
+} DMA_HandleTypeDef;
+
+#define DMA_NORMAL   0x00000000U
+#define DMA_CIRCULAR 0x00000020U
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->Instance->CNDTR)
+
+/*
+ * SPI
+ */
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+    uint32_t Mode;
+    uint32_t Direction;
+    uint32_t DataSize;
+    uint32_t CLKPolarity;
+    uint32_t CLKPhase;
+    uint32_t NSS;
+    uint32_t BaudRatePrescaler;
+    uint32_t FirstBit;
+} SPI_InitTypeDef;
+
+typedef struct {
+    SPI_TypeDef* Instance;
+    SPI_InitTypeDef Init;
+    DMA_HandleTypeDef* hdmatx;
+    DMA_HandleTypeDef* hdmarx;
+    __IO uint32_t ErrorCode;
+} SPI_HandleTypeDef;
+
+#define SPI_CR1_BR_Pos 3U
+#define SPI_CR1_BR     (0x7UL << SPI_CR1_BR_Pos)
+#define SPI_BAUDRATEPRESCALER_2   0x00000000U
+#define SPI_BAUDRATEPRESCALER_4   0x00000008U
+#define SPI_BAUDRATEPRESCALER_8   0x00000010U
+#define SPI_BAUDRATEPRESCALER_16  0x00000018U
+#define SPI_BAUDRATEPRESCALER_32  0x00000020U
+#define SPI_BAUDRATEPRESCALER_64  0x00000028U
+#define SPI_BAUDRATEPRESCALER_128 0x00000030U
+#define SPI_BAUDRATEPRESCALER_256 0x00000038U
+
+/*
+ * UART
+ */
+
+typedef struct {
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+    __IO uint32_t CR1;
+} USART_TypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+} UART_InitTypeDef;
+
+typedef struct {
+    USART_TypeDef* Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef* hdmatx;
+    DMA_HandleTypeDef* hdmarx;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B 0x00000000U
+#define UART_WORDLENGTH_9B 0x00001000U
+#define UART_STOPBITS_1    0x00000000U
+#define UART_STOPBITS_2    0x00002000U
+#define UART_PARITY_NONE   0x00000000U
+#define UART_PARITY_EVEN   0x00000400U
+
+#define USART_SR_IDLE 0x00000010U
+#define USART_SR_RXNE 0x00000020U
+#define USART_CR1_IDLEIE 0x00000010U
+#define USART_CR1_RXNEIE 0x00000020U
+#define USART_CR1_TCIE   0x00000040U
+#define UART_IT_IDLE USART_CR1_IDLEIE
+#define UART_IT_RXNE USART_CR1_RXNEIE
+#define UART_IT_TC   USART_CR1_TCIE
+#define UART_FLAG_IDLE USART_SR_IDLE
+
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __IT__)     ((__HANDLE__)->Instance->CR1 |= (__IT__))
+#define __HAL_UART_DISABLE_IT(__HANDLE__, __IT__)    ((__HANDLE__)->Instance->CR1 &= ~(__IT__))
+#define __HAL_UART_GET_IT_SOURCE(__HANDLE__, __IT__) (((__HANDLE__)->Instance->CR1 & (__IT__)) != 0U)
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__)    (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+// the target clears it by reading SR then DR
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__)        ((__HANDLE__)->Instance->SR &= ~USART_SR_IDLE)
+
+// a read of DR clears RXNE on the target, see uart.c
+uint32_t SIL_UartReadDR(USART_TypeDef* instance);
+#define UART_READ_DR(instance) SIL_UartReadDR(instance)
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do { (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); } while (0)
+
+/*
+ * TIM
+ */
+
+typedef struct {
+    __IO uint32_t CNT;
+    __IO uint32_t ARR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+    TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+
+/*
+ * FLASH, only the data page exists, see SIL_FlashLoad()
+ */
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t PageAddress;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_PAGES      0x00U
+#define FLASH_BANK_1               0x01U
+#define FLASH_TYPEPROGRAM_HALFWORD 0x01U
+
+// the CPU reads flash through the image, see flash.c
+const uint8_t* SIL_FlashReadPtr(uint32_t addr);
+#define FLASH_READ_PTR(addr) SIL_FlashReadPtr(addr)
+
+/*
+ * Core debug / DWT, CYCCNT follows virtual time at SystemCoreClock
+ */
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+extern uint32_t SystemCoreClock;
+
+// single threaded host, interrupts are delivered synchronously by the models
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void) priMask; }
+static inline void __disable_irq(void) {}
+static inline void __DMB(void) {}
+static inline void __enable_irq(void) {}
+// IAR intrinsic
+static inline void __no_operation(void) {}
+// sleeps until the next interrupt in virtual time, see SIL_WaitForInterrupt()
+void __WFI(void);
+
+/*
+ * Peripheral instances, owned by sil_hal.cpp
+ */
+
+extern GPIO_TypeDef SIL_GPIOA;
+extern GPIO_TypeDef SIL_GPIOB;
+extern GPIO_TypeDef SIL_GPIOC;
+extern I2C_TypeDef SIL_I2C1;
+extern SPI_TypeDef SIL_SPI2;
+extern USART_TypeDef SIL_USART2;
+extern USART_TypeDef SIL_USART3;
+extern DMA_Channel_TypeDef SIL_DMA1_Channel3;
+extern TIM_TypeDef SIL_TIM1;
+extern DWT_Type SIL_DWT;
+extern CoreDebug_Type SIL_CoreDebug;
+
+#define GPIOA  (&SIL_GPIOA)
+#define GPIOB  (&SIL_GPIOB)
+#define GPIOC  (&SIL_GPIOC)
+#define I2C1   (&SIL_I2C1)
+#define SPI2   (&SIL_SPI2)
+#define USART2 (&SIL_USART2)
+#define USART3 (&SIL_USART3)
+#define DMA1_Channel3 (&SIL_DMA1_Channel3)
+#define TIM1   (&SIL_TIM1)
+#define DWT       (&SIL_DWT)
+#define CoreDebug (&SIL_CoreDebug)
+
+/*
+ * API
+ */
+
+HAL_StatusTypeDef HAL_Init(void);
+void HAL_IncTick(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* hspi);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi);
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef* hspi);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi);
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef* huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError);
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
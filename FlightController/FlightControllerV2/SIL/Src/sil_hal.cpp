@@ -0,0 +1,1088 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "sil_hal.h"
+
+/*
+ * Defines
+ */
+
+#define MAX_I2C_DEVICES (4)
+#define NUM_OF_UARTS (2)
+#define NUM_OF_PWM_CHANNELS (4)
+#define NUM_OF_EXTI_LINES (16)
+
+#define DEFAULT_I2C_CLOCK_SPEED (100000)
+#define DEFAULT_UART_BAUDRATE (115200)
+#define I2C_BITS_PER_BYTE (9) // 8 data bits + ack
+#define I2C_START_STOP_BITS (2)
+#define MAX_I2C_IT_SIZE (512) // a full MPU9250 FIFO
+#define MAX_SPI_DEVICES (2)
+#define SPI_PCLK (32000000) // SPI2 on APB1
+#define SPI_BITS_PER_BYTE (8)
+#define MAX_SPI_DMA_SIZE (512)
+#define SPI_READ_FLAG (0x80)
+#define FLASH_PAGE_ADDR (0x0800FC00) // FLASH_DATA_PAGE_ADDR in flash.h
+#define FLASH_PAGE_LEN (1024)
+#define FLASH_ERASE_US (20000) // page erase, typical
+#define FLASH_PROGRAM_US (52)  // half word, typical
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    USART_TypeDef* instance;
+    UART_HandleTypeDef* huart;
+    SILIrqHandler irqHandler;
+    SILUartTxHook txHook;
+    uint8_t* pRxBuf;
+    uint16_t rxSize;
+    uint16_t rxPos;
+    bool rxArmed;
+    bool rxCircular;
+    bool txBusy;
+    uint64_t txDoneUs;
+} SILUartType;
+
+// the interrupt driven transfer on the bus
+typedef struct {
+    I2C_HandleTypeDef* hi2c;
+    const SILI2CDeviceType* pDevice;
+    uint16_t memAddr;
+    uint8_t* pData;
+    uint16_t size;
+    bool read;
+    bool busy;
+    bool failed; // NACK or device error, reported at the end
+    bool hung;   // never completes, until the firmware resets the peripheral
+    uint64_t doneUs;
+    uint8_t staged[MAX_I2C_IT_SIZE];
+} SILI2CTransferType;
+
+// the DMA transfer on SPI2, the data phase of a transaction
+typedef struct {
+    SPI_HandleTypeDef* hspi;
+    const SILSpiDeviceType* pDevice;
+    uint8_t reg;
+    uint8_t* pData;
+    uint16_t size;
+    bool read;
+    bool busy;
+    bool failed; // DMA error, reported at the end
+    bool hung;   // never completes, until the firmware aborts it
+    uint64_t doneUs;
+    uint8_t staged[MAX_SPI_DMA_SIZE];
+} SILSpiTransferType;
+
+/*
+ * Peripherals
+ */
+
+GPIO_TypeDef SIL_GPIOA;
+GPIO_TypeDef SIL_GPIOB;
+GPIO_TypeDef SIL_GPIOC;
+I2C_TypeDef SIL_I2C1;
+SPI_TypeDef SIL_SPI2;
+USART_TypeDef SIL_USART2;
+USART_TypeDef SIL_USART3;
+DMA_Channel_TypeDef SIL_DMA1_Channel3;
+TIM_TypeDef SIL_TIM1;
+DWT_Type SIL_DWT;
+CoreDebug_Type SIL_CoreDebug;
+
+uint32_t SystemCoreClock = SIL_CORE_CLOCK;
+
+/*
+ * Static
+ */
+
+static uint64_t sNowUs = 0;
+static uint64_t sNextTickUs = SIL_TICK_US;
+static volatile uint32_t sTick = 0;
+static SILTickHook sTickHook = NULL;
+
+static SILI2CDeviceType sI2CDevices[MAX_I2C_DEVICES];
+static int sNumOfI2CDevices = 0;
+static SILI2CTransferType sI2CTransfer;
+static uint32_t sI2CLatencyUs = 0;
+static uint32_t sI2CFaultOneInN = 0;
+static uint32_t sI2CItCnt = 0;
+
+static SILSpiDeviceType sSpiDevices[MAX_SPI_DEVICES];
+static int sNumOfSpiDevices = 0;
+// the device whose chip select is low, the first byte after it selected
+// the device is the address
+static const SILSpiDeviceType* spSpiSelected = NULL;
+static bool sSpiAddrPending = false;
+static uint8_t sSpiReg = 0;
+static bool sSpiRead = false;
+static SILSpiTransferType sSpiTransfer;
+static uint32_t sSpiFaultOneInN = 0;
+static uint32_t sSpiDmaCnt = 0;
+// SIL_AdvanceUs() calls on the stack, more than one while a callback runs
+static int sAdvanceDepth = 0;
+
+// EXTI line n is routed from pin n of one port (AFIO_EXTICRx)
+static GPIO_TypeDef* sExtiPort[NUM_OF_EXTI_LINES];
+static uint32_t sExtiMode[NUM_OF_EXTI_LINES];
+static uint16_t sExtiPending = 0;
+static bool sExti15_10Enabled = false;
+static SILIrqHandler sExti15_10Handler = NULL;
+
+static SILUartType sUarts[NUM_OF_UARTS];
+static bool sPwmRunning[NUM_OF_PWM_CHANNELS];
+
+static SILBusStatsType sStats;
+
+// not touched by SIL_Reset(), see SIL_FlashLoad()
+static uint8_t sFlashPage[FLASH_PAGE_LEN];
+static bool sFlashErased = false;
+static bool sFlashLocked = true;
+
+/*
+ * Code
+ */
+
+static SILUartType* GetUart(USART_TypeDef* instance)
+{
+    for (int i = 0; i < NUM_OF_UARTS; ++i) {
+        if (sUarts[i].instance == instance) return &sUarts[i];
+    }
+    return NULL;
+}
+
+static const SILI2CDeviceType* GetI2CDevice(uint16_t devAddr)
+{
+    for (int i = 0; i < sNumOfI2CDevices; ++i) {
+        if (sI2CDevices[i].devAddr == devAddr) return &sI2CDevices[i];
+    }
+    return NULL;
+}
+
+static uint64_t I2CTransferUs(I2C_HandleTypeDef* hi2c, uint32_t bytes)
+{
+    uint32_t clock = hi2c->Init.ClockSpeed ? hi2c->Init.ClockSpeed : DEFAULT_I2C_CLOCK_SPEED;
+    uint64_t bits = (uint64_t) bytes * I2C_BITS_PER_BYTE + I2C_START_STOP_BITS;
+    return (bits * 1000000 + clock - 1) / clock + sI2CLatencyUs;
+}
+
+static uint64_t SpiTransferUs(SPI_HandleTypeDef* hspi, uint32_t bytes)
+{
+    uint32_t br = (hspi->Instance->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+    uint32_t hz = SPI_PCLK >> (br + 1);
+    uint64_t bits = (uint64_t) bytes * SPI_BITS_PER_BYTE;
+    return (bits * 1000000 + hz - 1) / hz;
+}
+
+static uint64_t UartTransferUs(UART_HandleTypeDef* huart, uint32_t bytes)
+{
+    uint32_t baud = huart->Init.BaudRate ? huart->Init.BaudRate : DEFAULT_UART_BAUDRATE;
+    // start bit + data (parity included in 9B) + stop bits
+    uint32_t bitsPerFrame = 1 + (huart->Init.WordLength == UART_WORDLENGTH_9B ? 9 : 8)
+                            + (huart->Init.StopBits == UART_STOPBITS_2 ? 2 : 1);
+    uint64_t bits = (uint64_t) bytes * bitsPerFrame;
+    return (bits * 1000000 + baud - 1) / baud;
+}
+
+static void SetNowUs(uint64_t nowUs)
+{
+    // an interrupt that busy waited may have run past the next event, which
+    // then happens late instead of in the past
+    if (nowUs < sNowUs) return;
+    // counts on from whatever the firmware wrote, Clock_Init() zeroes it
+    SIL_DWT.CYCCNT += (uint32_t) ((nowUs - sNowUs) * (SIL_CORE_CLOCK / 1000000));
+    sNowUs = nowUs;
+}
+
+static int PwmChannelIndex(uint32_t channel)
+{
+    return (int) (channel / TIM_CHANNEL_2);
+}
+
+void SIL_Reset()
+{
+    sNowUs = 0;
+    SIL_DWT.CYCCNT = 0;
+    sNextTickUs = SIL_TICK_US;
+    sTick = 0;
+    sTickHook = NULL;
+    sNumOfI2CDevices = 0;
+    memset(&sI2CTransfer, 0, sizeof(sI2CTransfer));
+    sI2CLatencyUs = 0;
+    sI2CFaultOneInN = 0;
+    sI2CItCnt = 0;
+    sNumOfSpiDevices = 0;
+    spSpiSelected = NULL;
+    sSpiAddrPending = false;
+    memset(&sSpiTransfer, 0, sizeof(sSpiTransfer));
+    sSpiFaultOneInN = 0;
+    sSpiDmaCnt = 0;
+    sAdvanceDepth = 0;
+    memset(sUarts, 0, sizeof(sUarts));
+    sUarts[0].instance = USART2;
+    sUarts[1].instance = USART3;
+    memset(sPwmRunning, 0, sizeof(sPwmRunning));
+    memset(sExtiPort, 0, sizeof(sExtiPort));
+    memset(sExtiMode, 0, sizeof(sExtiMode));
+    sExtiPending = 0;
+    sExti15_10Enabled = false;
+    sExti15_10Handler = NULL;
+    // the I2C1 lines on their pull-ups, no modelled slave holds SDA
+    SIL_GPIOB.IDR = GPIO_PIN_8 | GPIO_PIN_9;
+    memset(&sStats, 0, sizeof(sStats));
+}
+
+uint64_t SIL_GetTimeUs()
+{
+    return sNowUs;
+}
+
+// DMA transmit in flight that finishes first, NULL if none
+static SILUartType* NextTxDone()
+{
+    SILUartType* pNext = NULL;
+    for (int i = 0; i < NUM_OF_UARTS; ++i) {
+        if (!sUarts[i].txBusy) continue;
+        if (!pNext || sUarts[i].txDoneUs < pNext->txDoneUs) pNext = &sUarts[i];
+    }
+    return pNext;
+}
+
+static bool I2CTransferDue()
+{
+    return sI2CTransfer.busy && !sI2CTransfer.hung;
+}
+
+// end of the interrupt driven transfer, as the event/error interrupt reports it
+static void CompleteI2CTransfer()
+{
+    SILI2CTransferType* pXfer = &sI2CTransfer;
+    pXfer->busy = false;
+    bool ok = !pXfer->failed;
+    if (ok && pXfer->read) {
+        memcpy(pXfer->pData, pXfer->staged, pXfer->size);
+    } else if (ok) {
+        ok = pXfer->pDevice->write && pXfer->pDevice->write(pXfer->memAddr, pXfer->pData, pXfer->size);
+    }
+    if (!ok) {
+        ++sStats.i2cErrors;
+        HAL_I2C_ErrorCallback(pXfer->hi2c);
+    } else if (pXfer->read) {
+        HAL_I2C_MemRxCpltCallback(pXfer->hi2c);
+    } else {
+        HAL_I2C_MemTxCpltCallback(pXfer->hi2c);
+    }
+}
+
+static bool SpiTransferDue()
+{
+    return sSpiTransfer.busy && !sSpiTransfer.hung;
+}
+
+// end of the SPI DMA transfer, as the DMA channel interrupt reports it
+static void CompleteSpiTransfer()
+{
+    SILSpiTransferType* pXfer = &sSpiTransfer;
+    pXfer->busy = false;
+    bool ok = !pXfer->failed;
+    if (ok && pXfer->read) {
+        memcpy(pXfer->pData, pXfer->staged, pXfer->size);
+    } else if (ok && pXfer->pDevice) {
+        // a write with nobody selected goes nowhere, as on the wire
+        ok = pXfer->pDevice->write && pXfer->pDevice->write(pXfer->reg, pXfer->pData, pXfer->size);
+    }
+    if (!ok) {
+        ++sStats.spiErrors;
+        HAL_SPI_ErrorCallback(pXfer->hspi);
+    } else if (pXfer->read) {
+        HAL_SPI_RxCpltCallback(pXfer->hspi);
+    } else {
+        HAL_SPI_TxCpltCallback(pXfer->hspi);
+    }
+}
+
+void SIL_AdvanceUs(uint64_t us)
+{
+    uint64_t target = sNowUs + us;
+    ++sAdvanceDepth;
+    for (;;) {
+        // DMA/I2C/SPI completions and ticks in time order, a completion may
+        // start the next transfer from its callback
+        SILUartType* pTx = NextTxDone();
+        if (I2CTransferDue() && sI2CTransfer.doneUs < sNextTickUs && sI2CTransfer.doneUs <= target
+            && (!pTx || sI2CTransfer.doneUs <= pTx->txDoneUs)
+            && (!SpiTransferDue() || sI2CTransfer.doneUs <= sSpiTransfer.doneUs)) {
+            SetNowUs(sI2CTransfer.doneUs);
+            CompleteI2CTransfer();
+            continue;
+        }
+        if (SpiTransferDue() && sSpiTransfer.doneUs < sNextTickUs && sSpiTransfer.doneUs <= target
+            && (!pTx || sSpiTransfer.doneUs <= pTx->txDoneUs)) {
+            SetNowUs(sSpiTransfer.doneUs);
+            CompleteSpiTransfer();
+            continue;
+        }
+        if (pTx && pTx->txDoneUs < sNextTickUs && pTx->txDoneUs <= target) {
+            SetNowUs(pTx->txDoneUs);
+            pTx->txBusy = false;
+            HAL_UART_TxCpltCallback(pTx->huart);
+            continue;
+        }
+        if (sNextTickUs > target) break;
+        SetNowUs(sNextTickUs);
+        sNextTickUs += SIL_TICK_US;
+        if (sTickHook) {
+            sTickHook();
+        } else {
+            HAL_IncTick();
+        }
+    }
+    --sAdvanceDepth;
+    SetNowUs(target);
+}
+
+// time a polled transfer takes; from an interrupt the other events wait for it
+static void BusyWaitUs(uint64_t us)
+{
+    if (sAdvanceDepth > 0) {
+        SetNowUs(sNowUs + us);
+    } else {
+        SIL_AdvanceUs(us);
+    }
+}
+
+void SIL_AdvanceToNextTick()
+{
+    SIL_AdvanceUs(sNextTickUs - sNowUs);
+}
+
+void SIL_WaitForInterrupt()
+{
+    uint64_t nextUs = sNextTickUs;
+    SILUartType* pTx = NextTxDone();
+    if (pTx && pTx->txDoneUs < nextUs) nextUs = pTx->txDoneUs;
+    if (I2CTransferDue() && sI2CTransfer.doneUs < nextUs) nextUs = sI2CTransfer.doneUs;
+    if (SpiTransferDue() && sSpiTransfer.doneUs < nextUs) nextUs = sSpiTransfer.doneUs;
+    SIL_AdvanceUs(nextUs > sNowUs ? nextUs - sNowUs : 0);
+}
+
+void __WFI(void)
+{
+    SIL_WaitForInterrupt();
+}
+
+void SIL_SetTickHook(SILTickHook hook)
+{
+    sTickHook = hook;
+}
+
+void SIL_AttachExtiIrq(IRQn_Type irq, SILIrqHandler handler)
+{
+    if (irq == EXTI15_10_IRQn) sExti15_10Handler = handler;
+}
+
+void SIL_GpioPulse(GPIO_TypeDef* port, uint16_t pin)
+{
+    for (int line = 0; line < NUM_OF_EXTI_LINES; ++line) {
+        if (!(pin & (1u << line)) || sExtiPort[line] != port) continue;
+        if (sExtiMode[line] != GPIO_MODE_IT_RISING && sExtiMode[line] != GPIO_MODE_IT_FALLING) continue;
+        sExtiPending |= (uint16_t) (1u << line);
+        if (line >= 10 && sExti15_10Enabled && sExti15_10Handler) {
+            sExti15_10Handler();
+        }
+    }
+}
+
+bool SIL_AttachI2CDevice(const SILI2CDeviceType* pDevice)
+{
+    if (!pDevice || sNumOfI2CDevices >= MAX_I2C_DEVICES) return false;
+    sI2CDevices[sNumOfI2CDevices++] = *pDevice;
+    return true;
+}
+
+void SIL_SetI2CLatencyUs(uint32_t us)
+{
+    sI2CLatencyUs = us;
+}
+
+void SIL_SetI2CFaults(uint32_t oneInN)
+{
+    sI2CFaultOneInN = oneInN;
+    sI2CItCnt = 0;
+}
+
+bool SIL_AttachSpiDevice(const SILSpiDeviceType* pDevice)
+{
+    if (!pDevice || sNumOfSpiDevices >= MAX_SPI_DEVICES) return false;
+    sSpiDevices[sNumOfSpiDevices++] = *pDevice;
+    return true;
+}
+
+void SIL_SetSpiFaults(uint32_t oneInN)
+{
+    sSpiFaultOneInN = oneInN;
+    sSpiDmaCnt = 0;
+}
+
+void SIL_AttachUartIrq(USART_TypeDef* instance, SILIrqHandler handler)
+{
+    SILUartType* pUart = GetUart(instance);
+    if (pUart) pUart->irqHandler = handler;
+}
+
+void SIL_SetUartTxHook(USART_TypeDef* instance, SILUartTxHook hook)
+{
+    SILUartType* pUart = GetUart(instance);
+    if (pUart) pUart->txHook = hook;
+}
+
+void SIL_UartInject(USART_TypeDef* instance, const uint8_t* pData, uint16_t size)
+{
+    SILUartType* pUart = GetUart(instance);
+    if (!pUart) return;
+    for (uint16_t i = 0; i < size; ++i) {
+        ++sStats.uartRxBytes;
+        if (!pUart->rxArmed) {
+            // no DMA armed, the byte waits in DR for a polled read and
+            // overruns the previous one if that was not read yet
+            if (instance->SR & USART_SR_RXNE) ++sStats.uartRxDropped;
+            instance->DR = pData[i];
+            instance->SR |= USART_SR_RXNE;
+            continue;
+        }
+        pUart->pRxBuf[pUart->rxPos++] = pData[i];
+        DMA_HandleTypeDef* pDma = pUart->huart->hdmarx;
+        if (pDma && pDma->Instance) pDma->Instance->CNDTR = pUart->rxSize - pUart->rxPos;
+        if (pUart->rxPos == pUart->rxSize / 2) {
+            HAL_UART_RxHalfCpltCallback(pUart->huart);
+        } else if (pUart->rxPos == pUart->rxSize) {
+            pUart->rxPos = 0;
+            // the counter reloads in circular mode
+            if (pDma && pDma->Instance && pUart->rxCircular) pDma->Instance->CNDTR = pUart->rxSize;
+            if (!pUart->rxCircular) pUart->rxArmed = false;
+            HAL_UART_RxCpltCallback(pUart->huart);
+        }
+    }
+}
+
+void SIL_UartLineIdle(USART_TypeDef* instance)
+{
+    SILUartType* pUart = GetUart(instance);
+    if (!pUart || !pUart->irqHandler) return;
+    instance->SR |= USART_SR_IDLE;
+    if (instance->CR1 & USART_CR1_IDLEIE) {
+        pUart->irqHandler();
+    }
+}
+
+uint32_t SIL_UartGetBaudRate(USART_TypeDef* instance)
+{
+    SILUartType* pUart = GetUart(instance);
+    if (!pUart || !pUart->huart) return 0;
+    return pUart->huart->Init.BaudRate;
+}
+
+bool SIL_PwmIsRunning(TIM_TypeDef* instance, uint32_t channel)
+{
+    if (instance != TIM1) return false;
+    int idx = PwmChannelIndex(channel);
+    if (idx < 0 || idx >= NUM_OF_PWM_CHANNELS) return false;
+    return sPwmRunning[idx];
+}
+
+void SIL_GetBusStats(SILBusStatsType* pStats)
+{
+    if (pStats) *pStats = sStats;
+}
+
+static bool FlashInPage(uint32_t addr, uint32_t size)
+{
+    return addr >= FLASH_PAGE_ADDR && addr + size <= FLASH_PAGE_ADDR + FLASH_PAGE_LEN;
+}
+
+void SIL_FlashErase()
+{
+    memset(sFlashPage, 0xFF, sizeof(sFlashPage));
+    sFlashErased = true;
+}
+
+bool SIL_FlashLoad(const char* pPath)
+{
+    SIL_FlashErase();
+    FILE* pFile = fopen(pPath, "rb");
+    if (!pFile) return false;
+    uint8_t image[FLASH_PAGE_LEN];
+    bool ok = fread(image, 1, sizeof(image), pFile) == sizeof(image) && fgetc(pFile) == EOF;
+    fclose(pFile);
+    if (ok) memcpy(sFlashPage, image, sizeof(image));
+    return ok;
+}
+
+bool SIL_FlashSave(const char* pPath)
+{
+    FILE* pFile = fopen(pPath, "wb");
+    if (!pFile) return false;
+    bool ok = fwrite(sFlashPage, 1, sizeof(sFlashPage), pFile) == sizeof(sFlashPage);
+    return fclose(pFile) == 0 && ok;
+}
+
+const uint8_t* SIL_FlashReadPtr(uint32_t addr)
+{
+    if (!sFlashErased) SIL_FlashErase();
+    // flash.c checks the range, anything else is a bug in the firmware
+    return FlashInPage(addr, 1) ? &sFlashPage[addr - FLASH_PAGE_ADDR] : NULL;
+}
+
+/*------------------------------------------*
+* HAL
+*------------------------------------------*/
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+    return HAL_OK;
+}
+
+void HAL_IncTick(void)
+{
+    ++sTick;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return sTick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    // same semantics as the F1 HAL: at least Delay full ticks
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t wait = Delay;
+    if (wait < HAL_MAX_DELAY) ++wait;
+    while ((HAL_GetTick() - tickstart) < wait) {
+        SIL_AdvanceToNextTick();
+    }
+}
+
+// a falling chip select starts a transaction on the device, a rising one ends it
+static void SpiChipSelect(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, bool low)
+{
+    for (int i = 0; i < sNumOfSpiDevices; ++i) {
+        const SILSpiDeviceType* pDevice = &sSpiDevices[i];
+        if (pDevice->csPort != GPIOx || !(pDevice->csPin & GPIO_Pin)) continue;
+        if (low && spSpiSelected != pDevice) {
+            spSpiSelected = pDevice;
+            sSpiAddrPending = true;
+            ++sStats.spiTransfers;
+        } else if (!low && spSpiSelected == pDevice) {
+            spSpiSelected = NULL;
+        }
+    }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if (PinState != GPIO_PIN_RESET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t) GPIO_Pin;
+    }
+    SpiChipSelect(GPIOx, GPIO_Pin, PinState == GPIO_PIN_RESET);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    GPIOx->ODR ^= GPIO_Pin;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init)
+{
+    for (int line = 0; line < NUM_OF_EXTI_LINES; ++line) {
+        if (!(GPIO_Init->Pin & (1u << line))) continue;
+        sExtiPort[line] = GPIOx;
+        sExtiMode[line] = GPIO_Init->Mode;
+    }
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin)
+{
+    if (sExtiPending & GPIO_Pin) {
+        sExtiPending &= (uint16_t) ~GPIO_Pin;
+        HAL_GPIO_EXTI_Callback(GPIO_Pin);
+    }
+}
+
+__weak void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    (void) GPIO_Pin;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    (void) IRQn;
+    (void) PreemptPriority;
+    (void) SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == EXTI15_10_IRQn) sExti15_10Enabled = true;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == EXTI15_10_IRQn) sExti15_10Enabled = false;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c)
+{
+    // the clock speed is taken from hi2c->Init on every transfer
+    return hi2c->Instance ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c)
+{
+    // the peripheral reset drops the transfer on the bus without a callback
+    if (sI2CTransfer.busy && sI2CTransfer.hi2c == hi2c) {
+        sI2CTransfer.busy = false;
+        ++sStats.i2cErrors;
+    }
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef StartI2CTransfer(I2C_HandleTypeDef* hi2c, uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize,
+                                          uint8_t* pData, uint16_t size, bool read)
+{
+    if (sI2CTransfer.busy) return HAL_BUSY;
+    if (!pData || size == 0 || size > MAX_I2C_IT_SIZE) return HAL_ERROR;
+    ++sStats.i2cTransfers;
+    SILI2CTransferType* pXfer = &sI2CTransfer;
+    pXfer->hi2c = hi2c;
+    pXfer->pDevice = GetI2CDevice(devAddr);
+    pXfer->memAddr = memAddr;
+    pXfer->pData = pData;
+    pXfer->size = size;
+    pXfer->read = read;
+    // every n-th transfer fails, alternately NACKed and with the bus hung
+    bool fault = sI2CFaultOneInN && ++sI2CItCnt % sI2CFaultOneInN == 0;
+    pXfer->hung = fault && (sI2CItCnt / sI2CFaultOneInN) % 2 == 0;
+    pXfer->failed = !pXfer->pDevice || fault;
+    uint32_t bytes = 1;
+    if (!pXfer->failed) {
+        // address + register, for a read repeated start + address, then the data
+        bytes = 1 + memAddSize + (read ? 1 : 0) + size;
+    }
+    uint64_t us = I2CTransferUs(hi2c, bytes);
+    sStats.i2cBusyUs += us;
+    pXfer->doneUs = sNowUs + us;
+    if (read && !pXfer->failed) {
+        // the device hands over its registers as of the start of the burst
+        pXfer->failed = !pXfer->pDevice->read || !pXfer->pDevice->read(memAddr, pXfer->staged, size);
+    }
+    pXfer->busy = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+    return StartI2CTransfer(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+    return StartI2CTransfer(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void) Timeout;
+    if (sI2CTransfer.busy) return HAL_BUSY;
+    ++sStats.i2cTransfers;
+    const SILI2CDeviceType* pDevice = GetI2CDevice(DevAddress);
+    if (!pDevice) {
+        // address NACK
+        uint64_t us = I2CTransferUs(hi2c, 1);
+        sStats.i2cBusyUs += us;
+        ++sStats.i2cErrors;
+        SIL_AdvanceUs(us);
+        return HAL_ERROR;
+    }
+    uint64_t us = I2CTransferUs(hi2c, 1 + MemAddSize + Size);
+    sStats.i2cBusyUs += us;
+    SIL_AdvanceUs(us);
+    if (!pDevice->write || !pDevice->write(MemAddress, pData, Size)) {
+        ++sStats.i2cErrors;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void) Timeout;
+    if (sI2CTransfer.busy) return HAL_BUSY;
+    ++sStats.i2cTransfers;
+    const SILI2CDeviceType* pDevice = GetI2CDevice(DevAddress);
+    if (!pDevice) {
+        uint64_t us = I2CTransferUs(hi2c, 1);
+        sStats.i2cBusyUs += us;
+        ++sStats.i2cErrors;
+        SIL_AdvanceUs(us);
+        return HAL_ERROR;
+    }
+    // address + register, repeated start + address, then the data bytes
+    uint64_t us = I2CTransferUs(hi2c, 1 + MemAddSize + 1 + Size);
+    sStats.i2cBusyUs += us;
+    SIL_AdvanceUs(us);
+    if (!pDevice->read || !pDevice->read(MemAddress, pData, Size)) {
+        ++sStats.i2cErrors;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c)
+{
+    (void) hi2c;
+}
+
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c)
+{
+    (void) hi2c;
+}
+
+__weak void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    (void) hi2c;
+}
+
+__weak void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    (void) hi2c;
+}
+
+__weak void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+    (void) hi2c;
+}
+
+/*------------------------------------------*
+* SPI
+*------------------------------------------*/
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* hspi)
+{
+    if (!hspi->Instance) return HAL_ERROR;
+    MODIFY_REG(hspi->Instance->CR1, SPI_CR1_BR, hspi->Init.BaudRatePrescaler);
+    return HAL_OK;
+}
+
+// bytes the master clocks out: the address if it is the first byte of the
+// transaction, then data for the selected device at the addressed register;
+// a write is only handed to the device if apply
+static const SILSpiDeviceType* SpiShiftOut(uint8_t*& pData, uint16_t& size, bool apply, bool* pOk)
+{
+    *pOk = true;
+    const SILSpiDeviceType* pDevice = spSpiSelected;
+    if (!pDevice) return NULL;
+    if (sSpiAddrPending && size > 0) {
+        sSpiAddrPending = false;
+        sSpiReg = pData[0] & ~SPI_READ_FLAG;
+        sSpiRead = (pData[0] & SPI_READ_FLAG) != 0;
+        ++pData;
+        --size;
+    }
+    // during a read the device ignores what comes in on MOSI
+    if (size == 0 || sSpiRead) return NULL;
+    if (apply) *pOk = pDevice->write && pDevice->write(sSpiReg, pData, size);
+    return pDevice;
+}
+
+// bytes the master clocks in, from the addressed register of the selected device
+static bool SpiShiftIn(uint8_t* pData, uint16_t size)
+{
+    const SILSpiDeviceType* pDevice = spSpiSelected;
+    if (!pDevice || sSpiAddrPending || !sSpiRead) {
+        // MISO floats high
+        memset(pData, 0xFF, size);
+        return true;
+    }
+    return pDevice->read && pDevice->read(sSpiReg, pData, size);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void) Timeout;
+    if (sSpiTransfer.busy) return HAL_BUSY;
+    if (!pData || Size == 0) return HAL_ERROR;
+    uint64_t us = SpiTransferUs(hspi, Size);
+    sStats.spiBusyUs += us;
+    BusyWaitUs(us);
+    bool ok;
+    SpiShiftOut(pData, Size, true, &ok);
+    if (!ok) ++sStats.spiErrors;
+    // nothing on the wire tells the master whether the slave took it
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void) Timeout;
+    if (sSpiTransfer.busy) return HAL_BUSY;
+    if (!pData || Size == 0) return HAL_ERROR;
+    uint64_t us = SpiTransferUs(hspi, Size);
+    sStats.spiBusyUs += us;
+    BusyWaitUs(us);
+    if (!SpiShiftIn(pData, Size)) ++sStats.spiErrors;
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef StartSpiTransfer(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t size, bool read)
+{
+    if (sSpiTransfer.busy) return HAL_BUSY;
+    if (!pData || size == 0 || size > MAX_SPI_DMA_SIZE) return HAL_ERROR;
+    SILSpiTransferType* pXfer = &sSpiTransfer;
+    pXfer->hspi = hspi;
+    pXfer->pData = pData;
+    pXfer->size = size;
+    pXfer->read = read;
+    // every n-th transfer fails, alternately with a DMA error and a lost interrupt
+    bool fault = sSpiFaultOneInN && ++sSpiDmaCnt % sSpiFaultOneInN == 0;
+    pXfer->hung = fault && (sSpiDmaCnt / sSpiFaultOneInN) % 2 == 0;
+    pXfer->failed = fault;
+    uint64_t us = SpiTransferUs(hspi, size);
+    sStats.spiBusyUs += us;
+    pXfer->doneUs = sNowUs + us;
+    if (read) {
+        // the device hands over its registers as of the start of the burst
+        pXfer->pDevice = spSpiSelected;
+        if (!SpiShiftIn(pXfer->staged, size)) pXfer->failed = true;
+    } else {
+        // the data goes to the device at the end, at the address sent before
+        bool ok;
+        uint8_t* pShift = pData;
+        uint16_t shiftSize = size;
+        pXfer->pDevice = SpiShiftOut(pShift, shiftSize, false, &ok);
+        pXfer->reg = sSpiReg;
+        pXfer->pData = pShift;
+        pXfer->size = shiftSize;
+    }
+    pXfer->busy = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size)
+{
+    return StartSpiTransfer(hspi, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size)
+{
+    return StartSpiTransfer(hspi, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi)
+{
+    // both DMA channels stop without a callback
+    if (sSpiTransfer.busy && sSpiTransfer.hspi == hspi) {
+        sSpiTransfer.busy = false;
+        ++sStats.spiErrors;
+    }
+    return HAL_OK;
+}
+
+__weak void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    (void) hspi;
+}
+
+__weak void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    (void) hspi;
+}
+
+__weak void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    (void) hspi;
+}
+
+/*------------------------------------------*
+* UART
+*------------------------------------------*/
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+    // the line settings are taken from huart->Init on every transfer
+    SILUartType* pUart = GetUart(huart->Instance);
+    if (!pUart) return HAL_ERROR;
+    pUart->huart = huart;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void) Timeout;
+    SILUartType* pUart = GetUart(huart->Instance);
+    if (pUart && pUart->txHook) {
+        pUart->txHook(pData, Size);
+    }
+    uint64_t us = UartTransferUs(huart, Size);
+    sStats.uartTxBytes += Size;
+    sStats.uartTxBusyUs += us;
+    SIL_AdvanceUs(us);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    SILUartType* pUart = GetUart(huart->Instance);
+    if (!pUart || !pData || Size == 0) return HAL_ERROR;
+    if (pUart->txBusy) return HAL_BUSY;
+    // the bytes are handed over now, the CPU is free while they are on the wire
+    if (pUart->txHook) {
+        pUart->txHook(pData, Size);
+    }
+    uint64_t us = UartTransferUs(huart, Size);
+    sStats.uartTxBytes += Size;
+    sStats.uartTxBusyUs += us;
+    pUart->huart = huart;
+    pUart->txBusy = true;
+    pUart->txDoneUs = sNowUs + us;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    // polled read of what has already arrived, waiting is not modelled
+    (void) Timeout;
+    for (uint16_t i = 0; i < Size; ++i) {
+        if (!(huart->Instance->SR & USART_SR_RXNE)) return HAL_TIMEOUT;
+        pData[i] = (uint8_t) huart->Instance->DR;
+        huart->Instance->SR &= ~USART_SR_RXNE;
+    }
+    return HAL_OK;
+}
+
+uint32_t SIL_UartReadDR(USART_TypeDef* instance)
+{
+    instance->SR &= ~USART_SR_RXNE;
+    return instance->DR;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    SILUartType* pUart = GetUart(huart->Instance);
+    if (!pUart || !pData || Size == 0) return HAL_ERROR;
+    if (pUart->rxArmed) return HAL_BUSY;
+    pUart->huart = huart;
+    pUart->pRxBuf = pData;
+    pUart->rxSize = Size;
+    pUart->rxPos = 0;
+    pUart->rxCircular = huart->hdmarx && huart->hdmarx->Init.Mode == DMA_CIRCULAR;
+    pUart->rxArmed = true;
+    if (huart->hdmarx && huart->hdmarx->Instance) huart->hdmarx->Instance->CNDTR = Size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef* huart)
+{
+    SILUartType* pUart = GetUart(huart->Instance);
+    if (!pUart) return HAL_ERROR;
+    pUart->rxArmed = false;
+    pUart->rxPos = 0;
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart)
+{
+    (void) huart;
+}
+
+__weak void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+    (void) huart;
+}
+
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+    (void) huart;
+}
+
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+    (void) huart;
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+    (void) huart;
+}
+
+/*------------------------------------------*
+* FLASH, the CPU stalls while it is busy
+*------------------------------------------*/
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    sFlashLocked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    sFlashLocked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    if (sFlashLocked || TypeProgram != FLASH_TYPEPROGRAM_HALFWORD || (Address & 1) || !FlashInPage(Address, 2)) {
+        return HAL_ERROR;
+    }
+    if (!sFlashErased) SIL_FlashErase();
+    BusyWaitUs(FLASH_PROGRAM_US);
+    uint8_t* pCell = &sFlashPage[Address - FLASH_PAGE_ADDR];
+    uint16_t cell = (uint16_t) (pCell[0] | (pCell[1] << 8));
+    uint16_t value = (uint16_t) Data;
+    // PGERR: only an erased half word takes a value other than 0
+    if (cell != 0xFFFF && value != 0) return HAL_ERROR;
+    pCell[0] = (uint8_t) value;
+    pCell[1] = (uint8_t) (value >> 8);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError)
+{
+    *PageError = 0xFFFFFFFF;
+    if (sFlashLocked || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES || pEraseInit->NbPages != 1
+        || pEraseInit->PageAddress != FLASH_PAGE_ADDR) {
+        *PageError = pEraseInit->PageAddress;
+        return HAL_ERROR;
+    }
+    BusyWaitUs(FLASH_ERASE_US);
+    SIL_FlashErase();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel)
+{
+    int idx = PwmChannelIndex(Channel);
+    if (htim->Instance != TIM1 || idx >= NUM_OF_PWM_CHANNELS) return HAL_ERROR;
+    sPwmRunning[idx] = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel)
+{
+    int idx = PwmChannelIndex(Channel);
+    if (htim->Instance != TIM1 || idx >= NUM_OF_PWM_CHANNELS) return HAL_ERROR;
+    sPwmRunning[idx] = false;
+    return HAL_OK;
+}
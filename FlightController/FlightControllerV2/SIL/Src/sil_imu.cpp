@@ -0,0 +1,578 @@
+#include <math.h>
+#include <string.h>
+
+#include "MPU9250_def.h"
+#include "dmpKey.h"
+
+#include "sil_hal.h"
+#include "sil_imu.h"
+
+/*
+ * Defines
+ */
+
+#define NUM_OF_MPU_REGS (128)
+#define NUM_OF_MAG_REGS (0x13)
+
+#define MPU9250_WHO_AM_I_VALUE (0x73)
+#define AK8963_WIA_VALUE (0x48)
+#define AK8963_ASA_DEFAULT (128) // adjustment of exactly 1.0
+
+#define RA_SMPLRT_DIV (0x19)
+#define RA_GYRO_CONFIG (0x1B)
+#define RA_ACCEL_CONFIG (0x1C)
+// XA_OFFSET_H/L, YA_ and ZA_ three apart, added to the accel output at
+// ACCEL_OFFSET_LSB_PER_G; bit 0 is the temperature compensation
+#define RA_XA_OFFSET_H (0x77)
+#define ACCEL_OFFSET_STRIDE (3)
+#define ACCEL_OFFSET_LSB_PER_G (2048.0f)
+#define FS_SEL_SHIFT (3)
+#define FS_SEL_MASK (0x3)
+#define PWR_MGMT_1_RESET (0x80)
+#define INT_STATUS_RAW_DATA_RDY (0x01)
+#define INT_ENABLE_RAW_RDY_EN (0x01)
+#define INT_STATUS_FIFO_OFLOW (0x10)
+#define USER_CTRL_FIFO_EN (0x40)
+#define USER_CTRL_FIFO_RST (0x04)
+#define FIFO_EN_TEMP (0x80)
+#define FIFO_EN_XG (0x40)
+#define FIFO_EN_YG (0x20)
+#define FIFO_EN_ZG (0x10)
+#define FIFO_EN_ACCEL (0x08)
+#define FIFO_SIZE (512)
+#define USER_CTRL_I2C_MST_EN (0x20)
+#define I2C_SLV_EN (0x80)      // I2C_SLVx_CTRL and I2C_SLV4_CTRL
+#define I2C_SLV_READ (0x80)    // I2C_SLVx_ADDR
+#define I2C_SLV_ADDR_MASK (0x7F)
+#define I2C_SLV_LEN_MASK (0x0F)
+#define I2C_MST_STATUS_SLV0_NACK (0x01)
+#define I2C_MST_STATUS_SLV4_DONE (0x40)
+#define I2C_MST_STATUS_SLV4_NACK (0x10)
+#define AK8963_I2C_ADDRESS (MPU9250_RA_MAG_ADDRESS >> 1)
+#define INT_STATUS_DMP_INT (0x02)
+#define INT_ENABLE_DMP_INT_EN (0x02)
+#define USER_CTRL_DMP_EN (0x80)
+#define USER_CTRL_DMP_RST (0x08)
+
+#define MAG_ST1_DRDY (0x01)
+#define MAG_CNTL_BIT (0x10)
+#define MAG_CNTL_MODE_MASK (0x0F)
+#define MAG_MODE_SINGLE (0x01)
+#define MAG_MODE_CONT_8HZ (0x02)
+#define MAG_MODE_CONT_100HZ (0x06)
+
+#define GYRO_LSB_PER_DPS_FS250 (131.0f)
+#define ACC_LSB_PER_G_FS2 (16384.0f)
+#define MAG_UT_PER_LSB_16BIT (0.15f)
+#define MAG_UT_PER_LSB_14BIT (0.6f)
+#define TEMP_LSB_PER_DEGC (333.87f)
+#define TEMP_ROOM_OFFSET (21.0f)
+#define DIE_TEMPERATURE (25.0f)
+#define SIL_IMU_PI (3.14159265f)
+#define DEG_TO_RAD (0.017453293f)
+
+// DMP memory, BANK_SEL picks a 256 byte bank and MEM_START_ADDR the byte in
+// it, MEM_R_W moves the data
+#define DMP_MEM_SIZE (4096)
+#define DMP_BANK_SIZE (256)
+// configuration words in DMP memory as inv_mpu_dmp_motion_driver.c writes
+// them, the packet layout follows from them
+#define DMP_CFG_LP_QUAT (2712)  // 3-axis quaternion: DINBC0, DINBC2, DINBC4, DINBC6
+#define DMP_CFG_8 (2718)        // 6-axis quaternion: DINA20, DINA28, DINA30, DINA38
+#define DMP_CFG_15 (2727)       // accel at [1], 0xC0, and gyro at [4], 0xC4
+#define DMP_CFG_27 (2742)       // gesture word: DINA20
+#define DMP_D_0_22 (22 + 512)   // FIFO rate divider, big endian
+#define DMP_CFG_15_ACCEL (0xC0)
+#define DMP_CFG_15_GYRO (0xC4)
+#define DMP_QUAT_LEN (16)
+#define DMP_GESTURE_LEN (4)
+#define DMP_MAX_PACKET_LEN (32)
+#define DMP_QUAT_ONE (1073741824.0) // Q30
+// the 6-axis fusion, a Mahony filter
+#define DMP_KP (1.0f)
+#define DMP_KI (0.3f) // the integral stands in for the DMP's gyro calibration
+
+/*
+ * Static
+ */
+
+static uint8_t sRegs[NUM_OF_MPU_REGS];
+static uint8_t sMagRegs[NUM_OF_MAG_REGS];
+
+static SILImuConfigType sConfig;
+static uint32_t sRandState = 1;
+
+static float sGyroTruth[3];
+static float sAccTruth[3];
+static float sMagTruth[3];
+
+static uint32_t sTickCnt = 0;
+static SILIrqHandler sIntHook = NULL;
+
+// FIFO ring, the count is what FIFO_COUNTH/L report
+static uint8_t sFifo[FIFO_SIZE];
+static uint16_t sFifoHead = 0;
+static uint16_t sFifoCount = 0;
+
+// DMP memory and the state of the fusion it runs: the quaternion of the
+// estimator frame, its integral feedback and the samples since the last
+// packet
+static uint8_t sDmpMem[DMP_MEM_SIZE];
+static float sDmpQuat[4];
+static float sDmpIntegral[3];
+static uint32_t sDmpSamples = 0;
+
+/*
+ * Code
+ */
+
+static float RandUniform()
+{
+    // xorshift32, deterministic for a given seed
+    sRandState ^= sRandState << 13;
+    sRandState ^= sRandState >> 17;
+    sRandState ^= sRandState << 5;
+    return (float) sRandState / 4294967296.0f;
+}
+
+static float RandGauss()
+{
+    // Irwin-Hall approximation, unit variance
+    float sum = 0.0f;
+    for (int i = 0; i < 4; ++i) sum += RandUniform();
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+static int16_t Quantise(float val)
+{
+    float r = roundf(val);
+    if (r > 32767.0f) return 32767;
+    if (r < -32768.0f) return -32768;
+    return (int16_t) r;
+}
+
+static void PutBigEndian(uint8_t* pReg, int16_t val)
+{
+    pReg[0] = (uint8_t) ((uint16_t) val >> 8);
+    pReg[1] = (uint8_t) ((uint16_t) val & 0xFF);
+}
+
+static void PutLittleEndian(uint8_t* pReg, int16_t val)
+{
+    pReg[0] = (uint8_t) ((uint16_t) val & 0xFF);
+    pReg[1] = (uint8_t) ((uint16_t) val >> 8);
+}
+
+static void ResetFifo()
+{
+    sFifoHead = 0;
+    sFifoCount = 0;
+}
+
+// a full FIFO overwrites its oldest byte and flags the overflow
+static void PushFifo(const uint8_t* pData, int len)
+{
+    for (int i = 0; i < len; ++i) {
+        if (sFifoCount == FIFO_SIZE) {
+            sFifoHead = (sFifoHead + 1) % FIFO_SIZE;
+            --sFifoCount;
+            sRegs[MPU9250_RA_INT_STATUS] |= INT_STATUS_FIFO_OFLOW;
+        }
+        sFifo[(sFifoHead + sFifoCount) % FIFO_SIZE] = pData[i];
+        ++sFifoCount;
+    }
+}
+
+static uint8_t PopFifo()
+{
+    if (sFifoCount == 0) return 0;
+    uint8_t val = sFifo[sFifoHead];
+    sFifoHead = (sFifoHead + 1) % FIFO_SIZE;
+    --sFifoCount;
+    return val;
+}
+
+// the sensors FIFO_EN selects, in the chip's order
+static void WriteFifo()
+{
+    uint8_t fifoEn = sRegs[MPU9250_RA_FIFO_EN];
+    if (fifoEn & FIFO_EN_ACCEL) PushFifo(&sRegs[MPU9250_RA_ACCEL_XOUT_H], 6);
+    if (fifoEn & FIFO_EN_TEMP) PushFifo(&sRegs[MPU9250_RA_TEMP_OUT_H], 2);
+    if (fifoEn & FIFO_EN_XG) PushFifo(&sRegs[MPU9250_RA_GYRO_XOUT_H], 2);
+    if (fifoEn & FIFO_EN_YG) PushFifo(&sRegs[MPU9250_RA_GYRO_YOUT_H], 2);
+    if (fifoEn & FIFO_EN_ZG) PushFifo(&sRegs[MPU9250_RA_GYRO_ZOUT_H], 2);
+}
+
+static void ResetDmp()
+{
+    memset(sDmpMem, 0, sizeof(sDmpMem));
+    sDmpQuat[0] = 1.0f;
+    sDmpQuat[1] = sDmpQuat[2] = sDmpQuat[3] = 0.0f;
+    memset(sDmpIntegral, 0, sizeof(sDmpIntegral));
+    sDmpSamples = 0;
+}
+
+static void ResetMpuRegs()
+{
+    memset(sRegs, 0, sizeof(sRegs));
+    ResetFifo();
+    ResetDmp();
+    sRegs[MPU9250_RA_PWR_MGMT_1] = 0x01;
+    sRegs[MPU9250_RA_WHO_AM_I] = MPU9250_WHO_AM_I_VALUE;
+}
+
+static void ResetMagRegs()
+{
+    memset(sMagRegs, 0, sizeof(sMagRegs));
+    sMagRegs[AK8963_WIA] = AK8963_WIA_VALUE;
+    sMagRegs[AK8963_ASAX] = AK8963_ASA_DEFAULT;
+    sMagRegs[AK8963_ASAY] = AK8963_ASA_DEFAULT;
+    sMagRegs[AK8963_ASAZ] = AK8963_ASA_DEFAULT;
+}
+
+static bool MagRead(uint16_t memAddr, uint8_t* pData, uint16_t size);
+static bool MagWrite(uint16_t memAddr, const uint8_t* pData, uint16_t size);
+
+// the MPU9250's aux I2C master, once per sample: slave 4 moves its one byte
+// and disables itself, slave 0 copies up to 15 bytes to EXT_SENS_DATA_00;
+// only the AK8963 answers on the aux bus
+static void RunI2CMaster()
+{
+    if (!(sRegs[MPU9250_RA_USER_CTRL] & USER_CTRL_I2C_MST_EN)) return;
+
+    if (sRegs[MPU9250_RA_I2C_SLV4_CTRL] & I2C_SLV_EN) {
+        uint8_t addr = sRegs[MPU9250_RA_I2C_SLV4_ADDR];
+        if ((addr & I2C_SLV_ADDR_MASK) != AK8963_I2C_ADDRESS) {
+            sRegs[MPU9250_RA_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV4_NACK;
+        } else if (addr & I2C_SLV_READ) {
+            MagRead(sRegs[MPU9250_RA_I2C_SLV4_REG], &sRegs[MPU9250_RA_I2C_SLV4_DI], 1);
+        } else {
+            MagWrite(sRegs[MPU9250_RA_I2C_SLV4_REG], &sRegs[MPU9250_RA_I2C_SLV4_DO], 1);
+        }
+        sRegs[MPU9250_RA_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV4_DONE;
+        sRegs[MPU9250_RA_I2C_SLV4_CTRL] &= ~I2C_SLV_EN;
+    }
+
+    uint8_t ctrl = sRegs[MPU9250_RA_I2C_SLV0_CTRL];
+    uint8_t addr = sRegs[MPU9250_RA_I2C_SLV0_ADDR];
+    if ((ctrl & I2C_SLV_EN) && (addr & I2C_SLV_READ)) {
+        if ((addr & I2C_SLV_ADDR_MASK) != AK8963_I2C_ADDRESS) {
+            sRegs[MPU9250_RA_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV0_NACK;
+        } else {
+            MagRead(sRegs[MPU9250_RA_I2C_SLV0_REG], &sRegs[MPU9250_RA_EXT_SENS_DATA_00], ctrl & I2C_SLV_LEN_MASK);
+        }
+    }
+
+    // slave 1 writes its one I2C_SLV1_DO byte, what the DMP driver uses to
+    // start the AK8963's single measurements
+    ctrl = sRegs[MPU9250_RA_I2C_SLV1_CTRL];
+    addr = sRegs[MPU9250_RA_I2C_SLV1_ADDR];
+    if ((ctrl & I2C_SLV_EN) && !(addr & I2C_SLV_READ) && (addr & I2C_SLV_ADDR_MASK) == AK8963_I2C_ADDRESS) {
+        MagWrite(sRegs[MPU9250_RA_I2C_SLV1_REG], &sRegs[MPU9250_RA_I2C_SLV1_DO], 1);
+    }
+}
+
+static bool DmpMemIs(uint16_t addr, uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3)
+{
+    return sDmpMem[addr] == b0 && sDmpMem[addr + 1] == b1 && sDmpMem[addr + 2] == b2 && sDmpMem[addr + 3] == b3;
+}
+
+static void PutQ30(uint8_t* pData, float val)
+{
+    int32_t q = (int32_t) lround(val * DMP_QUAT_ONE);
+    pData[0] = (uint8_t) ((uint32_t) q >> 24);
+    pData[1] = (uint8_t) ((uint32_t) q >> 16);
+    pData[2] = (uint8_t) ((uint32_t) q >> 8);
+    pData[3] = (uint8_t) q;
+}
+
+static float RegToFloat(const uint8_t* pReg)
+{
+    return (float) (int16_t) (((uint16_t) pReg[0] << 8) | pReg[1]);
+}
+
+// one Mahony step on the latched sample. The model's sensor axes follow the
+// firmware's conventions rather than a rigid chip, see SILPlant_GetImuTruth(),
+// so the fusion runs in StateEstimator's Madgwick frame, accel (x, y, -z)
+// and gyro negated; 6-axis corrects with the accel, 3-axis only integrates
+static void DmpFuse(float dt, bool useAccel)
+{
+    int gyroFs = (sRegs[RA_GYRO_CONFIG] >> FS_SEL_SHIFT) & FS_SEL_MASK;
+    float gyroLsb = GYRO_LSB_PER_DPS_FS250 / (float) (1 << gyroFs);
+    float g[3], a[3];
+    for (int i = 0; i < 3; ++i) {
+        g[i] = -RegToFloat(&sRegs[MPU9250_RA_GYRO_XOUT_H + 2 * i]) / gyroLsb * DEG_TO_RAD;
+        a[i] = RegToFloat(&sRegs[MPU9250_RA_ACCEL_XOUT_H + 2 * i]);
+    }
+    a[2] = -a[2];
+
+    float* q = sDmpQuat;
+    float norm = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    if (useAccel && norm > 0.0f) {
+        for (int i = 0; i < 3; ++i) a[i] /= norm;
+        // estimated up minus measured, as a rotation
+        float v[3] = { 2.0f * (q[1] * q[3] - q[0] * q[2]), 2.0f * (q[0] * q[1] + q[2] * q[3]),
+                       q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3] };
+        float e[3] = { a[1] * v[2] - a[2] * v[1], a[2] * v[0] - a[0] * v[2], a[0] * v[1] - a[1] * v[0] };
+        for (int i = 0; i < 3; ++i) {
+            sDmpIntegral[i] += DMP_KI * e[i] * dt;
+            g[i] += DMP_KP * e[i] + sDmpIntegral[i];
+        }
+    }
+    float dq[4] = { -q[1] * g[0] - q[2] * g[1] - q[3] * g[2], q[0] * g[0] + q[2] * g[2] - q[3] * g[1],
+                    q[0] * g[1] - q[1] * g[2] + q[3] * g[0], q[0] * g[2] + q[1] * g[1] - q[2] * g[0] };
+    norm = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        q[i] += 0.5f * dq[i] * dt;
+        norm += q[i] * q[i];
+    }
+    norm = sqrtf(norm);
+    for (int i = 0; i < 4; ++i) q[i] /= norm;
+}
+
+// the fused orientation as the chip would report it: sensor to world with
+// the sensor's own z and yaw about it, which StateEstimator::ConvertDmpQuat()
+// turns back
+static void DmpChipQuat(float* pQuat)
+{
+    const float* q = sDmpQuat;
+    float upX = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    float upY = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+    float upZ = -(q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3]);
+    float roll = atan2f(upY, upZ);
+    float pitch = asinf(fmaxf(-1.0f, fminf(1.0f, -upX)));
+    float yaw = -atan2f(2.0f * (q[1] * q[2] + q[0] * q[3]), 1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3]));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+    float cy = cosf(yaw * 0.5f), sy = sinf(yaw * 0.5f);
+    pQuat[0] = cr * cp * cy + sr * sp * sy;
+    pQuat[1] = sr * cp * cy - cr * sp * sy;
+    pQuat[2] = cr * sp * cy + sr * cp * sy;
+    pQuat[3] = cr * cp * sy - sr * sp * cy;
+}
+
+// the DMP on the latched sample, once per sample while USER_CTRL.DMP_EN is
+// set; every D_0_22 + 1 samples a packet of what the configuration words
+// enable goes to pPacket. Returns its length, 0 for none.
+static int RunDmp(uint8_t* pPacket)
+{
+    bool quat6 = DmpMemIs(DMP_CFG_8, DINA20, DINA28, DINA30, DINA38);
+    bool quat3 = DmpMemIs(DMP_CFG_LP_QUAT, DINBC0, DINBC2, DINBC4, DINBC6);
+    float dt = (float) (sRegs[RA_SMPLRT_DIV] + 1) * 1e-3f;
+    DmpFuse(dt, quat6);
+
+    uint32_t div = ((uint32_t) sDmpMem[DMP_D_0_22] << 8) | sDmpMem[DMP_D_0_22 + 1];
+    if (++sDmpSamples < div + 1) return 0;
+    sDmpSamples = 0;
+
+    int len = 0;
+    if (quat6 || quat3) {
+        float quat[4];
+        DmpChipQuat(quat);
+        for (int i = 0; i < 4; ++i) PutQ30(&pPacket[len + 4 * i], quat[i]);
+        len += DMP_QUAT_LEN;
+    }
+    if (sDmpMem[DMP_CFG_15 + 1] == DMP_CFG_15_ACCEL) {
+        memcpy(&pPacket[len], &sRegs[MPU9250_RA_ACCEL_XOUT_H], 6);
+        len += 6;
+    }
+    if (sDmpMem[DMP_CFG_15 + 4] == DMP_CFG_15_GYRO) {
+        memcpy(&pPacket[len], &sRegs[MPU9250_RA_GYRO_XOUT_H], 6);
+        len += 6;
+    }
+    if (sDmpMem[DMP_CFG_27] == DINA20) {
+        memset(&pPacket[len], 0, DMP_GESTURE_LEN);
+        len += DMP_GESTURE_LEN;
+    }
+    return len;
+}
+
+static void LatchMotion()
+{
+    int gyroFs = (sRegs[RA_GYRO_CONFIG] >> FS_SEL_SHIFT) & FS_SEL_MASK;
+    int accFs = (sRegs[RA_ACCEL_CONFIG] >> FS_SEL_SHIFT) & FS_SEL_MASK;
+    float gyroLsb = GYRO_LSB_PER_DPS_FS250 / (float) (1 << gyroFs);
+    float accLsb = ACC_LSB_PER_G_FS2 / (float) (1 << accFs);
+
+    for (int i = 0; i < 3; ++i) {
+        // a third of a period apart on the axes
+        float vibration = sinf(2.0f * SIL_IMU_PI * (sConfig.vibrationHz * sTickCnt * 1e-3f + i / 3.0f));
+        const uint8_t* pOffset = &sRegs[RA_XA_OFFSET_H + ACCEL_OFFSET_STRIDE * i];
+        float offset = (float) (int16_t) ((((uint16_t) pOffset[0] << 8) | pOffset[1]) & ~1) / ACCEL_OFFSET_LSB_PER_G;
+        float acc = sAccTruth[i] + sConfig.accBiasG[i] + offset + sConfig.accNoiseG * RandGauss() + sConfig.vibrationG * vibration;
+        float gyro = sGyroTruth[i] + sConfig.gyroBiasDps[i] + sConfig.gyroNoiseDps * RandGauss() + sConfig.vibrationDps * vibration;
+        PutBigEndian(&sRegs[MPU9250_RA_ACCEL_XOUT_H + 2 * i], Quantise(acc * accLsb));
+        PutBigEndian(&sRegs[MPU9250_RA_GYRO_XOUT_H + 2 * i], Quantise(gyro * gyroLsb));
+    }
+    PutBigEndian(&sRegs[MPU9250_RA_TEMP_OUT_H], Quantise((DIE_TEMPERATURE - TEMP_ROOM_OFFSET) * TEMP_LSB_PER_DEGC));
+    RunI2CMaster();
+    uint8_t packet[DMP_MAX_PACKET_LEN];
+    int packetLen = (sRegs[MPU9250_RA_USER_CTRL] & USER_CTRL_DMP_EN) ? RunDmp(packet) : 0;
+    if (sRegs[MPU9250_RA_USER_CTRL] & USER_CTRL_FIFO_EN) {
+        WriteFifo();
+        PushFifo(packet, packetLen);
+    }
+    // one pulse on the INT pin for whichever enabled source fired
+    uint8_t status = INT_STATUS_RAW_DATA_RDY | (packetLen ? INT_STATUS_DMP_INT : 0);
+    sRegs[MPU9250_RA_INT_STATUS] |= status;
+    if (sIntHook && (sRegs[MPU9250_RA_INT_ENABLE] & status)) {
+        sIntHook();
+    }
+}
+
+static void LatchMag()
+{
+    float utPerLsb = (sMagRegs[AK8963_CNTL] & MAG_CNTL_BIT) ? MAG_UT_PER_LSB_16BIT : MAG_UT_PER_LSB_14BIT;
+    for (int i = 0; i < 3; ++i) {
+        PutLittleEndian(&sMagRegs[AK8963_HXL + 2 * i], Quantise(sMagTruth[i] / utPerLsb));
+    }
+    sMagRegs[AK8963_ST1] |= MAG_ST1_DRDY;
+}
+
+static bool IsStreamReg(uint16_t reg)
+{
+    return reg == MPU9250_RA_FIFO_R_W || reg == MPU9250_RA_MEM_R_W;
+}
+
+// MEM_START_ADDR goes round within the bank
+static uint16_t DmpMemAddr()
+{
+    return (uint16_t) ((sRegs[MPU9250_RA_BANK_SEL] * DMP_BANK_SIZE + sRegs[MPU9250_RA_MEM_START_ADDR]) % DMP_MEM_SIZE);
+}
+
+static bool MpuRead(uint16_t memAddr, uint8_t* pData, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; ++i) {
+        // a burst from FIFO_R_W or MEM_R_W stays there and moves one byte
+        // after the other
+        uint16_t reg = IsStreamReg(memAddr) ? memAddr : (memAddr + i) % NUM_OF_MPU_REGS;
+        if (reg == MPU9250_RA_FIFO_R_W) {
+            pData[i] = PopFifo();
+        } else if (reg == MPU9250_RA_MEM_R_W) {
+            pData[i] = sDmpMem[DmpMemAddr()];
+            ++sRegs[MPU9250_RA_MEM_START_ADDR];
+        } else if (reg == MPU9250_RA_FIFO_COUNTH) {
+            pData[i] = (uint8_t) (sFifoCount >> 8);
+        } else if (reg == MPU9250_RA_FIFO_COUNTL) {
+            pData[i] = (uint8_t) (sFifoCount & 0xFF);
+        } else {
+            pData[i] = sRegs[reg];
+        }
+        if (reg == MPU9250_RA_INT_STATUS) {
+            sRegs[reg] &= ~(INT_STATUS_RAW_DATA_RDY | INT_STATUS_DMP_INT | INT_STATUS_FIFO_OFLOW); // cleared on read
+        } else if (reg == MPU9250_RA_I2C_MST_STATUS) {
+            sRegs[reg] = 0;
+        }
+    }
+    return true;
+}
+
+static bool MpuWrite(uint16_t memAddr, const uint8_t* pData, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; ++i) {
+        uint16_t reg = IsStreamReg(memAddr) ? memAddr : (memAddr + i) % NUM_OF_MPU_REGS;
+        if (reg == MPU9250_RA_MEM_R_W) {
+            sDmpMem[DmpMemAddr()] = pData[i];
+            ++sRegs[MPU9250_RA_MEM_START_ADDR];
+            continue;
+        }
+        if (reg == MPU9250_RA_WHO_AM_I || reg == MPU9250_RA_INT_STATUS || reg == MPU9250_RA_I2C_MST_STATUS
+            || reg == MPU9250_RA_I2C_SLV4_DI || (reg >= MPU9250_RA_EXT_SENS_DATA_00 && reg <= MPU9250_RA_EXT_SENS_DATA_23)) {
+            continue; // read only
+        }
+        if (reg == MPU9250_RA_PWR_MGMT_1 && (pData[i] & PWR_MGMT_1_RESET)) {
+            ResetMpuRegs();
+            continue;
+        }
+        if (reg == MPU9250_RA_USER_CTRL) {
+            // the reset bits clear themselves; a DMP reset restarts its
+            // packet count, the fusion state is in its memory
+            if (pData[i] & USER_CTRL_FIFO_RST) ResetFifo();
+            if (pData[i] & USER_CTRL_DMP_RST) sDmpSamples = 0;
+            sRegs[reg] = pData[i] & ~(USER_CTRL_FIFO_RST | USER_CTRL_DMP_RST);
+            continue;
+        }
+        sRegs[reg] = pData[i];
+    }
+    return true;
+}
+
+static bool MagRead(uint16_t memAddr, uint8_t* pData, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; ++i) {
+        uint16_t reg = memAddr + i;
+        pData[i] = reg < NUM_OF_MAG_REGS ? sMagRegs[reg] : 0;
+        if (reg == AK8963_ST2) {
+            sMagRegs[AK8963_ST1] &= ~MAG_ST1_DRDY; // reading ST2 releases the data
+        }
+    }
+    return true;
+}
+
+static bool MagWrite(uint16_t memAddr, const uint8_t* pData, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; ++i) {
+        uint16_t reg = memAddr + i;
+        if (reg != AK8963_CNTL) continue;
+        sMagRegs[reg] = pData[i];
+        if ((pData[i] & MAG_CNTL_MODE_MASK) == MAG_MODE_SINGLE) {
+            // one sample, then back to power down
+            LatchMag();
+            sMagRegs[reg] &= ~MAG_CNTL_MODE_MASK;
+        }
+    }
+    return true;
+}
+
+void SILImu_Init(const SILImuConfigType* pConfig, uint32_t seed)
+{
+    memset(&sConfig, 0, sizeof(sConfig));
+    if (pConfig) sConfig = *pConfig;
+    sRandState = seed ? seed : 1;
+    memset(sGyroTruth, 0, sizeof(sGyroTruth));
+    memset(sAccTruth, 0, sizeof(sAccTruth));
+    memset(sMagTruth, 0, sizeof(sMagTruth));
+    sTickCnt = 0;
+    sIntHook = NULL;
+    ResetMpuRegs();
+    ResetMagRegs();
+
+    static const SILI2CDeviceType mpu = { MPU9250_DEFAULT_ADDRESS, MpuRead, MpuWrite };
+    static const SILI2CDeviceType mag = { MPU9250_RA_MAG_ADDRESS, MagRead, MagWrite };
+    SIL_AttachI2CDevice(&mpu);
+    SIL_AttachI2CDevice(&mag);
+    // the same registers on SPI2, chip select on PB1; the AK8963 is reached
+    // through the MPU9250's own I2C master there, see RunI2CMaster()
+    static const SILSpiDeviceType mpuSpi = { SPI2, GPIOB, GPIO_PIN_1, MpuRead, MpuWrite };
+    SIL_AttachSpiDevice(&mpuSpi);
+}
+
+void SILImu_SetIntHook(SILIrqHandler hook)
+{
+    sIntHook = hook;
+}
+
+void SILImu_SetTruth(const float gyroDps[3], const float accG[3], const float magUT[3])
+{
+    for (int i = 0; i < 3; ++i) {
+        sGyroTruth[i] = gyroDps[i];
+        sAccTruth[i] = accG[i];
+        sMagTruth[i] = magUT[i];
+    }
+}
+
+void SILImu_Tick()
+{
+    ++sTickCnt;
+    // internal rate is 1 kHz with the DLPF enabled, divided by SMPLRT_DIV
+    uint32_t div = (uint32_t) sRegs[RA_SMPLRT_DIV] + 1;
+    if (sTickCnt % div == 0) {
+        LatchMotion();
+    }
+
+    uint8_t mode = sMagRegs[AK8963_CNTL] & MAG_CNTL_MODE_MASK;
+    if ((mode == MAG_MODE_CONT_100HZ && sTickCnt % 10 == 0)
+        || (mode == MAG_MODE_CONT_8HZ && sTickCnt % 125 == 0)) {
+        LatchMag();
+    }
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "sil_hal.h"
+#include "sil_imu_bus.h"
+
+/*
+ * Defines
+ */
+
+// the backend queue plus the one on the bus, with room to spare
+#define MAX_PENDING (16)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    OP_READ,
+    OP_WRITE,
+    OP_READ_ASYNC,
+    OP_WRITE_ASYNC,
+} SILImuBusOpType;
+
+// a queued transaction, its callback is wrapped until it reports
+typedef struct {
+    bool used;
+    SILImuBusOpType op;
+    uint16_t devAddr;
+    uint8_t reg;
+    uint16_t size;
+    uint64_t startUs;
+    ImuBusDoneCb cb;
+    void* pArg;
+} SILImuBusPendingType;
+
+/*
+ * Static
+ */
+
+static const ImuBusBackendType* spInner = NULL;
+static FILE* spLog = NULL;
+static SILImuBusPendingType sPending[MAX_PENDING];
+static SILImuBusSummaryType sSummary;
+
+static const char* const OP_NAMES[] = { "r", "w", "ar", "aw" };
+
+/*
+ * Code
+ */
+
+static void Record(SILImuBusOpType op, uint16_t devAddr, uint8_t reg, uint16_t size,
+                   uint64_t startUs, uint64_t doneUs, bool ok)
+{
+    ++sSummary.transactions;
+    if (!ok) ++sSummary.failed;
+    if (ok) sSummary.bytes += size;
+    if (op == OP_READ_ASYNC || op == OP_WRITE_ASYNC) {
+        ++sSummary.asyncTransactions;
+        if (doneUs == 0) {
+            ++sSummary.notQueued;
+        } else {
+            uint32_t us = (uint32_t) (doneUs - startUs);
+            sSummary.asyncLatencyUs += us;
+            if (us > sSummary.maxAsyncLatencyUs) sSummary.maxAsyncLatencyUs = us;
+        }
+    }
+    if (spLog) {
+        fprintf(spLog, "%llu,%llu,%s,0x%02x,0x%02x,%u,%d\n", (unsigned long long) startUs,
+                (unsigned long long) doneUs, OP_NAMES[op], devAddr >> 1, reg, size, ok ? 1 : 0);
+    }
+}
+
+static void OnDone(bool ok, void* pArg)
+{
+    SILImuBusPendingType* pPending = (SILImuBusPendingType*) pArg;
+    SILImuBusPendingType done = *pPending;
+    pPending->used = false;
+    Record(done.op, done.devAddr, done.reg, done.size, done.startUs, SIL_GetTimeUs(), ok);
+    if (done.cb) done.cb(ok, done.pArg);
+}
+
+static SILImuBusPendingType* Reserve(SILImuBusOpType op, uint16_t devAddr, uint8_t reg, uint16_t size,
+                                     ImuBusDoneCb cb, void* pArg)
+{
+    for (int i = 0; i < MAX_PENDING; ++i) {
+        SILImuBusPendingType* pPending = &sPending[i];
+        if (pPending->used) continue;
+        pPending->used = true;
+        pPending->op = op;
+        pPending->devAddr = devAddr;
+        pPending->reg = reg;
+        pPending->size = size;
+        pPending->startUs = SIL_GetTimeUs();
+        pPending->cb = cb;
+        pPending->pArg = pArg;
+        return pPending;
+    }
+    return NULL;
+}
+
+static bool Init()
+{
+    return spInner->init();
+}
+
+static void OnTick()
+{
+    spInner->onTick();
+}
+
+static bool Read(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    uint64_t startUs = SIL_GetTimeUs();
+    bool ok = spInner->read(devAddr, reg, pData, size);
+    Record(OP_READ, devAddr, reg, size, startUs, SIL_GetTimeUs(), ok);
+    return ok;
+}
+
+static bool Write(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    uint64_t startUs = SIL_GetTimeUs();
+    bool ok = spInner->write(devAddr, reg, pData, size);
+    Record(OP_WRITE, devAddr, reg, size, startUs, SIL_GetTimeUs(), ok);
+    return ok;
+}
+
+static bool Async(SILImuBusOpType op, uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size,
+                  ImuBusDoneCb cb, void* pArg)
+{
+    SILImuBusPendingType* pPending = Reserve(op, devAddr, reg, size, cb, pArg);
+    if (!pPending) {
+        // more in flight than any backend queues, pass it on unrecorded
+        return op == OP_READ_ASYNC ? spInner->readAsync(devAddr, reg, pData, size, cb, pArg)
+                                   : spInner->writeAsync(devAddr, reg, pData, size, cb, pArg);
+    }
+    uint64_t startUs = pPending->startUs;
+    bool queued = op == OP_READ_ASYNC ? spInner->readAsync(devAddr, reg, pData, size, OnDone, pPending)
+                                      : spInner->writeAsync(devAddr, reg, pData, size, OnDone, pPending);
+    if (!queued) {
+        pPending->used = false;
+        Record(op, devAddr, reg, size, startUs, 0, false);
+    }
+    return queued;
+}
+
+static bool ReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return Async(OP_READ_ASYNC, devAddr, reg, pData, size, cb, pArg);
+}
+
+static bool WriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return Async(OP_WRITE_ASYNC, devAddr, reg, pData, size, cb, pArg);
+}
+
+static void GetStats(ImuBusStatsType* pStats)
+{
+    spInner->getStats(pStats);
+}
+
+static void ResetStats()
+{
+    spInner->resetStats();
+}
+
+const ImuBusBackendType* SILImuBus_Wrap(const ImuBusBackendType* pInner, FILE* pLog)
+{
+    static ImuBusBackendType sBackend;
+    if (!pInner) return NULL;
+    spInner = pInner;
+    spLog = pLog;
+    memset(sPending, 0, sizeof(sPending));
+    memset(&sSummary, 0, sizeof(sSummary));
+    if (spLog) fprintf(spLog, "start_us,done_us,op,dev,reg,size,ok\n");
+    sBackend.name = pInner->name;
+    sBackend.bus = pInner->bus;
+    sBackend.init = Init;
+    sBackend.onTick = OnTick;
+    sBackend.read = Read;
+    sBackend.write = Write;
+    sBackend.readAsync = ReadAsync;
+    sBackend.writeAsync = WriteAsync;
+    sBackend.getStats = GetStats;
+    sBackend.resetStats = ResetStats;
+    return &sBackend;
+}
+
+void SILImuBus_GetSummary(SILImuBusSummaryType* pSummary)
+{
+    *pSummary = sSummary;
+}
@@ -0,0 +1,651 @@
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+#include "main_app.h"
+#include "blackbox.h"
+#include "boot_seq.h"
+#include "profiler.h"
+#include "crsf.h"
+#include "IMU.h"
+#include "imu_bus.h"
+#include "led.h"
+#include "rc_uart.h"
+#include "receiver.h"
+#include "sbus.h"
+#include "cmd_listener.h"
+#include "scheduler.h"
+#include "sensor_reader.h"
+#include "state_estimator.h"
+#include "uart.h"
+#include "util.h"
+#include "UAV_Defines.h"
+
+#include "sil_hal.h"
+#include "sil_imu.h"
+#include "sil_imu_bus.h"
+#include "sil_plant.h"
+#include "sil_rc.h"
+
+/*
+ * Software-in-the-loop entry point. Plays the role of main.c and
+ * stm32f1xx_it.c: owns the peripheral handles, routes the interrupts, and
+ * runs MainApp against the models in virtual time. Firmware compute is free
+ * in virtual time, only waits and bus transfers advance the clock, so the
+ * run is deterministic for a given seed and script.
+ */
+
+/*
+ * Defines
+ */
+
+#define DEFAULT_DURATION_S (30)
+#define DEFAULT_SEED (1)
+#define TRACE_PERIOD_MS (10)
+#define SETTLE_TIME_MS (7000)
+#define DIVERGED_ANGLE_DEG (60.0f)
+#define IMU_VIBRATION_DPS (10.0f) // amplitude with --imu-vibration
+#define IMU_VIBRATION_G (0.2f)
+
+#define SBUS_CHANNEL_MID ((SBUS_CHANNEL_MIN + SBUS_CHANNEL_MAX + 1) / 2)
+#define ARM_HOLD_MS (6000) // boot takes ~4.2 s, arming is checked at 4 Hz
+#define MANOEUVRE_START_MS (8000)
+#define MANOEUVRE_STEP_MS (2000)
+#define MANOEUVRE_ANGLE_DEG (10.0f)
+
+/*
+ * Peripheral handles, as in main.c
+ */
+
+I2C_HandleTypeDef hi2c1;
+SPI_HandleTypeDef hspi2;
+TIM_HandleTypeDef htim1;
+UART_HandleTypeDef huart2;
+UART_HandleTypeDef huart3;
+DMA_HandleTypeDef hdma_usart3_rx;
+
+/*
+ * Static
+ */
+
+typedef struct {
+    uint64_t samples;
+    double trackErrSq;
+    double estErrSq;
+    float maxAngle;
+} SILStatsType;
+
+static FILE* spTrace = NULL;
+static FILE* spLogOut = NULL;
+static FILE* spRcOut = NULL;
+static FILE* spBlackbox = NULL;
+static FILE* spImuBusLog = NULL;
+static bool sEchoLog = false;
+static SILStatsType sStats;
+static uint32_t sLedChanges = 0; // onboard LED, PC13
+static uint32_t sLedOdr = 0;
+
+/*
+ * Code
+ */
+
+static void MX_I2C1_Init(void)
+{
+    hi2c1.Instance = I2C1;
+    hi2c1.Init.ClockSpeed = 100000;
+}
+
+static void MX_SPI2_Init(void)
+{
+    hspi2.Instance = SPI2;
+    hspi2.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_32;
+    HAL_SPI_Init(&hspi2);
+}
+
+static void MX_TIM1_Init(void)
+{
+    htim1.Instance = TIM1;
+    htim1.Init.Prescaler = 64;
+    htim1.Init.Period = 5000;
+}
+
+static void MX_USART2_UART_Init(void)
+{
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = 460800;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits = UART_STOPBITS_1;
+    huart2.Init.Parity = UART_PARITY_NONE;
+}
+
+static void MX_USART3_UART_Init(void)
+{
+    huart3.Instance = USART3;
+    huart3.Init.BaudRate = 100000;
+    huart3.Init.WordLength = UART_WORDLENGTH_9B;
+    huart3.Init.StopBits = UART_STOPBITS_2;
+    huart3.Init.Parity = UART_PARITY_EVEN;
+    hdma_usart3_rx.Instance = DMA1_Channel3;
+    hdma_usart3_rx.Init.Mode = DMA_CIRCULAR;
+    __HAL_LINKDMA(&huart3, hdmarx, hdma_usart3_rx);
+}
+
+static void USART3_IRQHandler(void)
+{
+    HAL_UART_IRQHandler(&huart3);
+    RcUart_InterruptHandler();
+}
+
+static void EXTI15_10_IRQHandler(void)
+{
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_12);
+}
+
+// MPU9250 INT is wired to PB12, --imu-int-stop cuts it
+static uint64_t sImuIntStopUs = UINT64_MAX;
+
+static void OnImuInt(void)
+{
+    if (SIL_GetTimeUs() >= sImuIntStopUs) return;
+    SIL_GpioPulse(GPIOB, GPIO_PIN_12);
+}
+
+// --rc-stop ends the receiver frames, the motors must go idle after it
+static uint64_t sRcStopUs = UINT64_MAX;
+static uint64_t sMotorsRunUs = 0; // the last tick a motor ran
+
+static void SysTick_Handler(void)
+{
+    HAL_IncTick();
+    ImuBus_OnTick();
+    LED_OnTick();
+    MainApp_OnCoreTimerTick();
+}
+
+// Firmware compute is free in virtual time, so the profiler measures host
+// time instead, scaled to target cycles so the per-commit numbers compare.
+uint32_t Profiler_GetCycles()
+{
+    static const auto sStart = std::chrono::steady_clock::now();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sStart).count();
+    return (uint32_t) (ns * (SIL_CORE_CLOCK / 1000000) / 1000);
+}
+
+static void OnUartLog(const uint8_t* pData, uint16_t size)
+{
+    if (sEchoLog) fwrite(pData, 1, size, stdout);
+    if (spLogOut) fwrite(pData, 1, size, spLogOut);
+}
+
+static uint16_t AngleToChannel(float deg, float min, float max)
+{
+    return (uint16_t) (SBUS_CHANNEL_MIN + (deg - min) / (max - min) * (SBUS_CHANNEL_MAX - SBUS_CHANNEL_MIN) + 0.5f);
+}
+
+static int BuildDefaultScript(SILRcKeyframeType* pScript, int maxNum, uint32_t durationMs)
+{
+    // arm: throttle low, roll left, pitch down, yaw right; then centre and
+    // step pitch and roll in turn
+    int num = 0;
+    SILRcKeyframeType arm = { 0, { SBUS_CHANNEL_MIN, SBUS_CHANNEL_MIN, SBUS_CHANNEL_MIN, SBUS_CHANNEL_MAX, SBUS_CHANNEL_MIN } };
+    SILRcKeyframeType centre = { ARM_HOLD_MS, { SBUS_CHANNEL_MID, SBUS_CHANNEL_MID, SBUS_CHANNEL_MID, SBUS_CHANNEL_MID, SBUS_CHANNEL_MIN } };
+    pScript[num++] = arm;
+    pScript[num++] = centre;
+
+    uint16_t pitchUp = AngleToChannel(MANOEUVRE_ANGLE_DEG, CMD_PITCH_MIN, CMD_PITCH_MAX);
+    uint16_t rollLeft = AngleToChannel(-MANOEUVRE_ANGLE_DEG, CMD_ROLL_MIN, CMD_ROLL_MAX);
+    for (uint32_t t = MANOEUVRE_START_MS; t < durationMs && num + 4 <= maxNum; t += 4 * MANOEUVRE_STEP_MS) {
+        SILRcKeyframeType k = centre;
+        k.timeMs = t;
+        k.channels[2] = pitchUp;
+        pScript[num++] = k;
+        k = centre;
+        k.timeMs = t + MANOEUVRE_STEP_MS;
+        pScript[num++] = k;
+        k.timeMs = t + 2 * MANOEUVRE_STEP_MS;
+        k.channels[1] = rollLeft;
+        pScript[num++] = k;
+        k = centre;
+        k.timeMs = t + 3 * MANOEUVRE_STEP_MS;
+        pScript[num++] = k;
+    }
+    return num;
+}
+
+static void GetMotorCmd(float motorCmd[SIL_NUM_OF_MOTORS])
+{
+    static const uint32_t channels[SIL_NUM_OF_MOTORS] = { TIM_CHANNEL_1, TIM_CHANNEL_2, TIM_CHANNEL_3, TIM_CHANNEL_4 };
+    const uint32_t ccr[SIL_NUM_OF_MOTORS] = { TIM1->CCR1, TIM1->CCR2, TIM1->CCR3, TIM1->CCR4 };
+    for (int i = 0; i < SIL_NUM_OF_MOTORS; ++i) {
+        // pulse width in us, 1000 is stopped
+        float cmd = SIL_PwmIsRunning(TIM1, channels[i]) ? (float) ccr[i] - 1000.0f : 0.0f;
+        motorCmd[i] = cmd < 0.0f ? 0.0f : cmd;
+    }
+}
+
+static void RecordSample(uint32_t nowMs, const SILPlantStateType& plant)
+{
+    uint16_t ch[SIL_RC_NUM_OF_CHANNELS];
+    SILRc_GetChannels(ch);
+    float spRoll = Util_Constrain((float) ch[1], (float) SBUS_CHANNEL_MIN, (float) SBUS_CHANNEL_MAX, CMD_ROLL_MIN, CMD_ROLL_MAX);
+    float spPitch = Util_Constrain((float) ch[2], (float) SBUS_CHANNEL_MIN, (float) SBUS_CHANNEL_MAX, CMD_PITCH_MIN, CMD_PITCH_MAX);
+    const FCAttType& est = StateEstimator::GetInstance().mState.att;
+
+    // without the receiver the sticks of the script no longer apply
+    if (nowMs >= SETTLE_TIME_MS && nowMs * 1000ULL < sRcStopUs) {
+        float dRoll = spRoll - plant.att[SIL_AXIS_ROLL];
+        float dPitch = spPitch - plant.att[SIL_AXIS_PITCH];
+        float eRoll = est.roll - plant.att[SIL_AXIS_ROLL];
+        float ePitch = est.pitch - plant.att[SIL_AXIS_PITCH];
+        ++sStats.samples;
+        sStats.trackErrSq += dRoll * dRoll + dPitch * dPitch;
+        sStats.estErrSq += eRoll * eRoll + ePitch * ePitch;
+    }
+    for (int i = SIL_AXIS_ROLL; i <= SIL_AXIS_PITCH; ++i) {
+        if (fabsf(plant.att[i]) > sStats.maxAngle) sStats.maxAngle = fabsf(plant.att[i]);
+    }
+
+    if (spTrace) {
+        fprintf(spTrace, "%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f\n",
+                nowMs, spRoll, spPitch,
+                plant.att[SIL_AXIS_ROLL], plant.att[SIL_AXIS_PITCH], plant.att[SIL_AXIS_YAW],
+                est.roll, est.pitch,
+                plant.motor[0], plant.motor[1], plant.motor[2], plant.motor[3]);
+    }
+}
+
+static void OnSimTick(void)
+{
+    // plant and sensors first, so the firmware sees this tick's world
+    float motorCmd[SIL_NUM_OF_MOTORS];
+    GetMotorCmd(motorCmd);
+    SILPlant_Step(SIL_TICK_US * 1e-6f, motorCmd);
+    for (int i = 0; i < SIL_NUM_OF_MOTORS; ++i) {
+        if (motorCmd[i] > 0.0f) sMotorsRunUs = SIL_GetTimeUs();
+    }
+
+    float gyro[3], acc[3], mag[3];
+    SILPlant_GetImuTruth(gyro, acc, mag);
+    SILImu_SetTruth(gyro, acc, mag);
+    SILImu_Tick();
+
+    uint64_t nowUs = SIL_GetTimeUs();
+    if (nowUs < sRcStopUs) SILRc_Tick(nowUs);
+
+    SysTick_Handler();
+
+    uint32_t ledOdr = SIL_GPIOC.ODR & GPIO_PIN_13;
+    if (ledOdr != sLedOdr) {
+        sLedOdr = ledOdr;
+        ++sLedChanges;
+    }
+
+    uint32_t nowMs = (uint32_t) (nowUs / 1000);
+    if (nowMs % TRACE_PERIOD_MS == 0) {
+        SILPlantStateType plant;
+        SILPlant_GetState(&plant);
+        RecordSample(nowMs, plant);
+    }
+}
+
+// stands in for the storage backend, the file takes every frame immediately
+static bool BlackboxFileWrite(const uint8_t* pData, int size)
+{
+    return fwrite(pData, 1, size, spBlackbox) == (size_t) size;
+}
+
+static const BlackboxBackendType sBlackboxFile = { "file", BlackboxFileWrite };
+
+static void PrintUsage(const char* pName)
+{
+    printf("usage: %s [--duration <s>] [--seed <n>] [--rc <script.csv>] [--trace <out.csv>] [--log] [--log-out <out.bin>]\n"
+           "          [--blackbox <out.bin>] [--rc-protocol sbus|crsf] [--crsf-rate <hz>] [--rc-corrupt <n>] [--rc-out <out.bin>]\n"
+           "          [--i2c-latency <us>] [--i2c-fault <n>] [--imu-vibration <hz>] [--imu-bus i2c|spi]\n"
+           "          [--imu-bus-log <out.csv>] [--spi-fault <n>] [--imu-int-stop <s>] [--rc-stop <s>]\n"
+           "          [--flash <image.bin>]\n", pName);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t durationS = DEFAULT_DURATION_S;
+    uint32_t seed = DEFAULT_SEED;
+    const char* pRcPath = NULL;
+    const char* pTracePath = NULL;
+    const char* pLogOutPath = NULL;
+    const char* pBlackboxPath = NULL;
+    const char* pRcOutPath = NULL;
+    uint32_t rcCorruptOneInN = 0;
+    SILRcProtocolType rcProtocol = SIL_RC_SBUS;
+    uint32_t crsfRateHz = 0;
+    uint32_t i2cLatencyUs = 0;
+    uint32_t i2cFaultOneInN = 0;
+    float imuVibrationHz = 0.0f;
+    const ImuBusBackendType* pImuBus = ImuBus_GetBackend();
+    const char* pImuBusLogPath = NULL;
+    uint32_t spiFaultOneInN = 0;
+    const char* pFlashPath = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            durationS = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--rc") && i + 1 < argc) {
+            pRcPath = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            pTracePath = argv[++i];
+        } else if (!strcmp(argv[i], "--log")) {
+            sEchoLog = true;
+        } else if (!strcmp(argv[i], "--log-out") && i + 1 < argc) {
+            pLogOutPath = argv[++i];
+        } else if (!strcmp(argv[i], "--blackbox") && i + 1 < argc) {
+            pBlackboxPath = argv[++i];
+        } else if (!strcmp(argv[i], "--rc-protocol") && i + 1 < argc) {
+            const char* pName = argv[++i];
+            if (!strcmp(pName, "crsf")) {
+                rcProtocol = SIL_RC_CRSF;
+            } else if (strcmp(pName, "sbus")) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--crsf-rate") && i + 1 < argc) {
+            crsfRateHz = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rc-corrupt") && i + 1 < argc) {
+            rcCorruptOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--i2c-latency") && i + 1 < argc) {
+            i2cLatencyUs = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--i2c-fault") && i + 1 < argc) {
+            i2cFaultOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--imu-vibration") && i + 1 < argc) {
+            imuVibrationHz = (float) atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--imu-bus") && i + 1 < argc) {
+            const char* pName = argv[++i];
+            if (!strcmp(pName, "i2c")) {
+                pImuBus = ImuBus_GetBuiltinBackend(IMU_BUS_I2C);
+            } else if (!strcmp(pName, "spi")) {
+                pImuBus = ImuBus_GetBuiltinBackend(IMU_BUS_SPI);
+            } else {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--imu-bus-log") && i + 1 < argc) {
+            pImuBusLogPath = argv[++i];
+        } else if (!strcmp(argv[i], "--spi-fault") && i + 1 < argc) {
+            spiFaultOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--imu-int-stop") && i + 1 < argc) {
+            sImuIntStopUs = (uint64_t) (atof(argv[++i]) * 1e6);
+        } else if (!strcmp(argv[i], "--rc-stop") && i + 1 < argc) {
+            sRcStopUs = (uint64_t) (atof(argv[++i]) * 1e6);
+        } else if (!strcmp(argv[i], "--flash") && i + 1 < argc) {
+            pFlashPath = argv[++i];
+        } else if (!strcmp(argv[i], "--rc-out") && i + 1 < argc) {
+            pRcOutPath = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    SIL_Reset();
+    SIL_SetTickHook(OnSimTick);
+    SIL_AttachUartIrq(USART3, USART3_IRQHandler);
+    SIL_AttachExtiIrq(EXTI15_10_IRQn, EXTI15_10_IRQHandler);
+    SIL_SetUartTxHook(USART2, OnUartLog);
+    SIL_SetI2CLatencyUs(i2cLatencyUs);
+    // the flash data page of the last run, a blank part without it
+    if (pFlashPath && !SIL_FlashLoad(pFlashPath)) {
+        printf("flash           : no image in %s, blank data page\n", pFlashPath);
+    }
+
+    SILImuConfigType imuConfig = {
+        0.05f,                       // gyro noise, dps
+        0.002f,                      // accel noise, g
+        { 0.8f, -0.5f, 0.3f },       // gyro bias, removed by CalibrateSensorBias
+        { DEFAULT_ACC_BIAS_X, DEFAULT_ACC_BIAS_Y, DEFAULT_ACC_BIAS_Z },
+        imuVibrationHz,
+        imuVibrationHz > 0.0f ? IMU_VIBRATION_DPS : 0.0f,
+        imuVibrationHz > 0.0f ? IMU_VIBRATION_G : 0.0f,
+    };
+    SILImu_Init(&imuConfig, seed);
+    SILImu_SetIntHook(OnImuInt);
+
+    SILPlantConfigType plantConfig = {
+        0.02f,                       // motor lag, s
+        { 60.0f, 60.0f, 20.0f },     // dps/s per mixer unit
+        { 0.5f, 0.5f, 1.0f },        // aerodynamic damping, 1/s
+        200.0f,                      // lift-off thrust, half of hover
+    };
+    SILPlant_Init(&plantConfig);
+
+    SILRc_Init();
+    if (pRcPath) {
+        if (!SILRc_LoadScript(pRcPath)) return 1;
+    } else {
+        static SILRcKeyframeType script[512];
+        int num = BuildDefaultScript(script, 512, durationS * 1000);
+        SILRc_SetScript(script, num);
+    }
+    SILRc_SetProtocol(rcProtocol, crsfRateHz);
+    SILRc_SetCorruption(rcCorruptOneInN, seed);
+
+    if (pTracePath) {
+        spTrace = fopen(pTracePath, "w");
+        if (!spTrace) {
+            fprintf(stderr, "cannot open %s\n", pTracePath);
+            return 1;
+        }
+        fprintf(spTrace, "time_ms,sp_roll,sp_pitch,roll,pitch,yaw,est_roll,est_pitch,m0,m1,m2,m3\n");
+    }
+    if (pLogOutPath) {
+        spLogOut = fopen(pLogOutPath, "wb");
+        if (!spLogOut) {
+            fprintf(stderr, "cannot open %s\n", pLogOutPath);
+            return 1;
+        }
+    }
+    if (pRcOutPath) {
+        spRcOut = fopen(pRcOutPath, "wb");
+        if (!spRcOut) {
+            fprintf(stderr, "cannot open %s\n", pRcOutPath);
+            return 1;
+        }
+        SILRc_SetCapture(spRcOut);
+    }
+    if (pBlackboxPath) {
+        spBlackbox = fopen(pBlackboxPath, "wb");
+        if (!spBlackbox) {
+            fprintf(stderr, "cannot open %s\n", pBlackboxPath);
+            return 1;
+        }
+        Blackbox::GetInstance().SetBackend(&sBlackboxFile);
+    }
+    if (pImuBusLogPath) {
+        spImuBusLog = fopen(pImuBusLogPath, "w");
+        if (!spImuBusLog) {
+            fprintf(stderr, "cannot open %s\n", pImuBusLogPath);
+            return 1;
+        }
+    }
+    // every IMU bus transaction goes through the recorder
+    ImuBus_SetBackend(SILImuBus_Wrap(pImuBus, spImuBusLog));
+
+    HAL_Init();
+    MX_I2C1_Init();
+    MX_SPI2_Init();
+    MX_TIM1_Init();
+    MX_USART3_UART_Init();
+    MX_USART2_UART_Init();
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    HAL_Delay(1000);
+    if (!MainApp_Init()) {
+        fprintf(stderr, "MainApp_Init failed at %.3f s\n", SIL_GetTimeUs() * 1e-6);
+        return 1;
+    }
+    uint64_t readyUs = SIL_GetTimeUs();
+    // faults only from here, boot and calibration use blocking transfers
+    SIL_SetI2CFaults(i2cFaultOneInN);
+    SIL_SetSpiFaults(spiFaultOneInN);
+
+    uint64_t endUs = (uint64_t) durationS * 1000000;
+    uint64_t passes = 0;
+    uint64_t busyUs = 0;
+    while (SIL_GetTimeUs() < endUs) {
+        uint64_t before = SIL_GetTimeUs();
+        MainApp_Loop();
+        ++passes;
+        uint64_t spent = SIL_GetTimeUs() - before;
+        busyUs += spent;
+        if (spent == 0) {
+            // nothing pending, sleep until the next SysTick or bus completion
+            SIL_WaitForInterrupt();
+        }
+    }
+
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double simS = SIL_GetTimeUs() * 1e-6;
+    if (spTrace) fclose(spTrace);
+    if (spLogOut) fclose(spLogOut);
+    if (spBlackbox) fclose(spBlackbox);
+    if (spRcOut) fclose(spRcOut);
+    if (spImuBusLog) fclose(spImuBusLog);
+    if (pFlashPath && !SIL_FlashSave(pFlashPath)) {
+        fprintf(stderr, "cannot write %s\n", pFlashPath);
+    }
+
+    SILBusStatsType bus;
+    SIL_GetBusStats(&bus);
+    double loopS = (SIL_GetTimeUs() - readyUs) * 1e-6;
+    double trackRms = sStats.samples ? sqrt(sStats.trackErrSq / (2.0 * sStats.samples)) : 0.0;
+    double estRms = sStats.samples ? sqrt(sStats.estErrSq / (2.0 * sStats.samples)) : 0.0;
+
+    printf("sim time        : %.3f s (ready after %.3f s)\n", simS, readyUs * 1e-6);
+    printf("wall time       : %.3f s (%.0fx real time)\n", wallS, wallS > 0.0 ? simS / wallS : 0.0);
+    printf("loop passes     : %llu, busy %.1f%% of loop time\n", (unsigned long long) passes, loopS > 0.0 ? 100.0 * busyUs * 1e-6 / loopS : 0.0);
+    printf("i2c             : %u transfers, %u errors, %.1f%% bus load\n", bus.i2cTransfers, bus.i2cErrors, 100.0 * bus.i2cBusyUs * 1e-6 / simS);
+    printf("led             : %u changes\n", sLedChanges);
+    if (bus.spiTransfers > 0) {
+        printf("spi             : %u transfers, %u errors, %.1f%% bus load\n", bus.spiTransfers, bus.spiErrors, 100.0 * bus.spiBusyUs * 1e-6 / simS);
+    }
+    SILImuBusSummaryType imuBus;
+    SILImuBus_GetSummary(&imuBus);
+    printf("imu bus         : %s, %u transactions (%u queued), %u bytes, %u failed (%u not queued), queued latency mean %.0f us max %u us\n",
+           ImuBus_GetBackend()->name, imuBus.transactions, imuBus.asyncTransactions, imuBus.bytes, imuBus.failed, imuBus.notQueued,
+           imuBus.asyncTransactions > imuBus.notQueued ? (double) imuBus.asyncLatencyUs / (imuBus.asyncTransactions - imuBus.notQueued) : 0.0,
+           imuBus.maxAsyncLatencyUs);
+    ImuBusStatsType queue;
+    ImuBus_GetStats(&queue);
+    printf("imu bus queue   : %u transfers, max %u us, %u errors, %u timeouts, %u queue full, max queued %u/%u",
+           queue.transfers, queue.maxTransferUs, queue.errors, queue.timeouts, queue.queueFull, queue.maxQueued, queue.queueLen);
+#if UAV_IMU_PIPELINE
+    printf(", %u imu samples skipped, data-ready lost %u times", SensorReader::GetInstance().GetSkippedReads(),
+           MainApp_GetImuPolledCount());
+#endif
+    printf("\n");
+#if UAV_IMU_FIFO
+    SensorFifoStatsType fifo;
+    SensorReader::GetInstance().GetFifoStats(&fifo);
+    printf("imu fifo        : %u drains, %.1f samples per drain (%u..%u), %u short, %u overflows\n", fifo.reads,
+           fifo.reads ? (double) fifo.samples / fifo.reads : 0.0, fifo.reads ? fifo.minSamples : 0, fifo.maxSamples,
+           fifo.shortReads, fifo.overflows);
+#endif
+#if UAV_IMU_DMP
+    if (IMU::GetInstance().IsDmpActive()) {
+        printf("estimator       : %s, firmware loaded in %.1f ms, %u corrupt packets\n", StateEstimator::GetInstance().GetBackendName(),
+               IMU::GetInstance().GetDmpLoadUs() * 1e-3, fifo.corrupt);
+    } else {
+        printf("estimator       : %s, dmp failed to start\n", StateEstimator::GetInstance().GetBackendName());
+    }
+#endif
+    printf("boot            : %-15s %8s %8s %10s %10s %10s  (ready after %.1f ms)\n", "step", "attempts", "timeouts", "start ms",
+           "done ms", "took ms", BootSeq_GetReadyUs() * 1e-3);
+    for (int i = 0; i < BootSeq_GetNumOfSteps(); ++i) {
+        BootStepStatsType step;
+        BootSeq_GetStats(i, &step);
+        printf("                  %-15s %8u %8u %10.1f %10.1f %10.1f\n", BootSeq_GetStepName(i), step.attempts, step.timeouts,
+               step.startUs * 1e-3, step.doneUs * 1e-3, step.lastAttemptUs * 1e-3);
+    }
+    printf("calibration     : %s\n", IMU::GetInstance().IsCalibrationLoaded() ? "loaded from flash" : "measured at boot");
+    // one magnetometer read after the run, against what the plant puts there
+    float truthGyro[3], truthAcc[3], truthMag[3];
+    SILPlant_GetImuTruth(truthGyro, truthAcc, truthMag);
+    FCSensorDataType magData;
+    IMU::GetInstance().EnableMag(true);
+    if (IMU::GetInstance().GetRawCompassData(&magData)) {
+        printf("mag             : %s, %.1f %.1f %.1f uT, truth %.1f %.1f %.1f uT\n", UAV_IMU_MAG_AUX ? "aux i2c master" : "bypass",
+               magData.x, magData.y, magData.z, truthMag[0], truthMag[1], truthMag[2]);
+    } else {
+        printf("mag             : %s, read failed\n", UAV_IMU_MAG_AUX ? "aux i2c master" : "bypass");
+    }
+    printf("rc              : %s sent, %u frames (%u corrupted, %u at the wrong speed), %u bytes dropped, %s found\n",
+           rcProtocol == SIL_RC_CRSF ? "CRSF" : "SBUS", SILRc_GetFrameCnt(), SILRc_GetCorruptedCnt(),
+           SILRc_GetMismatchedCnt(), bus.uartRxDropped, Receiver::GetProtocolName(Receiver::GetInstance().GetProtocol()));
+    if (Receiver::GetInstance().GetProtocol() == RECEIVER_PROTOCOL_CRSF) {
+        CRSFStatsType crsf;
+        CRSF_GetStats(&crsf);
+        printf("crsf            : %u rc frames decoded at %.1f Hz, %u link stats, %u crc errors, %u bad lengths, %u partial, %u bytes skipped\n",
+               crsf.decoder.rcFrames, CRSFDecoder_GetRcFrameRateHz(&crsf.decoder), crsf.decoder.linkStatsFrames,
+               crsf.decoder.crcErrors, crsf.decoder.badLengths, crsf.decoder.partialFrames, crsf.decoder.skippedBytes);
+    } else {
+        SBUSStatsType sbus;
+        SBUS_GetStats(&sbus);
+        printf("sbus            : %u decoded at %.1f Hz, %u resyncs, %u partial, %u bytes skipped\n",
+               sbus.decoder.frames, SBUSDecoder_GetFrameRateHz(&sbus.decoder), sbus.decoder.resyncs,
+               sbus.decoder.partialFrames, sbus.decoder.skippedBytes);
+    }
+    CmdLatencyStatsType cmdLatency;
+    CmdListener::GetInstance().GetLatencyStats(cmdLatency);
+    printf("stick to motor  : %u frames, latency %u..%u us, mean %u us after %u us on the wire (smoothing %d)\n",
+           cmdLatency.samples, cmdLatency.samples ? cmdLatency.minUs : 0, cmdLatency.maxUs,
+           cmdLatency.samples ? (uint32_t) (cmdLatency.totalUs / cmdLatency.samples) : 0, SILRc_GetFrameWireUs(),
+           UAV_RC_SMOOTHING);
+    UartTxStatsType log;
+    UART_GetTxStats(&log);
+    printf("log             : %u msgs %u bytes queued, %u msgs %u bytes dropped, max %u/%u bytes buffered, %u tx errors\n",
+           log.queuedMsgs, log.queuedBytes, log.droppedMsgs, log.droppedBytes, log.maxUsedBytes, UART_TX_BUF_SIZE, log.txErrors);
+#if UAV_BLACKBOX
+    BlackboxStatsType blackbox;
+    Blackbox::GetInstance().GetStats(blackbox);
+    printf("blackbox        : %u frames recorded, %u dropped, %u written (%.1f bytes/frame), %u backend busy (%s)\n",
+           blackbox.recorded, blackbox.dropped, blackbox.written,
+           blackbox.written ? (double) blackbox.writtenBytes / blackbox.written : 0.0, blackbox.backendBusy,
+           spBlackbox ? "file" : "uart");
+#endif
+    printf("scheduler       : %-15s %8s %8s %8s %8s %13s %9s %11s\n", "task", "runs", "overrun", "deadline", "budget", "latency us", "exec us", "response us");
+    for (int i = 0; i < Scheduler_GetNumOfTasks(); ++i) {
+        SchedulerTaskStatsType task;
+        Scheduler_GetStats(i, &task);
+        printf("                  %-15s %8u %8u %8u %8u %6u..%-6u %4u/%-4u %5u/%-5u\n", Scheduler_GetTaskName(i), task.runs, task.overruns,
+               task.deadlineMisses, task.budgetOverruns, task.runs ? task.minLatencyUs : 0, task.maxLatencyUs,
+               task.runs ? (uint32_t) (task.totalExecUs / task.runs) : 0, task.maxExecUs,
+               task.runs ? (uint32_t) (task.totalResponseUs / task.runs) : 0, task.maxResponseUs);
+    }
+    printf("profiler        : %-21s %8s %10s %10s %10s  (host cycles)\n", "point", "count", "min", "mean", "max");
+    for (int i = 0; i < Profiler_GetNumOfPoints(); ++i) {
+        ProfilerStatsType point;
+        Profiler_GetStats(i, &point);
+        printf("                  %-21s %8u %10u %10u %10u\n", Profiler_GetName(i), point.count, point.count ? point.minCycles : 0,
+               point.count ? (uint32_t) (point.totalCycles / point.count) : 0, point.maxCycles);
+    }
+    printf("attitude        : tracking rms %.2f deg, estimate rms %.2f deg, max %.1f deg\n", trackRms, estRms, sStats.maxAngle);
+    if (sRcStopUs < endUs) {
+        // the motors ran on the tick before the last one at the latest
+        bool idle = !MainApp_IsArmed() && sMotorsRunUs + SIL_TICK_US < SIL_GetTimeUs();
+        printf("rc stop         : frames stopped at %.3f s, %s, motors idle %.0f ms after, %u failsafe disarms\n",
+               sRcStopUs * 1e-6, MainApp_IsArmed() ? "armed" : "disarmed",
+               sMotorsRunUs > sRcStopUs ? (sMotorsRunUs - sRcStopUs) * 1e-3 : 0.0, MainApp_GetFailsafeDisarmCount());
+        if (!idle) {
+            printf("motors still running without the receiver\n");
+            return 3;
+        }
+    }
+
+    if (sStats.maxAngle > DIVERGED_ANGLE_DEG) {
+        printf("attitude diverged\n");
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <math.h>
+#include <string.h>
+
+#include "sil_plant.h"
+
+/*
+ * Defines
+ */
+
+#define DEG_TO_RAD (0.017453293f)
+
+// earth field in the filter's z-up frame, uT
+#define EARTH_MAG_NORTH (20.0f)
+#define EARTH_MAG_EAST (0.0f)
+#define EARTH_MAG_UP (-45.0f)
+
+/*
+ * Static
+ */
+
+static SILPlantConfigType sConfig;
+static SILPlantStateType sState;
+
+/*
+ * Code
+ */
+
+// earth (z up) to filter body frame, ZYX euler angles in radians
+static void EarthToBody(float phi, float theta, float psi, const float e[3], float b[3])
+{
+    float c0 = cosf(psi) * e[0] + sinf(psi) * e[1];
+    float c1 = -sinf(psi) * e[0] + cosf(psi) * e[1];
+    float c2 = e[2];
+    float d0 = cosf(theta) * c0 - sinf(theta) * c2;
+    float d1 = c1;
+    float d2 = sinf(theta) * c0 + cosf(theta) * c2;
+    b[0] = d0;
+    b[1] = cosf(phi) * d1 + sinf(phi) * d2;
+    b[2] = -sinf(phi) * d1 + cosf(phi) * d2;
+}
+
+void SILPlant_Init(const SILPlantConfigType* pConfig)
+{
+    sConfig = *pConfig;
+    memset(&sState, 0, sizeof(sState));
+}
+
+void SILPlant_Step(float dt, const float motorCmd[SIL_NUM_OF_MOTORS])
+{
+    float alpha = sConfig.motorTau > 0.0f ? dt / (sConfig.motorTau + dt) : 1.0f;
+    for (int i = 0; i < SIL_NUM_OF_MOTORS; ++i) {
+        sState.motor[i] += alpha * (motorCmd[i] - sState.motor[i]);
+    }
+
+    const float* m = sState.motor;
+    float meanThrust = (m[0] + m[1] + m[2] + m[3]) * 0.25f;
+    if (meanThrust < sConfig.liftOffThrust) {
+        // on the ground, held level
+        for (int i = SIL_AXIS_ROLL; i <= SIL_AXIS_PITCH; ++i) {
+            sState.att[i] = 0.0f;
+        }
+        for (int i = 0; i < 3; ++i) {
+            sState.attRate[i] = 0.0f;
+        }
+        return;
+    }
+
+    // invert MotorCtrl::OutputMotor's X mixer
+    float torque[3];
+    torque[SIL_AXIS_ROLL] = (m[0] - m[1] + m[2] - m[3]) * 0.25f;
+    torque[SIL_AXIS_PITCH] = (-m[0] - m[1] + m[2] + m[3]) * 0.25f;
+    torque[SIL_AXIS_YAW] = (m[0] - m[1] - m[2] + m[3]) * 0.25f;
+
+    for (int i = 0; i < 3; ++i) {
+        float acc = sConfig.torqueGain[i] * torque[i] - sConfig.damping[i] * sState.attRate[i];
+        sState.attRate[i] += acc * dt;
+        sState.att[i] += sState.attRate[i] * dt;
+    }
+    if (sState.att[SIL_AXIS_YAW] > 180.0f) sState.att[SIL_AXIS_YAW] -= 360.0f;
+    if (sState.att[SIL_AXIS_YAW] < -180.0f) sState.att[SIL_AXIS_YAW] += 360.0f;
+}
+
+void SILPlant_GetState(SILPlantStateType* pState)
+{
+    *pState = sState;
+}
+
+void SILPlant_GetImuTruth(float gyroDps[3], float accG[3], float magUT[3])
+{
+    // StateEstimator feeds the filter (-gx, -gy, -gz, ax, ay, -az) and
+    // reports roll = -filterRoll, so the filter frame angles are
+    // phi = -roll, theta = pitch, psi = yaw.
+    float phi = -sState.att[SIL_AXIS_ROLL] * DEG_TO_RAD;
+    float theta = sState.att[SIL_AXIS_PITCH] * DEG_TO_RAD;
+    float psi = sState.att[SIL_AXIS_YAW] * DEG_TO_RAD;
+
+    gyroDps[0] = sState.attRate[SIL_AXIS_ROLL];
+    gyroDps[1] = -sState.attRate[SIL_AXIS_PITCH];
+    gyroDps[2] = -sState.attRate[SIL_AXIS_YAW];
+
+    static const float up[3] = { 0.0f, 0.0f, 1.0f };
+    float b[3];
+    EarthToBody(phi, theta, psi, up, b);
+    accG[0] = b[0];
+    accG[1] = b[1];
+    accG[2] = -b[2];
+
+    static const float field[3] = { EARTH_MAG_NORTH, EARTH_MAG_EAST, EARTH_MAG_UP };
+    EarthToBody(phi, theta, psi, field, b);
+    // IMU::GetCompassData swaps x/y and negates z to reach the accel axes
+    magUT[0] = b[1];
+    magUT[1] = b[0];
+    magUT[2] = b[2];
+}
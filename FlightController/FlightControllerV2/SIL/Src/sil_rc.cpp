@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crsf_decoder.h"
+#include "sil_hal.h"
+#include "sil_rc.h"
+
+/*
+ * Defines
+ */
+
+#define SBUS_HEADER (0x0F)
+#define SBUS_ENDBYTE (0x00)
+#define SBUS_MSG_LENGTH (25)
+#define SBUS_FLAGS_BYTE (23)
+#define SBUS_CHANNEL_BITS (11)
+#define SBUS_BAUDRATE (100000)
+#define SBUS_BITS_PER_BYTE (12) // start, 8 data, parity, 2 stop
+#define CRSF_BITS_PER_BYTE (10) // start, 8 data, stop
+
+#define LINK_STATS_PERIOD_US (100000)
+#define MAX_BURST_LEN (CRSF_MAX_FRAME_LEN + 1) // room for a stray byte
+#define MAX_NOISE_LEN (128)
+
+#define MAX_KEYFRAMES (1024)
+
+/*
+ * Struct
+ */
+
+// a frame on its way through the wire
+typedef struct {
+    uint8_t data[MAX_BURST_LEN];
+    int len;
+    uint64_t arriveUs;
+    bool pending;
+} SILRcBurstType;
+
+/*
+ * Static
+ */
+
+static SILRcKeyframeType sScript[MAX_KEYFRAMES];
+static int sNumOfKeyframes = 0;
+static int sCurKeyframe = 0;
+
+static uint16_t sChannels[SIL_RC_NUM_OF_CHANNELS];
+static SILRcProtocolType sProtocol = SIL_RC_SBUS;
+static uint32_t sFramePeriodUs = SIL_RC_FRAME_PERIOD_US;
+static uint64_t sNextFrameUs = 0;
+static uint64_t sNextLinkStatsUs = 0;
+static uint32_t sFrameCnt = 0;
+static uint32_t sMismatchedCnt = 0;
+static SILRcBurstType sRcBurst;
+static SILRcBurstType sLinkStatsBurst;
+
+static uint32_t sCorruptOneInN = 0;
+static uint32_t sRandState = 1;
+static uint32_t sCorruptedCnt = 0;
+static FILE* spCapture = NULL;
+
+/*
+ * Code
+ */
+
+static void PackSbusFrame(uint8_t* pMsg)
+{
+    memset(pMsg, 0, SBUS_MSG_LENGTH);
+    pMsg[0] = SBUS_HEADER;
+    // 16 channels of 11 bits, LSB first
+    int bit = 0;
+    for (int ch = 0; ch < SIL_RC_NUM_OF_CHANNELS; ++ch) {
+        for (int i = 0; i < SBUS_CHANNEL_BITS; ++i, ++bit) {
+            if (sChannels[ch] & (1 << i)) {
+                pMsg[1 + bit / 8] |= (uint8_t) (1 << (bit % 8));
+            }
+        }
+    }
+    pMsg[SBUS_FLAGS_BYTE] = 0;
+    pMsg[SBUS_MSG_LENGTH - 1] = SBUS_ENDBYTE;
+}
+
+static uint32_t Rand()
+{
+    // xorshift32, reproducible for a given seed
+    sRandState ^= sRandState << 13;
+    sRandState ^= sRandState >> 17;
+    sRandState ^= sRandState << 5;
+    return sRandState;
+}
+
+static int PackCrsfFrame(uint8_t* pMsg)
+{
+    uint8_t payload[CRSF_RC_CHANNELS_PAYLOAD_LEN];
+    CRSF_PackChannels(sChannels, payload);
+    return CRSF_BuildFrame(CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, sizeof(payload), pMsg);
+}
+
+static int PackCrsfLinkStats(uint8_t* pMsg)
+{
+    // a strong link: -40 dBm, 100% LQ, 10 dB SNR, 250 Hz mode, 100 mW
+    const uint8_t payload[CRSF_LINK_STATISTICS_PAYLOAD_LEN] = { 40, 40, 100, 10, 0, 5, 3, 45, 100, 8 };
+    return CRSF_BuildFrame(CRSF_FRAMETYPE_LINK_STATISTICS, payload, sizeof(payload), pMsg);
+}
+
+static uint32_t GetBaudRate()
+{
+    return sProtocol == SIL_RC_CRSF ? CRSF_BAUDRATE : SBUS_BAUDRATE;
+}
+
+static uint32_t WireUs(int len)
+{
+    uint32_t bitsPerByte = sProtocol == SIL_RC_CRSF ? CRSF_BITS_PER_BYTE : SBUS_BITS_PER_BYTE;
+    uint32_t baud = GetBaudRate();
+    return (uint32_t) (((uint64_t) len * bitsPerByte * 1000000 + baud - 1) / baud);
+}
+
+// damages the frame the way a noisy line does, returns the new length
+static int Corrupt(uint8_t* pMsg, int len)
+{
+    int pos = (int) (Rand() % len);
+    switch (Rand() % 3) {
+    case 0:
+        pMsg[pos] ^= (uint8_t) (1 << (Rand() % 8));
+        return len;
+    case 1:
+        memmove(&pMsg[pos], &pMsg[pos + 1], len - pos - 1);
+        return len - 1;
+    default:
+        memmove(&pMsg[pos + 1], &pMsg[pos], len - pos);
+        pMsg[pos] = (uint8_t) Rand();
+        return len + 1;
+    }
+}
+
+// puts a frame on the wire, it arrives once its last byte is through
+static void Send(SILRcBurstType* pBurst, uint64_t nowUs, bool corruptible)
+{
+    if (corruptible && sCorruptOneInN && Rand() % sCorruptOneInN == 0) {
+        pBurst->len = Corrupt(pBurst->data, pBurst->len);
+        ++sCorruptedCnt;
+    }
+    if (spCapture) fwrite(pBurst->data, 1, pBurst->len, spCapture);
+    pBurst->arriveUs = nowUs + WireUs(pBurst->len);
+    pBurst->pending = true;
+}
+
+static void Deliver(SILRcBurstType* pBurst, uint64_t nowUs)
+{
+    if (!pBurst->pending || nowUs < pBurst->arriveUs) return;
+    pBurst->pending = false;
+
+    uint32_t lineBaud = SIL_UartGetBaudRate(USART3);
+    uint32_t baud = GetBaudRate();
+    if (lineBaud && lineBaud != baud) {
+        // a UART at another speed samples garbage, about one character per
+        // character time of its own
+        uint8_t noise[MAX_NOISE_LEN];
+        int len = (int) ((uint64_t) pBurst->len * lineBaud / baud);
+        if (len < 1) len = 1;
+        if (len > MAX_NOISE_LEN) len = MAX_NOISE_LEN;
+        for (int i = 0; i < len; ++i) {
+            noise[i] = (uint8_t) Rand();
+        }
+        SIL_UartInject(USART3, noise, (uint16_t) len);
+        ++sMismatchedCnt;
+    } else {
+        SIL_UartInject(USART3, pBurst->data, (uint16_t) pBurst->len);
+    }
+    SIL_UartLineIdle(USART3);
+}
+
+void SILRc_Init()
+{
+    memset(sChannels, 0, sizeof(sChannels));
+    sNumOfKeyframes = 0;
+    sCurKeyframe = 0;
+    sProtocol = SIL_RC_SBUS;
+    sFramePeriodUs = SIL_RC_FRAME_PERIOD_US;
+    sNextFrameUs = 0;
+    sNextLinkStatsUs = 0;
+    sFrameCnt = 0;
+    sMismatchedCnt = 0;
+    memset(&sRcBurst, 0, sizeof(sRcBurst));
+    memset(&sLinkStatsBurst, 0, sizeof(sLinkStatsBurst));
+    sCorruptOneInN = 0;
+    sCorruptedCnt = 0;
+    spCapture = NULL;
+}
+
+void SILRc_SetProtocol(SILRcProtocolType protocol, uint32_t rateHz)
+{
+    sProtocol = protocol;
+    if (protocol == SIL_RC_CRSF) {
+        sFramePeriodUs = 1000000 / (rateHz ? rateHz : SIL_RC_CRSF_RATE_HZ);
+        // between two RC frames
+        sNextLinkStatsUs = sNextFrameUs + sFramePeriodUs / 2;
+    } else {
+        sFramePeriodUs = SIL_RC_FRAME_PERIOD_US;
+    }
+}
+
+SILRcProtocolType SILRc_GetProtocol()
+{
+    return sProtocol;
+}
+
+void SILRc_SetCorruption(uint32_t oneInN, uint32_t seed)
+{
+    sCorruptOneInN = oneInN;
+    sRandState = seed ? seed : 1;
+}
+
+uint32_t SILRc_GetCorruptedCnt()
+{
+    return sCorruptedCnt;
+}
+
+void SILRc_SetCapture(FILE* pFile)
+{
+    spCapture = pFile;
+}
+
+void SILRc_SetScript(const SILRcKeyframeType* pKeyframes, int num)
+{
+    if (num > MAX_KEYFRAMES) num = MAX_KEYFRAMES;
+    memcpy(sScript, pKeyframes, num * sizeof(SILRcKeyframeType));
+    sNumOfKeyframes = num;
+    sCurKeyframe = 0;
+}
+
+bool SILRc_LoadScript(const char* path)
+{
+    FILE* pFile = fopen(path, "r");
+    if (!pFile) {
+        fprintf(stderr, "SILRc: cannot open %s\n", path);
+        return false;
+    }
+    char line[256];
+    int num = 0;
+    while (fgets(line, sizeof(line), pFile) && num < MAX_KEYFRAMES) {
+        unsigned int t, ch[SIL_RC_SCRIPT_CHANNELS];
+        if (sscanf(line, "%u,%u,%u,%u,%u,%u", &t, &ch[0], &ch[1], &ch[2], &ch[3], &ch[4]) != 6) {
+            continue; // header or comment
+        }
+        sScript[num].timeMs = t;
+        for (int i = 0; i < SIL_RC_SCRIPT_CHANNELS; ++i) {
+            sScript[num].channels[i] = (uint16_t) ch[i];
+        }
+        ++num;
+    }
+    fclose(pFile);
+    if (num == 0) {
+        fprintf(stderr, "SILRc: no keyframes in %s\n", path);
+        return false;
+    }
+    sNumOfKeyframes = num;
+    sCurKeyframe = 0;
+    return true;
+}
+
+void SILRc_Tick(uint64_t nowUs)
+{
+    uint32_t nowMs = (uint32_t) (nowUs / 1000);
+    while (sCurKeyframe < sNumOfKeyframes && sScript[sCurKeyframe].timeMs <= nowMs) {
+        memcpy(sChannels, sScript[sCurKeyframe].channels, sizeof(sScript[sCurKeyframe].channels));
+        ++sCurKeyframe;
+    }
+
+    Deliver(&sRcBurst, nowUs);
+    Deliver(&sLinkStatsBurst, nowUs);
+
+    if (sProtocol == SIL_RC_CRSF && nowUs >= sNextLinkStatsUs && !sLinkStatsBurst.pending) {
+        sNextLinkStatsUs += LINK_STATS_PERIOD_US;
+        sLinkStatsBurst.len = PackCrsfLinkStats(sLinkStatsBurst.data);
+        Send(&sLinkStatsBurst, nowUs, false);
+    }
+
+    if (nowUs < sNextFrameUs || sRcBurst.pending) return;
+    sNextFrameUs += sFramePeriodUs;
+
+    if (sProtocol == SIL_RC_CRSF) {
+        sRcBurst.len = PackCrsfFrame(sRcBurst.data);
+    } else {
+        PackSbusFrame(sRcBurst.data);
+        sRcBurst.len = SBUS_MSG_LENGTH;
+    }
+    Send(&sRcBurst, nowUs, true);
+    ++sFrameCnt;
+}
+
+void SILRc_GetChannels(uint16_t channels[SIL_RC_NUM_OF_CHANNELS])
+{
+    memcpy(channels, sChannels, sizeof(sChannels));
+}
+
+uint32_t SILRc_GetFrameCnt()
+{
+    return sFrameCnt;
+}
+
+uint32_t SILRc_GetFrameWireUs()
+{
+    return WireUs(sProtocol == SIL_RC_CRSF ? CRSF_RC_CHANNELS_PAYLOAD_LEN + 4 : SBUS_MSG_LENGTH);
+}
+
+uint32_t SILRc_GetMismatchedCnt()
+{
+    return sMismatchedCnt;
+}
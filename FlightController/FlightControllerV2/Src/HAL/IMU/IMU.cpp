@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -5,7 +6,13 @@
 
 #include "IMU.h"
 
+#include "calib_store.h"
+#include "clock.h"
 #include "logging.h"
+#if UAV_IMU_DMP
+#include "inv_mpu.h"
+#include "inv_mpu_dmp_motion_driver.h"
+#endif
 
 /*
 * Defines
@@ -22,6 +29,15 @@
 
 #define LOW_PASS_FILTER_ACC_GAMMA 0.8
 
+// A_DLPFCFG: 99 Hz / 2.9 ms when the notch and the decimator take the motor
+// noise, 21 Hz / 8.5 ms otherwise
+#if UAV_IMU_FILTER_BANK
+#define ACC_DLPF_MODE                (2)
+#define FILTER_COUNTS_SCALE          (1.0f / (1 << FILTER_BANK_Q_SAMPLE_SHIFT))
+#else
+#define ACC_DLPF_MODE                (4)
+#endif
+
 /*
 * Constants
 */
@@ -30,7 +46,44 @@
 #define MPU9250_ID                   0x73
 #if USE_INTERRUPT
 #define MPU9250_Interrupt_Pin        GPIO_PIN_12
-#define MPU9250_Interrupt_GPIO_Port  GPIOF
+#define MPU9250_Interrupt_GPIO_Port  GPIOB
+// 1khz internal rate with the DLPF enabled; with the FIFO the MPU9250
+// samples faster and the FIFO is drained at UAV_IMU_SAMPLE_RATE_HZ
+#if UAV_IMU_FIFO
+#define MPU9250_SAMPLE_RATE_DIV      (1000 / UAV_IMU_FIFO_RATE_HZ - 1)
+#else
+#define MPU9250_SAMPLE_RATE_DIV      (1000 / UAV_IMU_SAMPLE_RATE_HZ - 1)
+#endif
+#endif
+
+// CalibrateSensorBias() averages CALIB_SAMPLES samples at rest, without the
+// data-ready interrupt one every CALIB_SAMPLE_PERIOD_MS
+#define CALIB_SAMPLES                (100)
+#define CALIB_SAMPLE_PERIOD_MS       (10)
+
+// LoadCalibration() checks the record against a few samples: the mean gyro
+// has to be within CALIB_CHECK_GYRO_DPS of the stored bias, so the quad is at
+// rest and the bias has not moved, |accel| within CALIB_CHECK_ACC_G of 1 g
+// and the die within CALIB_CHECK_TEMP_DEGC of the calibration temperature
+#define CALIB_CHECK_SAMPLES          (8)
+#define CALIB_CHECK_PERIOD_MS        (2)
+#define CALIB_CHECK_GYRO_DPS         (1.0f)
+#define CALIB_CHECK_ACC_G            (0.05f)
+#define CALIB_CHECK_TEMP_DEGC        (15.0f)
+#define TEMP_LSB_PER_DEGC            (333.87f)
+#define TEMP_ROOM_DEGC               (21.0f)
+
+#if UAV_IMU_DMP
+// gyro and accel axes as the chip has them, inv_orientation_matrix_to_scalar()
+// of the identity; StateEstimator maps the quaternion to the body
+#define DMP_ORIENTATION_IDENTITY     (0x88)
+// the DMP image keeps to the FIFO rate only with tap detection on, whose
+// gesture word then ends every packet; raw gyro, because CalibrateSensorBias()
+// already removes the bias the DMP's own calibration would
+#define DMP_FEATURES                 (DMP_FEATURE_6X_LP_QUAT | DMP_FEATURE_SEND_RAW_ACCEL | DMP_FEATURE_SEND_RAW_GYRO | \
+                                      DMP_FEATURE_GYRO_CAL | DMP_FEATURE_TAP)
+#define DMP_QUAT_ONE                 (1073741824.0f) // Q30
+#define DMP_ACCEL_BIAS_LSB_PER_G     (2048.0f)       // offset registers count at +-16g
 #endif
 
 /*
@@ -56,12 +109,23 @@ IMU::IMU()
     mMagCalibrateFlag = false;
     mReadyToStart = false;
     mMagEnabled = false;
+    mCalibLoaded = false;
+    mCalibCount = 0;
+    mCalibLastMs = 0;
+#if UAV_IMU_DMP
+    mDmpActive = false;
+    mDmpLoadUs = 0;
+    for (int i = 0; i < 3; ++i) {
+        mDmpAccBias[i] = 0.0f;
+    }
+#endif
 
     // LPS
     mFirstTime = false;
 
 #if USE_INTERRUPT
     mDataReadyCb = NULL;
+    mDataReadyCycles = 0;
 #endif
 
     for (int i = 0; i < 3; ++i) {
@@ -97,6 +161,7 @@ void IMU::OnGyroAccDataReady()
 {
 
     // LOG("%s\r\n", __func__);
+    mDataReadyCycles = Clock_GetCycles();
     SetGyroAccDataReadyFlg();
 
     if (mDataReadyCb != NULL) {
@@ -104,6 +169,13 @@ void IMU::OnGyroAccDataReady()
     }
 
 }
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == MPU9250_Interrupt_Pin) {
+        IMU::GetInstance().OnGyroAccDataReady();
+    }
+}
 #endif
 
 /*------------------------------------------------*
@@ -115,12 +187,20 @@ bool IMU::Init()
     // sanity check whoami register
     uint8_t deviceID = mIMU.getDeviceID();
     if (deviceID == MPU9250_ID) {
-        mIMU.Init(); //initialzie
+        mIMU.Init(UAV_IMU_MAG_AUX != 0, ACC_DLPF_MODE); //initialzie
         mReadyToStart = true;
     } else {
         LOGE("mIMU ID wrong, ID = %x\r\n", deviceID);
         return false;
     }
+#if UAV_IMU_FILTER_BANK
+    if (!FilterBankQ_Init(&mGyroFilter, UAV_IMU_FIFO_RATE_HZ) || !FilterBankQ_Init(&mAccFilter, UAV_IMU_FIFO_RATE_HZ) ||
+        FilterBankQ_AddStage(&mGyroFilter, FILTER_NOTCH, UAV_IMU_NOTCH_HZ, UAV_IMU_NOTCH_Q) < 0 ||
+        FilterBankQ_AddStage(&mAccFilter, FILTER_NOTCH, UAV_IMU_NOTCH_HZ, UAV_IMU_NOTCH_Q) < 0) {
+        LOGE("filter bank init failed\r\n");
+        return false;
+    }
+#endif
 
     return true;
 }
@@ -130,6 +210,25 @@ bool IMU::Start()
     LOG("%s\r\n", __func__);
     if (mReadyToStart) {
 #if USE_INTERRUPT
+        bool dmp = false;
+#if UAV_IMU_DMP
+        dmp = StartDmp();
+        if (!dmp) {
+            // the chip may be half way through the DMP setup
+            LOGE("DMP failed to start, fusing on the MCU\r\n");
+            mIMU.reset();
+            mIMU.Init(UAV_IMU_MAG_AUX != 0, ACC_DLPF_MODE);
+        }
+        mDmpActive = dmp;
+#endif
+        // the DMP keeps the sample rate its firmware was loaded for
+        if (!dmp) mIMU.setRate(MPU9250_SAMPLE_RATE_DIV);
+#if UAV_IMU_FIFO
+        if (!mIMU.enableFifo(true, dmp)) {
+            LOGE("failed to enable the IMU FIFO\r\n");
+            return false;
+        }
+#endif
         mIMU.enableInterrupt();
 #endif
     } else {
@@ -140,6 +239,80 @@ bool IMU::Start()
     return true;
 }
 
+#if UAV_IMU_DMP
+/* Load the DMP firmware through the InvenSense driver (inv_mpu.c) and start
+ * its 6-axis low power quaternion output into the FIFO at
+ * UAV_IMU_DMP_RATE_HZ. The driver resets the chip and sets it up its own
+ * way: gyro at 2000 dps and accel at 2 g as Init() has them, the sample rate
+ * at the DMP's 200 Hz. MPU9250::adoptDmpConfig() takes over from there.
+ */
+bool IMU::StartDmp()
+{
+    uint64_t startUs = Clock_GetUs();
+    // the driver's own compass setup only works through the bypass, the
+    // magnetometer stays with the MPU9250 driver
+    if (mpu_init(NULL) || mpu_set_sensors(INV_XYZ_GYRO | INV_XYZ_ACCEL)) {
+        LOGE("mpu_init failed\r\n");
+        return false;
+    }
+    // written in 16 byte chunks, each read back and compared
+    int result = dmp_load_motion_driver_firmware();
+    if (result) {
+        LOGE("DMP firmware load failed, %d\r\n", result);
+        return false;
+    }
+    mDmpLoadUs = (uint32_t) (Clock_GetUs() - startUs);
+    LOGI("DMP firmware loaded in %u us\r\n", (unsigned) mDmpLoadUs);
+
+    if (dmp_set_orientation(DMP_ORIENTATION_IDENTITY) || dmp_enable_feature(DMP_FEATURES)
+        || dmp_set_fifo_rate(UAV_IMU_DMP_RATE_HZ) || mpu_set_dmp_state(1)) {
+        LOGE("DMP setup failed\r\n");
+        return false;
+    }
+    if (!mIMU.adoptDmpConfig()) return false;
+
+    // the DMP fuses the chip's accel output, so the bias ConvertAccelData()
+    // takes off moves into the chip's offset registers
+    long accelBias[3];
+    for (int i = 0; i < 3; ++i) {
+        accelBias[i] = lroundf(accBias[i] * DMP_ACCEL_BIAS_LSB_PER_G);
+    }
+    if (mpu_set_accel_bias_6500_reg(accelBias)) {
+        LOGE("accel offset write failed\r\n");
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        mDmpAccBias[i] = accBias[i];
+        accBias[i] = 0.0f;
+    }
+    return true;
+}
+
+bool IMU::IsDmpActive()
+{
+    return mDmpActive;
+}
+
+uint32_t IMU::GetDmpLoadUs()
+{
+    return mDmpLoadUs;
+}
+
+bool IMU::GetFifoDmpData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCQuaternionType* pQuat)
+{
+    int32_t quat[4];
+    int16_t ax, ay, az, gx, gy, gz;
+    if (!MPU9250::parseFifoDmp(pData, quat, &ax, &ay, &az, &gx, &gy, &gz)) return false;
+    ConvertGyroData(gx, gy, gz, pGyroData);
+    ConvertAccelData(ax, ay, az, pAccData);
+    pQuat->q1 = (float) quat[0] / DMP_QUAT_ONE;
+    pQuat->q2 = (float) quat[1] / DMP_QUAT_ONE;
+    pQuat->q3 = (float) quat[2] / DMP_QUAT_ONE;
+    pQuat->q4 = (float) quat[3] / DMP_QUAT_ONE;
+    return true;
+}
+#endif
+
 bool IMU::EnableMag(bool enable)
 {
     mMagEnabled = enable;
@@ -176,19 +349,26 @@ void IMU::GetGyroData(FCSensorDataType* pGyroData)
 {
     int16_t gx, gy, gz;
     mIMU.getRotation(&gx, &gy, &gz);
+    ConvertGyroData(gx, gy, gz, pGyroData);
+}
+
+void IMU::ConvertGyroData(float gx, float gy, float gz, FCSensorDataType* pGyroData)
+{
     float Gxyz[3];
-    Gxyz[0] = (float) gx * mIMU.mGyroSensitivity;
-    Gxyz[1] = (float) gy * mIMU.mGyroSensitivity;
-    Gxyz[2] = (float) gz * mIMU.mGyroSensitivity;
+    Gxyz[0] = gx * mIMU.mGyroSensitivity;
+    Gxyz[1] = gy * mIMU.mGyroSensitivity;
+    Gxyz[2] = gz * mIMU.mGyroSensitivity;
     Gxyz[0] = Gxyz[0] - gyroBias[0];
     Gxyz[1] = Gxyz[1] - gyroBias[1];
     Gxyz[2] = Gxyz[2] - gyroBias[2];
+#if !UAV_IMU_FILTER_BANK
     //High Pass Filter -> remove all values that are less than 0.05dps.
     for (int i = 0; i < 3; ++i){
         if (-1 < Gxyz[i] && Gxyz[i] < 1){
             Gxyz[i]=0.0f;
         }
     }
+#endif
 
     pGyroData->x = Gxyz[0];
     pGyroData->y = Gxyz[1];
@@ -208,9 +388,14 @@ void IMU::GetAccelData(FCSensorDataType* pAccData)
 {
     int16_t ax, ay, az;
     mIMU.getAcceleration(&ax,&ay,&az);
-    float accX = (float) ax * mIMU.mAccSensitivity * 0.001f;
-    float accY = (float) ay * mIMU.mAccSensitivity * 0.001f;
-    float accZ = (float) az * mIMU.mAccSensitivity * 0.001f;
+    ConvertAccelData(ax, ay, az, pAccData);
+}
+
+void IMU::ConvertAccelData(float ax, float ay, float az, FCSensorDataType* pAccData)
+{
+    float accX = ax * mIMU.mAccSensitivity * 0.001f;
+    float accY = ay * mIMU.mAccSensitivity * 0.001f;
+    float accZ = az * mIMU.mAccSensitivity * 0.001f;
 
     //Low Pass Filter
     /*
@@ -234,6 +419,90 @@ void IMU::GetAccelData(FCSensorDataType* pAccData)
     pAccData->z = accZ - accBias[2];
 }
 
+// accel and gyro from one burst, the MPU9250 holds its output registers while
+// the burst is on the bus, so all axes belong to the same sample
+void IMU::GetMotionData(FCSensorDataType* pGyroData, FCSensorDataType* pAccData)
+{
+    int16_t ax, ay, az, gx, gy, gz;
+    mIMU.getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+    ConvertGyroData(gx, gy, gz, pGyroData);
+    ConvertAccelData(ax, ay, az, pAccData);
+}
+
+bool IMU::StartMotionRead(uint8_t* pData, ImuBusDoneCb cb, void* pArg)
+{
+    return mIMU.readMotion6Async(pData, cb, pArg);
+}
+
+void IMU::GetMotionData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData)
+{
+    int16_t ax, ay, az, gx, gy, gz;
+    MPU9250::parseMotion6(pData, &ax, &ay, &az, &gx, &gy, &gz);
+    ConvertGyroData(gx, gy, gz, pGyroData);
+    ConvertAccelData(ax, ay, az, pAccData);
+}
+
+#if UAV_IMU_MAG_AUX
+bool IMU::GetMotion9Data(FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCSensorDataType* pMagData)
+{
+    uint8_t data[MPU9250_MOTION9_LEN];
+    if (!mIMU.readMotion9(data)) return false;
+    return GetMotion9Data(data, pGyroData, pAccData, pMagData);
+}
+
+bool IMU::StartMotion9Read(uint8_t* pData, ImuBusDoneCb cb, void* pArg)
+{
+    return mIMU.readMotion9Async(pData, cb, pArg);
+}
+
+bool IMU::GetMotion9Data(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData, FCSensorDataType* pMagData)
+{
+    int16_t ax, ay, az, gx, gy, gz, mx, my, mz;
+    bool magValid = MPU9250::parseMotion9(pData, &ax, &ay, &az, &gx, &gy, &gz, &mx, &my, &mz);
+    ConvertGyroData(gx, gy, gz, pGyroData);
+    ConvertAccelData(ax, ay, az, pAccData);
+    if (magValid) ConvertMagData(mx, my, mz, pMagData);
+    return magValid;
+}
+#endif
+
+#if UAV_IMU_FIFO
+bool IMU::StartFifoCountRead(uint8_t* pData, ImuBusDoneCb cb, void* pArg)
+{
+    return mIMU.readFifoCountAsync(pData, cb, pArg);
+}
+
+bool IMU::StartFifoRead(uint8_t* pData, uint16_t len, ImuBusDoneCb cb, void* pArg)
+{
+    return mIMU.readFifoAsync(pData, len, cb, pArg);
+}
+
+bool IMU::StartFifoReset(ImuBusDoneCb cb, void* pArg)
+{
+    return mIMU.resetFifoAsync(cb, pArg);
+}
+
+void IMU::GetFifoMotionData(const uint8_t* pData, FCSensorDataType* pGyroData, FCSensorDataType* pAccData)
+{
+    int16_t ax, ay, az, gx, gy, gz;
+    MPU9250::parseFifoMotion6(pData, &ax, &ay, &az, &gx, &gy, &gz);
+#if UAV_IMU_FILTER_BANK
+    // integer all the way to the conversion, the M3 has no FPU
+    int32_t gyro[3] = { gx * (1 << FILTER_BANK_Q_SAMPLE_SHIFT), gy * (1 << FILTER_BANK_Q_SAMPLE_SHIFT),
+                        gz * (1 << FILTER_BANK_Q_SAMPLE_SHIFT) };
+    int32_t acc[3] = { ax * (1 << FILTER_BANK_Q_SAMPLE_SHIFT), ay * (1 << FILTER_BANK_Q_SAMPLE_SHIFT),
+                       az * (1 << FILTER_BANK_Q_SAMPLE_SHIFT) };
+    FilterBankQ_Apply(&mGyroFilter, gyro, gyro);
+    FilterBankQ_Apply(&mAccFilter, acc, acc);
+    ConvertGyroData(gyro[0] * FILTER_COUNTS_SCALE, gyro[1] * FILTER_COUNTS_SCALE, gyro[2] * FILTER_COUNTS_SCALE, pGyroData);
+    ConvertAccelData(acc[0] * FILTER_COUNTS_SCALE, acc[1] * FILTER_COUNTS_SCALE, acc[2] * FILTER_COUNTS_SCALE, pAccData);
+#else
+    ConvertGyroData(gx, gy, gz, pGyroData);
+    ConvertAccelData(ax, ay, az, pAccData);
+#endif
+}
+#endif
+
 bool IMU::GetCompassData(FCSensorDataType* pMagData)
 {
     if (!mMagEnabled) {
@@ -241,23 +510,9 @@ bool IMU::GetCompassData(FCSensorDataType* pMagData)
         return false;
     }
 
-    uint8_t dataReady = mIMU.getCompassDataReady();
-    if (dataReady == 1){
-        int16_t mx, my, mz;
-        float Mxyz[3];
-        mIMU.getMagData(&mx,&my,&mz);
-        //14 bit output.
-        Mxyz[0] = (float) mx * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[0];
-        Mxyz[1] = (float) my * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[1];
-        Mxyz[2] = (float) mz * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[2];
-        Mxyz[0] = (Mxyz[0] - mMagOffset[0]) * mMagScale[0];
-        Mxyz[1] = (Mxyz[1] - mMagOffset[1]) * mMagScale[1];
-        Mxyz[2] = (Mxyz[2] - mMagOffset[2]) * mMagScale[2];
-
-        /*frame transformation -> coz mag is mounted on different axies with gyro and accel*/
-        pMagData->x = Mxyz[1];
-        pMagData->y = Mxyz[0];
-        pMagData->z = Mxyz[2]*(-1);
+    int16_t mx, my, mz;
+    if (mIMU.readMag(&mx, &my, &mz)) {
+        ConvertMagData(mx, my, mz, pMagData);
         return true;
     } else {
         LOGI("Mag data not ready, skip\r\n");
@@ -272,10 +527,8 @@ bool IMU::GetRawCompassData(FCSensorDataType* pMagData)
         return false;
     }
 
-    uint8_t dataReady = mIMU.getCompassDataReady();
-    if (dataReady == 1) {
-        int16_t mx, my, mz;
-        mIMU.getMagData(&mx,&my,&mz);
+    int16_t mx, my, mz;
+    if (mIMU.readMag(&mx, &my, &mz)) {
         pMagData->x = (float) mx * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[0];
         pMagData->y = (float) my * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[1];
         pMagData->z = (float) mz * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[2];
@@ -286,6 +539,23 @@ bool IMU::GetRawCompassData(FCSensorDataType* pMagData)
     }
 }
 
+void IMU::ConvertMagData(int16_t mx, int16_t my, int16_t mz, FCSensorDataType* pMagData)
+{
+    float Mxyz[3];
+    //14 bit output.
+    Mxyz[0] = (float) mx * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[0];
+    Mxyz[1] = (float) my * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[1];
+    Mxyz[2] = (float) mz * mIMU.mMagSensitivity * mIMU.mMagSensAdjData[2];
+    Mxyz[0] = (Mxyz[0] - mMagOffset[0]) * mMagScale[0];
+    Mxyz[1] = (Mxyz[1] - mMagOffset[1]) * mMagScale[1];
+    Mxyz[2] = (Mxyz[2] - mMagOffset[2]) * mMagScale[2];
+
+    /*frame transformation -> coz mag is mounted on different axies with gyro and accel*/
+    pMagData->x = Mxyz[1];
+    pMagData->y = Mxyz[0];
+    pMagData->z = Mxyz[2]*(-1);
+}
+
 void IMU::CalibrateMag()
 {
     if (!mMagEnabled) {
@@ -339,63 +609,157 @@ void IMU::CalibrateMag()
 
 void IMU::CalibrateSensorBias()
 {
-    int counter = 0;
+    BeginSensorBiasCalibration();
+    while (!PollSensorBiasCalibration()) {
+        HAL_Delay(1);
+    }
+}
 
+void IMU::BeginSensorBiasCalibration()
+{
+    mCalibCount = 0;
+    mCalibLastMs = HAL_GetTick();
+    mSensorBiasCalibrateFlag = false;
+    for (int i = 0; i < 3; i++) {
+        magConst[i] = 0.0f;
+        gravity[i] = 0.0f;
+        gyroBias[i] = 0.0f;
+    }
+#if USE_INTERRUPT
+    ClearInterrupt();
+#endif
+}
+
+bool IMU::PollSensorBiasCalibration()
+{
     FCSensorDataType gyroData;
     FCSensorDataType accData;
     FCSensorDataType magData;
 
+    if (mSensorBiasCalibrateFlag) return true;
 #if USE_INTERRUPT
-    ClearInterrupt();
+    if (!mGyroAccDataRdyFlag) return false;
+#else
+    if (HAL_GetTick() - mCalibLastMs < CALIB_SAMPLE_PERIOD_MS) return false;
+    mCalibLastMs = HAL_GetTick();
 #endif
-    while (counter < 100) {
-        if (mGyroAccDataRdyFlag) {
-            GetRawGyroData(&gyroData);
-            GetAccelData(&accData);
-            if (mMagEnabled) {
-                GetCompassData(&magData);
-            } else {
-                magData.x = 0.0f;
-                magData.y = 0.0f;
-                magData.z = 0.0f;
-            }
-            if (counter < 100) {
-                magConst[0] += magData.x;
-                magConst[1] += magData.y;
-                magConst[2] += magData.z;
-                gravity[0] += accData.x;
-                gravity[1] += accData.y;
-                gravity[2] += accData.z;
-                gyroBias[0] += gyroData.x;
-                gyroBias[1] += gyroData.y;
-                gyroBias[2] += gyroData.z;
-
-                ++counter;
-            }
-            if (counter == 100) {
-                for (int i = 0; i < 3; i++) {
-                    magConst[i] = magConst[i] / 100;
-                    gravity[i] = gravity[i] / 100;
-                    gyroBias[i] = gyroBias[i] / 100;
-                }
-                mSensorBiasCalibrateFlag = true;
-            }
+    GetRawGyroData(&gyroData);
+    GetAccelData(&accData);
+    if (mMagEnabled) {
+        GetCompassData(&magData);
+    } else {
+        magData.x = 0.0f;
+        magData.y = 0.0f;
+        magData.z = 0.0f;
+    }
+    magConst[0] += magData.x;
+    magConst[1] += magData.y;
+    magConst[2] += magData.z;
+    gravity[0] += accData.x;
+    gravity[1] += accData.y;
+    gravity[2] += accData.z;
+    gyroBias[0] += gyroData.x;
+    gyroBias[1] += gyroData.y;
+    gyroBias[2] += gyroData.z;
 #if USE_INTERRUPT
-            mGyroAccDataRdyFlag = false;
-            ClearInterrupt();
-#else
-            HAL_Delay(10); // read at 100Hz
+    mGyroAccDataRdyFlag = false;
+    ClearInterrupt();
 #endif
-        } else {
-            /*data not ready*/
-            // LOG("Data not Ready \r\n");
-        }
-        HAL_Delay(1);
+    if (++mCalibCount < CALIB_SAMPLES) return false;
+
+    for (int i = 0; i < 3; i++) {
+        magConst[i] = magConst[i] / CALIB_SAMPLES;
+        gravity[i] = gravity[i] / CALIB_SAMPLES;
+        gyroBias[i] = gyroBias[i] / CALIB_SAMPLES;
     }
+    mSensorBiasCalibrateFlag = true;
     LOGI("gyroBias: %.2f, %.2f, %.2f, gravity: %.2f, %.2f, %.2f, MagConst: %.2f, %.2f, %.2f\r\n",
          gyroBias[0], gyroBias[1], gyroBias[2],
          gravity[0], gravity[1], gravity[2],
          magConst[0], magConst[1], magConst[2]);
+    return true;
+}
+
+float IMU::GetTemperature()
+{
+    return (float) mIMU.getTemperature() / TEMP_LSB_PER_DEGC + TEMP_ROOM_DEGC;
+}
+
+bool IMU::LoadCalibration()
+{
+    CalibDataType calib;
+    if (!CalibStore_Load(&calib)) return false;
+
+    float gyroMean[3] = { 0.0f, 0.0f, 0.0f };
+    float accMean[3] = { 0.0f, 0.0f, 0.0f };
+    FCSensorDataType gyroData;
+    FCSensorDataType accData;
+    for (int n = 0; n < CALIB_CHECK_SAMPLES; ++n) {
+        GetRawGyroData(&gyroData);
+        GetAccelData(&accData);
+        gyroMean[0] += gyroData.x / CALIB_CHECK_SAMPLES;
+        gyroMean[1] += gyroData.y / CALIB_CHECK_SAMPLES;
+        gyroMean[2] += gyroData.z / CALIB_CHECK_SAMPLES;
+        // with the stored accel bias instead of the one in use
+        accMean[0] += (accData.x + accBias[0] - calib.accBias[0]) / CALIB_CHECK_SAMPLES;
+        accMean[1] += (accData.y + accBias[1] - calib.accBias[1]) / CALIB_CHECK_SAMPLES;
+        accMean[2] += (accData.z + accBias[2] - calib.accBias[2]) / CALIB_CHECK_SAMPLES;
+        HAL_Delay(CALIB_CHECK_PERIOD_MS);
+    }
+    float temp = GetTemperature();
+
+    float gyroErr = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        float err = fabsf(gyroMean[i] - calib.gyroBias[i]);
+        if (err > gyroErr) gyroErr = err;
+    }
+    float accNorm = sqrtf(accMean[0] * accMean[0] + accMean[1] * accMean[1] + accMean[2] * accMean[2]);
+    if (gyroErr > CALIB_CHECK_GYRO_DPS || fabsf(accNorm - 1.0f) > CALIB_CHECK_ACC_G
+        || fabsf(temp - calib.tempDegC) > CALIB_CHECK_TEMP_DEGC) {
+        LOGI("stored calibration rejected: gyro off by %.2f dps, |acc| %.3f g, %.1f degC (calibrated at %.1f)\r\n",
+             gyroErr, accNorm, temp, calib.tempDegC);
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        gyroBias[i] = calib.gyroBias[i];
+        gravity[i] = calib.gravity[i];
+        accBias[i] = calib.accBias[i];
+        mMagOffset[i] = calib.magOffset[i];
+        mMagScale[i] = calib.magScale[i];
+    }
+    mSensorBiasCalibrateFlag = true;
+    mCalibLoaded = true;
+    LOGI("stored calibration loaded, gyroBias: %.2f, %.2f, %.2f, %.1f degC\r\n",
+         gyroBias[0], gyroBias[1], gyroBias[2], temp);
+    return true;
+}
+
+bool IMU::IsCalibrationLoaded()
+{
+    return mCalibLoaded;
+}
+
+bool IMU::SaveCalibration()
+{
+    CalibDataType calib;
+    for (int i = 0; i < 3; ++i) {
+        calib.gyroBias[i] = gyroBias[i];
+        calib.gravity[i] = gravity[i];
+        calib.accBias[i] = accBias[i];
+#if UAV_IMU_DMP
+        // the chip's offset registers hold it while the DMP runs
+        if (mDmpActive) calib.accBias[i] = mDmpAccBias[i];
+#endif
+        calib.magOffset[i] = mMagOffset[i];
+        calib.magScale[i] = mMagScale[i];
+    }
+    calib.tempDegC = GetTemperature();
+    if (!CalibStore_Save(&calib)) {
+        LOGE("failed to store the calibration\r\n");
+        return false;
+    }
+    return true;
 }
 
 void IMU::CalibrateAccBias()
@@ -2,12 +2,13 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "crsf.h"
 #include "sbus.h"
 #include "logging.h"
 #include "util.h"
 #include "UAV_Defines.h"
 
-#include "Receiver.h"
+#include "receiver.h"
 
 /*
  * Defines
@@ -15,11 +16,30 @@
 
 #define LOG_TAG ("Receiver")
 
+// a bound receiver sends every 4..20 ms, so a protocol that decodes no
+// frame in the probe time is not the one on the line
+#define RECEIVER_PROBE_MS (500)
+#define RECEIVER_START_TIMEOUT_MS (5000) // a set protocol, the receiver may still be booting
+#define RECEIVER_POLL_MS (10)
+
+// the mapping below takes either protocol's channels as they are
+#if SBUS_CHANNEL_MIN != CRSF_CHANNEL_MIN || SBUS_CHANNEL_MAX != CRSF_CHANNEL_MAX
+#error "SBUS and CRSF channel ranges differ"
+#endif
+
+/*
+ * Static
+ */
+
+static const char* sProtocolNames[NUM_OF_RECEIVER_PROTOCOLS] = { "auto", "SBUS", "CRSF" };
+
 /*
  * Code
  */
 
 Receiver::Receiver()
+    : mProtocol((ReceiverProtocolType) UAV_RECEIVER_PROTOCOL), mActive(RECEIVER_PROTOCOL_AUTO),
+      mProbing(RECEIVER_PROTOCOL_AUTO), mProbeStartMs(0)
 {}
 
 Receiver& Receiver::GetInstance()
@@ -30,29 +50,162 @@ Receiver& Receiver::GetInstance()
 
 bool Receiver::Init()
 {
-    return SBUS_Init();
+    return SBUS_Init() && CRSF_Init();
+}
+
+bool Receiver::StartProtocol(ReceiverProtocolType protocol)
+{
+    switch (protocol) {
+    case RECEIVER_PROTOCOL_SBUS: return SBUS_Start();
+    case RECEIVER_PROTOCOL_CRSF: return CRSF_Start();
+    default: return false;
+    }
+}
+
+void Receiver::StopProtocol(ReceiverProtocolType protocol)
+{
+    switch (protocol) {
+    case RECEIVER_PROTOCOL_SBUS: SBUS_Stop(); break;
+    case RECEIVER_PROTOCOL_CRSF: CRSF_Stop(); break;
+    default: break;
+    }
+}
+
+bool Receiver::IsReceiving(ReceiverProtocolType protocol)
+{
+    switch (protocol) {
+    case RECEIVER_PROTOCOL_SBUS: return SBUS_IsReceiving();
+    case RECEIVER_PROTOCOL_CRSF: return CRSF_IsReceiving();
+    default: return false;
+    }
+}
+
+// starts the protocol to try after mProbing, false if there is none left
+bool Receiver::ProbeNext()
+{
+    bool probe = (mProtocol == RECEIVER_PROTOCOL_AUTO);
+    for (int i = mProbing + 1; i < NUM_OF_RECEIVER_PROTOCOLS; ++i) {
+        ReceiverProtocolType protocol = (ReceiverProtocolType) i;
+        if (!probe && protocol != mProtocol) continue;
+        if (!StartProtocol(protocol)) continue;
+        mProbing = protocol;
+        mProbeStartMs = HAL_GetTick();
+        return true;
+    }
+    mProbing = RECEIVER_PROTOCOL_AUTO;
+    LOGE("no %s receiver found\r\n", sProtocolNames[mProtocol]);
+    return false;
+}
+
+bool Receiver::BeginStart()
+{
+    Stop();
+    return ProbeNext();
+}
+
+ReceiverStartStatusType Receiver::PollStart()
+{
+    if (mActive != RECEIVER_PROTOCOL_AUTO) return RECEIVER_START_DONE;
+    if (mProbing == RECEIVER_PROTOCOL_AUTO) return RECEIVER_START_FAILED;
+    if (IsReceiving(mProbing)) {
+        mActive = mProbing;
+        mProbing = RECEIVER_PROTOCOL_AUTO;
+        LOGI("%s receiver found\r\n", sProtocolNames[mActive]);
+        return RECEIVER_START_DONE;
+    }
+    uint32_t timeoutMs = (mProtocol == RECEIVER_PROTOCOL_AUTO) ? RECEIVER_PROBE_MS : RECEIVER_START_TIMEOUT_MS;
+    if (HAL_GetTick() - mProbeStartMs < timeoutMs) return RECEIVER_START_PENDING;
+    StopProtocol(mProbing);
+    return ProbeNext() ? RECEIVER_START_PENDING : RECEIVER_START_FAILED;
 }
 
 bool Receiver::Start()
 {
-    return SBUS_Start();
+    if (!BeginStart()) return false;
+    ReceiverStartStatusType status;
+    while ((status = PollStart()) == RECEIVER_START_PENDING) {
+        HAL_Delay(RECEIVER_POLL_MS);
+    }
+    return status == RECEIVER_START_DONE;
+}
+
+void Receiver::Stop()
+{
+    StopProtocol(mProbing);
+    mProbing = RECEIVER_PROTOCOL_AUTO;
+    StopProtocol(mActive);
+    mActive = RECEIVER_PROTOCOL_AUTO;
+}
+
+bool Receiver::SetProtocol(ReceiverProtocolType protocol)
+{
+    if (protocol >= NUM_OF_RECEIVER_PROTOCOLS) {
+        LOGE("invalid protocol %d\r\n", protocol);
+        return false;
+    }
+    mProtocol = protocol;
+    return true;
+}
+
+ReceiverProtocolType Receiver::GetProtocol()
+{
+    return mActive;
+}
+
+const char* Receiver::GetProtocolName(ReceiverProtocolType protocol)
+{
+    return protocol < NUM_OF_RECEIVER_PROTOCOLS ? sProtocolNames[protocol] : "?";
+}
+
+bool Receiver::SetFrameCb(ReceiverFrameCb cb)
+{
+    // only the protocol that runs delivers frames
+    SBUS_SetFrameCb(cb);
+    CRSF_SetFrameCb(cb);
+    return true;
+}
+
+bool Receiver::Read(ReceiverDataType& data)
+{
+    if (mActive == RECEIVER_PROTOCOL_SBUS) {
+        SBUSDataType sbusData;
+        if (!SBUS_Read(&sbusData)) return false;
+        memcpy(data.channels, sbusData.channels, sizeof(data.channels));
+        data.failsafe = sbusData.failsafe;
+        data.lostFrame = sbusData.lostFrame;
+        data.frameSeq = sbusData.frameSeq;
+        data.frameTimeUs = sbusData.frameTimeUs;
+        return true;
+    }
+    if (mActive == RECEIVER_PROTOCOL_CRSF) {
+        CRSFDataType crsfData;
+        if (!CRSF_Read(&crsfData)) return false;
+        memcpy(data.channels, crsfData.channels, sizeof(data.channels));
+        data.failsafe = crsfData.failsafe;
+        // the CRC drops damaged frames, a lost one is simply not there
+        data.lostFrame = false;
+        data.frameSeq = crsfData.frameSeq;
+        data.frameTimeUs = crsfData.frameTimeUs;
+        return true;
+    }
+    return false;
 }
 
 ReceiverStatus Receiver::GetCmd(FCCmdType& cmd)
 {
-    SBUSDataType sbusData;
-    memset(&sbusData, 0, sizeof(SBUSDataType));
-    if (!SBUS_Read(&sbusData)) {
-        LOGE("Failed to read SBUS data\r\n");
+    ReceiverDataType rcData;
+    memset(&rcData, 0, sizeof(ReceiverDataType));
+    if (!Read(rcData)) {
+        LOGE("Failed to read %s data\r\n", sProtocolNames[mActive]);
         return RECEIVER_FAIL;
     }
 
 #if UAV_CMD_ATT_RATE
-    cmd.desiredAccZ = Util_Constrain((float)sbusData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
-    cmd.desiredAttRate.roll = Util_Constrain((float)sbusData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ROLL_RATE_MIN, CMD_ROLL_RATE_MAX);
-    cmd.desiredAttRate.pitch = Util_Constrain((float)sbusData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_PITCH_RATE_MIN, CMD_PITCH_RATE_MAX);
-    cmd.desiredAttRate.yaw = -Util_Constrain((float)sbusData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_YAW_RATE_MIN, CMD_YAW_RATE_MAX);
-    cmd.toTunePID = (sbusData.channels[4] == SBUS_CHANNEL_MAX);
+    cmd.desiredAccZ = Util_Constrain((float)rcData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
+    cmd.desiredAttRate.roll = Util_Constrain((float)rcData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ROLL_RATE_MIN, CMD_ROLL_RATE_MAX);
+    cmd.desiredAttRate.pitch = Util_Constrain((float)rcData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_PITCH_RATE_MIN, CMD_PITCH_RATE_MAX);
+    cmd.desiredAttRate.yaw = -Util_Constrain((float)rcData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_YAW_RATE_MIN, CMD_YAW_RATE_MAX);
+    cmd.toTunePID = (rcData.channels[4] == SBUS_CHANNEL_MAX);
 
     if (fabs(cmd.desiredAccZ) < 0.006) cmd.desiredAccZ = 0.0f;
     if (fabs(cmd.desiredAttRate.roll) < 5) cmd.desiredAttRate.roll = 0.0f;
@@ -60,11 +213,11 @@ ReceiverStatus Receiver::GetCmd(FCCmdType& cmd)
     if (fabs(cmd.desiredAttRate.yaw) < 5) cmd.desiredAttRate.yaw = 0.0f;
 
 #elif UAV_CMD_ACC
-    cmd.desiredAcc.z = Util_Constrain((float)sbusData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
-    cmd.desiredAcc.y = Util_Constrain((float)sbusData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
-    cmd.desiredAcc.x = Util_Constrain((float)sbusData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
-    cmd.desiredYawRate = -Util_Constrain((float)sbusData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, (float)CMD_YAW_RATE_MIN, (float)CMD_YAW_RATE_MAX);
-    cmd.toTunePID = (sbusData.channels[4] == SBUS_CHANNEL_MAX);
+    cmd.desiredAcc.z = Util_Constrain((float)rcData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
+    cmd.desiredAcc.y = Util_Constrain((float)rcData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
+    cmd.desiredAcc.x = Util_Constrain((float)rcData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
+    cmd.desiredYawRate = -Util_Constrain((float)rcData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, (float)CMD_YAW_RATE_MIN, (float)CMD_YAW_RATE_MAX);
+    cmd.toTunePID = (rcData.channels[4] == SBUS_CHANNEL_MAX);
 
     if (fabs(cmd.desiredVel.z) < 0.006) cmd.desiredVel.z = 0.0f;
     if (fabs(cmd.desiredVel.y) < 0.006) cmd.desiredVel.y = 0.0f;
@@ -72,20 +225,22 @@ ReceiverStatus Receiver::GetCmd(FCCmdType& cmd)
     if (fabs(cmd.desiredYawRate) < 5) cmd.desiredYawRate = 0.0f;
 
 #elif UAV_CMD_ATT
-    cmd.desiredAccZ = Util_Constrain((float)sbusData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
-    cmd.desiredRoll = Util_Constrain((float)sbusData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ROLL_MIN, CMD_ROLL_MAX);
-    cmd.desiredPitch = Util_Constrain((float)sbusData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_PITCH_MIN, CMD_PITCH_MAX);
-    cmd.desiredYawRate = -Util_Constrain((float)sbusData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, (float)CMD_YAW_RATE_MIN, (float)CMD_YAW_RATE_MAX);
-    cmd.toTunePID = (sbusData.channels[4] == SBUS_CHANNEL_MAX);
+    cmd.desiredAccZ = Util_Constrain((float)rcData.channels[0], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ACC_MIN, CMD_ACC_MAX);
+    cmd.desiredRoll = Util_Constrain((float)rcData.channels[1], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_ROLL_MIN, CMD_ROLL_MAX);
+    cmd.desiredPitch = Util_Constrain((float)rcData.channels[2], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, CMD_PITCH_MIN, CMD_PITCH_MAX);
+    cmd.desiredYawRate = -Util_Constrain((float)rcData.channels[3], (float)SBUS_CHANNEL_MIN, (float)SBUS_CHANNEL_MAX, (float)CMD_YAW_RATE_MIN, (float)CMD_YAW_RATE_MAX);
+    cmd.toTunePID = (rcData.channels[4] == SBUS_CHANNEL_MAX);
 
     if (fabs(cmd.desiredAccZ) < 0.006) cmd.desiredAccZ = 0.0f;
     if (fabs(cmd.desiredRoll) < 0.2) cmd.desiredRoll = 0.0f;
     if (fabs(cmd.desiredPitch) < 0.2) cmd.desiredPitch = 0.0f;
     if (fabs(cmd.desiredYawRate) < 5) cmd.desiredYawRate = 0.0f;
 #endif
+    cmd.frameSeq = rcData.frameSeq;
+    cmd.frameTimeUs = rcData.frameTimeUs;
 
-    if (sbusData.failsafe) return RECEIVER_FAILSAFE;
-    if (sbusData.lostFrame) return RECEIVER_LOST_FRAME;
+    if (rcData.failsafe) return RECEIVER_FAILSAFE;
+    if (rcData.lostFrame) return RECEIVER_LOST_FRAME;
 
     return RECEIVER_SUCCESS;
 }
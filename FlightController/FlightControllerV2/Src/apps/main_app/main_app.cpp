@@ -10,6 +10,18 @@
 #include "sensor_reader.h"
 #include "led.h"
 #include "device_ctrl.h"
+#include "imu_bus.h"
+#include "clock.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "uart.h"
+#include "IMU.h"
+#include "motor_ctrl.h"
+#include "blackbox.h"
+#include "crsf.h"
+#include "receiver.h"
+#include "sbus.h"
+#include "calib_store.h"
 
 #define LOG_TAG ("MainApp")
 
@@ -24,47 +36,80 @@
 #define LOG(...)
 #endif
 
-// test result, read data 13ms
-//              estimate state 13ms
-//              controller  38ms
-//              listen cmd  13ms
-//
-
-// TODO modulus
 /*
 * Constants
 */
 
-#define CORE_TIMER_FREQ 1000
-#define TIMER_CNT_MAX 5000
-
+#if UAV_IMU_PIPELINE
+#define IMU_SAMPLE_PERIOD_MS (1000 / UAV_IMU_SAMPLE_RATE_HZ)
+#define CONTROL_ATT_RATE_CNT IMU_SAMPLE_PERIOD_MS // runs on every sample
+#define IMU_WATCHDOG_CNT IMU_SAMPLE_PERIOD_MS
+#define IMU_DATA_READY_TIMEOUT_US (50000) // no edge for this long, the watchdog polls the IMU
+#else
 #define READ_SENSOR_CNT 10 // 1000/100hz
 #define ESTIMATE_STATE_CNT 20 // 1000/50hz
-#define CONTROL_ATT_CNT 50 // 1000/20hz
 #define CONTROL_ATT_RATE_CNT 10 // 1000/100hz
-#define LISTEN_CMD_CNT 250 // 1000/4hz
+#endif
+#define CONTROL_ATT_CNT 50 // 1000/20hz
+// ListenCmd runs on every receiver frame and on this period, which notices a
+// receiver that stopped sending
+#define LISTEN_CMD_CNT 20 // 1000/50hz
+// a failsafe must last this long before it disarms, SBUS has no CRC to tell a
+// flipped failsafe bit from the receiver's own
+#define RC_FAILSAFE_DISARM_US (100000)
+#define TUNE_PID_PERIOD_US (250000) // one PID tuning step per 250ms while the stick is held
+#define DEBUG_CMD_CNT 100 // 1000/10hz
+#define BLACKBOX_CNT 10 // 1000/100hz, drains what the control loop recorded
+
+// single byte queries on the debug UART, answered with UAV_DEBUG_CMD
+#define DEBUG_CMD_PRINT_STATS 'p'
+#define DEBUG_CMD_RESET_STATS 'r'
+#define DEBUG_CMD_RECALIBRATE 'c' // drop the stored IMU calibration, the next boot measures it again
+
+// task ids, a task may only depend on tasks listed before it
+enum {
+#if UAV_IMU_PIPELINE
+    TASK_IMU_PIPELINE,
+    TASK_LISTEN_CMD,
+    TASK_CONTROL_ATT,
+    TASK_IMU_WATCHDOG,
+#else
+    TASK_READ_SENSOR,
+    TASK_LISTEN_CMD,
+    TASK_ESTIMATE_STATE,
+    TASK_CONTROL_ATT,
+    TASK_CONTROL_ATT_RATE,
+#endif
+    TASK_DEBUG_CMD,
+#if UAV_BLACKBOX
+    TASK_BLACKBOX,
+#endif
+    NUM_OF_TASKS,
+};
 
 /*
 *Static
 */
 
-static int sTimerCnt = 0;
-static int sReadSensorCnt = READ_SENSOR_CNT;
-static int sEstimateStateCnt = ESTIMATE_STATE_CNT;
-static int sControllerAttCnt = CONTROL_ATT_CNT;
-static int sControllerAttRateCnt = CONTROL_ATT_RATE_CNT;
-static int sListenCmdCnt = LISTEN_CMD_CNT;
-static volatile bool sReadSensorFlag = false;
-static volatile bool sListenCmdFlag = false;
-static volatile bool sControllerAttFlag = false;
-static volatile bool sControllerAttRateFlag = false;
-static volatile bool sEstimateStateFlag = false;
-
-static FCSensorMeasType sMeas;
-
 static bool sStarted = false;
 static bool sArmed = false;
 static bool sTunePID = false;
+static uint32_t sCmdFrameSeq = 0;      // last frame ListenCmd handled
+static bool sFailsafe = false;
+static uint64_t sFailsafeUs = 0;       // when the failsafe began
+static uint32_t sFailsafeDisarmCnt = 0;
+static uint64_t sTunePIDUs = 0;        // frame time of the last tuning step
+static uint64_t sSetpointFrameUs = 0;  // frame the controller setpoints came from
+#if UAV_CONTROL_ATT
+static uint64_t sAttFrameUs = 0;       // frame behind the attitude loop's rate setpoint
+#endif
+#if UAV_IMU_PIPELINE
+static volatile uint32_t sDataReadyEdges = 0;
+static uint32_t sWatchdogEdges = 0;    // edges the watchdog saw last time
+static uint64_t sLastEdgeUs = 0;       // when it last saw them go on
+static bool sImuPolled = false;        // no edges, the watchdog starts the reads and arming is blocked
+static uint32_t sImuPolledCnt = 0;     // times the edges stopped
+#endif
 
 /*
 * Code
@@ -93,6 +138,17 @@ static bool ToArm(FCCmdType& cmd)
 #endif
 }
 
+// a data-ready fault found on the ground keeps the motors off, in the air
+// the polled reads keep the pipeline going
+static bool CanArm()
+{
+#if UAV_IMU_PIPELINE
+    return !sImuPolled;
+#else
+    return true;
+#endif
+}
+
 static bool ToDisArm(FCCmdType& cmd)
 {
 #if UAV_CMD_ATT_RATE
@@ -180,35 +236,7 @@ static bool ToCalibrateESC(FCCmdType& cmd)
 void MainApp_OnCoreTimerTick(void)
 {
     if (!sStarted) return;
-    ++sTimerCnt;
-    if (sTimerCnt >= sReadSensorCnt) {
-        sReadSensorCnt += READ_SENSOR_CNT;
-        sReadSensorFlag = true;
-    }
-    if (sTimerCnt >= sEstimateStateCnt) {
-        sEstimateStateCnt += ESTIMATE_STATE_CNT;
-        sEstimateStateFlag = true;
-    }
-    if (sTimerCnt >= sListenCmdCnt) {
-        sListenCmdCnt += LISTEN_CMD_CNT;
-        sListenCmdFlag = true;
-    }
-    if (sTimerCnt >= sControllerAttCnt) {
-        sControllerAttCnt += CONTROL_ATT_CNT;
-        sControllerAttFlag = true;
-    }
-    if (sTimerCnt >= sControllerAttRateCnt) {
-        sControllerAttRateCnt += CONTROL_ATT_RATE_CNT;
-        sControllerAttRateFlag = true;
-    }
-    if (sTimerCnt >= TIMER_CNT_MAX) {
-        sTimerCnt = 0;
-        sReadSensorCnt = READ_SENSOR_CNT;
-        sEstimateStateCnt = ESTIMATE_STATE_CNT;
-        sListenCmdCnt = LISTEN_CMD_CNT;
-        sControllerAttCnt = CONTROL_ATT_CNT;
-        sControllerAttRateCnt = CONTROL_ATT_RATE_CNT;
-    }
+    Scheduler_OnTick();
 }
 
 static bool TunePID(FCCmdType& cmd)
@@ -352,134 +380,447 @@ static bool TunePID(FCCmdType& cmd)
 #endif
 }
 
-void MainApp()
+static void TaskReadSensor()
 {
-    bool res = DeviceInit();
-    if (!res) {
-        LOGE("MainApp failed to init device, try again\r\n");
-        HAL_Delay(1000);
-        res = DeviceInit();
-    }
-
-    if (!res) {
-        LOGE("MainApp failed to init device, abort\r\n");
-        LED_SetOn(LED_ONBOARD, false);
-        return;
-    }
+    SensorReader& reader = SensorReader::GetInstance();
+    reader.ReadSensorMeas();
+    // the tasks below read the sample in place through Latest()
+    reader.mMeas.Update();
+    const FCSensorMeasType& meas = reader.mMeas.Latest().value;
+    LOGI("sensor meas: gyro: %f %f %f, acc: %f %f %f\r\n", meas.gyroData.x, meas.gyroData.y, meas.gyroData.z, meas.accData.x, meas.accData.y, meas.accData.z);
+}
 
-    // set controller period
-    Controller::GetInstance().SetAttPeriodMs(CONTROL_ATT_CNT);
-    Controller::GetInstance().SetAttRatePeriodMs(CONTROL_ATT_RATE_CNT);
-    // everything ready. Let's go.
-    LOGI("MainApp starts\r\n");
-    sStarted = true;
-    LED_Blink(LED_ONBOARD, 4);
-    while (1) {
-        if (sReadSensorFlag) {
-            sReadSensorFlag = false;
-            LOG("readsensor : sTimerCnt = %d\r\n", sTimerCnt);
-            SensorReader::GetInstance().GetSensorMeas(sMeas);
-            LOG("readsensor: sTimerCnt = %d\r\n", sTimerCnt);
-            LOGI("sensor meas: gyro: %f %f %f, acc: %f %f %f\r\n", sMeas.gyroData.x, sMeas.gyroData.y, sMeas.gyroData.z, sMeas.accData.x, sMeas.accData.y, sMeas.accData.z);
-        }
-        if (sListenCmdFlag) {
-            sListenCmdFlag = false;
-            LOG("listencmd: sTimerCnt = %d\r\n", sTimerCnt);
-            FCCmdType cmd;
-            ReceiverStatus status = CmdListener::GetInstance().GetCmd(cmd);
-            if (status != RECEIVER_FAIL) {
+// hands the stick setpoint at this moment to the controller, called by every
+// loop that uses it so it follows the smoothing between frames
+static void ApplySetpoint()
+{
+    FCCmdType cmd;
+    if (!CmdListener::GetInstance().GetSetpoint(cmd, Clock_GetUs())) return;
+    sSetpointFrameUs = cmd.frameTimeUs;
 #if UAV_CMD_ATT_RATE
-                LOGI("Cmd: pitchRate %f rollRate %f acc.z %f, yawRate %f\r\n", cmd.desiredAttRate.pitch, cmd.desiredAttRate.roll, cmd.desiredAccZ, cmd.desiredAttRate.yaw);
+    Controller::GetInstance().SetAttRateSetpoint(cmd.desiredAttRate);
+
+    FCAccDataType accSetpoint;
+    accSetpoint.x = 0; // not used.
+    accSetpoint.y = 0; // not used.
+    accSetpoint.z = cmd.desiredAccZ;
+    Controller::GetInstance().SetAccSetpoint(accSetpoint);
 #elif UAV_CMD_ACC
-                LOGI("Cmd: acc.x %f acc.y %f acc.z %f, yawRate %f\r\n", cmd.desiredAcc.x, cmd.desiredAcc.y, cmd.desiredAcc.z, cmd.desiredYawRate);
+    Controller::GetInstance().SetAccSetpoint(cmd.desiredAcc);
+    Controller::GetInstance().SetYawRateSetpoint(cmd.desiredYawRate);
 #elif UAV_CMD_ATT
-                LOGI("Cmd: pitch %f roll %f acc.z %f, yawRate %f\r\n", cmd.desiredPitch, cmd.desiredRoll, cmd.desiredAccZ, cmd.desiredYawRate);
+    FCAttType attSetpoint;
+    attSetpoint.roll = cmd.desiredRoll;
+    attSetpoint.pitch = cmd.desiredPitch;
+    attSetpoint.yaw = 0; // yaw angle control is not used.
+    Controller::GetInstance().SetAttSetpoint(attSetpoint);
+
+    FCAccDataType accSetpoint;
+    accSetpoint.x = 0; // not used.
+    accSetpoint.y = 0; // not used.
+    accSetpoint.z = cmd.desiredAccZ;
+    Controller::GetInstance().SetAccSetpoint(accSetpoint);
+    Controller::GetInstance().SetYawRateSetpoint(cmd.desiredYawRate);
 #endif
-                // Controller::GetInstance().SetAccSetpoint(cmd.desiredVel);
-                if (!sArmed && (ToArm(cmd) || ToCalibrateESC(cmd))) {
-                    sArmed = true;
-                    sTunePID = false;
-                    if (ToCalibrateESC(cmd)) {
-                        // disable thrust clamp during ESC calibration
-                        MotorCtrl::GetInstance().EnableThrustClamp(false);
-                    }
-                    MotorCtrl::GetInstance().StartMotor();
-                    LOGI("MainApp: Armed!!!");
-                    LED_SetOn(LED_ONBOARD, true);
-                }
-                else if (!sArmed && cmd.toTunePID) {
-                    sTunePID = true;
-                    TunePID(cmd);
-                    LOGI("MainApp: Tuning PID!!!");
-                    LED_SetOn(LED_ONBOARD, true);
-                }
-                else if (sArmed && ToDisArm(cmd)) {
-                    sArmed = false;
-                    MotorCtrl::GetInstance().StopMotor();
-                    LOGI("MainApp: DisArmed!!!");
-                    LED_SetOn(LED_ONBOARD, false);
-                } else if (sTunePID && !cmd.toTunePID) {
-                    LOGI("MainApp: Exit Tuning PID!!!");
-                    sTunePID = false;
-                    LED_SetOn(LED_ONBOARD, false);
-                }
-
-                else if (sArmed) {
-#if UAV_CMD_ATT_RATE
-                    Controller::GetInstance().SetAttRateSetpoint(cmd.desiredAttRate);
+}
+
+static void Disarm()
+{
+    sArmed = false;
+    MotorCtrl::GetInstance().StopMotor();
+    LED_SetState(LED_ONBOARD, LED_STATE_ARMED, false);
+}
+
+// the receiver reports failsafe or its frames stopped, its sticks no longer
+// count: the setpoint holds and the motors stop once it lasts
+static void HandleFailsafe()
+{
+    uint64_t nowUs = Clock_GetUs();
+    if (!sFailsafe) {
+        sFailsafe = true;
+        sFailsafeUs = nowUs;
+    }
+    if (!sArmed || nowUs - sFailsafeUs < RC_FAILSAFE_DISARM_US) return;
+    Disarm();
+    ++sFailsafeDisarmCnt;
+    LOGE("MainApp: receiver failsafe for %u ms, DisArmed!!!\r\n", (uint32_t) ((nowUs - sFailsafeUs) / 1000));
+}
 
-                    FCAccDataType accSetpoint;
-                    accSetpoint.x = 0; // not used.
-                    accSetpoint.y = 0; // not used.
-                    accSetpoint.z = cmd.desiredAccZ;
-                    Controller::GetInstance().SetAccSetpoint(accSetpoint);
+static void TaskListenCmd()
+{
+    FCCmdType cmd;
+    CmdListener& cmdListener = CmdListener::GetInstance();
+    ReceiverStatus status = cmdListener.GetCmd(cmd);
+    LED_SetState(LED_ONBOARD, LED_STATE_FAILSAFE, status == RECEIVER_FAILSAFE);
+    if (status == RECEIVER_FAILSAFE) {
+        HandleFailsafe();
+        return;
+    }
+    sFailsafe = false;
+    // a frame may already have been handled with an earlier trigger or period
+    if (status != RECEIVER_FAIL && cmd.frameSeq == sCmdFrameSeq) return;
+    if (status != RECEIVER_FAIL) {
+        sCmdFrameSeq = cmd.frameSeq;
+#if UAV_CMD_ATT_RATE
+        LOG("Cmd: pitchRate %f rollRate %f acc.z %f, yawRate %f\r\n", cmd.desiredAttRate.pitch, cmd.desiredAttRate.roll, cmd.desiredAccZ, cmd.desiredAttRate.yaw);
 #elif UAV_CMD_ACC
-                    Controller::GetInstance().SetAccSetpoint(cmd.desiredAcc);
-                    Controller::GetInstance().SetYawRateSetpoint(cmd.desiredYawRate);
+        LOG("Cmd: acc.x %f acc.y %f acc.z %f, yawRate %f\r\n", cmd.desiredAcc.x, cmd.desiredAcc.y, cmd.desiredAcc.z, cmd.desiredYawRate);
 #elif UAV_CMD_ATT
-                    FCAttType attSetpoint;
-                    attSetpoint.roll = cmd.desiredRoll;
-                    attSetpoint.pitch = cmd.desiredPitch;
-                    attSetpoint.yaw = 0; // yaw angle control is not used.
-                    Controller::GetInstance().SetAttSetpoint(attSetpoint);
-
-                    FCAccDataType accSetpoint;
-                    accSetpoint.x = 0; // not used.
-                    accSetpoint.y = 0; // not used.
-                    accSetpoint.z = cmd.desiredAccZ;
-                    Controller::GetInstance().SetAccSetpoint(accSetpoint);
-                    Controller::GetInstance().SetYawRateSetpoint(cmd.desiredYawRate);
+        LOG("Cmd: pitch %f roll %f acc.z %f, yawRate %f\r\n", cmd.desiredPitch, cmd.desiredRoll, cmd.desiredAccZ, cmd.desiredYawRate);
 #endif
-                }
-            } else {
-                LOGE("sCmdListener.GetCmd returns fail, skip\r\n");
+        // Controller::GetInstance().SetAccSetpoint(cmd.desiredVel);
+        if (!sArmed && (ToArm(cmd) || ToCalibrateESC(cmd)) && CanArm()) {
+            sArmed = true;
+            sTunePID = false;
+            if (ToCalibrateESC(cmd)) {
+                // disable thrust clamp during ESC calibration
+                MotorCtrl::GetInstance().EnableThrustClamp(false);
             }
-            LOG("listencmd: sTimerCnt = %d\r\n", sTimerCnt);
+            MotorCtrl::GetInstance().StartMotor();
+            cmdListener.ResetSetpoint();
+            LOGI("MainApp: Armed!!!");
+            LED_SetState(LED_ONBOARD, LED_STATE_ARMED, true);
         }
-        if (sEstimateStateFlag) {
-            sEstimateStateFlag = false;
-            LOG("estimateState: sTimerCnt = %d\r\n", sTimerCnt);
-            StateEstimator::GetInstance().EstimateState(sMeas);
-            LOG("Estimated State: roll %f, pitch %f, yaw %f, rollRate %f, pitchRate %f, yawRate %f\r\n", StateEstimator::GetInstance().mState.att.roll, StateEstimator::GetInstance().mState.att.pitch,
-                 StateEstimator::GetInstance().mState.att.yaw, StateEstimator::GetInstance().mState.attRate.roll, StateEstimator::GetInstance().mState.attRate.pitch, StateEstimator::GetInstance().mState.attRate.yaw);
-            Controller::GetInstance().SetCurAtt(StateEstimator::GetInstance().mState.att);
-            Controller::GetInstance().SetCurAttRate(StateEstimator::GetInstance().mState.attRate);
-            LOG("estimateState: sTimerCnt = %d\r\n", sTimerCnt);
+        else if (!sArmed && cmd.toTunePID) {
+            sTunePID = true;
+            // frames come much faster than a stick is let go
+            if (cmd.frameTimeUs - sTunePIDUs >= TUNE_PID_PERIOD_US) {
+                sTunePIDUs = cmd.frameTimeUs;
+                TunePID(cmd);
+                LOGI("MainApp: Tuning PID!!!");
+            }
+            LED_SetState(LED_ONBOARD, LED_STATE_TUNING, true);
+        }
+        else if (sArmed && ToDisArm(cmd)) {
+            Disarm();
+            LOGI("MainApp: DisArmed!!!");
+        } else if (sTunePID && !cmd.toTunePID) {
+            LOGI("MainApp: Exit Tuning PID!!!");
+            sTunePID = false;
+            LED_SetState(LED_ONBOARD, LED_STATE_TUNING, false);
         }
-        if (sControllerAttFlag) {
+
+        else if (sArmed) {
+            cmdListener.SetSetpointTarget(cmd);
+            ApplySetpoint();
+        }
+    } else {
+        LOGE("sCmdListener.GetCmd returns fail, skip\r\n");
+    }
+}
+
+static void TaskEstimateState()
+{
+    StateEstimator::GetInstance().EstimateState(SensorReader::GetInstance().mMeas.Latest().value);
+    LOG("Estimated State: roll %f, pitch %f, yaw %f, rollRate %f, pitchRate %f, yawRate %f\r\n", StateEstimator::GetInstance().mState.att.roll, StateEstimator::GetInstance().mState.att.pitch,
+         StateEstimator::GetInstance().mState.att.yaw, StateEstimator::GetInstance().mState.attRate.roll, StateEstimator::GetInstance().mState.attRate.pitch, StateEstimator::GetInstance().mState.attRate.yaw);
+    Controller::GetInstance().SetCurAtt(StateEstimator::GetInstance().mState.att);
+    Controller::GetInstance().SetCurAttRate(StateEstimator::GetInstance().mState.attRate);
+}
+
+static void TaskControlAtt()
+{
 #if UAV_CONTROL_ATT
-            LOG("controller: sTimerCnt = %d\r\n", sTimerCnt);
-            sControllerAttFlag = false;
-            if (sArmed) Controller::GetInstance().RunAttCtrl();
-            LOG("controller: sTimerCnt = %d\r\n", sTimerCnt);
+    if (!sArmed) return;
+    ApplySetpoint();
+    Controller::GetInstance().RunAttCtrl();
+    sAttFrameUs = sSetpointFrameUs;
 #endif
+}
+
+#if UAV_BLACKBOX
+static void RecordBlackbox()
+{
+    BlackboxFrameType frame;
+    Controller& controller = Controller::GetInstance();
+    FCMotorPWMType motorPWM;
+
+    frame.timeUs = (uint32_t) Clock_GetUs();
+    const FCSensorMeasType& meas = SensorReader::GetInstance().mMeas.Latest().value;
+    frame.meas.gyroData = meas.gyroData;
+    frame.meas.accData = meas.accData;
+    frame.state = StateEstimator::GetInstance().mState;
+    controller.GetAttSetpoint(frame.attSetpoint);
+    controller.GetAttRateSetpoint(frame.attRateSetpoint);
+    controller.GetAttRatePIDTerms(frame.attRatePID[0], frame.attRatePID[1], frame.attRatePID[2]);
+    MotorCtrl::GetInstance().GetMotorPWM(motorPWM);
+    frame.motorPWM[0] = (uint16_t) motorPWM.motor1PWM;
+    frame.motorPWM[1] = (uint16_t) motorPWM.motor2PWM;
+    frame.motorPWM[2] = (uint16_t) motorPWM.motor3PWM;
+    frame.motorPWM[3] = (uint16_t) motorPWM.motor4PWM;
+    frame.flags = sArmed ? BLACKBOX_FLAG_ARMED : 0;
+    Blackbox::GetInstance().Record(frame);
+}
+
+static void TaskBlackbox()
+{
+    Blackbox::GetInstance().Flush();
+}
+#endif
+
+static void TaskControlAttRate()
+{
+    if (sArmed) {
+        ApplySetpoint();
+        Controller::GetInstance().RunAttRateCtrl();
+        // the pitch and roll sticks reach the motors through the attitude loop
+#if UAV_CONTROL_ATT
+        CmdListener::GetInstance().RecordLatency(sAttFrameUs, Clock_GetUs());
+#else
+        CmdListener::GetInstance().RecordLatency(sSetpointFrameUs, Clock_GetUs());
+#endif
+    }
+#if UAV_BLACKBOX
+    RecordBlackbox();
+#endif
+}
+
+static void PrintLogStats()
+{
+    UartTxStatsType stats;
+    UART_GetTxStats(&stats);
+    LOGI("log: queued %u msgs %u bytes, dropped %u msgs %u bytes, max buffered %u/%u, tx errors %u\r\n", stats.queuedMsgs,
+         stats.queuedBytes, stats.droppedMsgs, stats.droppedBytes, stats.maxUsedBytes, UART_TX_BUF_SIZE, stats.txErrors);
+#if UAV_BLACKBOX
+    BlackboxStatsType blackbox;
+    Blackbox::GetInstance().GetStats(blackbox);
+    LOGI("blackbox: recorded %u dropped %u written %u (%u bytes) backend busy %u\r\n", blackbox.recorded,
+         blackbox.dropped, blackbox.written, blackbox.writtenBytes, blackbox.backendBusy);
+#endif
+}
+
+static void PrintRcStats()
+{
+    LOGI("rc failsafe: %s, disarmed %u times\r\n", sFailsafe ? "on" : "off", sFailsafeDisarmCnt);
+    if (Receiver::GetInstance().GetProtocol() == RECEIVER_PROTOCOL_CRSF) {
+        CRSFStatsType stats;
+        CRSF_GetStats(&stats);
+        const CRSFDecoderStatsType& dec = stats.decoder;
+        // not CRSF_Read(), which would take the next RC frame from the control path
+        CRSFLinkStatsType link;
+        CRSF_GetLinkStats(&link);
+        LOGI("crsf: rc frames %u at %.1f Hz, period %u..%u us, link stats %u, crc errors %u, bad lengths %u, partial %u, skipped %u bytes, uart errors %u\r\n",
+             dec.rcFrames, CRSFDecoder_GetRcFrameRateHz(&dec), dec.rcFrames > 1 ? dec.minPeriodUs : 0, dec.maxPeriodUs,
+             dec.linkStatsFrames, dec.crcErrors, dec.badLengths, dec.partialFrames, dec.skippedBytes, stats.uartErrors);
+        LOGI("crsf link: rssi -%u/-%u dBm, lq %u%%, snr %d dB, rf mode %u, tx power %u\r\n", link.uplinkRssi1,
+             link.uplinkRssi2, link.uplinkLinkQuality, link.uplinkSnr, link.rfMode, link.uplinkTxPower);
+        return;
+    }
+    SBUSStatsType stats;
+    SBUS_GetStats(&stats);
+    const SBUSDecoderStatsType& dec = stats.decoder;
+    LOGI("sbus: frames %u at %.1f Hz, period %u..%u us, resyncs %u, partial %u, skipped %u bytes, lost %u, failsafe %u, uart errors %u\r\n",
+         dec.frames, SBUSDecoder_GetFrameRateHz(&dec), dec.frames > 1 ? dec.minPeriodUs : 0, dec.maxPeriodUs, dec.resyncs,
+         dec.partialFrames, dec.skippedBytes, dec.lostFrames, dec.failsafeFrames, stats.uartErrors);
+}
+
+static void PrintImuBusStats()
+{
+    ImuBusStatsType stats;
+    ImuBus_GetStats(&stats);
+    LOGI("imu bus %s: %u transfers, max %u us, errors %u, timeouts %u, queue full %u, max queued %u/%u\r\n",
+         ImuBus_GetBackend()->name, stats.transfers, stats.maxTransferUs, stats.errors, stats.timeouts, stats.queueFull,
+         stats.maxQueued, stats.queueLen);
+#if UAV_IMU_PIPELINE
+    LOGI("imu: %u samples skipped, data-ready lost %u times%s\r\n", SensorReader::GetInstance().GetSkippedReads(),
+         sImuPolledCnt, sImuPolled ? ", polling" : "");
+#endif
+#if UAV_IMU_FIFO
+    SensorFifoStatsType fifo;
+    SensorReader::GetInstance().GetFifoStats(&fifo);
+    LOGI("imu fifo: %u drains, %u samples, %u..%u per drain, %u short, %u overflows\r\n", fifo.reads, fifo.samples,
+         fifo.reads ? fifo.minSamples : 0, fifo.maxSamples, fifo.shortReads, fifo.overflows);
+#endif
+}
+
+static void PrintCmdStats()
+{
+    CmdLatencyStatsType latency;
+    CmdListener::GetInstance().GetLatencyStats(latency);
+    LOGI("stick to motor: %u frames, latency %u..%u us, mean %u us\r\n", latency.samples,
+         latency.samples ? latency.minUs : 0, latency.maxUs,
+         latency.samples ? (uint32_t) (latency.totalUs / latency.samples) : 0);
+}
+
+static void TaskDebugCmd()
+{
+    char cmd;
+    if (!UART_ReadByte(&cmd)) return;
+    LogBeginReply();
+    if (cmd == DEBUG_CMD_PRINT_STATS) {
+        Scheduler_PrintStats();
+        Profiler_Print();
+        PrintLogStats();
+        PrintRcStats();
+        PrintImuBusStats();
+        PrintCmdStats();
+    } else if (cmd == DEBUG_CMD_RESET_STATS) {
+        Scheduler_ResetStats();
+        Profiler_Reset();
+        UART_ResetTxStats();
+        SBUS_ResetStats();
+        CRSF_ResetStats();
+        ImuBus_ResetStats();
+#if UAV_IMU_FIFO
+        SensorReader::GetInstance().ResetFifoStats();
+#endif
+        CmdListener::GetInstance().ResetLatencyStats();
+#if UAV_BLACKBOX
+        Blackbox::GetInstance().ResetStats();
+#endif
+        LOGI("stats reset\r\n");
+    } else if (cmd == DEBUG_CMD_RECALIBRATE && !sArmed) {
+        // the erase stalls the CPU, not while flying
+        if (CalibStore_Erase()) LOGI("stored calibration dropped, recalibrating on the next boot\r\n");
+    }
+    LogEndReply();
+}
+
+#if UAV_IMU_PIPELINE
+// read -> estimate -> rate control -> motors on one sample, so the rate loop
+// never acts on stale gyro data. The burst read runs on the IMU bus interrupts
+// before the task is released, its response time in the scheduler stats is
+// still the data-ready to motor output latency.
+static void TaskImuPipeline()
+{
+    TaskReadSensor();
+    TaskEstimateState();
+    TaskControlAttRate();
+}
+
+// EXTI context, the main loop goes on while the sample is on the bus
+static void OnImuDataReady()
+{
+    ++sDataReadyEdges;
+    if (sStarted) SensorReader::GetInstance().StartRead();
+}
+
+// the pipeline only runs on data-ready edges. If they stop, e.g. a broken
+// INT wire or pin configuration, the reads are started from here at the
+// sample rate instead, until the edges come back.
+static void TaskImuWatchdog()
+{
+    uint64_t nowUs = Clock_GetUs();
+    uint32_t edges = sDataReadyEdges;
+    if (edges != sWatchdogEdges) {
+        sWatchdogEdges = edges;
+        sLastEdgeUs = nowUs;
+        if (sImuPolled) {
+            sImuPolled = false;
+            LOGI("imu data-ready is back\r\n");
         }
-        if (sControllerAttRateFlag) {
-            LOG("controller: sTimerCnt = %d\r\n", sTimerCnt);
-            sControllerAttRateFlag = false;
-            if (sArmed) Controller::GetInstance().RunAttRateCtrl();
-            LOG("controller: sTimerCnt = %d\r\n", sTimerCnt);
-        }
+        return;
+    }
+    if (!sImuPolled && nowUs - sLastEdgeUs > IMU_DATA_READY_TIMEOUT_US) {
+        sImuPolled = true;
+        ++sImuPolledCnt;
+        LOGE("no imu data-ready for %u ms, polling the imu, arming blocked\r\n", (uint32_t) ((nowUs - sLastEdgeUs) / 1000));
+    }
+    if (sImuPolled) SensorReader::GetInstance().StartRead(true);
+}
+
+// IMU bus context
+static void OnImuSampleRead(uint64_t dataReadyUs)
+{
+    Scheduler_TriggerAt(TASK_IMU_PIPELINE, dataReadyUs);
+}
+#endif
+
+// USART3 context
+static void OnRcFrame()
+{
+    if (sStarted) Scheduler_Trigger(TASK_LISTEN_CMD);
+}
+
+#if UAV_IMU_PIPELINE
+static const SchedulerTaskConfigType sTaskTable[NUM_OF_TASKS] = {
+    { "ImuPipeline", TaskImuPipeline, 0, IMU_SAMPLE_PERIOD_MS, 0, 0, 0 },
+    { "ListenCmd", TaskListenCmd, LISTEN_CMD_CNT, 0, 0, 4, 0 },
+    { "ControlAtt", TaskControlAtt, CONTROL_ATT_CNT, 0, 0, 3, SCHEDULER_TASK_BIT(TASK_IMU_PIPELINE) },
+    { "ImuWatchdog", TaskImuWatchdog, IMU_WATCHDOG_CNT, 0, 0, 1, 0 },
+    { "DebugCmd", TaskDebugCmd, DEBUG_CMD_CNT, 0, 0, 5, 0 },
+#if UAV_BLACKBOX
+    { "Blackbox", TaskBlackbox, BLACKBOX_CNT, 0, 0, 6, 0 },
+#endif
+};
+#else
+// rate-monotonic priorities, the 10ms tasks first
+static const SchedulerTaskConfigType sTaskTable[NUM_OF_TASKS] = {
+    { "ReadSensor", TaskReadSensor, READ_SENSOR_CNT, 0, 0, 0, 0 },
+    { "ListenCmd", TaskListenCmd, LISTEN_CMD_CNT, 0, 0, 4, 0 },
+    { "EstimateState", TaskEstimateState, ESTIMATE_STATE_CNT, 0, 0, 2, SCHEDULER_TASK_BIT(TASK_READ_SENSOR) },
+    { "ControlAtt", TaskControlAtt, CONTROL_ATT_CNT, 0, 0, 3, SCHEDULER_TASK_BIT(TASK_ESTIMATE_STATE) },
+    { "ControlAttRate", TaskControlAttRate, CONTROL_ATT_RATE_CNT, 0, 0, 1,
+      SCHEDULER_TASK_BIT(TASK_READ_SENSOR) | SCHEDULER_TASK_BIT(TASK_ESTIMATE_STATE) | SCHEDULER_TASK_BIT(TASK_CONTROL_ATT) },
+    { "DebugCmd", TaskDebugCmd, DEBUG_CMD_CNT, 0, 0, 5, 0 },
+#if UAV_BLACKBOX
+    { "Blackbox", TaskBlackbox, BLACKBOX_CNT, 0, 0, 6, 0 },
+#endif
+};
+#endif
+
+bool MainApp_Init()
+{
+    // first, the drivers time stamp their data from the start
+    Clock_Init();
+    // retries the steps that fail on its own
+    if (!DeviceInit()) {
+        LOGE("MainApp failed to init device, abort\r\n");
+        LED_SetOn(LED_ONBOARD, false);
+        return false;
     }
+
+    if (!Scheduler_Init(sTaskTable, NUM_OF_TASKS)) {
+        LOGE("MainApp failed to init scheduler, abort\r\n");
+        return false;
+    }
+#if UAV_IMU_PIPELINE
+    IMU::GetInstance().SetDataReadyCb(OnImuDataReady);
+    SensorReader::GetInstance().SetReadDoneCb(OnImuSampleRead);
+#endif
+    CmdListener::GetInstance().SetFrameCb(OnRcFrame);
+
+    // set controller period
+    Controller::GetInstance().SetAttPeriodMs(CONTROL_ATT_CNT);
+    Controller::GetInstance().SetAttRatePeriodMs(CONTROL_ATT_RATE_CNT);
+    // everything ready. Let's go.
+    LOGI("MainApp starts\r\n");
+    // plays from SysTick while the tasks run
+    LED_Blink(LED_ONBOARD, 4);
+#if UAV_IMU_PIPELINE
+    sLastEdgeUs = Clock_GetUs();
+#endif
+    sStarted = true;
+    return true;
+}
+
+bool MainApp_IsArmed()
+{
+    return sArmed;
 }
 
+uint32_t MainApp_GetFailsafeDisarmCount()
+{
+    return sFailsafeDisarmCnt;
+}
+
+#if UAV_IMU_PIPELINE
+uint32_t MainApp_GetImuPolledCount()
+{
+    return sImuPolledCnt;
+}
+#endif
+
+void MainApp_Loop()
+{
+    while (Scheduler_RunNext()) {
+    }
+}
+
+void MainApp()
+{
+    if (!MainApp_Init()) return;
+    while (1) {
+        MainApp_Loop();
+    }
+}
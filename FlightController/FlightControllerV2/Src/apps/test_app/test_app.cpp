@@ -10,7 +10,6 @@
 #include "MadgwickAHRS.h"
 #include "cmd_listener.h"
 #include "pwm.h"
-#include "sbus.h"
 
 /*
 * Defines
@@ -82,6 +81,8 @@ void TestIMU_Main()
 
     imu.CalibrateSensorBias();
     LOGI("IMU calibrate success\r\n");
+    // with the mag calibration, which the main app does not measure
+    imu.SaveCalibration();
 
     QKF* pQKF = new QKF();
     float gravityVector[3];
@@ -193,6 +194,8 @@ void TestMadgwick_Main()
 
     imu.CalibrateSensorBias();
     LOGI("IMU calibrate success\r\n");
+    // with the mag calibration, which the main app does not measure
+    imu.SaveCalibration();
 
     FCSensorDataType magData;
     FCSensorDataType accData;
@@ -313,8 +316,8 @@ void TestCmdListener()
 //    HAL_Delay(1000);
 //    LED_SetOn(LED_BLUE, false);
 //    HAL_Delay(1000);
-    SBUS_Start();
     CmdListener& cmdListener = CmdListener::GetInstance();
+    cmdListener.Start();
     FCCmdType cmd;
     while (1) {
         cmdListener.GetCmd(cmd);
@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "crsf.h"
+
+#include "UAV_Defines.h"
+#include "clock.h"
+#include "latest_value.h"
+#include "logging.h"
+#include "rc_uart.h"
+#include "crsf_decoder.h"
+
+/*
+* Defines
+*/
+
+#define LOG_TAG ("CRSF")
+#define CRSF_DEBUG (0)
+
+#if CRSF_DEBUG
+#define LOG(...) LOGI(__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+
+/*
+* Struct
+*/
+
+typedef struct {
+    uint8_t data[CRSF_RC_CHANNELS_PAYLOAD_LEN];
+} CRSFRcFrameType;
+
+/*
+* Static
+*/
+
+static volatile bool sStarted = false;
+// the USART3 and DMA interrupts feed what the receiver sent to the decoder
+static CRSFDecoderType sDecoder;
+// RC frames go to the main loop, CRSF_Read() unpacks the latest in place
+static LatestValue<CRSFRcFrameType> sFrames;
+static LatestValue<CRSFLinkStatsType> sLinkStats;
+static CRSFDataType sLastData;
+static CRSFFrameCb spFrameCb = NULL;
+
+/*
+* Prototypes
+*/
+static void CRSF_OnRx(const uint8_t* pData, uint32_t len, uint64_t timeUs);
+static void CRSF_OnIdle();
+
+/*
+* Constant
+*/
+
+// 8 data bits, no parity, 1 stop bit
+static const RcUartConfigType sRcUartConfig = {
+    CRSF_BAUDRATE, UART_WORDLENGTH_8B, UART_STOPBITS_1, UART_PARITY_NONE, CRSF_OnRx, CRSF_OnIdle
+};
+
+/*
+* Code
+*/
+
+// hands a frame with a valid CRC to the main loop
+static void CRSF_Publish(const uint8_t* pFrame, uint64_t timeUs)
+{
+    if (!pFrame) return;
+    const uint8_t* pPayload = &pFrame[CRSF_FRAME_PAYLOAD_INDEX];
+    switch (pFrame[CRSF_FRAME_TYPE_INDEX]) {
+    case CRSF_FRAMETYPE_RC_CHANNELS_PACKED:
+        memcpy(sFrames.BeginWrite()->data, pPayload, CRSF_RC_CHANNELS_PAYLOAD_LEN);
+        sFrames.EndWrite(timeUs);
+        sStarted = true;
+        if (spFrameCb) spFrameCb();
+        break;
+    case CRSF_FRAMETYPE_LINK_STATISTICS:
+        CRSF_ParseLinkStats(pPayload, sLinkStats.BeginWrite());
+        sLinkStats.EndWrite(timeUs);
+        break;
+    default:
+        // telemetry requests and the like, not used
+        break;
+    }
+}
+
+/*------------------------------------------*
+* Callbacks/Interrupts
+*------------------------------------------*/
+
+// the bytes RcUart handed over, unlike SBUS the CRC confirms a frame as
+// soon as its last byte is in
+static void CRSF_OnRx(const uint8_t* pData, uint32_t len, uint64_t timeUs)
+{
+    for (uint32_t i = 0; i < len; ++i) {
+        const uint8_t* pFrame = CRSFDecoder_PutByte(&sDecoder, pData[i], timeUs);
+        for (; pFrame; pFrame = CRSFDecoder_Next(&sDecoder, timeUs)) {
+            CRSF_Publish(pFrame, timeUs);
+        }
+    }
+}
+
+static void CRSF_OnIdle()
+{
+    CRSFDecoder_OnIdle(&sDecoder);
+}
+
+bool CRSF_Init()
+{
+    CRSFDecoder_Init(&sDecoder);
+    memset(&sLastData, 0, sizeof(sLastData));
+    return true;
+}
+
+bool CRSF_Start()
+{
+    // the interrupts must not feed the decoder while it is reset
+    RcUart_Stop();
+    sStarted = false;
+    CRSFDecoder_Init(&sDecoder);
+    if (!RcUart_Start(&sRcUartConfig)) {
+        LOGE("CRSF failed to start\r\n");
+        return false;
+    }
+    return true;
+}
+
+void CRSF_Stop()
+{
+    RcUart_Stop();
+}
+
+bool CRSF_IsReceiving()
+{
+    return sStarted;
+}
+
+bool CRSF_Read(CRSFDataType* pCRSFData)
+{
+    if (!pCRSFData) {
+        LOGE("%s, input invalid\r\n", __func__);
+        return false;
+    }
+
+    if (sLinkStats.Update()) {
+        sLastData.link = sLinkStats.Latest().value;
+        sLastData.linkSeq = sLinkStats.Latest().seq;
+        // the receiver keeps sending RC frames with the failsafe positions
+        // when the uplink is gone, only the link statistics tell
+        sLastData.failsafe = sLastData.link.uplinkLinkQuality == 0;
+    }
+    if (sFrames.Update()) {
+        const LatestValue<CRSFRcFrameType>::SlotType& frame = sFrames.Latest();
+        uint16_t channels[CRSF_NUM_OF_CHANNELS];
+        CRSF_UnpackChannels(frame.value.data, channels);
+        for (int i = 0; i < CRSF_NUM_OF_CHANNELS; ++i) {
+            if (i < 5) LOG("CRSFData: channel %d : %d\r\n", i, channels[i]);
+            sLastData.channels[i] = channels[i];
+        }
+        sLastData.frameSeq = frame.seq;
+        sLastData.frameTimeUs = frame.timeUs;
+    }
+    // no new frame since the last call, repeat the last one with the same frameSeq
+    *pCRSFData = sLastData;
+    // with the receiver gone there are no link statistics either, the last
+    // ones may still show a good uplink
+    pCRSFData->stale = !sStarted || Clock_GetUs() - sLastData.frameTimeUs > UAV_RC_LINK_TIMEOUT_MS * 1000ULL;
+    if (pCRSFData->stale) pCRSFData->failsafe = true;
+    return true;
+}
+
+void CRSF_GetLinkStats(CRSFLinkStatsType* pLinkStats)
+{
+    if (!pLinkStats) return;
+    *pLinkStats = sLastData.link;
+}
+
+void CRSF_SetFrameCb(CRSFFrameCb cb)
+{
+    spFrameCb = cb;
+}
+
+void CRSF_GetStats(CRSFStatsType* pStats)
+{
+    // the interrupts update the counters, take a consistent copy
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pStats->decoder = sDecoder.stats;
+    pStats->uartErrors = RcUart_GetErrors();
+    __set_PRIMASK(primask);
+}
+
+void CRSF_ResetStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    CRSFDecoder_ResetStats(&sDecoder);
+    RcUart_ResetErrors();
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,67 @@
+#include "stm32f1xx_hal.h"
+
+#include "clock.h"
+
+#include "logging.h"
+
+#define LOG_TAG ("Clock")
+
+/*
+* Static
+*/
+
+static uint32_t sCyclesPerUs = 1;
+static uint32_t sLastCycles = 0;
+static uint64_t sHighCycles = 0;
+
+/*
+* Code
+*/
+
+bool Clock_Init()
+{
+    // enable trace so the DWT is clocked, then start the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    sCyclesPerUs = SystemCoreClock / 1000000;
+    if (sCyclesPerUs == 0) {
+        LOGE("SystemCoreClock too low, %u\r\n", SystemCoreClock);
+        sCyclesPerUs = 1;
+        return false;
+    }
+    sLastCycles = DWT->CYCCNT;
+    sHighCycles = 0;
+    return true;
+}
+
+uint32_t Clock_GetCycles()
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t Clock_GetCyclesPerUs()
+{
+    return sCyclesPerUs;
+}
+
+uint32_t Clock_CyclesToUs(uint32_t cycles)
+{
+    return cycles / sCyclesPerUs;
+}
+
+uint64_t Clock_GetUs()
+{
+    // called from both thread and SysTick context, keep the extension atomic
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t cycles = DWT->CYCCNT;
+    if (cycles < sLastCycles) {
+        sHighCycles += (uint64_t) 1 << 32;
+    }
+    sLastCycles = cycles;
+    uint64_t total = sHighCycles | cycles;
+    __set_PRIMASK(primask);
+    return total / sCyclesPerUs;
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "flash.h"
+
+#include "logging.h"
+
+#define LOG_TAG ("Flash")
+
+// where the CPU reads flash address addr; the SIL HAL points it at its image
+#ifndef FLASH_READ_PTR
+#define FLASH_READ_PTR(addr) ((const uint8_t*) (addr))
+#endif
+
+/*
+ * Code
+ */
+
+static bool Flash_IsDataPage(uint32_t addr, uint32_t size)
+{
+    return addr >= FLASH_DATA_PAGE_ADDR && addr + size <= FLASH_DATA_PAGE_ADDR + FLASH_DATA_PAGE_LEN;
+}
+
+bool Flash_Read(uint32_t addr, void* pData, uint16_t size)
+{
+    if (!pData || !Flash_IsDataPage(addr, size)) return false;
+    memcpy(pData, FLASH_READ_PTR(addr), size);
+    return true;
+}
+
+bool Flash_ErasePage(uint32_t addr)
+{
+    if (!Flash_IsDataPage(addr, 1)) return false;
+    FLASH_EraseInitTypeDef erase;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_1;
+    erase.PageAddress = addr - (addr - FLASH_DATA_PAGE_ADDR) % FLASH_DATA_PAGE_LEN;
+    erase.NbPages = 1;
+    uint32_t pageError = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &pageError);
+    HAL_FLASH_Lock();
+    if (status != HAL_OK) {
+        LOGE("HAL_FLASHEx_Erase failed, status = %d, page = 0x%x\r\n", status, (unsigned) erase.PageAddress);
+        return false;
+    }
+    return true;
+}
+
+bool Flash_Write(uint32_t addr, const void* pData, uint16_t size)
+{
+    if (!pData || (addr & 1) || (size & 1) || !Flash_IsDataPage(addr, size)) return false;
+    const uint8_t* pBytes = (const uint8_t*) pData;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+    for (uint16_t i = 0; i < size && status == HAL_OK; i += 2) {
+        uint16_t halfWord = (uint16_t) (pBytes[i] | (pBytes[i + 1] << 8));
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + i, halfWord);
+    }
+    HAL_FLASH_Lock();
+    if (status != HAL_OK) {
+        LOGE("HAL_FLASH_Program failed, status = %d, addr = 0x%x\r\n", status, (unsigned) addr);
+        return false;
+    }
+    return true;
+}
@@ -1,15 +1,79 @@
+#include <string.h>
+
 #include "stm32f1xx_hal.h"
 
 #include "i2c.h"
 
+#include "UAV_Defines.h"
+#include "clock.h"
 #include "logging.h"
 
 #define LOG_TAG ("I2C")
 
 #define I2C_TIMEOUT (100)
 
+#if UAV_I2C_FAST_MODE
+#define I2C_CLOCK_SPEED (400000)
+#else
+#define I2C_CLOCK_SPEED (100000)
+#endif
+// 8 data bits and the ACK per byte; address, register and restart on top
+#define I2C_BITS_PER_BYTE (9)
+#define I2C_OVERHEAD_BYTES (4)
+
+// I2C1 on PB8/PB9 (remapped), see HAL_I2C_MspInit()
+#define I2C_GPIO_PORT (GPIOB)
+#define I2C_SCL_PIN (GPIO_PIN_8)
+#define I2C_SDA_PIN (GPIO_PIN_9)
+#define I2C_HALF_BIT_US (1000000 / I2C_CLOCK_SPEED / 2 + 1)
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    I2C_RESULT_OK,
+    I2C_RESULT_ERROR,
+    I2C_RESULT_TIMEOUT,
+} I2CResultType;
+
+typedef struct {
+    uint16_t devAddr;
+    uint16_t memAddr;
+    uint16_t memAddSize;
+    uint8_t* pData;
+    uint16_t size;
+    bool read;
+    I2CDoneCb cb;
+    void* pArg;
+} I2CTransactionType;
+
+/*
+ * Static
+ */
+
 extern I2C_HandleTypeDef hi2c1;
 
+// sQueue[sHead] is the transaction on the bus while sActive, sCount counts it
+static I2CTransactionType sQueue[I2C_QUEUE_LEN];
+static volatile uint32_t sHead = 0;
+static volatile uint32_t sCount = 0;
+static volatile bool sActive = false;
+// a blocking transfer owns the bus, the queue waits
+static volatile bool sPolled = false;
+static uint32_t sStartTick = 0;
+static uint32_t sTimeoutMs = 0;
+static uint64_t sStartUs = 0;
+static I2CStatsType sStats;
+
+/*
+ * Prototypes
+ */
+static bool I2C_Queue(const I2CTransactionType* pTransaction);
+static void I2C_StartNext();
+static void I2C_Finish(I2CResultType result);
+static void I2C_Complete(I2CResultType result);
+
 /*
  * Code
  */
@@ -31,6 +95,22 @@ bool I2C_Init()
       return false;
    }
    */
+   // the queue runs on the event and error interrupts, at the priority of
+   // the data-ready EXTI that queues the sample reads
+   HAL_NVIC_SetPriority(I2C1_EV_IRQn, 0, 0);
+   HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+   HAL_NVIC_SetPriority(I2C1_ER_IRQn, 0, 0);
+   HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+
+   if (hi2c1.Init.ClockSpeed != I2C_CLOCK_SPEED) {
+      // fast mode needs duty cycle 2 or 16/9, 2 works from the 32 MHz APB1
+      hi2c1.Init.ClockSpeed = I2C_CLOCK_SPEED;
+      hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+      if (HAL_I2C_Init(&hi2c1) != HAL_OK) {
+         LOGE("HAL_I2C_Init failed at %d hz\r\n", I2C_CLOCK_SPEED);
+         return false;
+      }
+   }
    return true;
 }
 
@@ -40,9 +120,49 @@ void I2C_InterruptHandler()
     HAL_I2C_EV_IRQHandler(&hi2c1);
 }
 
+void I2C_ErrorInterruptHandler()
+{
+    HAL_I2C_ER_IRQHandler(&hi2c1);
+}
+
+/*------------------------------------------*
+* Blocking transfers
+*------------------------------------------*/
+
+// waits for the queued transactions, then holds the queue off the bus
+static bool I2C_Acquire()
+{
+    uint32_t tickstart = HAL_GetTick();
+    for (;;) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (!sActive && sCount == 0) {
+            sPolled = true;
+            __set_PRIMASK(primask);
+            return true;
+        }
+        __set_PRIMASK(primask);
+        if (HAL_GetTick() - tickstart > I2C_TIMEOUT) return false;
+        // the completion or the timeout tick wakes us
+        __WFI();
+    }
+}
+
+static void I2C_Release()
+{
+    sPolled = false;
+    // whatever an interrupt queued in the meantime
+    I2C_StartNext();
+}
+
 bool I2C_Write(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t *pData, uint16_t size)
 {
+    if (!I2C_Acquire()) {
+        LOGE("I2C_Write timed out waiting for the queue\r\n");
+        return false;
+    }
     HAL_StatusTypeDef status = HAL_I2C_Mem_Write(&hi2c1, devAddr, memAddr, memAddSize, pData, size, I2C_TIMEOUT);
+    I2C_Release();
     if (status != HAL_OK) {
         LOGE("HAL_I2C_Mem_Write failed, status = %d\r\n", status);
         return false;
@@ -52,7 +172,12 @@ bool I2C_Write(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t
 
 bool I2C_Read(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t *pData, uint16_t size)
 {
+   if (!I2C_Acquire()) {
+       LOGE("I2C_Read timed out waiting for the queue\r\n");
+       return false;
+   }
    HAL_StatusTypeDef status = HAL_I2C_Mem_Read(&hi2c1, devAddr, memAddr, memAddSize, pData, size, I2C_TIMEOUT);
+   I2C_Release();
    if (status != HAL_OK) {
        LOGE("HAL_I2C_Mem_Read failed, status = %d, memAddr = %d\r\n", status, memAddr);
        return false;
@@ -60,3 +185,202 @@ bool I2C_Read(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t *
    return true;
 }
 
+/*------------------------------------------*
+* Queued transfers
+*------------------------------------------*/
+
+static bool I2C_Queue(const I2CTransactionType* pTransaction)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (sCount >= I2C_QUEUE_LEN) {
+        ++sStats.queueFull;
+        __set_PRIMASK(primask);
+        return false;
+    }
+    sQueue[(sHead + sCount) % I2C_QUEUE_LEN] = *pTransaction;
+    ++sCount;
+    if (sCount > sStats.maxQueued) sStats.maxQueued = sCount;
+    __set_PRIMASK(primask);
+
+    I2C_StartNext();
+    return true;
+}
+
+// puts the head of the queue on the bus unless something else owns it
+static void I2C_StartNext()
+{
+    for (;;) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (sActive || sPolled || sCount == 0) {
+            __set_PRIMASK(primask);
+            return;
+        }
+        sActive = true;
+        const I2CTransactionType* pTransaction = &sQueue[sHead];
+        sStartTick = HAL_GetTick();
+        sStartUs = Clock_GetUs();
+        // a long burst, e.g. a FIFO drain, gets its time on the wire on top
+        sTimeoutMs = I2C_ASYNC_TIMEOUT_MS +
+                     ((pTransaction->size + I2C_OVERHEAD_BYTES) * I2C_BITS_PER_BYTE * 1000 + I2C_CLOCK_SPEED - 1) / I2C_CLOCK_SPEED;
+        __set_PRIMASK(primask);
+
+        HAL_StatusTypeDef status;
+        if (pTransaction->read) {
+            status = HAL_I2C_Mem_Read_IT(&hi2c1, pTransaction->devAddr, pTransaction->memAddr,
+                                         pTransaction->memAddSize, pTransaction->pData, pTransaction->size);
+        } else {
+            status = HAL_I2C_Mem_Write_IT(&hi2c1, pTransaction->devAddr, pTransaction->memAddr,
+                                          pTransaction->memAddSize, pTransaction->pData, pTransaction->size);
+        }
+        if (status == HAL_OK) return;
+        // bus still busy or the HAL is locked, fail this one and go on
+        I2C_Finish(I2C_RESULT_ERROR);
+    }
+}
+
+// retires the transaction on the bus and reports it
+static void I2C_Finish(I2CResultType result)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!sActive) {
+        // completion of a transaction the timeout already retired
+        __set_PRIMASK(primask);
+        return;
+    }
+    I2CTransactionType done = sQueue[sHead];
+    sHead = (sHead + 1) % I2C_QUEUE_LEN;
+    --sCount;
+    sActive = false;
+    if (result == I2C_RESULT_OK) {
+        ++sStats.transfers;
+        uint32_t us = (uint32_t) (Clock_GetUs() - sStartUs);
+        if (us > sStats.maxTransferUs) sStats.maxTransferUs = us;
+    } else if (result == I2C_RESULT_TIMEOUT) {
+        ++sStats.timeouts;
+    } else {
+        ++sStats.errors;
+    }
+    __set_PRIMASK(primask);
+
+    if (done.cb) done.cb(result == I2C_RESULT_OK, done.pArg);
+}
+
+static void I2C_Complete(I2CResultType result)
+{
+    I2C_Finish(result);
+    I2C_StartNext();
+}
+
+bool I2C_WriteAsync(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t *pData, uint16_t size,
+                    I2CDoneCb cb, void* pArg)
+{
+    I2CTransactionType transaction = { devAddr, memAddr, memAddSize, pData, size, false, cb, pArg };
+    return I2C_Queue(&transaction);
+}
+
+bool I2C_ReadAsync(uint16_t devAddr, uint16_t memAddr, uint16_t memAddSize, uint8_t *pData, uint16_t size,
+                   I2CDoneCb cb, void* pArg)
+{
+    I2CTransactionType transaction = { devAddr, memAddr, memAddSize, pData, size, true, cb, pArg };
+    return I2C_Queue(&transaction);
+}
+
+bool I2C_IsIdle()
+{
+    return !sActive && sCount == 0;
+}
+
+// a few cycles per pass, so at least the time asked for
+static void I2C_WaitHalfBit()
+{
+    for (volatile uint32_t n = Clock_GetCyclesPerUs() * I2C_HALF_BIT_US / 4; n > 0; --n) {
+    }
+}
+
+// a slave that was sending when the transfer broke off holds SDA low until it
+// has clocked out the rest of its byte. With the peripheral off, up to 9 SCL
+// pulses let it finish, then a STOP leaves the bus idle for HAL_I2C_Init().
+static void I2C_ClearBus()
+{
+    GPIO_InitTypeDef gpio = {0};
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SCL_PIN | I2C_SDA_PIN, GPIO_PIN_SET);
+    gpio.Pin = I2C_SCL_PIN | I2C_SDA_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_OD;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(I2C_GPIO_PORT, &gpio);
+    I2C_WaitHalfBit();
+
+    for (int i = 0; i < I2C_BITS_PER_BYTE && HAL_GPIO_ReadPin(I2C_GPIO_PORT, I2C_SDA_PIN) == GPIO_PIN_RESET; ++i) {
+        HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SCL_PIN, GPIO_PIN_RESET);
+        I2C_WaitHalfBit();
+        HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SCL_PIN, GPIO_PIN_SET);
+        I2C_WaitHalfBit();
+    }
+    // STOP, SDA rises while SCL is high
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SCL_PIN, GPIO_PIN_RESET);
+    I2C_WaitHalfBit();
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SDA_PIN, GPIO_PIN_RESET);
+    I2C_WaitHalfBit();
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SCL_PIN, GPIO_PIN_SET);
+    I2C_WaitHalfBit();
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, I2C_SDA_PIN, GPIO_PIN_SET);
+    I2C_WaitHalfBit();
+}
+
+void I2C_OnTick()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!sActive || HAL_GetTick() - sStartTick <= sTimeoutMs) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    // a slave holding the bus or a lost interrupt, a reset aborts the
+    // transfer and returns the HAL to ready; DeInit() hands the pins back to
+    // GPIO for the bus clear and Init() to the peripheral
+    HAL_I2C_DeInit(&hi2c1);
+    I2C_ClearBus();
+    HAL_I2C_Init(&hi2c1);
+    __set_PRIMASK(primask);
+
+    I2C_Complete(I2C_RESULT_TIMEOUT);
+}
+
+void I2C_GetStats(I2CStatsType* pStats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pStats = sStats;
+    __set_PRIMASK(primask);
+}
+
+void I2C_ResetStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&sStats, 0, sizeof(sStats));
+    __set_PRIMASK(primask);
+}
+
+/*------------------------------------------*
+* Callbacks/Interrupts
+*------------------------------------------*/
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == &hi2c1) I2C_Complete(I2C_RESULT_OK);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == &hi2c1) I2C_Complete(I2C_RESULT_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+    // a blocking transfer reports its own errors
+    if (hi2c == &hi2c1 && !sPolled) I2C_Complete(I2C_RESULT_ERROR);
+}
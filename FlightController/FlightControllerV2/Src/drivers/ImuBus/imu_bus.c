@@ -0,0 +1,234 @@
+#include "stm32f1xx_hal.h"
+
+#include "imu_bus.h"
+
+#include "UAV_Defines.h"
+#include "MPU9250_def.h"
+#include "i2c.h"
+#include "logging.h"
+#include "spi.h"
+
+#define LOG_TAG ("ImuBus")
+
+// AD0 picks 0x68 or 0x69, on SPI the chip select does
+#define IMU_BUS_IS_MPU9250(devAddr) (((devAddr) & ~0x02) == MPU9250_DEFAULT_ADDRESS)
+
+/*
+ * Prototypes
+ */
+static bool I2CBackendInit();
+static void I2CBackendOnTick();
+static bool I2CBackendRead(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+static bool I2CBackendWrite(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+static bool I2CBackendReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+static bool I2CBackendWriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+static void I2CBackendGetStats(ImuBusStatsType* pStats);
+static bool SPIBackendInit();
+static void SPIBackendOnTick();
+static bool SPIBackendRead(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+static bool SPIBackendWrite(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size);
+static bool SPIBackendReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+static bool SPIBackendWriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg);
+static void SPIBackendGetStats(ImuBusStatsType* pStats);
+
+/*
+ * Static
+ */
+
+static const ImuBusBackendType sI2CBackend = {
+    "i2c", IMU_BUS_I2C, I2CBackendInit, I2CBackendOnTick, I2CBackendRead, I2CBackendWrite,
+    I2CBackendReadAsync, I2CBackendWriteAsync, I2CBackendGetStats, I2C_ResetStats
+};
+static const ImuBusBackendType sSPIBackend = {
+    "spi", IMU_BUS_SPI, SPIBackendInit, SPIBackendOnTick, SPIBackendRead, SPIBackendWrite,
+    SPIBackendReadAsync, SPIBackendWriteAsync, SPIBackendGetStats, SPI_ResetStats
+};
+
+#if UAV_IMU_BUS == IMU_BUS_SPI
+static const ImuBusBackendType* spBackend = &sSPIBackend;
+#else
+static const ImuBusBackendType* spBackend = &sI2CBackend;
+#endif
+
+/*
+ * Code
+ */
+
+/*------------------------------------------*
+* I2C1
+*------------------------------------------*/
+
+static bool I2CBackendInit()
+{
+    return I2C_Init();
+}
+
+static void I2CBackendOnTick()
+{
+    I2C_OnTick();
+}
+
+static bool I2CBackendRead(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    return I2C_Read(devAddr, reg, I2C_MEMADD_SIZE_8BIT, pData, size);
+}
+
+static bool I2CBackendWrite(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    return I2C_Write(devAddr, reg, I2C_MEMADD_SIZE_8BIT, pData, size);
+}
+
+static bool I2CBackendReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return I2C_ReadAsync(devAddr, reg, I2C_MEMADD_SIZE_8BIT, pData, size, cb, pArg);
+}
+
+static bool I2CBackendWriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return I2C_WriteAsync(devAddr, reg, I2C_MEMADD_SIZE_8BIT, pData, size, cb, pArg);
+}
+
+static void I2CBackendGetStats(ImuBusStatsType* pStats)
+{
+    I2CStatsType stats;
+    I2C_GetStats(&stats);
+    pStats->transfers = stats.transfers;
+    pStats->errors = stats.errors;
+    pStats->timeouts = stats.timeouts;
+    pStats->queueFull = stats.queueFull;
+    pStats->maxQueued = stats.maxQueued;
+    pStats->queueLen = I2C_QUEUE_LEN;
+    pStats->maxTransferUs = stats.maxTransferUs;
+}
+
+/*------------------------------------------*
+* SPI2
+*------------------------------------------*/
+
+// sensor data, interrupt status and the FIFO may be read fast, anything
+// else only at 1 MHz
+static SPISpeedType SPIBackendReadSpeed(uint8_t reg)
+{
+    if (reg >= MPU9250_RA_INT_STATUS && reg <= MPU9250_RA_EXT_SENS_DATA_23) return SPI_SPEED_FAST;
+    if (reg == MPU9250_RA_FIFO_COUNTH || reg == MPU9250_RA_FIFO_R_W) return SPI_SPEED_FAST;
+    return SPI_SPEED_SLOW;
+}
+
+static bool SPIBackendInit()
+{
+    return SPI_Init();
+}
+
+static void SPIBackendOnTick()
+{
+    SPI_OnTick();
+}
+
+static bool SPIBackendRead(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    if (!IMU_BUS_IS_MPU9250(devAddr)) return false;
+    return SPI_Read(reg, pData, size, SPIBackendReadSpeed(reg));
+}
+
+static bool SPIBackendWrite(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    if (!IMU_BUS_IS_MPU9250(devAddr)) return false;
+    return SPI_Write(reg, pData, size);
+}
+
+static bool SPIBackendReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    if (!IMU_BUS_IS_MPU9250(devAddr)) return false;
+    return SPI_ReadAsync(reg, pData, size, SPIBackendReadSpeed(reg), cb, pArg);
+}
+
+static bool SPIBackendWriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    if (!IMU_BUS_IS_MPU9250(devAddr)) return false;
+    return SPI_WriteAsync(reg, pData, size, cb, pArg);
+}
+
+static void SPIBackendGetStats(ImuBusStatsType* pStats)
+{
+    SPIStatsType stats;
+    SPI_GetStats(&stats);
+    pStats->transfers = stats.transfers;
+    pStats->errors = stats.errors;
+    pStats->timeouts = stats.timeouts;
+    pStats->queueFull = stats.queueFull;
+    pStats->maxQueued = stats.maxQueued;
+    pStats->queueLen = SPI_QUEUE_LEN;
+    pStats->maxTransferUs = stats.maxTransferUs;
+}
+
+/*------------------------------------------*
+* Selected backend
+*------------------------------------------*/
+
+const ImuBusBackendType* ImuBus_GetBuiltinBackend(int bus)
+{
+    if (bus == IMU_BUS_I2C) return &sI2CBackend;
+    if (bus == IMU_BUS_SPI) return &sSPIBackend;
+    return NULL;
+}
+
+bool ImuBus_SetBackend(const ImuBusBackendType* pBackend)
+{
+    if (!pBackend || !pBackend->init || !pBackend->onTick || !pBackend->read || !pBackend->write
+        || !pBackend->readAsync || !pBackend->writeAsync || !pBackend->getStats || !pBackend->resetStats) {
+        LOGE("invalid backend\r\n");
+        return false;
+    }
+    spBackend = pBackend;
+    return true;
+}
+
+const ImuBusBackendType* ImuBus_GetBackend()
+{
+    return spBackend;
+}
+
+bool ImuBus_Init()
+{
+    if (!spBackend->init()) {
+        LOGE("%s init failed\r\n", spBackend->name);
+        return false;
+    }
+    LOGI("imu on %s\r\n", spBackend->name);
+    return true;
+}
+
+void ImuBus_OnTick()
+{
+    spBackend->onTick();
+}
+
+bool ImuBus_Write(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    return spBackend->write(devAddr, reg, pData, size);
+}
+
+bool ImuBus_Read(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    return spBackend->read(devAddr, reg, pData, size);
+}
+
+bool ImuBus_WriteAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return spBackend->writeAsync(devAddr, reg, pData, size, cb, pArg);
+}
+
+bool ImuBus_ReadAsync(uint16_t devAddr, uint8_t reg, uint8_t* pData, uint16_t size, ImuBusDoneCb cb, void* pArg)
+{
+    return spBackend->readAsync(devAddr, reg, pData, size, cb, pArg);
+}
+
+void ImuBus_GetStats(ImuBusStatsType* pStats)
+{
+    spBackend->getStats(pStats);
+}
+
+void ImuBus_ResetStats()
+{
+    spBackend->resetStats();
+}
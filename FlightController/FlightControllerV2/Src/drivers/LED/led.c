@@ -1,10 +1,80 @@
+#include <string.h>
+
 #include "stm32f1xx_hal.h"
 
 #include "led.h"
 
 #define ONBOARD_LED_Pin GPIO_PIN_13
 
-static uint8_t sOnBoardLedStatus = GPIO_PIN_RESET;
+/*
+ * Defines
+ */
+
+#define LED_BLINK_STEPS (LED_BLINK_TOGGLE_MS / LED_PATTERN_STEP_MS) // per toggle
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t bits;
+    uint8_t steps;
+} LEDPatternType;
+
+typedef struct {
+    bool baseOn;                           // LED_SetOn()
+    uint8_t states;                        // bit per LEDStateType
+    LEDPatternType queue[LED_QUEUE_LEN];
+    uint8_t queueHead;
+    uint8_t queueCnt;
+    int8_t shown;                          // state on the LED, -1 for none
+    uint8_t step;                          // of what is on the LED
+} LEDChannelType;
+
+/*
+ * Static
+ */
+
+// 1 s slow blink, solid, 200 ms fast blink
+static const LEDPatternType sStatePatterns[NUM_OF_LED_STATES] = {
+    { 0x0000001F, 10 },
+    { 0x00000001, 1 },
+    { 0x00000001, 2 },
+};
+
+static LEDChannelType sLeds[NUM_OF_LEDS];
+static bool sInitialized = false;
+static uint16_t sTickMs = 0;
+
+/*
+ * Code
+ */
+
+static void Write(LEDType led, bool on)
+{
+    switch(led) {
+    case LED_ONBOARD:
+        // For blue pill, set the pin to low to light up LED
+        HAL_GPIO_WritePin(GPIOC, ONBOARD_LED_Pin, on ? GPIO_PIN_RESET : GPIO_PIN_SET);
+        break;
+    default:
+        break;
+    }
+}
+
+static int HighestState(const LEDChannelType* pLed)
+{
+    for (int state = NUM_OF_LED_STATES - 1; state >= 0; --state) {
+        if (pLed->states & (1u << state)) return state;
+    }
+    return -1;
+}
+
+// whether anything covers the base level, with interrupts off
+static bool IsIdle(const LEDChannelType* pLed)
+{
+    return pLed->states == 0 && pLed->queueCnt == 0;
+}
 
 bool LED_Init()
 {
@@ -18,38 +88,120 @@ bool LED_Init()
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 #endif
-    HAL_GPIO_WritePin(GPIOC, ONBOARD_LED_Pin, GPIO_PIN_SET); // For blue pill, set the pin to low to light up LED
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(sLeds, 0, sizeof(sLeds));
+    for (int led = 0; led < NUM_OF_LEDS; ++led) {
+        sLeds[led].shown = -1;
+        Write((LEDType) led, false);
+    }
+    sTickMs = 0;
+    sInitialized = true;
+    __set_PRIMASK(primask);
     return true;
 }
 
-bool LED_SetOn(LEDType led, bool on)
+void LED_OnTick()
 {
-    switch(led) {
-    case LED_ONBOARD:
-        HAL_GPIO_WritePin(GPIOC, ONBOARD_LED_Pin, on ? GPIO_PIN_RESET : GPIO_PIN_SET);
-        break;
+    if (!sInitialized || ++sTickMs < LED_PATTERN_STEP_MS) return;
+    sTickMs = 0;
+
+    for (int led = 0; led < NUM_OF_LEDS; ++led) {
+        LEDChannelType* pLed = &sLeds[led];
+        int state = HighestState(pLed);
+        if (pLed->queueCnt > 0 && state != LED_STATE_FAILSAFE) {
+            // a one-shot plays to its end, only a failsafe cuts in and restarts it
+            const LEDPatternType* pPattern = &pLed->queue[pLed->queueHead];
+            if (pLed->shown != NUM_OF_LED_STATES) {
+                pLed->shown = NUM_OF_LED_STATES;
+                pLed->step = 0;
+            }
+            Write((LEDType) led, (pPattern->bits >> pLed->step) & 1);
+            if (++pLed->step >= pPattern->steps) {
+                pLed->queueHead = (pLed->queueHead + 1) % LED_QUEUE_LEN;
+                --pLed->queueCnt;
+                pLed->shown = -1;
+            }
+        } else if (state >= 0) {
+            const LEDPatternType* pPattern = &sStatePatterns[state];
+            if (pLed->shown != state) {
+                pLed->shown = (int8_t) state;
+                pLed->step = 0;
+            }
+            Write((LEDType) led, (pPattern->bits >> pLed->step) & 1);
+            pLed->step = (pLed->step + 1) % pPattern->steps;
+        } else {
+            pLed->shown = -1;
+            Write((LEDType) led, pLed->baseOn);
+        }
     }
+}
 
+bool LED_SetOn(LEDType led, bool on)
+{
+    if (led >= NUM_OF_LEDS) return false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    LEDChannelType* pLed = &sLeds[led];
+    pLed->baseOn = on;
+    // right away if nothing covers it, the next step otherwise
+    if (IsIdle(pLed)) Write(led, on);
+    __set_PRIMASK(primask);
     return true;
 }
 
 bool LED_Toggle(LEDType led)
 {
-    switch(led) {
-    case LED_ONBOARD:
-        sOnBoardLedStatus ^= 1;
-        HAL_GPIO_WritePin(GPIOC, ONBOARD_LED_Pin, sOnBoardLedStatus ? GPIO_PIN_RESET : GPIO_PIN_SET);
-        break;
+    if (led >= NUM_OF_LEDS) return false;
+    return LED_SetOn(led, !sLeds[led].baseOn);
+}
+
+bool LED_QueuePattern(LEDType led, uint32_t bits, uint8_t steps)
+{
+    if (led >= NUM_OF_LEDS || steps == 0 || steps > LED_PATTERN_MAX_STEPS) return false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    LEDChannelType* pLed = &sLeds[led];
+    if (pLed->queueCnt >= LED_QUEUE_LEN) {
+        __set_PRIMASK(primask);
+        return false;
     }
+    LEDPatternType* pPattern = &pLed->queue[(pLed->queueHead + pLed->queueCnt) % LED_QUEUE_LEN];
+    pPattern->bits = bits;
+    pPattern->steps = steps;
+    ++pLed->queueCnt;
+    __set_PRIMASK(primask);
     return true;
 }
 
 bool LED_Blink(LEDType led, uint8_t cnt)
 {
-    // we blink every 200ms
+    if (led >= NUM_OF_LEDS || cnt == 0) return false;
+    if (cnt > LED_PATTERN_MAX_STEPS / LED_BLINK_STEPS) cnt = LED_PATTERN_MAX_STEPS / LED_BLINK_STEPS;
+    // from the base level, as the toggles did when they blocked; an odd count
+    // leaves the LED toggled
+    bool on = sLeds[led].baseOn;
+    uint32_t bits = 0;
     for (uint8_t i = 0; i < cnt; ++i) {
-        LED_Toggle(led);
-        HAL_Delay(200);
+        on = !on;
+        if (on) bits |= ((1u << LED_BLINK_STEPS) - 1) << (i * LED_BLINK_STEPS);
     }
+    if (!LED_QueuePattern(led, bits, (uint8_t) (cnt * LED_BLINK_STEPS))) return false;
+    if (cnt & 1) sLeds[led].baseOn = on;
     return true;
-}
\ No newline at end of file
+}
+
+bool LED_SetState(LEDType led, LEDStateType state, bool set)
+{
+    if (led >= NUM_OF_LEDS || state >= NUM_OF_LED_STATES) return false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    LEDChannelType* pLed = &sLeds[led];
+    if (set) {
+        pLed->states |= (uint8_t) (1u << state);
+    } else {
+        pLed->states &= (uint8_t) ~(1u << state);
+    }
+    __set_PRIMASK(primask);
+    return true;
+}
@@ -40,8 +40,9 @@ THE SOFTWARE.
 
 #include "MPU9250.h"
 #include "MPU9250_def.h"
-#include "i2c.h"
+#include "imu_bus.h"
 #include "logging.h"
+#include "profiler.h"
 
 #define LOG_TAG ("MPU9250")
 
@@ -59,22 +60,67 @@ THE SOFTWARE.
 #define DEFAULT_ACC_FREQUENCY 1000 // hz
 #define DEFAULT_MAG_FREQUENCY 200 // hz
 
+// the AK8963 on the aux I2C master: 7 bit address, slave 0 reads ST1 to ST2
+// into EXT_SENS_DATA_00..07, slave 4 moves single bytes at boot
+#define AK8963_I2C_ADDRESS (MPU9250_RA_MAG_ADDRESS >> 1)
+#define AK8963_ST2_HOFL (0x08) // the sample overflowed
+#define MAG_AUX_READ_LEN (AK8963_ST2 - AK8963_ST1 + 1)
+#define MAG_AUX_TIMEOUT_MS (10) // a slave 4 transfer waits for the next sample
+
+// a DMP packet's quaternion squared in Q28 is within this of 1.0
+#define DMP_QUAT_MAG_SQ_ONE (1L << 28)
+#define DMP_QUAT_MAG_SQ_TOLERANCE (1L << 24)
+#define DMP_QUAT_MAG_SQ_MIN (DMP_QUAT_MAG_SQ_ONE - DMP_QUAT_MAG_SQ_TOLERANCE)
+#define DMP_QUAT_MAG_SQ_MAX (DMP_QUAT_MAG_SQ_ONE + DMP_QUAT_MAG_SQ_TOLERANCE)
+
+/*
+ * Struct
+ */
+
+// adjacent registers in the shadow, a load or verify reads each in one burst
+typedef struct {
+    uint8_t reg;
+    uint8_t len;
+} MPU9250ShadowBlockType;
+
+/*
+ * Static
+ */
+
+// in mShadow order, MPU9250_SHADOW_LEN registers in all
+static const MPU9250ShadowBlockType sShadowBlocks[] = {
+    { MPU9250_RA_SMPLRT_DIV, 5 },  // to ACCEL_CONFIG2
+    { MPU9250_RA_FIFO_EN, 2 },     // and I2C_MST_CTRL
+    { MPU9250_RA_INT_PIN_CFG, 2 }, // and INT_ENABLE
+    { MPU9250_RA_USER_CTRL, 2 },   // and PWR_MGMT_1
+};
+#define NUM_OF_SHADOW_BLOCKS (sizeof(sShadowBlocks) / sizeof(sShadowBlocks[0]))
+
+static const int sProfileGetRotation = Profiler_Register("MPU9250::getRotation");
+static const int sProfileGetMotion6 = Profiler_Register("MPU9250::getMotion6");
+
 /** Default constructor, uses default I2C address.
  * @see MPU9250_DEFAULT_ADDRESS
  */
 
 MPU9250::MPU9250() :
-    devAddr(MPU9250_DEFAULT_ADDRESS),
-    ID(0),
+    mGyroSensitivity(DEFAULT_GYRO_SENSITIVITY),
+    mAccSensitivity(DEFAULT_ACC_SENSITIVITY),
+    mMagSensitivity(DEFAULT_MAG_SENSITIVITY),
     mGyroFreq(DEFAULT_GYRO_FREQUENCY),
     mAccFreq(DEFAULT_ACC_FREQUENCY),
     mMagFreq(DEFAULT_MAG_FREQUENCY),
     mGyroRange(DEFAULT_GYRO_RANGE),
     mAccRange(DEFAULT_ACC_RANGE),
     mMagRange(DEFAULT_MAG_RANGE),
-    mMagSensitivity(DEFAULT_MAG_SENSITIVITY),
-    mAccSensitivity(DEFAULT_ACC_SENSITIVITY),
-    mGyroSensitivity(DEFAULT_GYRO_SENSITIVITY)
+    devAddr(MPU9250_DEFAULT_ADDRESS),
+    ID(0),
+    mFifoResetCtrl(0),
+    mShadowDirty(0),
+    mShadowValid(false),
+    mShadowBatch(false),
+    mShadowVerify(UAV_Debug != 0),
+    mMagAux(false)
 {
     for (int i=0 ; i < 14; ++i) {
       buffer[i] = 0;
@@ -82,6 +128,9 @@ MPU9250::MPU9250() :
     for (int i = 0; i < 3; ++i) {
         mMagSensAdjData[i] = 1.0f; // default value is 128.
     }
+    for (int i = 0; i < MPU9250_SHADOW_LEN; ++i) {
+        mShadow[i] = 0;
+    }
 }
 
 /** Specific address constructor.
@@ -102,27 +151,274 @@ MPU9250::MPU9250() :
  * the clock source to use the X Gyro for reference, which is slightly better than
  * the default internal clock source.
  */
-void MPU9250::Init()
+void MPU9250::Init(bool magAux, uint8_t accDlpfMode)
 {
+    mMagAux = magAux;
+    // the registers are read once, the changed ones written together at the end
+    beginConfig();
     //set clock source
     setClockSource(MPU9250_CLOCK_PLL_XGYRO);
     //set gyro output data rate to 1000hz. Low pass filter bandwidth 184Hz
     setGyroDLPFMode(1);
     //set gyro range to 2000dps.
     setFullScaleGyroRange(MPU9250_GYRO_FS_2000);
-    //set accel output data rate to 1000hz. Low pass filter bandwidth 21.2Hz
-    setAccDLPFMode(4);
+    //set accel output data rate to 1000hz. Low pass filter bandwidth 21.2Hz by default
+    setAccDLPFMode(accDlpfMode);
     //set accel range to 2g
     setFullScaleAccelRange(MPU9250_ACCEL_FS_2);
     //setSleepEnabled(false); // thanks to Jack Elston for pointing this one out!
-    //set i2c bypass enable pin to true to access magnetometer and configure interrupt
-    setBypassEnable(MPU9250_BYPASS_ENABLE);
+    configInterface();
+    configMagPath();
+    if (!commitConfig()) {
+        LOGE("configuration failed\r\n");
+    }
+    startMag();
+}
+
+/** Take the chip over after the InvenSense DMP driver (inv_mpu.c) set it up.
+ * The sensor settings and the DMP stay as the driver left them; the INT pin
+ * goes back to active high and the magnetometer, which the driver powered
+ * down, is set up again on the path Init() chose.
+ * @return false if a register write failed
+ */
+bool MPU9250::adoptDmpConfig()
+{
+    // whatever the shadow held is stale
+    invalidateShadow();
+    beginConfig();
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_INT_PIN_CFG, &temp);
+    writeReg(MPU9250_RA_INT_PIN_CFG, temp & ~(1 << MPU9250_INTCFG_INT_LEVEL_BIT));
+    // the driver's slave 1 starts a single measurement on every sample, which
+    // would knock the continuous mode out again
+    writeReg(MPU9250_RA_I2C_SLV1_CTRL, 0);
+    configInterface();
+    configMagPath();
+    if (!commitConfig()) {
+        LOGE("configuration failed\r\n");
+        return false;
+    }
+    startMag();
+    return true;
+}
+
+/** Reset every register to its power-on value, e.g. after the DMP driver
+ * left the chip half set up. Init() configures it again.
+ */
+bool MPU9250::reset()
+{
+    uint8_t temp = 1 << MPU9250_PWR1_DEVICE_RESET_BIT;
+    bool ok = ImuBus_Write(devAddr, MPU9250_RA_PWR_MGMT_1, &temp, 1);
+    invalidateShadow();
+    // the chip does not answer while it resets
+    HAL_Delay(100);
+    return ok;
+}
+
+// on SPI, USER_CTRL.I2C_IF_DIS keeps the chip from taking SPI traffic for
+// I2C; a reset clears it, so every Init() sets it again. Inside a
+// beginConfig()/commitConfig() batch.
+void MPU9250::configInterface()
+{
+    if (ImuBus_GetBackend()->bus != IMU_BUS_SPI) return;
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_USER_CTRL, &temp);
+    writeReg(MPU9250_RA_USER_CTRL, temp | (1 << MPU9250_USERCTRL_I2C_IF_DIS_BIT));
+}
+
+// INT_PIN_CFG, I2C_MST_CTRL and USER_CTRL for the magnetometer path, inside
+// a beginConfig()/commitConfig() batch
+void MPU9250::configMagPath()
+{
+    if (mMagAux) {
+        // the I2C master owns the aux bus at 400 kHz, the bypass stays off;
+        // data-ready waits until the master has read the magnetometer
+        uint8_t temp = 0;
+        readReg(MPU9250_RA_INT_PIN_CFG, &temp);
+        writeReg(MPU9250_RA_INT_PIN_CFG, temp & ~MPU9250_BYPASS_ENABLE);
+        writeReg(MPU9250_RA_I2C_MST_CTRL, (1 << MPU9250_WAIT_FOR_ES_BIT) | (1 << MPU9250_I2C_MST_P_NSR_BIT) | MPU9250_CLOCK_DIV_400);
+        readReg(MPU9250_RA_USER_CTRL, &temp);
+        writeReg(MPU9250_RA_USER_CTRL, temp | (1 << MPU9250_USERCTRL_I2C_MST_EN_BIT));
+    } else {
+        //set i2c bypass enable pin to true to access magnetometer and configure interrupt
+        setBypassEnable(MPU9250_BYPASS_ENABLE);
+    }
+}
+
+// the AK8963 to 16 bit continuous measurement, after commitConfig()
+void MPU9250::startMag()
+{
+    // the bypass or the master takes a moment before the magnetometer answers
+    HAL_Delay(10);
     // get mag sensitivity adjust data
     GetMagSensitivityAdjData(mMagSensAdjData);
     // set mag to 16 bit
     setMagMeasOutputBit(MPU9250_MAG_16BIT_OUTPUT);
     //set mag to continuous measurement mode
     setMagContMeasMode(MPU9250_MAG_CONTINUOUS_MODE_200HZ);
+    if (mMagAux && !startMagAux()) {
+        LOGE("failed to start the aux magnetometer read\r\n");
+    }
+}
+
+// Register shadow
+
+// mShadow entry of reg, -1 if the shadow does not hold it
+static int ShadowIndex(uint8_t reg)
+{
+    int index = 0;
+    for (int i = 0; i < (int) NUM_OF_SHADOW_BLOCKS; ++i) {
+        const MPU9250ShadowBlockType* pBlk = &sShadowBlocks[i];
+        if (reg >= pBlk->reg && reg < pBlk->reg + pBlk->len) return index + (reg - pBlk->reg);
+        index += pBlk->len;
+    }
+    return -1;
+}
+
+// register of the mShadow entry
+static uint8_t ShadowReg(int index)
+{
+    for (int i = 0; i < (int) NUM_OF_SHADOW_BLOCKS; ++i) {
+        const MPU9250ShadowBlockType* pBlk = &sShadowBlocks[i];
+        if (index < pBlk->len) return pBlk->reg + index;
+        index -= pBlk->len;
+    }
+    return 0;
+}
+
+/** Read every shadowed register from the chip, one burst per block.
+ * Dirty registers that were not committed are dropped.
+ * @return false if a read failed, the shadow is invalid then
+ */
+bool MPU9250::loadShadow() {
+    mShadowValid = false;
+    mShadowDirty = 0;
+    int index = 0;
+    for (int i = 0; i < (int) NUM_OF_SHADOW_BLOCKS; ++i) {
+        const MPU9250ShadowBlockType* pBlk = &sShadowBlocks[i];
+        if (!ImuBus_Read(devAddr, pBlk->reg, &mShadow[index], pBlk->len)) {
+            LOGE("shadow load failed at reg 0x%x\r\n", pBlk->reg);
+            return false;
+        }
+        index += pBlk->len;
+    }
+    mShadowValid = true;
+    return true;
+}
+
+void MPU9250::invalidateShadow() {
+    mShadowValid = false;
+    mShadowDirty = 0;
+}
+
+/** Hold back setter writes of shadowed registers until commitConfig().
+ */
+void MPU9250::beginConfig() {
+    mShadowBatch = true;
+}
+
+/** Write the registers changed since beginConfig(), adjacent ones in one
+ * burst, then verify them if setShadowVerify(true).
+ * @return false if a write failed or the chip disagrees with the shadow
+ */
+bool MPU9250::commitConfig() {
+    mShadowBatch = false;
+    bool ok = true;
+    int index = 0;
+    for (int i = 0; i < (int) NUM_OF_SHADOW_BLOCKS; ++i) {
+        int end = index + sShadowBlocks[i].len;
+        while (index < end) {
+            if (!(mShadowDirty & (1 << index))) {
+                ++index;
+                continue;
+            }
+            int last = index;
+            while (last + 1 < end && (mShadowDirty & (1 << (last + 1)))) ++last;
+            if (!writeShadowRun(index, last)) ok = false;
+            index = last + 1;
+        }
+    }
+    if (ok && mShadowVerify) ok = verifyShadow();
+    return ok;
+}
+
+/** Compare the shadow with the chip and log every register that differs.
+ * @return false if a register differs or a read failed
+ */
+bool MPU9250::verifyShadow() {
+    if (!mShadowValid) return loadShadow();
+    bool ok = true;
+    int index = 0;
+    uint8_t chip[MPU9250_SHADOW_LEN];
+    for (int i = 0; i < (int) NUM_OF_SHADOW_BLOCKS; ++i) {
+        const MPU9250ShadowBlockType* pBlk = &sShadowBlocks[i];
+        if (!ImuBus_Read(devAddr, pBlk->reg, &chip[index], pBlk->len)) {
+            LOGE("shadow verify failed to read reg 0x%x\r\n", pBlk->reg);
+            invalidateShadow();
+            return false;
+        }
+        for (int j = 0; j < pBlk->len; ++j, ++index) {
+            if (chip[index] == mShadow[index] || (mShadowDirty & (1 << index))) continue;
+            LOGE("reg 0x%x is 0x%x, shadow 0x%x\r\n", pBlk->reg + j, chip[index], mShadow[index]);
+            mShadow[index] = chip[index];
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void MPU9250::setShadowVerify(bool verify) {
+    mShadowVerify = verify;
+}
+
+// a shadowed register from the copy, anything else from the chip
+bool MPU9250::readReg(uint8_t reg, uint8_t* pValue) {
+    int index = ShadowIndex(reg);
+    if (index < 0) return ImuBus_Read(devAddr, reg, pValue, 1);
+    if (!mShadowValid && !loadShadow()) return false;
+    *pValue = mShadow[index];
+    return true;
+}
+
+// a shadowed register only goes to the chip if it changed, and not before
+// commitConfig() in a batch
+bool MPU9250::writeReg(uint8_t reg, uint8_t value) {
+    int index = ShadowIndex(reg);
+    if (index < 0) return ImuBus_Write(devAddr, reg, &value, 1);
+    if (!mShadowValid && !loadShadow()) return false;
+    if (mShadow[index] == value && !(mShadowDirty & (1 << index))) return true;
+    mShadow[index] = value;
+    mShadowDirty |= (1 << index);
+    if (mShadowBatch) return true;
+    return writeShadowRun(index, index);
+}
+
+// entries first to last of one block, in one burst
+bool MPU9250::writeShadowRun(int first, int last) {
+    uint8_t reg = ShadowReg(first);
+    uint16_t len = (uint16_t) (last - first + 1);
+    if (!ImuBus_Write(devAddr, reg, &mShadow[first], len)) {
+        // the chip's value is unknown now
+        LOGE("write of reg 0x%x failed\r\n", reg);
+        invalidateShadow();
+        return false;
+    }
+    for (int i = first; i <= last; ++i) {
+        mShadowDirty &= ~(1 << i);
+    }
+    return true;
+}
+
+// SMPLRT_DIV register
+
+/** Set gyroscope sample rate divider.
+ * Sample Rate = Internal Sample Rate / (1 + SMPLRT_DIV), where the internal
+ * rate is 1kHz with the DLPF enabled. Data-ready follows the sample rate.
+ * @param rate New sample rate divider
+ * @see MPU9250_RA_SMPLRT_DIV
+ */
+void MPU9250::setRate(uint8_t rate) {
+    writeReg(MPU9250_RA_SMPLRT_DIV, rate);
 }
 
 // CONFIG register
@@ -156,9 +452,9 @@ void MPU9250::Init()
  * @see MPU9250_CFG_DLPF_CFG_LENGTH
  */
 uint8_t MPU9250::getGyroDLPFMode() {
-    uint16_t dataSizeToRead = 1;
-    I2C_Read(devAddr, MPU9250_RA_CONFIG, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
-    return buffer[0];
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_CONFIG, &temp);
+    return temp;
 }
 
 /** Set digital low-pass filter configuration.
@@ -170,11 +466,11 @@ uint8_t MPU9250::getGyroDLPFMode() {
  * @see MPU9250_CFG_DLPF_CFG_LENGTH
  */
 void MPU9250::setGyroDLPFMode(uint8_t mode) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_CONFIG, I2C_MEMADD_SIZE_8BIT, (uint8_t*)buffer, dataSize);
-    uint8_t temp = (buffer[0] & 0xF8);
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_CONFIG, &temp)) return;
+    temp = (temp & 0xF8);
     temp = (temp | mode);
-    I2C_Write(devAddr, MPU9250_RA_CONFIG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_CONFIG, temp);
 }
 
 // GYRO_CONFIG register
@@ -197,9 +493,9 @@ void MPU9250::setGyroDLPFMode(uint8_t mode) {
  * @see MPU9250_GCONFIG_FS_SEL_LENGTH
  */
 uint8_t MPU9250::getFullScaleGyroRange() {
-    uint16_t dataSizeToRead = 1;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_CONFIG, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
-    return buffer[0];
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_GYRO_CONFIG, &temp);
+    return temp;
 }
 /** Set full-scale gyroscope range.
  * @param range New full-scale gyroscope range value
@@ -210,14 +506,13 @@ uint8_t MPU9250::getFullScaleGyroRange() {
  * @see MPU9250_GCONFIG_FS_SEL_LENGTH
  */
 void MPU9250::setFullScaleGyroRange(uint8_t range) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_CONFIG, I2C_MEMADD_SIZE_8BIT, buffer, dataSize);
-    uint8_t temp = (buffer[0] & 0xE7);
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_GYRO_CONFIG, &temp)) return;
+    temp = (temp & 0xE7);
     temp = (temp | (range<<3));
     //set fchoice_b to 00 as well
     temp = (temp & 0xFC);
-    dataSize = 1;
-    I2C_Write(devAddr, MPU9250_RA_GYRO_CONFIG,I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_GYRO_CONFIG, temp);
 
     switch(range) {
     case MPU9250_GYRO_FS_250:
@@ -255,9 +550,9 @@ void MPU9250::setFullScaleGyroRange(uint8_t range) {
  * @see MPU9250_ACONFIG_AFS_SEL_LENGTH
  */
 uint8_t MPU9250::getFullScaleAccelRange() {
-    uint16_t dataSizeToRead = 1;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_CONFIG, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
-    return buffer[0];
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_ACCEL_CONFIG, &temp);
+    return temp;
 }
 
 /** Set full-scale accelerometer range.
@@ -265,11 +560,11 @@ uint8_t MPU9250::getFullScaleAccelRange() {
  * @see getFullScaleAccelRange()
  */
 void MPU9250::setFullScaleAccelRange(uint8_t range) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_CONFIG, I2C_MEMADD_SIZE_8BIT, buffer, dataSize);
-    uint8_t temp = (buffer[0] & 0xE7);
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_ACCEL_CONFIG, &temp)) return;
+    temp = (temp & 0xE7);
     temp = (temp | (range<<3));
-    I2C_Write(devAddr, MPU9250_RA_ACCEL_CONFIG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_ACCEL_CONFIG, temp);
 
     switch(range) {
     case MPU9250_ACCEL_FS_2:
@@ -289,20 +584,19 @@ void MPU9250::setFullScaleAccelRange(uint8_t range) {
 
 //ACCEL_CONFIG2 register
 uint8_t MPU9250::getAccDLPFMode() {
-    uint16_t dataSizeToRead = 1;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_CONFIG2, I2C_MEMADD_SIZE_8BIT, (uint8_t *)buffer, dataSizeToRead);
-    return buffer[0];
+    uint8_t temp = 0;
+    readReg(MPU9250_RA_ACCEL_CONFIG2, &temp);
+    return temp;
 }
 
 void MPU9250::setAccDLPFMode(uint8_t bandwidth) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_CONFIG2, I2C_MEMADD_SIZE_8BIT, (uint8_t *)buffer, dataSize);
-    uint8_t temp = (buffer[0] & 0xF8);
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_ACCEL_CONFIG2, &temp)) return;
+    temp = (temp & 0xF8);
     temp = (temp | bandwidth);
     //set fchoice_b to 0
     temp = (temp & 0xF7);
-    dataSize = 1;
-    I2C_Write(devAddr, MPU9250_RA_ACCEL_CONFIG2,I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_ACCEL_CONFIG2, temp);
 }
 
 // ACCEL_*OUT_* registers
@@ -324,21 +618,28 @@ void MPU9250::setAccDLPFMode(uint8_t bandwidth) {
  * @see MPU9250_RA_ACCEL_XOUT_H
  */
 void MPU9250::getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz, int16_t* mx, int16_t* my, int16_t* mz) {
+    if (mMagAux) {
+        // one burst, the mag part as the I2C master last read it
+        uint8_t data[MPU9250_MOTION9_LEN];
+        if (!readMotion9(data)) return;
+        parseMotion9(data, ax, ay, az, gx, gy, gz, mx, my, mz);
+        return;
+    }
 
     //get accel and gyro
     getMotion6(ax, ay, az, gx, gy, gz);
 
     //read mag
     uint8_t temp =0x02;
-    I2C_Write(devAddr, MPU9250_RA_INT_PIN_CFG,I2C_MEMADD_SIZE_8BIT, &temp, 1);
+    writeReg(MPU9250_RA_INT_PIN_CFG, temp);
     //I2Cdev::writeByte(devAddr, MPU9250_RA_INT_PIN_CFG, 0x02); //set i2c bypass enable pin to true to access magnetometer
     HAL_Delay(10);
     temp = 0x01;
-    I2C_Write(MPU9250_RA_MAG_ADDRESS, 0x0A, I2C_MEMADD_SIZE_8BIT, &temp, 1);
+    ImuBus_Write(MPU9250_RA_MAG_ADDRESS, 0x0A, &temp, 1);
     //I2Cdev::writeByte(MPU9250_RA_MAG_ADDRESS, 0x0A, 0x01); //enable the magnetometer
     HAL_Delay(10);
     uint16_t dataSizeToRead = 6;
-    I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_HXL, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(MPU9250_RA_MAG_ADDRESS, AK8963_HXL, buffer, dataSizeToRead);
     //I2Cdev::readBytes(MPU9250_RA_MAG_ADDRESS, MPU9250_RA_MAG_XOUT_L, 6, buffer);
     *mx = (((int16_t)buffer[1]) << 8) | buffer[0];
     *my = (((int16_t)buffer[3]) << 8) | buffer[2];
@@ -357,16 +658,106 @@ void MPU9250::getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int
  * @see MPU9250_RA_ACCEL_XOUT_H
  */
 void MPU9250::getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
-    uint16_t dataSizeToRead = 14;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ProfilerScope profile(sProfileGetMotion6);
+    // ACCEL_XOUT_H to GYRO_ZOUT_L in one burst, temperature in between
+    uint16_t dataSizeToRead = MPU9250_MOTION6_LEN;
+    ImuBus_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_ACCEL_XOUT_H, 14, buffer);
-    *ax = (((int16_t)buffer[0]) << 8) | buffer[1];
-    *ay = (((int16_t)buffer[2]) << 8) | buffer[3];
-    *az = (((int16_t)buffer[4]) << 8) | buffer[5];
-    *gx = (((int16_t)buffer[8]) << 8) | buffer[9];
-    *gy = (((int16_t)buffer[10]) << 8) | buffer[11];
-    *gz = (((int16_t)buffer[12]) << 8) | buffer[13];
+    parseMotion6(buffer, ax, ay, az, gx, gy, gz);
+}
+
+/** Start a 6-axis burst read without waiting for it.
+ * The transfer is queued on I2C1, cb reports from interrupt context when
+ * pData holds the registers from ACCEL_XOUT_H on.
+ * @param pData MPU9250_MOTION6_LEN bytes, untouched until cb
+ * @return false if the I2C queue is full, cb is not called then
+ * @see parseMotion6()
+ */
+bool MPU9250::readMotion6Async(uint8_t* pData, ImuBusDoneCb cb, void* pArg) {
+    return ImuBus_ReadAsync(devAddr, MPU9250_RA_ACCEL_XOUT_H, pData, MPU9250_MOTION6_LEN, cb, pArg);
+}
+
+/** Decode a 6-axis burst as read by getMotion6() or readMotion6Async().
+ * @see getMotion6()
+ */
+void MPU9250::parseMotion6(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
+    *ax = (((int16_t)pData[0]) << 8) | pData[1];
+    *ay = (((int16_t)pData[2]) << 8) | pData[3];
+    *az = (((int16_t)pData[4]) << 8) | pData[5];
+    *gx = (((int16_t)pData[8]) << 8) | pData[9];
+    *gy = (((int16_t)pData[10]) << 8) | pData[11];
+    *gz = (((int16_t)pData[12]) << 8) | pData[13];
+}
+
+/** Decode one FIFO record, MPU9250_FIFO_MOTION6_LEN bytes as read by
+ * readFifoAsync(). Same as the burst but without the temperature.
+ * @see enableFifo()
+ */
+void MPU9250::parseFifoMotion6(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
+    *ax = (((int16_t)pData[0]) << 8) | pData[1];
+    *ay = (((int16_t)pData[2]) << 8) | pData[3];
+    *az = (((int16_t)pData[4]) << 8) | pData[5];
+    *gx = (((int16_t)pData[6]) << 8) | pData[7];
+    *gy = (((int16_t)pData[8]) << 8) | pData[9];
+    *gz = (((int16_t)pData[10]) << 8) | pData[11];
+}
+
+/** Decode one DMP packet, MPU9250_FIFO_DMP_LEN bytes as read by
+ * readFifoAsync(): the quaternion w, x, y, z in Q30, raw accel and the DMP's
+ * calibrated gyro, then the gesture word, which is not used.
+ * @return false if the quaternion is not of unit length, the packet is not
+ *         one then and the FIFO is out of step
+ * @see enableFifo()
+ */
+bool MPU9250::parseFifoDmp(const uint8_t* pData, int32_t* pQuat, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
+    // |q|^2 in Q28 from Q14 parts, as dmp_read_fifo() checks it
+    int32_t magSq = 0;
+    for (int i = 0; i < 4; ++i) {
+        pQuat[i] = (int32_t) (((uint32_t) pData[4 * i] << 24) | ((uint32_t) pData[4 * i + 1] << 16) |
+                              ((uint32_t) pData[4 * i + 2] << 8) | pData[4 * i + 3]);
+        int32_t q14 = pQuat[i] >> 16;
+        magSq += q14 * q14;
+    }
+    parseFifoMotion6(&pData[16], ax, ay, az, gx, gy, gz);
+    return magSq >= DMP_QUAT_MAG_SQ_MIN && magSq <= DMP_QUAT_MAG_SQ_MAX;
+}
+
+/** Read ACCEL_XOUT_H to EXT_SENS_DATA_07 on the IMU bus queue, nine axes of
+ * one sample when the magnetometer is on the aux I2C master.
+ * @param pData MPU9250_MOTION9_LEN bytes, for parseMotion9() once cb
+ *              reported success
+ * @return false without the aux magnetometer or if the queue is full, cb is
+ *         not called then
+ */
+bool MPU9250::readMotion9Async(uint8_t* pData, ImuBusDoneCb cb, void* pArg) {
+    if (!mMagAux) return false;
+    return ImuBus_ReadAsync(devAddr, MPU9250_RA_ACCEL_XOUT_H, pData, MPU9250_MOTION9_LEN, cb, pArg);
 }
+
+/** The same burst as readMotion9Async(), blocking. */
+bool MPU9250::readMotion9(uint8_t* pData) {
+    if (!mMagAux) return false;
+    return ImuBus_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, pData, MPU9250_MOTION9_LEN);
+}
+
+// ST1, HXL to HZH, ST2 as slave 0 copied them
+static bool ParseMagAux(const uint8_t* pExt, int16_t* mx, int16_t* my, int16_t* mz) {
+    *mx = (((int16_t)pExt[2]) << 8) | pExt[1];
+    *my = (((int16_t)pExt[4]) << 8) | pExt[3];
+    *mz = (((int16_t)pExt[6]) << 8) | pExt[5];
+    return !(pExt[7] & AK8963_ST2_HOFL);
+}
+
+/** Decode the burst readMotion9Async() or getMotion9() read.
+ * @return false if the magnetometer part is not valid, the AK8963
+ *         overflowed; accel and gyro are decoded anyway
+ */
+bool MPU9250::parseMotion9(const uint8_t* pData, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz,
+                           int16_t* mx, int16_t* my, int16_t* mz) {
+    parseMotion6(pData, ax, ay, az, gx, gy, gz);
+    return ParseMagAux(&pData[MPU9250_MOTION6_LEN], mx, my, mz);
+}
+
 /** Get 3-axis accelerometer readings.
  * These registers store the most recent accelerometer measurements.
  * Accelerometer measurements are written to these registers at the Sample Rate
@@ -405,7 +796,7 @@ void MPU9250::getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int
  */
 void MPU9250::getAcceleration(int16_t* x, int16_t* y, int16_t* z) {
     uint16_t dataSizeToRead = 6;
-    if (!I2C_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead)) {
+    if (!ImuBus_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, buffer, dataSizeToRead)) {
         return;
     }
     //I2Cdev::readBytes(devAddr, MPU9250_RA_ACCEL_XOUT_H, 6, buffer);
@@ -421,7 +812,7 @@ void MPU9250::getAcceleration(int16_t* x, int16_t* y, int16_t* z) {
  */
 int16_t MPU9250::getAccelerationX() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_ACCEL_XOUT_H, buffer, dataSizeToRead);
   //I2Cdev::readBytes(devAddr, MPU9250_RA_ACCEL_XOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -432,7 +823,7 @@ int16_t MPU9250::getAccelerationX() {
  */
 int16_t MPU9250::getAccelerationY() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_YOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_ACCEL_YOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_ACCEL_YOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -443,7 +834,7 @@ int16_t MPU9250::getAccelerationY() {
  */
 int16_t MPU9250::getAccelerationZ() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_ACCEL_ZOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_ACCEL_ZOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_ACCEL_ZOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -456,7 +847,7 @@ int16_t MPU9250::getAccelerationZ() {
  */
 int16_t MPU9250::getTemperature() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_TEMP_OUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_TEMP_OUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_TEMP_OUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -496,8 +887,9 @@ int16_t MPU9250::getTemperature() {
  * @see MPU9250_RA_GYRO_XOUT_H
  */
 void MPU9250::getRotation(int16_t* x, int16_t* y, int16_t* z) {
+    ProfilerScope profile(sProfileGetRotation);
     uint16_t dataSizeToRead = 6;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_XOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_GYRO_XOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_GYRO_XOUT_H, 6, buffer);
     *x = (((int16_t)buffer[0]) << 8) | buffer[1];
     *y = (((int16_t)buffer[2]) << 8) | buffer[3];
@@ -510,7 +902,7 @@ void MPU9250::getRotation(int16_t* x, int16_t* y, int16_t* z) {
  */
 int16_t MPU9250::getRotationX() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_XOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_GYRO_XOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_GYRO_XOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -521,7 +913,7 @@ int16_t MPU9250::getRotationX() {
  */
 int16_t MPU9250::getRotationY() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_YOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_GYRO_YOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_GYRO_YOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -532,7 +924,7 @@ int16_t MPU9250::getRotationY() {
  */
 int16_t MPU9250::getRotationZ() {
     uint16_t dataSizeToRead = 2;
-    I2C_Read(devAddr, MPU9250_RA_GYRO_ZOUT_H, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(devAddr, MPU9250_RA_GYRO_ZOUT_H, buffer, dataSizeToRead);
     //I2Cdev::readBytes(devAddr, MPU9250_RA_GYRO_ZOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
@@ -546,12 +938,11 @@ int16_t MPU9250::getRotationZ() {
  * @see MPU9250_PWR1_SLEEP_BIT
  */
 void MPU9250::setSleepEnabled(bool enabled) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_PWR_MGMT_1, I2C_MEMADD_SIZE_8BIT, buffer, dataSize);
-    uint8_t temp = (buffer[0] & 0xBF);
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_PWR_MGMT_1, &temp)) return;
+    temp = (temp & 0xBF);
     temp = (temp | (enabled<<6));
-    dataSize = 1;
-    I2C_Write(devAddr, MPU9250_RA_PWR_MGMT_1,I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_PWR_MGMT_1, temp);
     //I2Cdev::writeBit(devAddr, MPU9250_RA_PWR_MGMT_1, MPU9250_PWR1_SLEEP_BIT, enabled);
 }
 
@@ -586,12 +977,11 @@ void MPU9250::setSleepEnabled(bool enabled) {
  * @see MPU9250_PWR1_CLKSEL_LENGTH
  */
 void MPU9250::setClockSource(uint8_t source) {
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_PWR_MGMT_1, I2C_MEMADD_SIZE_8BIT, buffer, dataSize);
-    uint8_t temp = ((buffer[0]) & (0xF8));
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_PWR_MGMT_1, &temp)) return;
+    temp = (temp & 0xF8);
     temp = (temp | source);
-    dataSize = 1;
-    I2C_Write(devAddr, MPU9250_RA_PWR_MGMT_1, I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_PWR_MGMT_1, temp);
     //I2Cdev::writeBits(devAddr, MPU9250_RA_PWR_MGMT_1, MPU9250_PWR1_CLKSEL_BIT, MPU9250_PWR1_CLKSEL_LENGTH, source);
 }
 
@@ -606,73 +996,73 @@ void MPU9250::setClockSource(uint8_t source) {
 
 uint8_t MPU9250::getDeviceID(){
     uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_WHO_AM_I, I2C_MEMADD_SIZE_8BIT, &ID, dataSize);
+    ImuBus_Read(devAddr, MPU9250_RA_WHO_AM_I, &ID, dataSize);
     return ID;
 }
 
 bool MPU9250::setBypassEnable(uint8_t enable){
-    uint16_t dataSize = 1;
     uint8_t temp;
-    if (!I2C_Read(devAddr, MPU9250_RA_INT_PIN_CFG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
+    if (!readReg(MPU9250_RA_INT_PIN_CFG, &temp)) return false;
     temp = (temp | enable);
-    dataSize = 1;
-    if (!I2C_Write(devAddr, MPU9250_RA_INT_PIN_CFG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
-    HAL_Delay(10);
+    if (!writeReg(MPU9250_RA_INT_PIN_CFG, temp)) return false;
+    // in a batch the caller waits after commitConfig()
+    if (!mShadowBatch) HAL_Delay(10);
     return true;
 }
 
 bool MPU9250::configInterrupt(MPU9250IntConfigType* pConfig)
 {
     if (!pConfig) return false;
-    uint16_t dataSize = 1;
     uint8_t temp;
-    if (!I2C_Read(devAddr, MPU9250_RA_INT_PIN_CFG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
+    if (!readReg(MPU9250_RA_INT_PIN_CFG, &temp)) return false;
     temp |= pConfig->activeLvl;
     temp |= pConfig->intMode;
     temp |= pConfig->latch;
     temp |= pConfig->clearMethod;
-    dataSize = 1;
-    if (!I2C_Write(devAddr, MPU9250_RA_INT_PIN_CFG, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
+    if (!writeReg(MPU9250_RA_INT_PIN_CFG, temp)) return false;
     return true;
 }
 
 void MPU9250::enableInterrupt(){
-    uint16_t dataSize = 1;
-    I2C_Read(devAddr, MPU9250_RA_INT_ENABLE, I2C_MEMADD_SIZE_8BIT, buffer, dataSize);
-    uint8_t temp = ((buffer[0]) & (0xA6)); // 0xA6 = 10100110 -> clear bits 6,4,3,0
+    uint8_t temp = 0;
+    if (!readReg(MPU9250_RA_INT_ENABLE, &temp)) return;
+    temp = (temp & 0xA6); // 0xA6 = 10100110 -> clear bits 6,4,3,0
     temp = (temp | 0x01); //set last bit to enable data ready interrupt
-    dataSize = 1;
-    I2C_Write(devAddr, MPU9250_RA_INT_ENABLE,I2C_MEMADD_SIZE_8BIT, &temp, dataSize);
+    writeReg(MPU9250_RA_INT_ENABLE, temp);
 }
 
 bool MPU9250::setMagMeasOutputBit(uint8_t outputBit)
 {
     uint16_t dataSize = 1;
-    if (!I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_CNTL, I2C_MEMADD_SIZE_8BIT, buffer, dataSize)) return false;
+    if (!magRead(AK8963_CNTL, buffer, dataSize)) return false;
     uint8_t temp = ((buffer[0]) & (0x1F)); // clear bit 7,6,5,
     temp = (temp | outputBit);
-    if (!I2C_Write(MPU9250_RA_MAG_ADDRESS, AK8963_CNTL, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
+    if (!magWrite(AK8963_CNTL, temp)) return false;
     return true;
 }
 
 bool MPU9250::setMagContMeasMode(uint8_t mode){
     uint16_t dataSize = 1;
-    if (!I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_CNTL, I2C_MEMADD_SIZE_8BIT, buffer, dataSize)) return false;
+    if (!magRead(AK8963_CNTL, buffer, dataSize)) return false;
     uint8_t temp = ((buffer[0]) & (0x1F)); // clear bit 7,6,5,
     temp = (temp | mode);
-    if (!I2C_Write(MPU9250_RA_MAG_ADDRESS, AK8963_CNTL, I2C_MEMADD_SIZE_8BIT, &temp, dataSize)) return false;
+    if (!magWrite(AK8963_CNTL, temp)) return false;
     return true;
 }
 
 void MPU9250::getMagData(int16_t* mx,int16_t* my, int16_t* mz){
+    if (mMagAux) {
+        readMag(mx, my, mz);
+        return;
+    }
     uint16_t dataSizeToRead = 6;
-    I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_HXL, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+    ImuBus_Read(MPU9250_RA_MAG_ADDRESS, AK8963_HXL, buffer, dataSizeToRead);
     //I2C_M.readBytes(MPU9250_RA_MAG_ADDRESS, MPU9250_RA_MAG_XOUT_L, 6, buffer_m);
 
     /*read ST2 register as required by magnetometer.Otherwise the data is protected and won't be updated.*/
     uint8_t temp;
     dataSizeToRead = 1;
-    I2C_Read(MPU9250_RA_MAG_ADDRESS, 0x09, I2C_MEMADD_SIZE_8BIT, &temp, dataSizeToRead);
+    ImuBus_Read(MPU9250_RA_MAG_ADDRESS, 0x09, &temp, dataSizeToRead);
     //I2C_M.readByte(MPU9250_RA_MAG_ADDRESS, 0x09, &buffer_);
 
     *mx = ((int16_t)(buffer[1]) << 8) | buffer[0];
@@ -683,7 +1073,12 @@ void MPU9250::getMagData(int16_t* mx,int16_t* my, int16_t* mz){
 uint8_t MPU9250::getCompassDataReady(){
    uint8_t temp = 0;
    uint16_t dataSizeToRead = 1;
-   I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_ST1, I2C_MEMADD_SIZE_8BIT, &temp, dataSizeToRead);
+   // the aux master has released the sample long since, ST1 as it saw it
+   if (mMagAux) {
+       ImuBus_Read(devAddr, MPU9250_RA_EXT_SENS_DATA_00, &temp, dataSizeToRead);
+       return temp & 0x01;
+   }
+   ImuBus_Read(MPU9250_RA_MAG_ADDRESS, AK8963_ST1, &temp, dataSizeToRead);
    //I2C_M.readByte(MPU9250_RA_MAG_ADDRESS, MPU9250_RA_MAG_ST1, &buffer_);
    temp = (temp & 0x01);//remove the front 7 bits.
    return temp;
@@ -694,7 +1089,7 @@ bool MPU9250::GetMagSensitivityAdjData(float* pAdjData)
     if (!pAdjData) return false;
     uint16_t dataSizeToRead = 3;
     uint8_t rawAdjData[3];
-    if (!I2C_Read(MPU9250_RA_MAG_ADDRESS, AK8963_ASAX, I2C_MEMADD_SIZE_8BIT, rawAdjData, dataSizeToRead)) return false;
+    if (!magRead(AK8963_ASAX, rawAdjData, dataSizeToRead)) return false;
     LOGI("MagSensAdjData: %d %d %d\r\n", rawAdjData[0], rawAdjData[1], rawAdjData[2]);
     for (int i = 0; i < 3; ++i) {
         pAdjData[i] = (rawAdjData[i] - 128) * 0.5f / 128 + 1;
@@ -703,16 +1098,174 @@ bool MPU9250::GetMagSensitivityAdjData(float* pAdjData)
 }
 
 
+bool MPU9250::readMag(int16_t* mx, int16_t* my, int16_t* mz)
+{
+    if (mMagAux) {
+        uint8_t ext[MAG_AUX_READ_LEN];
+        if (!ImuBus_Read(devAddr, MPU9250_RA_EXT_SENS_DATA_00, ext, MAG_AUX_READ_LEN)) return false;
+        return ParseMagAux(ext, mx, my, mz);
+    }
+    if (getCompassDataReady() != 1) return false;
+    getMagData(mx, my, mz);
+    return true;
+}
+
+bool MPU9250::magRead(uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    if (!mMagAux) return ImuBus_Read(MPU9250_RA_MAG_ADDRESS, reg, pData, size);
+    for (uint16_t i = 0; i < size; ++i) {
+        if (!magAuxTransfer(reg + i, &pData[i], true)) return false;
+    }
+    return true;
+}
+
+bool MPU9250::magWrite(uint8_t reg, uint8_t value)
+{
+    if (!mMagAux) return ImuBus_Write(MPU9250_RA_MAG_ADDRESS, reg, &value, 1);
+    return magAuxTransfer(reg, &value, false);
+}
+
+/** Move one byte to or from the AK8963 on slave 4 of the aux I2C master. The
+ * master runs it at its next sample, so this waits up to MAG_AUX_TIMEOUT_MS;
+ * at boot only.
+ */
+bool MPU9250::magAuxTransfer(uint8_t reg, uint8_t* pValue, bool read)
+{
+    // I2C_SLV4_ADDR, _REG, _DO and _CTRL in one write, the enable last
+    uint8_t slv4[4];
+    slv4[0] = (read ? (1 << MPU9250_I2C_SLV4_RW_BIT) : 0) | AK8963_I2C_ADDRESS;
+    slv4[1] = reg;
+    slv4[2] = read ? 0 : *pValue;
+    slv4[3] = 1 << MPU9250_I2C_SLV4_EN_BIT;
+    if (!ImuBus_Write(devAddr, MPU9250_RA_I2C_SLV4_ADDR, slv4, sizeof(slv4))) return false;
+
+    uint32_t tickstart = HAL_GetTick();
+    for (;;) {
+        // I2C_SLV4_DI and I2C_MST_STATUS, which clears on read
+        uint8_t diStatus[2];
+        if (!ImuBus_Read(devAddr, MPU9250_RA_I2C_SLV4_DI, diStatus, sizeof(diStatus))) return false;
+        if (diStatus[1] & (1 << MPU9250_MST_I2C_SLV4_NACK_BIT)) {
+            LOGE("AK8963 NACKed reg 0x%x\r\n", reg);
+            return false;
+        }
+        if (diStatus[1] & (1 << MPU9250_MST_I2C_SLV4_DONE_BIT)) {
+            if (read) *pValue = diStatus[0];
+            return true;
+        }
+        if (HAL_GetTick() - tickstart > MAG_AUX_TIMEOUT_MS) {
+            LOGE("AK8963 reg 0x%x timed out\r\n", reg);
+            return false;
+        }
+        HAL_Delay(1);
+    }
+}
+
+/** Let slave 0 read ST1 to ST2 of the AK8963 into EXT_SENS_DATA_00..07 on
+ * every sample. Reading ST2 last releases the AK8963's next sample. Slave 1,
+ * which the DMP driver points at the AK8963's CNTL, is disabled.
+ */
+bool MPU9250::startMagAux()
+{
+    // I2C_SLV0_ADDR to I2C_SLV1_CTRL
+    uint8_t slv[6];
+    slv[0] = (1 << MPU9250_I2C_SLV_RW_BIT) | AK8963_I2C_ADDRESS;
+    slv[1] = AK8963_ST1;
+    slv[2] = (1 << MPU9250_I2C_SLV_EN_BIT) | MAG_AUX_READ_LEN;
+    slv[3] = 0;
+    slv[4] = 0;
+    slv[5] = 0;
+    return ImuBus_Write(devAddr, MPU9250_RA_I2C_SLV0_ADDR, slv, sizeof(slv));
+}
+
 void MPU9250::readIntStatus(){
    uint16_t dataSizeToRead = 1;
-   I2C_Read(devAddr, MPU9250_RA_DMP_INT_STATUS, I2C_MEMADD_SIZE_8BIT, buffer, dataSizeToRead);
+   ImuBus_Read(devAddr, MPU9250_RA_INT_STATUS, buffer, dataSizeToRead);
 }
 
 bool MPU9250::GetDataReady(uint8_t* pDataReady)
 {
     if (!pDataReady) return false;
    uint16_t dataSizeToRead = 1;
-   I2C_Read(devAddr, MPU9250_RA_DMP_INT_STATUS, I2C_MEMADD_SIZE_8BIT, pDataReady, dataSizeToRead);
+   ImuBus_Read(devAddr, MPU9250_RA_DMP_INT_STATUS, pDataReady, dataSizeToRead);
    *pDataReady &= 0x01; // clear all but last bit
     return true;
-}
\ No newline at end of file
+}
+
+/** Write accel and gyro to the FIFO at the sample rate, or stop it.
+ * The FIFO is reset in the same write, so it starts empty. Each sample adds
+ * MPU9250_FIFO_MOTION6_LEN bytes; once MPU9250_FIFO_SIZE bytes are in, the
+ * oldest are overwritten and INT_STATUS flags FIFO_OFLOW.
+ * With dmp the sensors stay out of the FIFO, the running DMP writes its
+ * packets there, MPU9250_FIFO_DMP_LEN bytes each; a reset restarts the DMP
+ * along with the FIFO.
+ * @param enable true to start, false to stop the FIFO
+ * @see MPU9250_RA_FIFO_EN
+ * @see MPU9250_RA_USER_CTRL
+ */
+bool MPU9250::enableFifo(bool enable, bool dmp)
+{
+    uint16_t dataSize = 1;
+    uint8_t fifoEn = 0;
+    if (enable && !dmp) {
+        fifoEn = (1 << MPU9250_XG_FIFO_EN_BIT) | (1 << MPU9250_YG_FIFO_EN_BIT) | (1 << MPU9250_ZG_FIFO_EN_BIT) |
+                 (1 << MPU9250_ACCEL_FIFO_EN_BIT);
+    }
+    if (!writeReg(MPU9250_RA_FIFO_EN, fifoEn)) return false;
+
+    // keep the other USER_CTRL bits as they are
+    uint8_t userCtrl;
+    if (!readReg(MPU9250_RA_USER_CTRL, &userCtrl)) return false;
+    userCtrl &= ~((1 << MPU9250_USERCTRL_FIFO_EN_BIT) | (1 << MPU9250_USERCTRL_FIFO_RESET_BIT));
+    if (enable) userCtrl |= (1 << MPU9250_USERCTRL_FIFO_EN_BIT);
+    mFifoResetCtrl = userCtrl | (1 << MPU9250_USERCTRL_FIFO_RESET_BIT);
+    if (dmp) mFifoResetCtrl |= 1 << MPU9250_USERCTRL_DMP_RESET_BIT;
+    // the reset write must not turn the I2C interface back on
+    if (ImuBus_GetBackend()->bus == IMU_BUS_SPI) mFifoResetCtrl |= 1 << MPU9250_USERCTRL_I2C_IF_DIS_BIT;
+    // the reset is an action rather than a setting, it goes out right away
+    // and the shadow keeps USER_CTRL as it reads after the reset cleared
+    uint8_t temp = mFifoResetCtrl;
+    if (!ImuBus_Write(devAddr, MPU9250_RA_USER_CTRL, &temp, dataSize)) {
+        invalidateShadow();
+        return false;
+    }
+    int index = ShadowIndex(MPU9250_RA_USER_CTRL);
+    mShadow[index] = userCtrl;
+    mShadowDirty &= ~(1 << index);
+    return true;
+}
+
+/** Read FIFO_COUNTH and FIFO_COUNTL on the I2C queue.
+ * @param pData 2 bytes, for parseFifoCount() once cb reported success
+ * @return false if the I2C queue is full, cb is not called then
+ */
+bool MPU9250::readFifoCountAsync(uint8_t* pData, ImuBusDoneCb cb, void* pArg)
+{
+    return ImuBus_ReadAsync(devAddr, MPU9250_RA_FIFO_COUNTH, pData, 2, cb, pArg);
+}
+
+/** Bytes in the FIFO, from the 2 bytes readFifoCountAsync() read.
+ */
+uint16_t MPU9250::parseFifoCount(const uint8_t* pData)
+{
+    return (((uint16_t)(pData[0] & 0x1F)) << 8) | pData[1];
+}
+
+/** Pop len bytes off the FIFO on the I2C queue. FIFO_R_W does not advance
+ * the register address, so one burst drains several records.
+ * @param len a multiple of MPU9250_FIFO_MOTION6_LEN, at most what
+ *            FIFO_COUNT reported, or the records go out of step
+ * @return false if the I2C queue is full, cb is not called then
+ */
+bool MPU9250::readFifoAsync(uint8_t* pData, uint16_t len, ImuBusDoneCb cb, void* pArg)
+{
+    return ImuBus_ReadAsync(devAddr, MPU9250_RA_FIFO_R_W, pData, len, cb, pArg);
+}
+
+/** Empty the FIFO on the I2C queue, it goes on filling afterwards.
+ * @return false if the I2C queue is full, cb is not called then
+ * @see enableFifo()
+ */
+bool MPU9250::resetFifoAsync(ImuBusDoneCb cb, void* pArg)
+{
+    return ImuBus_WriteAsync(devAddr, MPU9250_RA_USER_CTRL, &mFifoResetCtrl, 1, cb, pArg);
+}
@@ -38,13 +38,13 @@
  */
 #include "stm32f1xx_hal.h"
 #include "logging.h"
-#include "i2c.h"
+#include "imu_bus.h"
 
 #define LOG_TAG ("INV_MPU")
 
 #define MPU9250
-#define i2c_write(a, b, c, d) I2C_Write(a << 1, b, I2C_MEMADD_SIZE_8BIT, d, c) ? 0 : -1
-#define i2c_read(a, b, c, d)  I2C_Read(a << 1, b, I2C_MEMADD_SIZE_8BIT, d, c) ? 0 : -1
+#define i2c_write(a, b, c, d) ImuBus_Write(a << 1, b, d, c) ? 0 : -1
+#define i2c_read(a, b, c, d)  ImuBus_Read(a << 1, b, d, c) ? 0 : -1
 #define delay_ms  HAL_Delay
 #define get_ms    GetMs
 #define log_i     LOGI
@@ -513,8 +513,7 @@ const struct gyro_reg_s reg = {
     .mem_start_addr = 0x6E,
     .prgm_start_h   = 0x70
 #ifdef AK89xx_SECONDARY
-    ,.raw_compass   = 0x49,
-    .s0_addr        = 0x25,
+    ,.s0_addr       = 0x25,
     .s0_reg         = 0x26,
     .s0_ctrl        = 0x27,
     .s1_addr        = 0x28,
@@ -523,7 +522,8 @@ const struct gyro_reg_s reg = {
     .s4_ctrl        = 0x34,
     .s0_do          = 0x63,
     .s1_do          = 0x64,
-    .i2c_delay_ctrl = 0x67
+    .i2c_delay_ctrl = 0x67,
+    .raw_compass    = 0x49
 #endif
 };
 const struct hw_s hw = {
@@ -34,7 +34,7 @@
  */
 #include "stm32f1xx_hal.h"
 #include "logging.h"
-#include "i2c.h"
+#include "imu_bus.h"
 
 #define LOG_TAG ("INV_MPU_DMP")
 
@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include "rc_uart.h"
+
+#include "clock.h"
+#include "logging.h"
+#include "uart.h"
+
+/*
+* Defines
+*/
+
+#define LOG_TAG ("RcUart")
+#define RC_UART_DEBUG (0)
+
+#if RC_UART_DEBUG
+#define LOG(...) LOGI(__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+
+/*
+* Constant
+*/
+
+// circular DMA target, the half and full transfer interrupts drain it every
+// 32 bytes in case the idle line interrupt is late, 3.8 ms at SBUS speed
+// and 0.8 ms at CRSF speed
+#define RC_UART_DMA_BUF_SIZE (64)
+
+/*
+* Static
+*/
+
+extern UART_HandleTypeDef huart3;
+
+static volatile bool sRunning = false;
+static uint8_t sDmaBuf[RC_UART_DMA_BUF_SIZE];
+static uint32_t sDmaPos = 0;
+static uint32_t sErrors = 0;
+static RcUartRxCb spRxCb = NULL;
+static RcUartIdleCb spIdleCb = NULL;
+
+/*
+* Code
+*/
+
+// (re)starts the circular DMA, called with the interrupts masked or from them
+static void RcUart_StartRx()
+{
+    sDmaPos = 0;
+    HAL_UART_Receive_DMA(&huart3, sDmaBuf, RC_UART_DMA_BUF_SIZE);
+}
+
+// hands the bytes the DMA wrote since the last call to the protocol. Only
+// called from the USART3 and DMA1 channel 3 interrupts, which share a
+// priority and cannot preempt each other.
+static void RcUart_Drain()
+{
+    uint32_t pos = RC_UART_DMA_BUF_SIZE - __HAL_DMA_GET_COUNTER(huart3.hdmarx);
+    if (pos >= RC_UART_DMA_BUF_SIZE) pos = 0;
+    if (pos == sDmaPos || !spRxCb) {
+        sDmaPos = pos;
+        return;
+    }
+    // the bytes are stamped when they are drained, at most half a buffer
+    // after they arrived and usually an idle character after
+    uint64_t nowUs = Clock_GetUs();
+    if (pos < sDmaPos) {
+        // wrapped, the tail of the buffer first
+        spRxCb(&sDmaBuf[sDmaPos], RC_UART_DMA_BUF_SIZE - sDmaPos, nowUs);
+        sDmaPos = 0;
+    }
+    if (pos > sDmaPos) spRxCb(&sDmaBuf[sDmaPos], pos - sDmaPos, nowUs);
+    sDmaPos = pos;
+}
+
+static void RcUart_OnIdle()
+{
+    if (spIdleCb) spIdleCb();
+}
+
+/*------------------------------------------*
+* Callbacks/Interrupts
+*------------------------------------------*/
+
+void RcUart_InterruptHandler()
+{
+    // Custom handling
+    if (__HAL_UART_GET_FLAG(&huart3, UART_FLAG_IDLE) && __HAL_UART_GET_IT_SOURCE(&huart3, UART_IT_IDLE)) {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart3);
+        // end of a frame, hand it over now instead of with the next one
+        RcUart_Drain();
+        RcUart_OnIdle();
+    }
+
+    // HAL handling
+    HAL_UART_IRQHandler(&huart3);
+}
+
+void RcUart_DMAInterruptHandler()
+{
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        // the debug UART shares the HAL callback
+        UART_TxErrorHandler();
+        return;
+    }
+    if (huart->Instance != USART3 || !sRunning) return;
+    LOG("RC UART ERROR %d\r\n", huart->ErrorCode);
+    ++sErrors;
+    // the HAL stopped the DMA. Keep the frames that arrived, drop the
+    // damaged one and restart, the decoder finds the next frame by itself.
+    RcUart_Drain();
+    RcUart_OnIdle();
+    HAL_UART_DMAStop(&huart3);
+    RcUart_StartRx();
+}
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART3) return;
+    RcUart_Drain();
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART3) return;
+    // circular mode, the DMA has already wrapped and keeps running
+    RcUart_Drain();
+}
+
+bool RcUart_Start(const RcUartConfigType* pConfig)
+{
+    if (!pConfig || !pConfig->rxCb) {
+        LOGE("%s, input invalid\r\n", __func__);
+        return false;
+    }
+    RcUart_Stop();
+
+    huart3.Init.BaudRate = pConfig->baudRate;
+    huart3.Init.WordLength = pConfig->wordLength;
+    huart3.Init.StopBits = pConfig->stopBits;
+    huart3.Init.Parity = pConfig->parity;
+    if (HAL_UART_Init(&huart3) != HAL_OK) {
+        LOGE("USART3 init failed, %u baud\r\n", pConfig->baudRate);
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    spRxCb = pConfig->rxCb;
+    spIdleCb = pConfig->idleCb;
+    sRunning = true;
+    RcUart_StartRx();
+    // enable idle line interrupt
+    __HAL_UART_ENABLE_IT(&huart3, UART_IT_IDLE);
+    __set_PRIMASK(primask);
+    LOG("started at %u baud\r\n", pConfig->baudRate);
+    return true;
+}
+
+void RcUart_Stop()
+{
+    if (!sRunning) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    __HAL_UART_DISABLE_IT(&huart3, UART_IT_IDLE);
+    HAL_UART_DMAStop(&huart3);
+    sRunning = false;
+    spRxCb = NULL;
+    spIdleCb = NULL;
+    __set_PRIMASK(primask);
+}
+
+uint32_t RcUart_GetErrors()
+{
+    return sErrors;
+}
+
+void RcUart_ResetErrors()
+{
+    sErrors = 0;
+}
@@ -2,9 +2,13 @@
 
 #include "sbus.h"
 
+#include "UAV_Defines.h"
+#include "clock.h"
+#include "latest_value.h"
 #include "led.h"
 #include "logging.h"
-#include "ping_pong_buffer.h"
+#include "rc_uart.h"
+#include "sbus_decoder.h"
 
 /*
 * Defines
@@ -21,28 +25,19 @@
 
 #define SBUS_PRINT_RECEIVED_MSG (0)
 
-#define LOSTFRAME_MASK (0x20)
-#define FAILSAFE_MASK (0x10)
-
 /*
 * Constant
 */
 
-#define SBUS_HEADER 0x0f // little endian
-#define SBUS_ENDBYTE 0x00
 #define SBUS_BAUDRATE 100000
-#define SBUS_MSG_LENGTH 25
-
-
 
 /*
 * Struct
 */
 
-typedef enum {
-    SBUS_IDLE,
-    SBUS_HEADER_DETECTED,
-} SBUSDetectStateType;
+typedef struct {
+    uint8_t data[SBUS_FRAME_LEN];
+} SBUSFrameType;
 
 /*
 * Static
@@ -52,11 +47,12 @@ extern UART_HandleTypeDef huart3;
 extern DMA_HandleTypeDef hdma_usart3_rx;
 
 static volatile bool sStarted = false;
-// static SBUSDetectStateType sDetectState = SBUS_IDLE;
-static uint8_t sRecBuffer[SBUS_MSG_LENGTH];
-// static uint8_t sRecBytesCnt = 0;
-static PPBufferType* spPPBuffer;
-static uint8_t sRetryCnt = 0;
+// the USART3 and DMA interrupts feed what the receiver sent to the decoder
+static SBUSDecoderType sDecoder;
+// complete frames go to the main loop, SBUS_Read() decodes the latest in place
+static LatestValue<SBUSFrameType> sFrames;
+static SBUSDataType sLastData;
+static SBUSFrameCb spFrameCb = NULL;
 
 //static float sChannelOutMin = -50.0f;
 //static float sChannelOutMax = 50.0f;
@@ -64,44 +60,25 @@ static uint8_t sRetryCnt = 0;
 /*
 * Prototypes
 */
-#if 0
-static bool SBUS_DetectMsg(uint8_t data);
-#endif
+static void SBUS_OnRx(const uint8_t* pData, uint32_t len, uint64_t timeUs);
+static void SBUS_OnIdle();
+static void SBUS_Publish(const uint8_t* pFrame);
+static void SBUS_DecodeFrame(const uint8_t* pMsg, SBUSDataType* pSBUSData);
 
 /*
-* Code
+* Constant
 */
 
-#if 0 // not used. As we are not receiving data byte by byte
-/* Detect SBUS data */
-static bool SBUS_DetectMsg(uint8_t data)
-{
-    // find the header
-    if (sDetectState == SBUS_IDLE) {
-        if (data == SBUS_HEADER) {
-            sDetectState = SBUS_HEADER_DETECTED;
-        }
-    }
-    else if (sDetectState == SBUS_HEADER_DETECTED) {
-        sRecBuffer[sRecBytesCnt++] = data;
-        if (sRecBytesCnt == SBUS_MSG_LENGTH) {
-            if (sRecBuffer[SBUS_MSG_LENGTH - 1] == SBUS_ENDBYTE) {
-                // endbyte valid. Valid data, copy to buffer
-                //LOG("received SBUS data\r\n");
-                // memcpy(sReceivedMsg, sRecBuffer, SBUS_MSG_LENGTH);
-                PingPongBuffer_Write(spPPBuffer, sRecBuffer, SBUS_MSG_LENGTH);
-            } else {
-                //LOGE("Invalid SBUS data received\r\n");
-            }
-            sRecBytesCnt = 0;
-            sDetectState = SBUS_IDLE;
-        }
-    }
-    return true;
-}
-#endif
+// 8 data bits, even parity, 2 stop bits
+static const RcUartConfigType sRcUartConfig = {
+    SBUS_BAUDRATE, UART_WORDLENGTH_9B, UART_STOPBITS_2, UART_PARITY_EVEN, SBUS_OnRx, SBUS_OnIdle
+};
 
-static bool DMA_Init()
+/*
+* Code
+*/
+
+static bool SBUS_DMAInit()
 {
 #if 0
     /* DMA controller clock enable */
@@ -115,7 +92,7 @@ static bool DMA_Init()
     return true;
 }
 
-static bool UART_Init()
+static bool SBUS_UARTInit()
 {
 #if 0
     huart3.Instance = USART3;
@@ -154,121 +131,102 @@ static bool UART_Init()
     return true;
 }
 
-/*------------------------------------------*
-* Callbacks/Interrupts
-*------------------------------------------*/
-
-void SBUS_InterruptHandler()
+// hands a frame the decoder confirmed to the main loop
+static void SBUS_Publish(const uint8_t* pFrame)
 {
-    // Custom handling
-    if (__HAL_UART_GET_IT_SOURCE(&huart3, UART_IT_IDLE)) {
-        HAL_UART_Receive_DMA(&huart3, sRecBuffer, SBUS_MSG_LENGTH); // this is time-critical.
-        __HAL_UART_DISABLE_IT(&huart3, UART_IT_IDLE);
+    if (!pFrame) return;
+#if SBUS_PRINT_RECEIVED_MSG
+    for (int i = 0; i < SBUS_FRAME_LEN; ++i) {
+        PRINT("0x%x ", pFrame[i]);
     }
-
-    // HAL handling
-    HAL_UART_IRQHandler(&huart3);
+    PRINT("\r\n");
+#endif
+    memcpy(sFrames.BeginWrite()->data, pFrame, SBUS_FRAME_LEN);
+    sFrames.EndWrite(SBUSDecoder_GetFrameTimeUs(&sDecoder));
+    sStarted = true;
+    if (spFrameCb) spFrameCb();
 }
 
-void SBUS_DMAInterruptHandler()
-{
-}
+/*------------------------------------------*
+* Callbacks/Interrupts
+*------------------------------------------*/
 
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+// the bytes RcUart handed over, a frame is stamped with the time of the
+// bytes that completed it
+static void SBUS_OnRx(const uint8_t* pData, uint32_t len, uint64_t timeUs)
 {
-    LOG("SBUS ERROR %d\r\n", huart->ErrorCode);
-    ++sRetryCnt;
-    LOG("Retry cnt : %d\r\n", sRetryCnt);
-    HAL_UART_Receive_DMA(&huart3, sRecBuffer, 5);
+    for (uint32_t i = 0; i < len; ++i) {
+        SBUS_Publish(SBUSDecoder_PutByte(&sDecoder, pData[i], timeUs));
+    }
 }
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+static void SBUS_OnIdle()
 {
-#if SBUS_PRINT_RECEIVED_MSG
-    for (int i = 0; i < 25; ++i) {
-        PRINT("0x%x ", sRecBuffer[i]);
-    }
-    PRINT("\r\n");
-#endif
-    if (sRecBuffer[0] != SBUS_HEADER) {
-        // the first byte is not header. Try again.
-        LOGE("SBUS try again %d\r\n", sRecBuffer[0]);
-        HAL_UART_DMAStop(&huart3);
-        __HAL_UART_ENABLE_IT(&huart3, UART_IT_IDLE);
-        return;
-    }
-    sStarted = true;
-    PingPongBuffer_Write(spPPBuffer, sRecBuffer, SBUS_MSG_LENGTH);
+    // end of a frame, the idle line confirms it, hand it over now instead
+    // of with the next header
+    SBUS_Publish(SBUSDecoder_OnIdle(&sDecoder));
 }
 
 bool SBUS_Init()
 {
-    if (DMA_Init()) {
+    if (SBUS_DMAInit()) {
         LOG("SBUS DMA init success\r\n");
     }
-    if (UART_Init()) {
+    if (SBUS_UARTInit()) {
         LOG("SBUS UART init success\r\n");
     } else {
         LOGE("SBUS UART init failed\r\n");
         return false;
     }
 
-    spPPBuffer = PingPongBuffer_Init(SBUS_MSG_LENGTH);
-    if (!spPPBuffer) {
-        LOGE("PingPongBuffer_Init failed\r\n");
-        return false;
-    }
+    SBUSDecoder_Init(&sDecoder);
+    memset(&sLastData, 0, sizeof(sLastData));
     return true;
 }
 
 bool SBUS_Start()
 {
-    // enable idle line interrupt
-    __HAL_UART_ENABLE_IT(&huart3, UART_IT_IDLE);
-
-    // wait for dma to detect header
-    int cnt = 5;
-    while (!sStarted && --cnt) {
-        HAL_Delay(1000); // wait 5 * 1 = 5 sec
-    }
-
-    if (!sStarted) {
-        // LED_SetOn(LED_RED, true);
+    // the interrupts must not feed the decoder while it is reset
+    RcUart_Stop();
+    sStarted = false;
+    SBUSDecoder_Init(&sDecoder);
+    if (!RcUart_Start(&sRcUartConfig)) {
         LOGE("SBUS failed to start\r\n");
-        // LED_Toggle(LED_ONBOARD);
         return false;
     }
     return true;
 }
 
-bool SBUS_Read(SBUSDataType* pSBUSData)
+void SBUS_Stop()
 {
-    if (!pSBUSData) {
-        LOGE("%s, input invalid\r\n");
-        return false;
-    }
+    RcUart_Stop();
+}
 
-    uint8_t receivedMsg[SBUS_MSG_LENGTH];
-    uint32_t msgSize = SBUS_MSG_LENGTH;
-    PingPongBuffer_Read(spPPBuffer, receivedMsg, &msgSize);
+bool SBUS_IsReceiving()
+{
+    return sStarted;
+}
+
+static void SBUS_DecodeFrame(const uint8_t* pMsg, SBUSDataType* pSBUSData)
+{
     // 16 channels of 11 bit data
     uint16_t channels_int[16];
-    channels_int[0]  = (uint16_t) ((receivedMsg[1]    | receivedMsg[2] <<8)                       & 0x07FF);
-    channels_int[1]  = (uint16_t) ((receivedMsg[2]>>3 | receivedMsg[3] <<5)                       & 0x07FF);
-    channels_int[2]  = (uint16_t) ((receivedMsg[3]>>6 | receivedMsg[4] <<2 | receivedMsg[5]<<10)  & 0x07FF);
-    channels_int[3]  = (uint16_t) ((receivedMsg[5]>>1 | receivedMsg[6] <<7)                       & 0x07FF);
-    channels_int[4]  = (uint16_t) ((receivedMsg[6]>>4 | receivedMsg[7] <<4)                       & 0x07FF);
-    channels_int[5]  = (uint16_t) ((receivedMsg[7]>>7 | receivedMsg[8] <<1 | receivedMsg[9]<<9)   & 0x07FF);
-    channels_int[6]  = (uint16_t) ((receivedMsg[9]>>2 | receivedMsg[10] <<6)                      & 0x07FF);
-    channels_int[7]  = (uint16_t) ((receivedMsg[10]>>5 | receivedMsg[11]<<3)                      & 0x07FF);
-    channels_int[8]  = (uint16_t) ((receivedMsg[12]   | receivedMsg[13]<<8)                       & 0x07FF);
-    channels_int[9]  = (uint16_t) ((receivedMsg[13]>>3| receivedMsg[14]<<5)                       & 0x07FF);
-    channels_int[10] = (uint16_t) ((receivedMsg[14]>>6| receivedMsg[15]<<2 | receivedMsg[16]<<10) & 0x07FF);
-    channels_int[11] = (uint16_t) ((receivedMsg[16]>>1| receivedMsg[17]<<7)                       & 0x07FF);
-    channels_int[12] = (uint16_t) ((receivedMsg[17]>>4| receivedMsg[18]<<4)                       & 0x07FF);
-    channels_int[13] = (uint16_t) ((receivedMsg[18]>>7| receivedMsg[19]<<1 | receivedMsg[20]<<9)  & 0x07FF);
-    channels_int[14] = (uint16_t) ((receivedMsg[20]>>2| receivedMsg[21]<<6)                       & 0x07FF);
-    channels_int[15] = (uint16_t) ((receivedMsg[21]>>5| receivedMsg[22]<<3)                       & 0x07FF);
+    channels_int[0]  = (uint16_t) ((pMsg[1]    | pMsg[2] <<8)                & 0x07FF);
+    channels_int[1]  = (uint16_t) ((pMsg[2]>>3 | pMsg[3] <<5)                & 0x07FF);
+    channels_int[2]  = (uint16_t) ((pMsg[3]>>6 | pMsg[4] <<2 | pMsg[5]<<10)  & 0x07FF);
+    channels_int[3]  = (uint16_t) ((pMsg[5]>>1 | pMsg[6] <<7)                & 0x07FF);
+    channels_int[4]  = (uint16_t) ((pMsg[6]>>4 | pMsg[7] <<4)                & 0x07FF);
+    channels_int[5]  = (uint16_t) ((pMsg[7]>>7 | pMsg[8] <<1 | pMsg[9]<<9)   & 0x07FF);
+    channels_int[6]  = (uint16_t) ((pMsg[9]>>2 | pMsg[10] <<6)               & 0x07FF);
+    channels_int[7]  = (uint16_t) ((pMsg[10]>>5 | pMsg[11]<<3)               & 0x07FF);
+    channels_int[8]  = (uint16_t) ((pMsg[12]   | pMsg[13]<<8)                & 0x07FF);
+    channels_int[9]  = (uint16_t) ((pMsg[13]>>3| pMsg[14]<<5)                & 0x07FF);
+    channels_int[10] = (uint16_t) ((pMsg[14]>>6| pMsg[15]<<2 | pMsg[16]<<10) & 0x07FF);
+    channels_int[11] = (uint16_t) ((pMsg[16]>>1| pMsg[17]<<7)                & 0x07FF);
+    channels_int[12] = (uint16_t) ((pMsg[17]>>4| pMsg[18]<<4)                & 0x07FF);
+    channels_int[13] = (uint16_t) ((pMsg[18]>>7| pMsg[19]<<1 | pMsg[20]<<9)  & 0x07FF);
+    channels_int[14] = (uint16_t) ((pMsg[20]>>2| pMsg[21]<<6)                & 0x07FF);
+    channels_int[15] = (uint16_t) ((pMsg[21]>>5| pMsg[22]<<3)                & 0x07FF);
     // parse
     for (int i = 0; i < 16; ++i) {
         if (i < 5) LOG("SBUSData: channel %d : %d\r\n", i, channels_int[i]);
@@ -277,19 +235,64 @@ bool SBUS_Read(SBUSDataType* pSBUSData)
     }
 
     // count lost frames
-    if (receivedMsg[22] & LOSTFRAME_MASK) {
+    if (pMsg[SBUS_FRAME_FLAGS_BYTE] & SBUS_FLAG_LOST_FRAME) {
         pSBUSData->lostFrame = true;
     } else {
         pSBUSData->lostFrame = false;
     }
     // failsafe state
-    if (receivedMsg[22] & FAILSAFE_MASK) {
+    if (pMsg[SBUS_FRAME_FLAGS_BYTE] & SBUS_FLAG_FAILSAFE) {
         pSBUSData->failsafe = true;
     }
     else{
         pSBUSData->failsafe = false;
     }
+}
+
+bool SBUS_Read(SBUSDataType* pSBUSData)
+{
+    if (!pSBUSData) {
+        LOGE("%s, input invalid\r\n");
+        return false;
+    }
+
+    if (sFrames.Update()) {
+        const LatestValue<SBUSFrameType>::SlotType& frame = sFrames.Latest();
+        SBUS_DecodeFrame(frame.value.data, &sLastData);
+        sLastData.frameSeq = frame.seq;
+        sLastData.frameTimeUs = frame.timeUs;
+    }
+    // no new frame since the last call, repeat the last one with the same frameSeq
+    *pSBUSData = sLastData;
+    // a receiver that lost power or its wire sends nothing, not even the
+    // failsafe flag; the last frame must not stand in for the sticks then
+    pSBUSData->stale = !sStarted || Clock_GetUs() - sLastData.frameTimeUs > UAV_RC_LINK_TIMEOUT_MS * 1000ULL;
+    if (pSBUSData->stale) pSBUSData->failsafe = true;
 
     // return true on receiving a full packet
     return true;
 }
+
+void SBUS_SetFrameCb(SBUSFrameCb cb)
+{
+    spFrameCb = cb;
+}
+
+void SBUS_GetStats(SBUSStatsType* pStats)
+{
+    // the interrupts update the counters, take a consistent copy
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pStats->decoder = sDecoder.stats;
+    pStats->uartErrors = RcUart_GetErrors();
+    __set_PRIMASK(primask);
+}
+
+void SBUS_ResetStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    SBUSDecoder_ResetStats(&sDecoder);
+    RcUart_ResetErrors();
+    __set_PRIMASK(primask);
+}
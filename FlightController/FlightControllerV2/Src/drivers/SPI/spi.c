@@ -0,0 +1,341 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "spi.h"
+
+#include "clock.h"
+#include "logging.h"
+
+#define LOG_TAG ("SPI")
+
+#define SPI_TIMEOUT (100)
+
+// SPI2 on the 32 MHz APB1
+#define SPI_SLOW_HZ (1000000)
+#define SPI_FAST_HZ (16000000)
+#define SPI_SLOW_PRESCALER SPI_BAUDRATEPRESCALER_32
+#define SPI_FAST_PRESCALER SPI_BAUDRATEPRESCALER_2
+#define SPI_BITS_PER_BYTE (8)
+
+#define SPI_CS_Pin       GPIO_PIN_1
+#define SPI_CS_GPIO_Port GPIOB
+
+/*
+ * Struct
+ */
+
+typedef enum {
+    SPI_RESULT_OK,
+    SPI_RESULT_ERROR,
+    SPI_RESULT_TIMEOUT,
+} SPIResultType;
+
+typedef struct {
+    uint8_t reg;
+    uint8_t* pData;
+    uint16_t size;
+    bool read;
+    SPISpeedType speed;
+    SPIDoneCb cb;
+    void* pArg;
+} SPITransactionType;
+
+/*
+ * Static
+ */
+
+extern SPI_HandleTypeDef hspi2;
+
+// sQueue[sHead] is the transaction on the bus while sActive, sCount counts it
+static SPITransactionType sQueue[SPI_QUEUE_LEN];
+static volatile uint32_t sHead = 0;
+static volatile uint32_t sCount = 0;
+static volatile bool sActive = false;
+// a blocking transfer owns the bus, the queue waits
+static volatile bool sPolled = false;
+static uint32_t sStartTick = 0;
+static uint32_t sTimeoutMs = 0;
+static uint64_t sStartUs = 0;
+// the address byte of the transaction on the bus, sent before its data
+static uint8_t sAddr = 0;
+static SPIStatsType sStats;
+
+/*
+ * Prototypes
+ */
+static bool SPI_Queue(const SPITransactionType* pTransaction);
+static void SPI_StartNext();
+static void SPI_Finish(SPIResultType result);
+static void SPI_Complete(SPIResultType result);
+
+/*
+ * Code
+ */
+
+bool SPI_Init()
+{
+    // MX_SPI2_Init() set mode 3 at SPI_SLOW_HZ, the DMA channels and their
+    // interrupts; the chip select is ours
+    GPIO_InitTypeDef GPIO_InitStruct;
+    GPIO_InitStruct.Pin = SPI_CS_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_WritePin(SPI_CS_GPIO_Port, SPI_CS_Pin, GPIO_PIN_SET);
+    HAL_GPIO_Init(SPI_CS_GPIO_Port, &GPIO_InitStruct);
+
+    if (hspi2.Init.BaudRatePrescaler != SPI_SLOW_PRESCALER) {
+        hspi2.Init.BaudRatePrescaler = SPI_SLOW_PRESCALER;
+        if (HAL_SPI_Init(&hspi2) != HAL_OK) {
+            LOGE("HAL_SPI_Init failed at %d hz\r\n", SPI_SLOW_HZ);
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t SPI_GetHz(SPISpeedType speed)
+{
+    return speed == SPI_SPEED_FAST ? SPI_FAST_HZ : SPI_SLOW_HZ;
+}
+
+// only between transactions, the baud rate must not change while one runs
+static void SPI_SetSpeed(SPISpeedType speed)
+{
+    MODIFY_REG(hspi2.Instance->CR1, SPI_CR1_BR, speed == SPI_SPEED_FAST ? SPI_FAST_PRESCALER : SPI_SLOW_PRESCALER);
+}
+
+static void SPI_Select(bool select)
+{
+    HAL_GPIO_WritePin(SPI_CS_GPIO_Port, SPI_CS_Pin, select ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+/*------------------------------------------*
+* Blocking transfers
+*------------------------------------------*/
+
+// waits for the queued transactions, then holds the queue off the bus
+static bool SPI_Acquire()
+{
+    uint32_t tickstart = HAL_GetTick();
+    for (;;) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (!sActive && sCount == 0) {
+            sPolled = true;
+            __set_PRIMASK(primask);
+            return true;
+        }
+        __set_PRIMASK(primask);
+        if (HAL_GetTick() - tickstart > SPI_TIMEOUT) return false;
+        // the completion or the timeout tick wakes us
+        __WFI();
+    }
+}
+
+static void SPI_Release()
+{
+    sPolled = false;
+    // whatever an interrupt queued in the meantime
+    SPI_StartNext();
+}
+
+bool SPI_Write(uint8_t reg, uint8_t* pData, uint16_t size)
+{
+    if (!SPI_Acquire()) {
+        LOGE("SPI_Write timed out waiting for the queue\r\n");
+        return false;
+    }
+    SPI_SetSpeed(SPI_SPEED_SLOW);
+    uint8_t addr = reg & ~SPI_READ_FLAG;
+    SPI_Select(true);
+    HAL_StatusTypeDef status = HAL_SPI_Transmit(&hspi2, &addr, 1, SPI_TIMEOUT);
+    if (status == HAL_OK) status = HAL_SPI_Transmit(&hspi2, pData, size, SPI_TIMEOUT);
+    SPI_Select(false);
+    SPI_Release();
+    if (status != HAL_OK) {
+        LOGE("HAL_SPI_Transmit failed, status = %d, reg = %d\r\n", status, reg);
+        return false;
+    }
+    return true;
+}
+
+bool SPI_Read(uint8_t reg, uint8_t* pData, uint16_t size, SPISpeedType speed)
+{
+    if (!SPI_Acquire()) {
+        LOGE("SPI_Read timed out waiting for the queue\r\n");
+        return false;
+    }
+    SPI_SetSpeed(speed);
+    uint8_t addr = reg | SPI_READ_FLAG;
+    SPI_Select(true);
+    HAL_StatusTypeDef status = HAL_SPI_Transmit(&hspi2, &addr, 1, SPI_TIMEOUT);
+    if (status == HAL_OK) status = HAL_SPI_Receive(&hspi2, pData, size, SPI_TIMEOUT);
+    SPI_Select(false);
+    SPI_Release();
+    if (status != HAL_OK) {
+        LOGE("HAL_SPI_Receive failed, status = %d, reg = %d\r\n", status, reg);
+        return false;
+    }
+    return true;
+}
+
+/*------------------------------------------*
+* Queued transfers
+*------------------------------------------*/
+
+static bool SPI_Queue(const SPITransactionType* pTransaction)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (sCount >= SPI_QUEUE_LEN) {
+        ++sStats.queueFull;
+        __set_PRIMASK(primask);
+        return false;
+    }
+    sQueue[(sHead + sCount) % SPI_QUEUE_LEN] = *pTransaction;
+    ++sCount;
+    if (sCount > sStats.maxQueued) sStats.maxQueued = sCount;
+    __set_PRIMASK(primask);
+
+    SPI_StartNext();
+    return true;
+}
+
+// puts the head of the queue on the bus unless something else owns it
+static void SPI_StartNext()
+{
+    for (;;) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (sActive || sPolled || sCount == 0) {
+            __set_PRIMASK(primask);
+            return;
+        }
+        sActive = true;
+        const SPITransactionType* pTransaction = &sQueue[sHead];
+        sStartTick = HAL_GetTick();
+        sStartUs = Clock_GetUs();
+        uint32_t hz = SPI_GetHz(pTransaction->speed);
+        sTimeoutMs = SPI_ASYNC_TIMEOUT_MS + ((pTransaction->size + 1) * SPI_BITS_PER_BYTE * 1000 + hz - 1) / hz;
+        __set_PRIMASK(primask);
+
+        // the address byte goes out polled, a few us at most, the data by DMA
+        SPI_SetSpeed(pTransaction->speed);
+        sAddr = pTransaction->read ? (pTransaction->reg | SPI_READ_FLAG) : (pTransaction->reg & ~SPI_READ_FLAG);
+        SPI_Select(true);
+        HAL_StatusTypeDef status = HAL_SPI_Transmit(&hspi2, &sAddr, 1, SPI_TIMEOUT);
+        if (status == HAL_OK && pTransaction->read) {
+            status = HAL_SPI_Receive_DMA(&hspi2, pTransaction->pData, pTransaction->size);
+        } else if (status == HAL_OK) {
+            status = HAL_SPI_Transmit_DMA(&hspi2, pTransaction->pData, pTransaction->size);
+        }
+        if (status == HAL_OK) return;
+        // the HAL is busy or locked, fail this one and go on
+        SPI_Finish(SPI_RESULT_ERROR);
+    }
+}
+
+// retires the transaction on the bus and reports it
+static void SPI_Finish(SPIResultType result)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!sActive) {
+        // completion of a transaction the timeout already retired
+        __set_PRIMASK(primask);
+        return;
+    }
+    SPI_Select(false);
+    SPITransactionType done = sQueue[sHead];
+    sHead = (sHead + 1) % SPI_QUEUE_LEN;
+    --sCount;
+    sActive = false;
+    if (result == SPI_RESULT_OK) {
+        ++sStats.transfers;
+        uint32_t us = (uint32_t) (Clock_GetUs() - sStartUs);
+        if (us > sStats.maxTransferUs) sStats.maxTransferUs = us;
+    } else if (result == SPI_RESULT_TIMEOUT) {
+        ++sStats.timeouts;
+    } else {
+        ++sStats.errors;
+    }
+    __set_PRIMASK(primask);
+
+    if (done.cb) done.cb(result == SPI_RESULT_OK, done.pArg);
+}
+
+static void SPI_Complete(SPIResultType result)
+{
+    SPI_Finish(result);
+    SPI_StartNext();
+}
+
+bool SPI_WriteAsync(uint8_t reg, uint8_t* pData, uint16_t size, SPIDoneCb cb, void* pArg)
+{
+    SPITransactionType transaction = { reg, pData, size, false, SPI_SPEED_SLOW, cb, pArg };
+    return SPI_Queue(&transaction);
+}
+
+bool SPI_ReadAsync(uint8_t reg, uint8_t* pData, uint16_t size, SPISpeedType speed, SPIDoneCb cb, void* pArg)
+{
+    SPITransactionType transaction = { reg, pData, size, true, speed, cb, pArg };
+    return SPI_Queue(&transaction);
+}
+
+bool SPI_IsIdle()
+{
+    return !sActive && sCount == 0;
+}
+
+void SPI_OnTick()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!sActive || HAL_GetTick() - sStartTick <= sTimeoutMs) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    // a lost DMA interrupt, stop both channels and return the HAL to ready
+    HAL_SPI_Abort(&hspi2);
+    __set_PRIMASK(primask);
+
+    SPI_Complete(SPI_RESULT_TIMEOUT);
+}
+
+void SPI_GetStats(SPIStatsType* pStats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pStats = sStats;
+    __set_PRIMASK(primask);
+}
+
+void SPI_ResetStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&sStats, 0, sizeof(sStats));
+    __set_PRIMASK(primask);
+}
+
+/*------------------------------------------*
+* Callbacks/Interrupts
+*------------------------------------------*/
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    if (hspi == &hspi2) SPI_Complete(SPI_RESULT_OK);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    if (hspi == &hspi2) SPI_Complete(SPI_RESULT_OK);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    // a blocking transfer reports its own errors
+    if (hspi == &hspi2 && !sPolled) SPI_Complete(SPI_RESULT_ERROR);
+}
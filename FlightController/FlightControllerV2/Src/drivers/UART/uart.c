@@ -1,13 +1,40 @@
+#include <string.h>
+
 #include "stm32f1xx_hal.h"
 
 #include "uart.h"
 
+#include "bip_buffer.h"
 #include "logging.h"
 
+/*
+* Defines
+*/
+
 #define LOG_TAG ("UART")
 
+// reading DR clears RXNE
+#ifndef UART_READ_DR
+#define UART_READ_DR(instance) ((instance)->DR)
+#endif
+
+/*
+* Static
+*/
+
 extern UART_HandleTypeDef huart2;
 
+// messages are never split, so each one is a single copy in and the DMA
+// always gets a contiguous span
+static uint8_t sTxBuf[UART_TX_BUF_SIZE];
+static BipBufferType sTxBip = { sTxBuf, UART_TX_BUF_SIZE, 0, 0, 0, 0, 0 }; // ready before UART_Init, logs start early
+static volatile uint16_t sTxDmaLen = 0; // bytes owned by the DMA, 0 when idle
+static UartTxStatsType sTxStats;
+
+/*
+* Code
+*/
+
 /* USART3 init function */
 bool UART_Init()
 {
@@ -29,7 +56,104 @@ bool UART_Init()
     return true;
 }
 
-void UART_Send(const char* pData, const int dataSize)
+// called with interrupts disabled
+static void StartTx()
+{
+    if (sTxDmaLen) return;
+
+    // everything up to the wrap point in one transfer, straight from the queue
+    uint32_t len;
+    uint8_t* pSpan = BipBuffer_Peek(&sTxBip, &len);
+    if (!pSpan) return;
+    if (HAL_UART_Transmit_DMA(&huart2, pSpan, (uint16_t) len) != HAL_OK) {
+        // e.g. not initialised yet, the data stays queued for the next send
+        ++sTxStats.txErrors;
+        return;
+    }
+    sTxDmaLen = (uint16_t) len;
+}
+
+static void OnTxDone()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    BipBuffer_Release(&sTxBip, sTxDmaLen);
+    sTxDmaLen = 0;
+    StartTx();
+    __set_PRIMASK(primask);
+}
+
+bool UART_Send(const char* pData, const int dataSize)
+{
+    if (!pData || dataSize <= 0) return true;
+
+    // the copy is short (one log line), so the critical section is what lets
+    // interrupt handlers log as well
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t* pSpan = BipBuffer_Reserve(&sTxBip, (uint32_t) dataSize);
+    if (!pSpan) {
+        // never wait for the wire, drop the whole message instead of a torn one
+        ++sTxStats.droppedMsgs;
+        sTxStats.droppedBytes += dataSize;
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    memcpy(pSpan, pData, dataSize);
+    BipBuffer_Commit(&sTxBip, (uint32_t) dataSize);
+
+    ++sTxStats.queuedMsgs;
+    sTxStats.queuedBytes += dataSize;
+    uint16_t used = (uint16_t) BipBuffer_GetUsed(&sTxBip);
+    if (used > sTxStats.maxUsedBytes) sTxStats.maxUsedBytes = used;
+
+    StartTx();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+bool UART_IsTxIdle()
 {
-   HAL_UART_Transmit(&huart2, (uint8_t *)pData, dataSize, 50);
-}
\ No newline at end of file
+    return BipBuffer_GetUsed(&sTxBip) == 0;
+}
+
+void UART_GetTxStats(UartTxStatsType* pStats)
+{
+    if (!pStats) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pStats = sTxStats;
+    __set_PRIMASK(primask);
+}
+
+void UART_ResetTxStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&sTxStats, 0, sizeof(sTxStats));
+    __set_PRIMASK(primask);
+}
+
+// straight from the registers: HAL_UART_Receive() would lock huart2, which
+// the TX DMA is using, and its timeout path puts the handle back to READY
+bool UART_ReadByte(char* pData)
+{
+    USART_TypeDef* pUsart = huart2.Instance;
+    if (!(pUsart->SR & USART_SR_RXNE)) return false;
+    *pData = (char) (UART_READ_DR(pUsart) & 0xFF);
+    return true;
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART2) return;
+    OnTxDone();
+}
+
+void UART_TxErrorHandler()
+{
+    // the HAL aborted the transfer, skip the span rather than resend part of it
+    ++sTxStats.txErrors;
+    if (sTxDmaLen) OnTxDone();
+}
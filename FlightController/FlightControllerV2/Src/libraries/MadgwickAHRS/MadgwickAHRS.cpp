@@ -20,6 +20,7 @@
 // Header files
 
 #include "MadgwickAHRS.h"
+#include "profiler.h"
 #include <math.h>
 
 //-------------------------------------------------------------------------------------------
@@ -28,6 +29,8 @@
 #define sampleFreqDef   512.0f          // sample frequency in Hz
 #define betaDef         0.1f            // 2 * proportional gain
 
+static const int sProfileUpdateIMU = Profiler_Register("Madgwick::updateIMU");
+
 
 //============================================================================================
 // Functions
@@ -156,6 +159,7 @@ void Madgwick::update(float gx, float gy, float gz, float ax, float ay, float az
 // IMU algorithm update
 
 void Madgwick::updateIMU(float gx, float gy, float gz, float ax, float ay, float az) {
+	ProfilerScope profile(sProfileUpdateIMU);
 	float recipNorm;
 	float s0, s1, s2, s3;
 	float qDot1, qDot2, qDot3, qDot4;
@@ -8,9 +8,12 @@
 #include <PID.h>
 
 #include "logging.h"
+#include "profiler.h"
 
 #define LOG_TAG ("PID")
 
+static const int sProfileCompute = Profiler_Register("PID::Compute");
+
 /*Constructor (...)*********************************************************
 *    The parameters specified here are those for for which we can't set up
 *    reliable defaults, so we need to have the user set them.
@@ -22,6 +25,7 @@ PID::PID(float* Input, float* Output, float* Setpoint,
     myInput = Input;
     mySetpoint = Setpoint;
     inAuto = false;
+    pTerm = iTerm = dTerm = 0;
 
     PID::SetOutputLimits(0, 255);				//default output limit corresponds to
     //the arduino pwm limits
@@ -44,6 +48,7 @@ PID::PID(float* Input, float* Output, float* Setpoint,
     myInput = Input;
     mySetpoint = Setpoint;
     inAuto = false;
+    pTerm = iTerm = dTerm = 0;
 
     PID::SetOutputLimits(0, 255);				//default output limit corresponds to
     //the arduino pwm limits
@@ -62,6 +67,7 @@ PID::PID(float* Input, float* Output, float* Setpoint,
 **********************************************************************************/
 bool PID::Compute()
 {
+    ProfilerScope profile(sProfileCompute);
     if(!inAuto) return false;
 #if 0
     // Here it is assumed that timing control lies outside of this library. Everytime this API gets
@@ -90,6 +96,9 @@ bool PID::Compute()
 
     /*Compute Rest of PID Output*/
     output += outputSum - kd * dInput;
+    pTerm = pOnE ? kp * error : 0;
+    iTerm = outputSum;
+    dTerm = -kd * dInput;
 
     if(output > outMax) output = outMax;
     else if(output < outMin) output = outMin;
@@ -228,4 +237,7 @@ float PID::GetKp(){ return  dispKp; }
 float PID::GetKi(){ return  dispKi;}
 float PID::GetKd(){ return  dispKd;}
 int PID::GetMode(){ return  inAuto ? PID_MODE_AUTOMATIC : PID_MODE_MANUAL;}
-int PID::GetDirection(){ return controllerDirection;}
\ No newline at end of file
+int PID::GetDirection(){ return controllerDirection;}
+float PID::GetPTerm(){ return pTerm;}
+float PID::GetITerm(){ return iTerm;}
+float PID::GetDTerm(){ return dTerm;}
\ No newline at end of file
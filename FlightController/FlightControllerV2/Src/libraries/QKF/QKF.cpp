@@ -1,6 +1,7 @@
 #include "QKF.h"
 
 #include "logging.h"
+#include "profiler.h"
 
 #define LOG_TAG ("QKF")
 
@@ -21,6 +22,12 @@
 #define ACC_NOISE_DEFAULT 0.008
 #define MAG_NOISE_DEFAULT 0.05
 
+/*
+* Static
+*/
+
+static const int sProfileUpdateState = Profiler_Register("QKF::UpdateState");
+
 /*
 * Code
 */
@@ -281,6 +288,7 @@ bool QKF::PredictState(FCSensorDataType* pGyroData)
 
 bool QKF::UpdateState(FCSensorDataType* pAccData, FCSensorDataType* pMagData)
 {
+    ProfilerScope profile(sProfileUpdateState);
     // Input validity check
     if (pAccData == NULL) {
         LOGI("pAccData == NULL", __func__);
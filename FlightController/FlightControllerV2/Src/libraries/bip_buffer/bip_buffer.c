@@ -0,0 +1,104 @@
+#include "stm32f1xx_hal.h"
+
+#include "bip_buffer.h"
+
+/*
+ * Code
+ */
+
+bool BipBuffer_Init(BipBufferType* pBip, uint8_t* pStorage, uint32_t size)
+{
+    if (!pBip || !pStorage || size == 0) return false;
+    pBip->pBuf = pStorage;
+    pBip->size = size;
+    BipBuffer_Reset(pBip);
+    return true;
+}
+
+void BipBuffer_Reset(BipBufferType* pBip)
+{
+    pBip->write = 0;
+    pBip->last = 0;
+    pBip->read = 0;
+    pBip->reserveStart = 0;
+    pBip->reserveLen = 0;
+}
+
+uint8_t* BipBuffer_Reserve(BipBufferType* pBip, uint32_t len)
+{
+    uint32_t write = pBip->write;
+    uint32_t read = pBip->read;
+    uint32_t start;
+    if (len == 0 || len > pBip->size) return NULL;
+
+    if (write >= read) {
+        if (pBip->size - write >= len) {
+            start = write;
+        } else if (read > len) {
+            // wrap, write must stay behind read or the buffer looks empty
+            start = 0;
+        } else {
+            return NULL;
+        }
+    } else {
+        // already wrapped, the free space ends at read
+        if (read - write > len) {
+            start = write;
+        } else {
+            return NULL;
+        }
+    }
+    pBip->reserveStart = start;
+    pBip->reserveLen = len;
+    return &pBip->pBuf[start];
+}
+
+void BipBuffer_Commit(BipBufferType* pBip, uint32_t len)
+{
+    uint32_t write = pBip->write;
+    uint32_t start = pBip->reserveStart;
+    if (len > pBip->reserveLen) len = pBip->reserveLen;
+    pBip->reserveLen = 0;
+    if (len == 0) return;
+
+    if (start != write) {
+        // the reservation wrapped, the data up to the old write ends region A
+        pBip->last = write;
+    }
+    // data and last must be visible before the consumer can see write
+    __DMB();
+    pBip->write = start + len;
+}
+
+uint8_t* BipBuffer_Peek(BipBufferType* pBip, uint32_t* pLen)
+{
+    uint32_t write = pBip->write;
+    __DMB();
+    uint32_t last = pBip->last;
+    uint32_t read = pBip->read;
+
+    if (write < read && read == last) {
+        // region A is done, continue with B at the start
+        read = 0;
+        pBip->read = 0;
+    }
+    uint32_t len = write < read ? last - read : write - read;
+    *pLen = len;
+    return len ? &pBip->pBuf[read] : NULL;
+}
+
+void BipBuffer_Release(BipBufferType* pBip, uint32_t len)
+{
+    // the consumer must be done with the data before the producer reuses it
+    __DMB();
+    pBip->read = pBip->read + len;
+}
+
+uint32_t BipBuffer_GetUsed(const BipBufferType* pBip)
+{
+    uint32_t write = pBip->write;
+    __DMB();
+    uint32_t last = pBip->last;
+    uint32_t read = pBip->read;
+    return write < read ? last - read + write : write - read;
+}
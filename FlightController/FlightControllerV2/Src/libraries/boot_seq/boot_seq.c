@@ -0,0 +1,207 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "boot_seq.h"
+
+#include "clock.h"
+#include "logging.h"
+
+/*
+* Defines
+*/
+
+#define LOG_TAG ("BootSeq")
+
+/*
+* Struct
+*/
+
+typedef struct {
+    const BootStepConfigType* pConfig;
+    uint64_t attemptUs; // start of the current attempt
+    uint64_t retryUs;   // start of the next one, while BACKOFF
+    BootStepStatsType stats;
+} BootStepType;
+
+/*
+* Static
+*/
+
+static BootStepType sSteps[BOOT_SEQ_MAX_STEPS];
+static int sNumOfSteps = 0;
+static uint32_t sDoneMask = 0;
+static uint64_t sInitUs = 0;
+static uint32_t sReadyUs = 0;
+
+/*
+* Code
+*/
+
+bool BootSeq_Init(const BootStepConfigType* pSteps, int numOfSteps)
+{
+    if (!pSteps || numOfSteps <= 0 || numOfSteps > BOOT_SEQ_MAX_STEPS) {
+        LOGE("invalid step table, numOfSteps = %d\r\n", numOfSteps);
+        return false;
+    }
+    for (int i = 0; i < numOfSteps; ++i) {
+        const BootStepConfigType* pConfig = &pSteps[i];
+        if (!pConfig->start && !pConfig->poll) {
+            LOGE("step %d invalid\r\n", i);
+            return false;
+        }
+        // only on earlier entries, as in the scheduler, so one pass can run
+        // a chain of steps and cycles are impossible
+        if (pConfig->dependsOn & ~(BOOT_STEP_BIT(i) - 1)) {
+            LOGE("step %s depends on a later step\r\n", pConfig->name);
+            return false;
+        }
+    }
+
+    memset(sSteps, 0, sizeof(sSteps));
+    for (int i = 0; i < numOfSteps; ++i) {
+        sSteps[i].pConfig = &pSteps[i];
+        sSteps[i].stats.state = BOOT_STEP_WAITING;
+    }
+    sNumOfSteps = numOfSteps;
+    sDoneMask = 0;
+    sInitUs = Clock_GetUs();
+    sReadyUs = 0;
+    return true;
+}
+
+static void CompleteStep(int stepId)
+{
+    BootStepType* pStep = &sSteps[stepId];
+    uint64_t nowUs = Clock_GetUs();
+    pStep->stats.state = BOOT_STEP_COMPLETE;
+    pStep->stats.doneUs = (uint32_t) (nowUs - sInitUs);
+    pStep->stats.lastAttemptUs = (uint32_t) (nowUs - pStep->attemptUs);
+    sDoneMask |= BOOT_STEP_BIT(stepId);
+    LOGI("%s done at %u ms, took %u ms, %u attempts\r\n", pStep->pConfig->name, pStep->stats.doneUs / 1000,
+         pStep->stats.lastAttemptUs / 1000, pStep->stats.attempts);
+}
+
+static void FailStep(int stepId)
+{
+    BootStepType* pStep = &sSteps[stepId];
+    const BootStepConfigType* pConfig = pStep->pConfig;
+    if (pConfig->maxRetries != BOOT_STEP_RETRY_FOREVER && pStep->stats.attempts > pConfig->maxRetries) {
+        pStep->stats.state = BOOT_STEP_ABORTED;
+        LOGE("%s failed after %u attempts\r\n", pConfig->name, pStep->stats.attempts);
+        return;
+    }
+    pStep->stats.state = BOOT_STEP_BACKOFF;
+    pStep->retryUs = Clock_GetUs() + (uint64_t) pConfig->retryDelayMs * 1000;
+    LOGI("%s failed, retry in %u ms\r\n", pConfig->name, pConfig->retryDelayMs);
+}
+
+static void StartStep(int stepId)
+{
+    BootStepType* pStep = &sSteps[stepId];
+    pStep->attemptUs = Clock_GetUs();
+    if (pStep->stats.attempts++ == 0) {
+        pStep->stats.startUs = (uint32_t) (pStep->attemptUs - sInitUs);
+    }
+    pStep->stats.state = BOOT_STEP_RUNNING;
+    if (pStep->pConfig->start && !pStep->pConfig->start()) {
+        FailStep(stepId);
+    } else if (!pStep->pConfig->poll) {
+        CompleteStep(stepId);
+    }
+}
+
+static void PollStep(int stepId)
+{
+    BootStepType* pStep = &sSteps[stepId];
+    const BootStepConfigType* pConfig = pStep->pConfig;
+    switch (pConfig->poll()) {
+    case BOOT_STEP_DONE:
+        CompleteStep(stepId);
+        break;
+    case BOOT_STEP_FAILED:
+        FailStep(stepId);
+        break;
+    default:
+        if (pConfig->timeoutMs && Clock_GetUs() - pStep->attemptUs > (uint64_t) pConfig->timeoutMs * 1000) {
+            ++pStep->stats.timeouts;
+            LOGE("%s timed out after %u ms\r\n", pConfig->name, pConfig->timeoutMs);
+            FailStep(stepId);
+        }
+        break;
+    }
+}
+
+BootStepStatusType BootSeq_Poll()
+{
+    bool failed = false;
+    for (int i = 0; i < sNumOfSteps; ++i) {
+        BootStepType* pStep = &sSteps[i];
+        switch (pStep->stats.state) {
+        case BOOT_STEP_WAITING:
+            if ((pStep->pConfig->dependsOn & ~sDoneMask) == 0) StartStep(i);
+            break;
+        case BOOT_STEP_RUNNING:
+            PollStep(i);
+            break;
+        case BOOT_STEP_BACKOFF:
+            if (Clock_GetUs() >= pStep->retryUs) StartStep(i);
+            break;
+        case BOOT_STEP_ABORTED:
+            failed = true;
+            break;
+        default:
+            break;
+        }
+    }
+    if (failed) return BOOT_STEP_FAILED;
+    if (sDoneMask != BOOT_STEP_BIT(sNumOfSteps) - 1) return BOOT_STEP_PENDING;
+    if (sReadyUs == 0) sReadyUs = (uint32_t) (Clock_GetUs() - sInitUs);
+    return BOOT_STEP_DONE;
+}
+
+bool BootSeq_Run()
+{
+    BootStepStatusType status;
+    while ((status = BootSeq_Poll()) == BOOT_STEP_PENDING) {
+        // the steps wait on interrupts, SysTick at the latest
+        __WFI();
+    }
+    if (status == BOOT_STEP_DONE) {
+        LOGI("ready after %u ms\r\n", sReadyUs / 1000);
+    }
+    return status == BOOT_STEP_DONE;
+}
+
+uint32_t BootSeq_GetReadyUs()
+{
+    return sReadyUs;
+}
+
+int BootSeq_GetNumOfSteps()
+{
+    return sNumOfSteps;
+}
+
+const char* BootSeq_GetStepName(int stepId)
+{
+    if (stepId < 0 || stepId >= sNumOfSteps) return NULL;
+    return sSteps[stepId].pConfig->name;
+}
+
+bool BootSeq_GetStats(int stepId, BootStepStatsType* pStats)
+{
+    if (stepId < 0 || stepId >= sNumOfSteps || !pStats) return false;
+    *pStats = sSteps[stepId].stats;
+    return true;
+}
+
+void BootSeq_PrintStats()
+{
+    for (int i = 0; i < sNumOfSteps; ++i) {
+        const BootStepStatsType* pStats = &sSteps[i].stats;
+        LOGI("%s: state %d attempts %u timeouts %u, started at %u ms, done at %u ms, last attempt %u ms\r\n",
+             sSteps[i].pConfig->name, pStats->state, pStats->attempts, pStats->timeouts, pStats->startUs / 1000,
+             pStats->doneUs / 1000, pStats->lastAttemptUs / 1000);
+    }
+}
@@ -0,0 +1,99 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "calib_store.h"
+
+#include "flash.h"
+#include "logging.h"
+
+#define LOG_TAG ("CalibStore")
+
+/*
+ * Defines
+ */
+
+#define CALIB_STORE_ADDR (FLASH_DATA_PAGE_ADDR)
+#define CALIB_CRC32_POLY (0xEDB88320) // reflected 0x04C11DB7
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;      // sizeof(CalibDataType)
+    CalibDataType data;
+    uint32_t crc;       // from magic to the end of data
+} CalibRecordType;
+
+static_assert(sizeof(CalibRecordType) % 2 == 0, "flash is programmed in half words");
+static_assert(sizeof(CalibRecordType) <= FLASH_DATA_PAGE_LEN, "calibration record does not fit the page");
+
+/*
+ * Code
+ */
+
+uint32_t CalibStore_Crc32(const void* pData, uint32_t size)
+{
+    const uint8_t* pBytes = (const uint8_t*) pData;
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < size; ++i) {
+        crc ^= pBytes[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CALIB_CRC32_POLY : 0);
+        }
+    }
+    return ~crc;
+}
+
+bool CalibStore_Load(CalibDataType* pData)
+{
+    if (!pData) return false;
+    CalibRecordType record;
+    if (!Flash_Read(CALIB_STORE_ADDR, &record, sizeof(record))) return false;
+    if (record.magic != CALIB_STORE_MAGIC) {
+        LOGI("no calibration record\r\n");
+        return false;
+    }
+    if (record.version != CALIB_STORE_VERSION || record.size != sizeof(CalibDataType)) {
+        LOGI("calibration record version %u size %u, need %u size %u\r\n", record.version, record.size,
+             CALIB_STORE_VERSION, (unsigned) sizeof(CalibDataType));
+        return false;
+    }
+    if (record.crc != CalibStore_Crc32(&record, offsetof(CalibRecordType, crc))) {
+        LOGE("calibration record CRC mismatch\r\n");
+        return false;
+    }
+    *pData = record.data;
+    return true;
+}
+
+bool CalibStore_Save(const CalibDataType* pData)
+{
+    if (!pData) return false;
+    CalibRecordType record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CALIB_STORE_MAGIC;
+    record.version = CALIB_STORE_VERSION;
+    record.size = sizeof(CalibDataType);
+    record.data = *pData;
+    record.crc = CalibStore_Crc32(&record, offsetof(CalibRecordType, crc));
+
+    if (!Flash_ErasePage(CALIB_STORE_ADDR) || !Flash_Write(CALIB_STORE_ADDR, &record, sizeof(record))) {
+        LOGE("calibration record write failed\r\n");
+        return false;
+    }
+    // read back, a write to a page that did not erase fails quietly
+    CalibDataType check;
+    if (!CalibStore_Load(&check) || memcmp(&check, pData, sizeof(check)) != 0) {
+        LOGE("calibration record verify failed\r\n");
+        return false;
+    }
+    return true;
+}
+
+bool CalibStore_Erase()
+{
+    return Flash_ErasePage(CALIB_STORE_ADDR);
+}
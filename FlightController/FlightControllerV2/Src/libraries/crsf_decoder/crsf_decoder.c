@@ -0,0 +1,214 @@
+#include <string.h>
+
+#include "crsf_decoder.h"
+
+/*
+ * Defines
+ */
+
+#define CRSF_FRAME_LENGTH_INDEX (1)
+#define CRSF_CRC8_POLY (0xD5)
+
+/*
+ * Code
+ */
+
+static bool IsAddress(uint8_t byte)
+{
+    return byte == CRSF_ADDRESS_FLIGHT_CONTROLLER || byte == CRSF_ADDRESS_TRANSMITTER;
+}
+
+// drops the first count bytes and whatever follows up to the next address byte
+static void Drop(CRSFDecoderType* pDec, uint8_t count, bool skipped)
+{
+    uint8_t start = count;
+    while (start < pDec->len && !IsAddress(pDec->frame[start])) {
+        ++start;
+    }
+    pDec->stats.skippedBytes += skipped ? start : start - count;
+    pDec->len = (uint8_t) (pDec->len - start);
+    memmove(pDec->frame, &pDec->frame[start], pDec->len);
+}
+
+// the bytes in frame are not a frame, rescan them from the next address byte
+static void Resync(CRSFDecoderType* pDec)
+{
+    Drop(pDec, 1, true);
+}
+
+static bool IsLengthValid(uint8_t length)
+{
+    return length >= CRSF_MIN_LENGTH && length <= CRSF_MAX_LENGTH;
+}
+
+// the frame types with a fixed payload, a damaged length byte is caught
+// with the type instead of swallowing the frames after it
+static bool IsLengthValidForType(uint8_t length, uint8_t type)
+{
+    switch (type) {
+    case CRSF_FRAMETYPE_RC_CHANNELS_PACKED: return length == CRSF_RC_CHANNELS_PAYLOAD_LEN + CRSF_MIN_LENGTH;
+    case CRSF_FRAMETYPE_LINK_STATISTICS: return length == CRSF_LINK_STATISTICS_PAYLOAD_LEN + CRSF_MIN_LENGTH;
+    default: return true;
+    }
+}
+
+// a complete frame passed the CRC
+static void Accept(CRSFDecoderType* pDec, uint64_t timeUs)
+{
+    CRSFDecoderStatsType* pStats = &pDec->stats;
+    uint8_t type = pDec->frame[CRSF_FRAME_TYPE_INDEX];
+    ++pStats->frames;
+    if (type == CRSF_FRAMETYPE_LINK_STATISTICS) {
+        ++pStats->linkStatsFrames;
+    } else if (type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED) {
+        if (pStats->rcFrames == 0) {
+            pStats->firstRcFrameUs = timeUs;
+        } else {
+            uint32_t periodUs = (uint32_t) (timeUs - pStats->lastRcFrameUs);
+            if (periodUs < pStats->minPeriodUs) pStats->minPeriodUs = periodUs;
+            if (periodUs > pStats->maxPeriodUs) pStats->maxPeriodUs = periodUs;
+        }
+        pStats->lastRcFrameUs = timeUs;
+        ++pStats->rcFrames;
+    }
+}
+
+void CRSFDecoder_Init(CRSFDecoderType* pDec)
+{
+    pDec->len = 0;
+    CRSFDecoder_ResetStats(pDec);
+}
+
+void CRSFDecoder_ResetStats(CRSFDecoderType* pDec)
+{
+    memset(&pDec->stats, 0, sizeof(pDec->stats));
+    pDec->stats.minPeriodUs = UINT32_MAX;
+}
+
+// the first complete frame in the buffered bytes, rescanning past what is
+// not a frame
+static const uint8_t* Parse(CRSFDecoderType* pDec, uint64_t timeUs)
+{
+    while (pDec->len > CRSF_FRAME_LENGTH_INDEX) {
+        uint8_t length = pDec->frame[CRSF_FRAME_LENGTH_INDEX];
+        if (!IsLengthValid(length) ||
+            (pDec->len > CRSF_FRAME_TYPE_INDEX && !IsLengthValidForType(length, pDec->frame[CRSF_FRAME_TYPE_INDEX]))) {
+            ++pDec->stats.badLengths;
+            Resync(pDec);
+            continue;
+        }
+        int frameLen = length + 2;
+        if (pDec->len < frameLen) return NULL;
+
+        const uint8_t* pType = &pDec->frame[CRSF_FRAME_TYPE_INDEX];
+        if (CRSF_Crc8(pType, length - 1) != pType[length - 1]) {
+            ++pDec->stats.crcErrors;
+            Resync(pDec);
+            continue;
+        }
+        Accept(pDec, timeUs);
+        memcpy(pDec->out, pDec->frame, frameLen);
+        Drop(pDec, (uint8_t) frameLen, false);
+        return pDec->out;
+    }
+    return NULL;
+}
+
+const uint8_t* CRSFDecoder_PutByte(CRSFDecoderType* pDec, uint8_t byte, uint64_t timeUs)
+{
+    if (pDec->len == 0 && !IsAddress(byte)) {
+        ++pDec->stats.skippedBytes;
+        return NULL;
+    }
+    pDec->frame[pDec->len++] = byte;
+    return Parse(pDec, timeUs);
+}
+
+const uint8_t* CRSFDecoder_Next(CRSFDecoderType* pDec, uint64_t timeUs)
+{
+    return Parse(pDec, timeUs);
+}
+
+void CRSFDecoder_OnIdle(CRSFDecoderType* pDec)
+{
+    if (pDec->len) {
+        ++pDec->stats.partialFrames;
+        pDec->stats.skippedBytes += pDec->len;
+        pDec->len = 0;
+    }
+}
+
+float CRSFDecoder_GetRcFrameRateHz(const CRSFDecoderStatsType* pStats)
+{
+    if (pStats->rcFrames < 2 || pStats->lastRcFrameUs == pStats->firstRcFrameUs) return 0.0f;
+    return (float) (pStats->rcFrames - 1) * 1e6f / (float) (pStats->lastRcFrameUs - pStats->firstRcFrameUs);
+}
+
+uint8_t CRSF_Crc8(const uint8_t* pData, int len)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < len; ++i) {
+        crc ^= pData[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ CRSF_CRC8_POLY) : (uint8_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+void CRSF_UnpackChannels(const uint8_t* pPayload, uint16_t channels[CRSF_NUM_OF_CHANNELS])
+{
+    // little endian bit stream, channel 0 in the low bits of the first byte
+    uint32_t bits = 0;
+    int numOfBits = 0;
+    int ch = 0;
+    for (int i = 0; i < CRSF_RC_CHANNELS_PAYLOAD_LEN; ++i) {
+        bits |= (uint32_t) pPayload[i] << numOfBits;
+        numOfBits += 8;
+        if (numOfBits >= CRSF_CHANNEL_BITS) {
+            channels[ch++] = (uint16_t) (bits & 0x7FF);
+            bits >>= CRSF_CHANNEL_BITS;
+            numOfBits -= CRSF_CHANNEL_BITS;
+        }
+    }
+}
+
+void CRSF_PackChannels(const uint16_t channels[CRSF_NUM_OF_CHANNELS], uint8_t* pPayload)
+{
+    uint32_t bits = 0;
+    int numOfBits = 0;
+    int i = 0;
+    for (int ch = 0; ch < CRSF_NUM_OF_CHANNELS; ++ch) {
+        bits |= (uint32_t) (channels[ch] & 0x7FF) << numOfBits;
+        numOfBits += CRSF_CHANNEL_BITS;
+        while (numOfBits >= 8) {
+            pPayload[i++] = (uint8_t) bits;
+            bits >>= 8;
+            numOfBits -= 8;
+        }
+    }
+}
+
+void CRSF_ParseLinkStats(const uint8_t* pPayload, CRSFLinkStatsType* pLink)
+{
+    pLink->uplinkRssi1 = pPayload[0];
+    pLink->uplinkRssi2 = pPayload[1];
+    pLink->uplinkLinkQuality = pPayload[2];
+    pLink->uplinkSnr = (int8_t) pPayload[3];
+    pLink->activeAntenna = pPayload[4];
+    pLink->rfMode = pPayload[5];
+    pLink->uplinkTxPower = pPayload[6];
+    pLink->downlinkRssi = pPayload[7];
+    pLink->downlinkLinkQuality = pPayload[8];
+    pLink->downlinkSnr = (int8_t) pPayload[9];
+}
+
+int CRSF_BuildFrame(uint8_t type, const uint8_t* pPayload, int payloadLen, uint8_t* pFrame)
+{
+    pFrame[0] = CRSF_ADDRESS_FLIGHT_CONTROLLER;
+    pFrame[CRSF_FRAME_LENGTH_INDEX] = (uint8_t) (payloadLen + CRSF_MIN_LENGTH);
+    pFrame[CRSF_FRAME_TYPE_INDEX] = type;
+    memcpy(&pFrame[CRSF_FRAME_PAYLOAD_INDEX], pPayload, payloadLen);
+    pFrame[CRSF_FRAME_PAYLOAD_INDEX + payloadLen] = CRSF_Crc8(&pFrame[CRSF_FRAME_TYPE_INDEX], payloadLen + 1);
+    return payloadLen + 4;
+}
@@ -0,0 +1,88 @@
+#include <math.h>
+#include <string.h>
+
+#include "decimator.h"
+
+/*
+ * Defines
+ */
+
+#define DECIMATOR_PI (3.1415926f)
+
+/*
+ * Code
+ */
+
+// RBJ low pass section; the Butterworth response of the cascade comes from
+// the Q of each stage, 1 / (2 sin((2k + 1) pi / 4N)) for N stages
+static void Decimator_SetLowPass(DecimatorCoeffType* pCoeff, float inputRateHz, float cutoffHz, float q)
+{
+    float w0 = 2.0f * DECIMATOR_PI * cutoffHz / inputRateHz;
+    float cosW0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    pCoeff->b0 = (1.0f - cosW0) * 0.5f / a0;
+    pCoeff->b1 = (1.0f - cosW0) / a0;
+    pCoeff->b2 = pCoeff->b0;
+    pCoeff->a1 = -2.0f * cosW0 / a0;
+    pCoeff->a2 = (1.0f - alpha) / a0;
+}
+
+bool Decimator_Init(DecimatorType* pDec, int numOfChannels, float inputRateHz, int factor, float cutoffHz, int numOfStages)
+{
+    if (!pDec || numOfChannels <= 0 || numOfChannels > DECIMATOR_MAX_CHANNELS) return false;
+    if (numOfStages <= 0 || numOfStages > DECIMATOR_MAX_STAGES || factor <= 0) return false;
+    if (cutoffHz <= 0.0f || cutoffHz >= inputRateHz * 0.5f) return false;
+    memset(pDec, 0, sizeof(DecimatorType));
+    pDec->numOfChannels = numOfChannels;
+    pDec->numOfStages = numOfStages;
+    pDec->factor = factor;
+    for (int k = 0; k < numOfStages; ++k) {
+        float q = 1.0f / (2.0f * sinf((2 * k + 1) * DECIMATOR_PI / (4.0f * numOfStages)));
+        Decimator_SetLowPass(&pDec->coeff[k], inputRateHz, cutoffHz, q);
+    }
+    return true;
+}
+
+void Decimator_Reset(DecimatorType* pDec)
+{
+    pDec->primed = false;
+    pDec->phase = 0;
+}
+
+// state of a section that has seen x for ever, its DC gain is 1
+static void Decimator_Prime(DecimatorType* pDec, const float* pIn)
+{
+    for (int k = 0; k < pDec->numOfStages; ++k) {
+        const DecimatorCoeffType* pCoeff = &pDec->coeff[k];
+        for (int i = 0; i < pDec->numOfChannels; ++i) {
+            pDec->z2[k][i] = pIn[i] * (pCoeff->b2 - pCoeff->a2);
+            pDec->z1[k][i] = pIn[i] * (pCoeff->b1 - pCoeff->a1) + pDec->z2[k][i];
+        }
+    }
+    pDec->primed = true;
+}
+
+bool Decimator_Put(DecimatorType* pDec, const float* pIn, float* pOut)
+{
+    if (!pDec->primed) Decimator_Prime(pDec, pIn);
+
+    float y[DECIMATOR_MAX_CHANNELS];
+    memcpy(y, pIn, pDec->numOfChannels * sizeof(float));
+    for (int k = 0; k < pDec->numOfStages; ++k) {
+        const DecimatorCoeffType* pCoeff = &pDec->coeff[k];
+        float* z1 = pDec->z1[k];
+        float* z2 = pDec->z2[k];
+        for (int i = 0; i < pDec->numOfChannels; ++i) {
+            float x = y[i];
+            y[i] = pCoeff->b0 * x + z1[i];
+            z1[i] = pCoeff->b1 * x - pCoeff->a1 * y[i] + z2[i];
+            z2[i] = pCoeff->b2 * x - pCoeff->a2 * y[i];
+        }
+    }
+
+    if (++pDec->phase < pDec->factor) return false;
+    pDec->phase = 0;
+    memcpy(pOut, y, pDec->numOfChannels * sizeof(float));
+    return true;
+}
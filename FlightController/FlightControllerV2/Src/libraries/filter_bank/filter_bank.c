@@ -0,0 +1,287 @@
+#include <math.h>
+#include <string.h>
+
+#include "filter_bank.h"
+
+/*
+ * Defines
+ */
+
+#define FILTER_BANK_PI (3.1415926f)
+#define FILTER_BANK_BUTTERWORTH_Q (0.70710678f)
+// per PT1 of a PT2, so that the cascade is 3 dB down at the cutoff:
+// 1 / sqrt(2^(1/2) - 1)
+#define FILTER_BANK_PT2_SCALE (1.553774f)
+#define FILTER_BANK_Q_ONE (1 << FILTER_BANK_Q_BITS)
+#define FILTER_BANK_Q_ROUND ((int64_t) 1 << (FILTER_BANK_Q_BITS - 1))
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    float b0, b1, b2;
+    float a1, a2;
+} FilterCoeffType;
+
+/*
+ * Code
+ */
+
+static float PT1Gain(float sampleRateHz, float hz)
+{
+    float w = 2.0f * FILTER_BANK_PI * hz / sampleRateHz;
+    return w / (w + 1.0f);
+}
+
+// RBJ cookbook sections, normalised to a0 = 1
+static bool Design(FilterKindType kind, float sampleRateHz, float hz, float q, FilterCoeffType* pCoeff)
+{
+    if (hz <= 0.0f || hz >= sampleRateHz * 0.5f) return false;
+    memset(pCoeff, 0, sizeof(FilterCoeffType));
+    switch (kind) {
+    case FILTER_PT1:
+        pCoeff->b0 = PT1Gain(sampleRateHz, hz);
+        return true;
+    case FILTER_PT2:
+        pCoeff->b0 = PT1Gain(sampleRateHz, hz * FILTER_BANK_PT2_SCALE);
+        return true;
+    case FILTER_BIQUAD_LPF:
+    case FILTER_NOTCH: {
+        if (kind == FILTER_BIQUAD_LPF && q <= 0.0f) q = FILTER_BANK_BUTTERWORTH_Q;
+        if (q <= 0.0f) return false;
+        float w0 = 2.0f * FILTER_BANK_PI * hz / sampleRateHz;
+        float cosW0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * q);
+        float a0 = 1.0f + alpha;
+        if (kind == FILTER_BIQUAD_LPF) {
+            pCoeff->b0 = (1.0f - cosW0) * 0.5f / a0;
+            pCoeff->b1 = (1.0f - cosW0) / a0;
+            pCoeff->b2 = pCoeff->b0;
+        } else {
+            pCoeff->b0 = 1.0f / a0;
+            pCoeff->b1 = -2.0f * cosW0 / a0;
+            pCoeff->b2 = pCoeff->b0;
+        }
+        pCoeff->a1 = -2.0f * cosW0 / a0;
+        pCoeff->a2 = (1.0f - alpha) / a0;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static int32_t ToQ(float coeff)
+{
+    return (int32_t) lrintf(coeff * (float) FILTER_BANK_Q_ONE);
+}
+
+/*
+ * Float
+ */
+
+bool FilterBank_Init(FilterBankType* pBank, float sampleRateHz)
+{
+    if (!pBank || sampleRateHz <= 0.0f) return false;
+    memset(pBank, 0, sizeof(FilterBankType));
+    pBank->sampleRateHz = sampleRateHz;
+    return true;
+}
+
+int FilterBank_AddStage(FilterBankType* pBank, FilterKindType kind, float hz, float q)
+{
+    if (pBank->numOfStages >= FILTER_BANK_MAX_STAGES) return -1;
+    int stageId = pBank->numOfStages;
+    pBank->stage[stageId].kind = kind;
+    if (!FilterBank_SetStage(pBank, stageId, hz, q)) return -1;
+    ++pBank->numOfStages;
+    // the new stage has no state yet
+    pBank->primed = false;
+    return stageId;
+}
+
+bool FilterBank_SetStage(FilterBankType* pBank, int stageId, float hz, float q)
+{
+    if (stageId < 0 || stageId >= FILTER_BANK_MAX_STAGES) return false;
+    FilterStageType* pStage = &pBank->stage[stageId];
+    FilterCoeffType coeff;
+    if (!Design(pStage->kind, pBank->sampleRateHz, hz, q, &coeff)) return false;
+    pStage->b0 = coeff.b0;
+    pStage->b1 = coeff.b1;
+    pStage->b2 = coeff.b2;
+    pStage->a1 = coeff.a1;
+    pStage->a2 = coeff.a2;
+    return true;
+}
+
+void FilterBank_Reset(FilterBankType* pBank)
+{
+    pBank->primed = false;
+}
+
+// state of a cascade that has seen x for ever, every stage has a DC gain of 1
+static void FilterBank_Prime(FilterBankType* pBank, const float* pIn)
+{
+    for (int k = 0; k < pBank->numOfStages; ++k) {
+        FilterStageType* pStage = &pBank->stage[k];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            if (pStage->kind == FILTER_PT1 || pStage->kind == FILTER_PT2) {
+                pStage->z1[i] = pIn[i];
+                pStage->z2[i] = pIn[i];
+            } else {
+                pStage->z2[i] = pIn[i] * (pStage->b2 - pStage->a2);
+                pStage->z1[i] = pIn[i] * (pStage->b1 - pStage->a1) + pStage->z2[i];
+            }
+        }
+    }
+    pBank->primed = true;
+}
+
+void FilterBank_Apply(FilterBankType* pBank, const float* pIn, float* pOut)
+{
+    if (!pBank->primed) FilterBank_Prime(pBank, pIn);
+
+    float y[FILTER_BANK_AXES];
+    memcpy(y, pIn, sizeof(y));
+    for (int k = 0; k < pBank->numOfStages; ++k) {
+        FilterStageType* pStage = &pBank->stage[k];
+        float* z1 = pStage->z1;
+        float* z2 = pStage->z2;
+        switch (pStage->kind) {
+        case FILTER_PT1: {
+            float gain = pStage->b0;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                z1[i] += gain * (y[i] - z1[i]);
+                y[i] = z1[i];
+            }
+            break;
+        }
+        case FILTER_PT2: {
+            float gain = pStage->b0;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                z1[i] += gain * (y[i] - z1[i]);
+                z2[i] += gain * (z1[i] - z2[i]);
+                y[i] = z2[i];
+            }
+            break;
+        }
+        default: {
+            float b0 = pStage->b0, b1 = pStage->b1, b2 = pStage->b2;
+            float a1 = pStage->a1, a2 = pStage->a2;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                float x = y[i];
+                y[i] = b0 * x + z1[i];
+                z1[i] = b1 * x - a1 * y[i] + z2[i];
+                z2[i] = b2 * x - a2 * y[i];
+            }
+            break;
+        }
+        }
+    }
+    memcpy(pOut, y, sizeof(y));
+}
+
+/*
+ * Fixed point
+ */
+
+bool FilterBankQ_Init(FilterBankQType* pBank, float sampleRateHz)
+{
+    if (!pBank || sampleRateHz <= 0.0f) return false;
+    memset(pBank, 0, sizeof(FilterBankQType));
+    pBank->sampleRateHz = sampleRateHz;
+    return true;
+}
+
+int FilterBankQ_AddStage(FilterBankQType* pBank, FilterKindType kind, float hz, float q)
+{
+    if (pBank->numOfStages >= FILTER_BANK_MAX_STAGES) return -1;
+    int stageId = pBank->numOfStages;
+    pBank->stage[stageId].kind = kind;
+    if (!FilterBankQ_SetStage(pBank, stageId, hz, q)) return -1;
+    ++pBank->numOfStages;
+    pBank->primed = false;
+    return stageId;
+}
+
+bool FilterBankQ_SetStage(FilterBankQType* pBank, int stageId, float hz, float q)
+{
+    if (stageId < 0 || stageId >= FILTER_BANK_MAX_STAGES) return false;
+    FilterStageQType* pStage = &pBank->stage[stageId];
+    FilterCoeffType coeff;
+    if (!Design(pStage->kind, pBank->sampleRateHz, hz, q, &coeff)) return false;
+    pStage->b0 = ToQ(coeff.b0);
+    pStage->b1 = ToQ(coeff.b1);
+    pStage->b2 = ToQ(coeff.b2);
+    pStage->a1 = ToQ(coeff.a1);
+    pStage->a2 = ToQ(coeff.a2);
+    return true;
+}
+
+void FilterBankQ_Reset(FilterBankQType* pBank)
+{
+    pBank->primed = false;
+}
+
+// direct form I at DC holds the input in every tap
+static void FilterBankQ_Prime(FilterBankQType* pBank, const int32_t* pIn)
+{
+    for (int k = 0; k < pBank->numOfStages; ++k) {
+        FilterStageQType* pStage = &pBank->stage[k];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            pStage->x1[i] = pStage->x2[i] = pIn[i];
+            pStage->y1[i] = pStage->y2[i] = pIn[i];
+        }
+    }
+    pBank->primed = true;
+}
+
+void FilterBankQ_Apply(FilterBankQType* pBank, const int32_t* pIn, int32_t* pOut)
+{
+    if (!pBank->primed) FilterBankQ_Prime(pBank, pIn);
+
+    int32_t y[FILTER_BANK_AXES];
+    memcpy(y, pIn, sizeof(y));
+    for (int k = 0; k < pBank->numOfStages; ++k) {
+        FilterStageQType* pStage = &pBank->stage[k];
+        int32_t* y1 = pStage->y1;
+        int32_t* y2 = pStage->y2;
+        switch (pStage->kind) {
+        case FILTER_PT1: {
+            int64_t gain = pStage->b0;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                y1[i] += (int32_t) ((gain * (y[i] - y1[i]) + FILTER_BANK_Q_ROUND) >> FILTER_BANK_Q_BITS);
+                y[i] = y1[i];
+            }
+            break;
+        }
+        case FILTER_PT2: {
+            int64_t gain = pStage->b0;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                y1[i] += (int32_t) ((gain * (y[i] - y1[i]) + FILTER_BANK_Q_ROUND) >> FILTER_BANK_Q_BITS);
+                y2[i] += (int32_t) ((gain * (y1[i] - y2[i]) + FILTER_BANK_Q_ROUND) >> FILTER_BANK_Q_BITS);
+                y[i] = y2[i];
+            }
+            break;
+        }
+        default: {
+            int32_t* x1 = pStage->x1;
+            int32_t* x2 = pStage->x2;
+            int64_t b0 = pStage->b0, b1 = pStage->b1, b2 = pStage->b2;
+            int64_t a1 = pStage->a1, a2 = pStage->a2;
+            for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+                int32_t x = y[i];
+                int64_t acc = b0 * x + b1 * x1[i] + b2 * x2[i] - a1 * y1[i] - a2 * y2[i];
+                y[i] = (int32_t) ((acc + FILTER_BANK_Q_ROUND) >> FILTER_BANK_Q_BITS);
+                x2[i] = x1[i];
+                x1[i] = x;
+                y2[i] = y1[i];
+                y1[i] = y[i];
+            }
+            break;
+        }
+        }
+    }
+    memcpy(pOut, y, sizeof(y));
+}
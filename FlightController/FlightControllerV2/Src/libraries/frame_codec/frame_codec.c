@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "frame_codec.h"
+
+/*
+ * No HAL or logging in here, the host tools build this file as is.
+ */
+
+/*
+ * Code
+ */
+
+static uint32_t ZigZag(uint32_t value)
+{
+    return (value << 1) ^ (uint32_t) -(int32_t) (value >> 31);
+}
+
+static uint32_t UnZigZag(uint32_t value)
+{
+    return (value >> 1) ^ (uint32_t) -(int32_t) (value & 1);
+}
+
+static uint32_t Predict(const FrameCodecStateType* pState, int field, bool keyframe)
+{
+    if (keyframe) return 0;
+    switch (pState->pConfig->pPredictors[field]) {
+    case FRAME_CODEC_PREDICT_PREVIOUS:
+        return (uint32_t) pState->prev[field];
+    case FRAME_CODEC_PREDICT_LINEAR:
+        // falls back to the previous value until there are two frames
+        if (pState->history < 2) return (uint32_t) pState->prev[field];
+        return 2u * (uint32_t) pState->prev[field] - (uint32_t) pState->prev2[field];
+    default:
+        return 0;
+    }
+}
+
+static void PushHistory(FrameCodecStateType* pState, const int32_t* pFields, bool keyframe)
+{
+    int numOfFields = pState->pConfig->numOfFields;
+    memcpy(pState->prev2, pState->prev, numOfFields * sizeof(int32_t));
+    memcpy(pState->prev, pFields, numOfFields * sizeof(int32_t));
+    // a keyframe starts a new history, LINEAR must not reach across it
+    pState->history = keyframe ? 1 : 2;
+}
+
+bool FrameCodec_Init(FrameCodecStateType* pState, const FrameCodecConfigType* pConfig)
+{
+    if (!pState || !pConfig || !pConfig->pPredictors || pConfig->numOfFields <= 0
+        || pConfig->numOfFields > FRAME_CODEC_MAX_FIELDS || pConfig->keyframeInterval == 0) {
+        return false;
+    }
+    memset(pState, 0, sizeof(FrameCodecStateType));
+    pState->pConfig = pConfig;
+    return true;
+}
+
+void FrameCodec_Reset(FrameCodecStateType* pState)
+{
+    pState->history = 0;
+    pState->framesSinceKeyframe = 0;
+}
+
+int FrameCodec_Encode(FrameCodecStateType* pState, const int32_t* pFields, uint8_t* pOut, int outSize)
+{
+    const FrameCodecConfigType* pConfig = pState->pConfig;
+    if (outSize < FRAME_CODEC_MAX_LEN(pConfig->numOfFields)) return 0;
+
+    bool keyframe = pState->history == 0 || pState->framesSinceKeyframe >= pConfig->keyframeInterval;
+    int len = 0;
+    pOut[len++] = keyframe ? FRAME_CODEC_KEYFRAME : FRAME_CODEC_DELTA;
+    for (int i = 0; i < pConfig->numOfFields; ++i) {
+        uint32_t value = ZigZag((uint32_t) pFields[i] - Predict(pState, i, keyframe));
+        while (value >= 0x80) {
+            pOut[len++] = (uint8_t) (value | 0x80);
+            value >>= 7;
+        }
+        pOut[len++] = (uint8_t) value;
+    }
+
+    PushHistory(pState, pFields, keyframe);
+    pState->framesSinceKeyframe = keyframe ? 1 : pState->framesSinceKeyframe + 1;
+    return len;
+}
+
+int FrameCodec_Decode(FrameCodecStateType* pState, const uint8_t* pIn, int inSize, int32_t* pFields)
+{
+    const FrameCodecConfigType* pConfig = pState->pConfig;
+    if (inSize < 1) return 0;
+    bool keyframe = pIn[0] == FRAME_CODEC_KEYFRAME;
+    if (!keyframe && (pIn[0] != FRAME_CODEC_DELTA || pState->history == 0)) return 0;
+
+    int len = 1;
+    for (int i = 0; i < pConfig->numOfFields; ++i) {
+        uint32_t value = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (len >= inSize || shift >= 7 * FRAME_CODEC_MAX_VARINT_LEN) return 0;
+            byte = pIn[len++];
+            value |= (uint32_t) (byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        pFields[i] = (int32_t) (UnZigZag(value) + Predict(pState, i, keyframe));
+    }
+
+    PushHistory(pState, pFields, keyframe);
+    return len;
+}
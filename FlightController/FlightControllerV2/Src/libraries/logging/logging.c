@@ -1,4 +1,3 @@
-
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,41 +5,206 @@
 #include <uart.h>
 
 #include "UAV_Defines.h"
+#include "log_token.h"
 #include "logging.h"
 
-#define HEADER_LEN (16)
+#define HEADER_LEN (17) // "L|tag         : " and the terminator
 #define MSG_LEN    (128)
+#define LOG_BUILT_IN (UAV_Debug || UAV_DEBUG_CMD)
+
+#if LOG_BUILT_IN
+typedef struct {
+   uint8_t* pBuf;
+   int len;
+   bool full;
+} ArgPackerType;
+
+static const char LEVEL_MAP[] = {
+   'E',
+   'W',
+   'I',
+   'V',
+};
+
+// length actually written by a bounded printf, which returns the untruncated length
+static int ClampLen(int len, int size)
+{
+   if (len < 0) return 0;
+   return len < size ? len : size - 1;
+}
 
-#if UAV_Debug
-static char headerBuf[HEADER_LEN] = {0};
-static char msgBuf[MSG_LEN] = {0};
+static bool sReplying = false;
+
+// everything with UAV_Debug, otherwise only a debug command's reply
+static bool LogEnabled()
+{
+   return UAV_Debug || sReplying;
+}
 #endif
 
+void LogBeginReply()
+{
+#if UAV_DEBUG_CMD
+   sReplying = true;
+#endif
+}
+
+void LogEndReply()
+{
+#if UAV_DEBUG_CMD
+   sReplying = false;
+#endif
+}
+
 void LogPrint(int level, const char* pTag, const char* pFmt, ...)
 {
-#if UAV_Debug
+#if LOG_BUILT_IN
+   if (!LogEnabled()) return;
+   // formatted on the stack so interrupt handlers can log too, only the
+   // exact length is queued for the UART
+   char buf[HEADER_LEN + MSG_LEN];
+   int len = ClampLen(snprintf(buf, HEADER_LEN, "%c|%-12.12s: ", LEVEL_MAP[level], pTag), HEADER_LEN);
+
    va_list args;
    va_start(args, pFmt);
-   // vnsprintf(msgBuf, MSG_LEN, pFmt, args); // vnsprintf seems to be unsupported
-   vsprintf(msgBuf, pFmt, args);
+   len += ClampLen(vsnprintf(buf + len, MSG_LEN, pFmt, args), MSG_LEN);
    va_end(args);
-
-   snprintf(headerBuf, HEADER_LEN, "%c|%-12.12s: ", LEVEL_MAP[level], pTag);
-   UART_Send(headerBuf, HEADER_LEN);
-   UART_Send(msgBuf, MSG_LEN);
-   memset(msgBuf, 0, MSG_LEN);
+   UART_Send(buf, len);
+#else
+   (void) level;
+   (void) pTag;
+   (void) pFmt;
 #endif
 }
 
 void Print(const char* pFmt, ...)
 {
-#if UAV_Debug
+#if LOG_BUILT_IN
+   if (!LogEnabled()) return;
+   char buf[MSG_LEN];
    va_list args;
    va_start(args, pFmt);
-   vsprintf(msgBuf, pFmt, args);
+   int len = ClampLen(vsnprintf(buf, MSG_LEN, pFmt, args), MSG_LEN);
    va_end(args);
-   UART_Send(msgBuf, MSG_LEN);
-   memset(msgBuf, 0, MSG_LEN); // clear buffer
+   UART_Send(buf, len);
+#else
+   (void) pFmt;
 #endif
 }
 
+#if LOG_BUILT_IN
+static void PackBytes(ArgPackerType* pPacker, const void* pData, int size)
+{
+   if (pPacker->full || pPacker->len + size > LOG_TOKEN_MAX_ARGS_LEN) {
+      // keep the arguments before the first one that does not fit
+      pPacker->full = true;
+      return;
+   }
+   memcpy(pPacker->pBuf + pPacker->len, pData, size);
+   pPacker->len += size;
+}
+
+static void PackU32(ArgPackerType* pPacker, uint32_t value)
+{
+   PackBytes(pPacker, &value, sizeof(value)); // the target and hosts are little endian
+}
+
+static void PackString(ArgPackerType* pPacker, const char* pStr)
+{
+   if (!pStr) pStr = "(null)";
+   uint8_t len = 0;
+   while (pStr[len] && len < LOG_TOKEN_MAX_STR_LEN) ++len;
+   if (pPacker->full || pPacker->len + 1 + len > LOG_TOKEN_MAX_ARGS_LEN) {
+      pPacker->full = true;
+      return;
+   }
+   PackBytes(pPacker, &len, 1);
+   PackBytes(pPacker, pStr, len);
+}
+
+// walks the conversions of pFmt and stores each argument raw, no formatting
+static void PackArgs(ArgPackerType* pPacker, const char* pFmt, va_list args)
+{
+   for (const char* p = pFmt; *p; ++p) {
+      if (*p != '%') continue;
+      ++p;
+      if (*p == '%') continue;
+      while (*p && strchr("-+ #0", *p)) ++p;
+      if (*p == '*') {
+         PackU32(pPacker, (uint32_t) va_arg(args, int));
+         ++p;
+      }
+      while (*p >= '0' && *p <= '9') ++p;
+      if (*p == '.') {
+         ++p;
+         if (*p == '*') {
+            PackU32(pPacker, (uint32_t) va_arg(args, int));
+            ++p;
+         }
+         while (*p >= '0' && *p <= '9') ++p;
+      }
+      int longs = 0;
+      while (*p && strchr("hlLzjt", *p)) {
+         if (*p == 'l') ++longs;
+         ++p;
+      }
+
+      switch (*p) {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+         if (longs >= 2) {
+            uint64_t value = va_arg(args, unsigned long long);
+            PackBytes(pPacker, &value, sizeof(value));
+         } else if (longs == 1) {
+            PackU32(pPacker, (uint32_t) va_arg(args, unsigned long));
+         } else {
+            PackU32(pPacker, (uint32_t) va_arg(args, unsigned int));
+         }
+         break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+         float value = (float) va_arg(args, double);
+         PackBytes(pPacker, &value, sizeof(value));
+         break;
+      }
+      case 's':
+         PackString(pPacker, va_arg(args, const char*));
+         break;
+      case 'p':
+         PackU32(pPacker, (uint32_t) (uintptr_t) va_arg(args, void*));
+         break;
+      default:
+         // unknown conversion, the argument list can not be followed any further
+         return;
+      }
+   }
+}
+#endif
+
+void LogPrintToken(int level, uint32_t token, const char* pFmt, ...)
+{
+#if LOG_BUILT_IN
+   if (!LogEnabled()) return;
+   uint8_t frame[LOG_TOKEN_MAX_FRAME_LEN];
+   ArgPackerType packer = { &frame[LOG_TOKEN_HEADER_LEN], 0, false };
+
+   va_list args;
+   va_start(args, pFmt);
+   PackArgs(&packer, pFmt, args);
+   va_end(args);
+
+   frame[0] = LOG_TOKEN_SYNC;
+   frame[1] = (uint8_t) level;
+   frame[2] = (uint8_t) packer.len;
+   memcpy(&frame[3], &token, sizeof(token));
+   int len = LOG_TOKEN_HEADER_LEN + packer.len;
+   uint8_t checksum = 0;
+   for (int i = 1; i < len; ++i) {
+      checksum += frame[i];
+   }
+   frame[len++] = checksum;
+   UART_Send((const char*) frame, len);
+#else
+   (void) level;
+   (void) token;
+   (void) pFmt;
+#endif
+}
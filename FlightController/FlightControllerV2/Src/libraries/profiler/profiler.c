@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "profiler.h"
+
+#include "clock.h"
+#include "logging.h"
+
+/*
+* Defines
+*/
+
+#define LOG_TAG ("Profiler")
+
+#define HIST_ENTRIES_PER_LINE (6)
+
+/*
+* Struct
+*/
+
+typedef struct {
+    const char* name;
+    ProfilerStatsType stats;
+} ProfilerPointType;
+
+/*
+* Static
+*/
+
+static ProfilerPointType sPoints[PROFILER_MAX_POINTS];
+static int sNumOfPoints = 0;
+
+/*
+* Code
+*/
+
+static void ResetPointStats(ProfilerStatsType* pStats)
+{
+    memset(pStats, 0, sizeof(ProfilerStatsType));
+    pStats->minCycles = UINT32_MAX;
+}
+
+static int GetBucket(uint32_t cycles)
+{
+    int bucket = 0;
+    while (cycles > 1 && bucket < PROFILER_NUM_OF_BUCKETS - 1) {
+        cycles >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+int Profiler_Register(const char* name)
+{
+    for (int i = 0; i < sNumOfPoints; ++i) {
+        if (strcmp(sPoints[i].name, name) == 0) return i;
+    }
+    if (sNumOfPoints >= PROFILER_MAX_POINTS) {
+        LOGE("no free profile point for %s\r\n", name);
+        return PROFILER_INVALID_ID;
+    }
+    int id = sNumOfPoints++;
+    sPoints[id].name = name;
+    ResetPointStats(&sPoints[id].stats);
+    return id;
+}
+
+__weak uint32_t Profiler_GetCycles()
+{
+    return Clock_GetCycles();
+}
+
+void Profiler_Record(int id, uint32_t cycles)
+{
+    if (id < 0 || id >= sNumOfPoints) return;
+
+    ProfilerStatsType* pStats = &sPoints[id].stats;
+    ++pStats->count;
+    pStats->totalCycles += cycles;
+    if (cycles < pStats->minCycles) pStats->minCycles = cycles;
+    if (cycles > pStats->maxCycles) pStats->maxCycles = cycles;
+    ++pStats->histogram[GetBucket(cycles)];
+}
+
+int Profiler_GetNumOfPoints()
+{
+    return sNumOfPoints;
+}
+
+const char* Profiler_GetName(int id)
+{
+    if (id < 0 || id >= sNumOfPoints) return NULL;
+    return sPoints[id].name;
+}
+
+bool Profiler_GetStats(int id, ProfilerStatsType* pStats)
+{
+    if (!pStats || id < 0 || id >= sNumOfPoints) return false;
+    *pStats = sPoints[id].stats;
+    return true;
+}
+
+void Profiler_Reset()
+{
+    for (int i = 0; i < sNumOfPoints; ++i) {
+        ResetPointStats(&sPoints[i].stats);
+    }
+}
+
+void Profiler_Print()
+{
+    for (int i = 0; i < sNumOfPoints; ++i) {
+        const ProfilerStatsType* pStats = &sPoints[i].stats;
+        uint32_t meanCycles = pStats->count ? (uint32_t) (pStats->totalCycles / pStats->count) : 0;
+        PRINT("%-20.20s n %u cycles min %u mean %u max %u (mean %u us)\r\n", sPoints[i].name, pStats->count,
+              pStats->count ? pStats->minCycles : 0, meanCycles, pStats->maxCycles, Clock_CyclesToUs(meanCycles));
+
+        // nonzero histogram buckets as 2^k:count, a few per line to fit the log buffer
+        char line[96];
+        int len = 0;
+        int entries = 0;
+        for (int b = 0; b < PROFILER_NUM_OF_BUCKETS; ++b) {
+            if (!pStats->histogram[b]) continue;
+            len += snprintf(line + len, sizeof(line) - len, " 2^%d:%u", b, pStats->histogram[b]);
+            if (++entries == HIST_ENTRIES_PER_LINE) {
+                PRINT("  %s\r\n", line);
+                len = 0;
+                entries = 0;
+            }
+        }
+        if (entries) PRINT("  %s\r\n", line);
+    }
+}
@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include "rc_smoothing.h"
+
+/*
+ * Defines
+ */
+
+#define RC_SMOOTHING_PI (3.1415926f)
+#define RC_SMOOTHING_PERIOD_AVG_SHIFT (3) // the period average follows 1/8 of each new interval
+
+/*
+ * Code
+ */
+
+static void Interpolate(const RcSmoothingType* pSmoothing, uint64_t nowUs, float* pOut)
+{
+    float t = 1.0f;
+    if (nowUs < pSmoothing->frameUs) {
+        t = 0.0f;
+    } else if (nowUs - pSmoothing->frameUs < pSmoothing->framePeriodUs) {
+        t = (float) (nowUs - pSmoothing->frameUs) / (float) pSmoothing->framePeriodUs;
+    }
+    for (int i = 0; i < pSmoothing->numOfChannels; ++i) {
+        pOut[i] = pSmoothing->from[i] + (pSmoothing->target[i] - pSmoothing->from[i]) * t;
+    }
+}
+
+static void UpdatePT1(RcSmoothingType* pSmoothing, uint64_t nowUs)
+{
+    if (nowUs <= pSmoothing->lastUs) return;
+    float dt = (float) (nowUs - pSmoothing->lastUs) * 1e-6f;
+    float rc = 1.0f / (2.0f * RC_SMOOTHING_PI * pSmoothing->cutoffHz);
+    float k = dt / (rc + dt);
+    for (int i = 0; i < pSmoothing->numOfChannels; ++i) {
+        pSmoothing->out[i] += k * (pSmoothing->target[i] - pSmoothing->out[i]);
+    }
+    pSmoothing->lastUs = nowUs;
+}
+
+bool RcSmoothing_Init(RcSmoothingType* pSmoothing, RcSmoothingModeType mode, int numOfChannels, float cutoffHz)
+{
+    if (!pSmoothing || numOfChannels <= 0 || numOfChannels > RC_SMOOTHING_MAX_CHANNELS) return false;
+    if (mode == RC_SMOOTHING_PT1 && cutoffHz <= 0.0f) return false;
+    memset(pSmoothing, 0, sizeof(RcSmoothingType));
+    pSmoothing->mode = mode;
+    pSmoothing->numOfChannels = numOfChannels;
+    pSmoothing->cutoffHz = cutoffHz;
+    pSmoothing->framePeriodUs = RC_SMOOTHING_DEFAULT_PERIOD_US;
+    return true;
+}
+
+void RcSmoothing_Reset(RcSmoothingType* pSmoothing)
+{
+    pSmoothing->hasTarget = false;
+}
+
+void RcSmoothing_SetTarget(RcSmoothingType* pSmoothing, const float* pTarget, uint64_t frameUs)
+{
+    int num = pSmoothing->numOfChannels;
+    if (!pSmoothing->hasTarget) {
+        memcpy(pSmoothing->from, pTarget, num * sizeof(float));
+        memcpy(pSmoothing->out, pTarget, num * sizeof(float));
+        pSmoothing->lastUs = frameUs;
+    } else {
+        uint64_t intervalUs = frameUs - pSmoothing->frameUs;
+        if (intervalUs >= RC_SMOOTHING_MIN_PERIOD_US && intervalUs <= RC_SMOOTHING_MAX_PERIOD_US) {
+            int32_t diff = (int32_t) intervalUs - (int32_t) pSmoothing->framePeriodUs;
+            pSmoothing->framePeriodUs = (uint32_t) ((int32_t) pSmoothing->framePeriodUs + diff / (1 << RC_SMOOTHING_PERIOD_AVG_SHIFT));
+        }
+        if (pSmoothing->mode == RC_SMOOTHING_INTERPOLATE) {
+            // continue from where the ramp to the previous target got to
+            Interpolate(pSmoothing, frameUs, pSmoothing->from);
+        } else if (pSmoothing->mode == RC_SMOOTHING_PT1) {
+            // the filter ran towards the old target up to now
+            UpdatePT1(pSmoothing, frameUs);
+        }
+    }
+    memcpy(pSmoothing->target, pTarget, num * sizeof(float));
+    pSmoothing->frameUs = frameUs;
+    pSmoothing->hasTarget = true;
+}
+
+bool RcSmoothing_Get(RcSmoothingType* pSmoothing, uint64_t nowUs, float* pOut)
+{
+    if (!pSmoothing->hasTarget) return false;
+    switch (pSmoothing->mode) {
+    case RC_SMOOTHING_INTERPOLATE:
+        Interpolate(pSmoothing, nowUs, pOut);
+        break;
+    case RC_SMOOTHING_PT1:
+        UpdatePT1(pSmoothing, nowUs);
+        memcpy(pOut, pSmoothing->out, pSmoothing->numOfChannels * sizeof(float));
+        break;
+    default:
+        memcpy(pOut, pSmoothing->target, pSmoothing->numOfChannels * sizeof(float));
+        break;
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+
+#include "sbus_decoder.h"
+
+/*
+ * Defines
+ */
+
+#define SBUS_FRAME_END_INDEX (SBUS_FRAME_LEN - 1)
+
+/*
+ * Code
+ */
+
+static bool IsEndByte(uint8_t byte)
+{
+    // SBUS, or one of the four SBUS2 telemetry slot markers
+    return byte == 0x00 || (byte & 0xCF) == 0x04;
+}
+
+// the bytes in frame are not a frame, keep them from the next header on
+static void Resync(SBUSDecoderType* pDec)
+{
+    uint8_t start = 1;
+    while (start < pDec->len && pDec->frame[start] != SBUS_FRAME_HEADER) {
+        ++start;
+    }
+    ++pDec->stats.resyncs;
+    pDec->stats.skippedBytes += start;
+    pDec->len = (uint8_t) (pDec->len - start);
+    memmove(pDec->frame, &pDec->frame[start], pDec->len);
+}
+
+static const uint8_t* Accept(SBUSDecoderType* pDec)
+{
+    SBUSDecoderStatsType* pStats = &pDec->stats;
+    uint8_t flags = pDec->pending[SBUS_FRAME_FLAGS_BYTE];
+    if (pStats->frames == 0) {
+        pStats->firstFrameUs = pDec->pendingUs;
+    } else {
+        uint32_t periodUs = (uint32_t) (pDec->pendingUs - pStats->lastFrameUs);
+        if (periodUs < pStats->minPeriodUs) pStats->minPeriodUs = periodUs;
+        if (periodUs > pStats->maxPeriodUs) pStats->maxPeriodUs = periodUs;
+    }
+    pStats->lastFrameUs = pDec->pendingUs;
+    ++pStats->frames;
+    if (flags & SBUS_FLAG_LOST_FRAME) ++pStats->lostFrames;
+    if (flags & SBUS_FLAG_FAILSAFE) ++pStats->failsafeFrames;
+    pDec->hasPending = false;
+    return pDec->pending;
+}
+
+static void Append(SBUSDecoderType* pDec, uint8_t byte, uint64_t timeUs)
+{
+    if (pDec->len == 0 && byte != SBUS_FRAME_HEADER) {
+        ++pDec->stats.skippedBytes;
+        return;
+    }
+    pDec->frame[pDec->len++] = byte;
+    if (pDec->len < SBUS_FRAME_LEN) return;
+
+    if (!IsEndByte(pDec->frame[SBUS_FRAME_END_INDEX])) {
+        Resync(pDec);
+        return;
+    }
+    memcpy(pDec->pending, pDec->frame, SBUS_FRAME_LEN);
+    pDec->hasPending = true;
+    pDec->pendingUs = timeUs;
+    pDec->len = 0;
+}
+
+void SBUSDecoder_Init(SBUSDecoderType* pDec)
+{
+    pDec->len = 0;
+    pDec->hasPending = false;
+    pDec->pendingUs = 0;
+    SBUSDecoder_ResetStats(pDec);
+}
+
+void SBUSDecoder_ResetStats(SBUSDecoderType* pDec)
+{
+    memset(&pDec->stats, 0, sizeof(pDec->stats));
+    pDec->stats.minPeriodUs = UINT32_MAX;
+}
+
+const uint8_t* SBUSDecoder_PutByte(SBUSDecoderType* pDec, uint8_t byte, uint64_t timeUs)
+{
+    const uint8_t* pFrame = NULL;
+    if (pDec->hasPending) {
+        if (byte == SBUS_FRAME_HEADER) {
+            pFrame = Accept(pDec);
+        } else {
+            // the end byte matched by chance, rescan the frame
+            pDec->hasPending = false;
+            memcpy(pDec->frame, pDec->pending, SBUS_FRAME_LEN);
+            pDec->len = SBUS_FRAME_LEN;
+            Resync(pDec);
+        }
+    }
+    // cannot complete a frame right after Accept(), pending stays intact
+    Append(pDec, byte, timeUs);
+    return pFrame;
+}
+
+const uint8_t* SBUSDecoder_OnIdle(SBUSDecoderType* pDec)
+{
+    if (pDec->len) {
+        ++pDec->stats.partialFrames;
+        pDec->stats.skippedBytes += pDec->len;
+        pDec->len = 0;
+    }
+    return pDec->hasPending ? Accept(pDec) : NULL;
+}
+
+uint64_t SBUSDecoder_GetFrameTimeUs(const SBUSDecoderType* pDec)
+{
+    return pDec->pendingUs;
+}
+
+float SBUSDecoder_GetFrameRateHz(const SBUSDecoderStatsType* pStats)
+{
+    if (pStats->frames < 2 || pStats->lastFrameUs == pStats->firstFrameUs) return 0.0f;
+    return (float) (pStats->frames - 1) * 1e6f / (float) (pStats->lastFrameUs - pStats->firstFrameUs);
+}
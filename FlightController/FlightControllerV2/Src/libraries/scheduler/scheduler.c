@@ -0,0 +1,243 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "scheduler.h"
+
+#include "clock.h"
+#include "logging.h"
+#include "profiler.h"
+
+/*
+* Defines
+*/
+
+#define LOG_TAG ("Scheduler")
+
+#define SCHEDULER_DEBUG (0)
+#if SCHEDULER_DEBUG
+#define LOG(...) LOGI(__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+
+/*
+* Struct
+*/
+
+typedef struct {
+    const SchedulerTaskConfigType* pConfig;
+    uint32_t nextReleaseTick;
+    uint32_t deadlineUs;
+    int profileId;
+    uint64_t releaseUs;
+    SchedulerTaskStatsType stats;
+} SchedulerTaskType;
+
+/*
+* Static
+*/
+
+static SchedulerTaskType sTasks[SCHEDULER_MAX_TASKS];
+static uint8_t sPriorityOrder[SCHEDULER_MAX_TASKS];
+static int sNumOfTasks = 0;
+static uint32_t sTick = 0;
+static volatile uint32_t sPendingMask = 0;
+
+/*
+* Code
+*/
+
+static void ResetTaskStats(SchedulerTaskStatsType* pStats)
+{
+    memset(pStats, 0, sizeof(SchedulerTaskStatsType));
+    pStats->minLatencyUs = UINT32_MAX;
+}
+
+bool Scheduler_Init(const SchedulerTaskConfigType* pTasks, int numOfTasks)
+{
+    if (!pTasks || numOfTasks <= 0 || numOfTasks > SCHEDULER_MAX_TASKS) {
+        LOGE("invalid task table, numOfTasks = %d\r\n", numOfTasks);
+        return false;
+    }
+
+    for (int i = 0; i < numOfTasks; ++i) {
+        const SchedulerTaskConfigType* pConfig = &pTasks[i];
+        if (!pConfig->func) {
+            LOGE("task %d invalid\r\n", i);
+            return false;
+        }
+        // only depend on earlier entries, so the table order is a valid
+        // dependency order and cycles are impossible
+        if (pConfig->dependsOn & ~(SCHEDULER_TASK_BIT(i) - 1)) {
+            LOGE("task %s depends on a later task\r\n", pConfig->name);
+            return false;
+        }
+    }
+
+    sNumOfTasks = numOfTasks;
+    sTick = 0;
+    sPendingMask = 0;
+    for (int i = 0; i < numOfTasks; ++i) {
+        SchedulerTaskType* pTask = &sTasks[i];
+        pTask->pConfig = &pTasks[i];
+        pTask->nextReleaseTick = pTasks[i].periodMs;
+        // 0 leaves the deadline unchecked, the case for event tasks without one
+        pTask->deadlineUs = (uint32_t) (pTasks[i].deadlineMs ? pTasks[i].deadlineMs : pTasks[i].periodMs) * 1000;
+        pTask->releaseUs = 0;
+        pTask->profileId = Profiler_Register(pTasks[i].name);
+        if (pTask->profileId == PROFILER_INVALID_ID) {
+            // runs anyway, its runs just do not show up in the profile
+            LOGE("task %s is not profiled, raise PROFILER_MAX_POINTS\r\n", pTasks[i].name);
+        }
+        ResetTaskStats(&pTask->stats);
+    }
+
+    // stable insertion sort by priority, ties keep table order
+    for (int i = 0; i < numOfTasks; ++i) {
+        int j = i;
+        while (j > 0 && pTasks[sPriorityOrder[j - 1]].priority > pTasks[i].priority) {
+            sPriorityOrder[j] = sPriorityOrder[j - 1];
+            --j;
+        }
+        sPriorityOrder[j] = (uint8_t) i;
+    }
+    return true;
+}
+
+static void Release(int id, uint64_t nowUs)
+{
+    SchedulerTaskType* pTask = &sTasks[id];
+    // the tick and event interrupts may preempt each other
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ++pTask->stats.releases;
+    if (sPendingMask & SCHEDULER_TASK_BIT(id)) {
+        // previous job has not finished, drop this one
+        ++pTask->stats.overruns;
+    } else {
+        pTask->releaseUs = nowUs;
+        sPendingMask |= SCHEDULER_TASK_BIT(id);
+    }
+    __set_PRIMASK(primask);
+}
+
+void Scheduler_OnTick()
+{
+    ++sTick;
+    uint64_t nowUs = Clock_GetUs();
+    for (int i = 0; i < sNumOfTasks; ++i) {
+        SchedulerTaskType* pTask = &sTasks[i];
+        if (pTask->pConfig->periodMs == 0) continue;
+        if ((int32_t) (sTick - pTask->nextReleaseTick) < 0) continue;
+
+        pTask->nextReleaseTick += pTask->pConfig->periodMs;
+        Release(i, nowUs);
+    }
+}
+
+void Scheduler_Trigger(int taskId)
+{
+    if (taskId < 0 || taskId >= sNumOfTasks) return;
+    Release(taskId, Clock_GetUs());
+}
+
+void Scheduler_TriggerAt(int taskId, uint64_t eventUs)
+{
+    if (taskId < 0 || taskId >= sNumOfTasks) return;
+    Release(taskId, eventUs);
+}
+
+bool Scheduler_RunNext()
+{
+    uint32_t pending = sPendingMask;
+    int id = -1;
+    for (int i = 0; i < sNumOfTasks; ++i) {
+        int candidate = sPriorityOrder[i];
+        if (!(pending & SCHEDULER_TASK_BIT(candidate))) continue;
+        if (pending & sTasks[candidate].pConfig->dependsOn) continue;
+        id = candidate;
+        break;
+    }
+    if (id < 0) return false;
+
+    SchedulerTaskType* pTask = &sTasks[id];
+    uint64_t startUs = Clock_GetUs();
+    uint32_t startCycles = Profiler_Start();
+    pTask->pConfig->func();
+    Profiler_Stop(pTask->profileId, startCycles);
+    uint64_t endUs = Clock_GetUs();
+
+    // the job stays pending while it runs, so a release during execution
+    // is an overrun and dependents wait for completion
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sPendingMask &= ~SCHEDULER_TASK_BIT(id);
+    uint64_t releaseUs = pTask->releaseUs;
+    __set_PRIMASK(primask);
+
+    SchedulerTaskStatsType* pStats = &pTask->stats;
+    uint32_t latencyUs = (uint32_t) (startUs - releaseUs);
+    uint32_t execUs = (uint32_t) (endUs - startUs);
+    uint32_t responseUs = (uint32_t) (endUs - releaseUs);
+    ++pStats->runs;
+    pStats->totalExecUs += execUs;
+    if (latencyUs < pStats->minLatencyUs) pStats->minLatencyUs = latencyUs;
+    if (latencyUs > pStats->maxLatencyUs) pStats->maxLatencyUs = latencyUs;
+    if (execUs > pStats->maxExecUs) pStats->maxExecUs = execUs;
+    pStats->totalResponseUs += responseUs;
+    if (responseUs > pStats->maxResponseUs) pStats->maxResponseUs = responseUs;
+    if (pTask->deadlineUs && responseUs > pTask->deadlineUs) {
+        ++pStats->deadlineMisses;
+        LOG("%s missed deadline by %u us\r\n", pTask->pConfig->name, responseUs - pTask->deadlineUs);
+    }
+    if (pTask->pConfig->budgetUs && execUs > pTask->pConfig->budgetUs) {
+        ++pStats->budgetOverruns;
+    }
+    return true;
+}
+
+int Scheduler_GetNumOfTasks()
+{
+    return sNumOfTasks;
+}
+
+const char* Scheduler_GetTaskName(int taskId)
+{
+    if (taskId < 0 || taskId >= sNumOfTasks) return NULL;
+    return sTasks[taskId].pConfig->name;
+}
+
+bool Scheduler_GetStats(int taskId, SchedulerTaskStatsType* pStats)
+{
+    if (!pStats || taskId < 0 || taskId >= sNumOfTasks) return false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pStats = sTasks[taskId].stats;
+    __set_PRIMASK(primask);
+    return true;
+}
+
+void Scheduler_ResetStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (int i = 0; i < sNumOfTasks; ++i) {
+        ResetTaskStats(&sTasks[i].stats);
+    }
+    __set_PRIMASK(primask);
+}
+
+void Scheduler_PrintStats()
+{
+    for (int i = 0; i < sNumOfTasks; ++i) {
+        SchedulerTaskStatsType stats;
+        Scheduler_GetStats(i, &stats);
+        uint32_t meanExecUs = stats.runs ? (uint32_t) (stats.totalExecUs / stats.runs) : 0;
+        uint32_t meanResponseUs = stats.runs ? (uint32_t) (stats.totalResponseUs / stats.runs) : 0;
+        LOGI("%s: runs %u overruns %u deadline misses %u budget overruns %u\r\n",
+             sTasks[i].pConfig->name, stats.runs, stats.overruns, stats.deadlineMisses, stats.budgetOverruns);
+        LOGI("  latency %u..%u us, exec mean %u max %u us, response mean %u max %u us\r\n",
+             stats.runs ? stats.minLatencyUs : 0, stats.maxLatencyUs, meanExecUs, stats.maxExecUs, meanResponseUs, stats.maxResponseUs);
+    }
+}
@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "blackbox.h"
+
+#include "logging.h"
+#include "profiler.h"
+#include "uart.h"
+
+/*
+ * Defines
+ */
+
+#define LOG_TAG ("Blackbox")
+
+/*
+ * Static
+ */
+
+static bool UartWrite(const uint8_t* pData, int size)
+{
+    return UART_Send((const char*) pData, size);
+}
+
+static const BlackboxBackendType sUartBackend = { "uart", UartWrite };
+
+#if UAV_BLACKBOX_ENCODED
+static const int sProfileEncode = Profiler_Register("Blackbox::Encode");
+#endif
+
+/*
+ * Code
+ */
+
+Blackbox::Blackbox() :
+    mSeq(0),
+    mBackend(&sUartBackend)
+{
+    memset(&mStats, 0, sizeof(mStats));
+#if UAV_BLACKBOX_ENCODED
+    Blackbox_InitCodec(&mCodec);
+    mPacketLen = 0;
+#endif
+}
+
+Blackbox& Blackbox::GetInstance()
+{
+    static Blackbox blackbox;
+    return blackbox;
+}
+
+bool Blackbox::SetBackend(const BlackboxBackendType* pBackend)
+{
+    if (!pBackend || !pBackend->write) {
+        LOGE("invalid backend\r\n");
+        return false;
+    }
+    mBackend = pBackend;
+    return true;
+}
+
+bool Blackbox::Record(BlackboxFrameType& frame)
+{
+    uint32_t seq = mSeq++;
+    ++mStats.recorded;
+    BlackboxFrameType* pSlot = mFrames.PeekWrite();
+    if (!pSlot) {
+        ++mStats.dropped;
+        return false;
+    }
+
+    frame.sync[0] = BLACKBOX_SYNC_0;
+    frame.sync[1] = BLACKBOX_SYNC_1;
+    frame.version = BLACKBOX_FRAME_VERSION;
+    frame.size = (uint8_t) sizeof(BlackboxFrameType);
+    frame.seq = seq;
+    *pSlot = frame;
+    mFrames.CommitWrite();
+    return true;
+}
+
+#if UAV_BLACKBOX_ENCODED
+int Blackbox::Flush()
+{
+    int written = 0;
+    while (mPacketLen > 0 || !mFrames.IsEmpty()) {
+        if (mPacketLen == 0) {
+            // encoded here to keep it out of the control loop
+            ProfilerScope profile(sProfileEncode);
+            mPacketLen = Blackbox_EncodePacket(&mCodec, *mFrames.Peek(), mPacket, sizeof(mPacket));
+            mFrames.CommitRead();
+            if (mPacketLen == 0) {
+                // nothing to write, the frame is lost like one the full ring turned away
+                ++mStats.dropped;
+                continue;
+            }
+        }
+        if (!mBackend->write(mPacket, mPacketLen)) {
+            ++mStats.backendBusy;
+            break;
+        }
+        mStats.writtenBytes += mPacketLen;
+        mPacketLen = 0;
+        ++mStats.written;
+        ++written;
+    }
+    return written;
+}
+#else
+int Blackbox::Flush()
+{
+    int written = 0;
+    BlackboxFrameType* pFrame;
+    while ((pFrame = mFrames.Peek()) != NULL) {
+        // checksummed here to keep it out of the control loop
+        const uint8_t* pBytes = (const uint8_t*) pFrame;
+        pFrame->checksum = Blackbox_Checksum(pBytes + 2, (int) (sizeof(BlackboxFrameType) - 4));
+        if (!mBackend->write(pBytes, sizeof(BlackboxFrameType))) {
+            ++mStats.backendBusy;
+            break;
+        }
+        mFrames.CommitRead();
+        ++mStats.written;
+        mStats.writtenBytes += sizeof(BlackboxFrameType);
+        ++written;
+    }
+    return written;
+}
+#endif
+
+bool Blackbox::GetStats(BlackboxStatsType& stats)
+{
+    stats = mStats;
+    return true;
+}
+
+bool Blackbox::ResetStats()
+{
+    memset(&mStats, 0, sizeof(mStats));
+    return true;
+}
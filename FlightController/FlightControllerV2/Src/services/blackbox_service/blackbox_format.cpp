@@ -0,0 +1,211 @@
+#include <math.h>
+#include <string.h>
+
+#include "blackbox.h"
+
+/*
+ * Frame and packet format, no HAL or logging in here, the host tools build
+ * this file as is.
+ */
+
+/*
+ * Defines
+ */
+
+#define QUANTISE_LIMIT (1.0e9f) // keeps out of range floats from overflowing int32
+
+/*
+ * Static
+ */
+
+static const uint8_t sPredictors[BLACKBOX_NUM_OF_FIELDS] = {
+    FRAME_CODEC_PREDICT_LINEAR,   // time, constant loop period codes as 0
+    FRAME_CODEC_PREDICT_LINEAR,   // seq
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // gyro
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // acc
+    FRAME_CODEC_PREDICT_LINEAR, FRAME_CODEC_PREDICT_LINEAR, FRAME_CODEC_PREDICT_LINEAR,       // att, integrated
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // att rate
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // att setpoint
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // att rate setpoint
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // pitch PID
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // roll PID
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // yaw PID
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS,
+    FRAME_CODEC_PREDICT_PREVIOUS, FRAME_CODEC_PREDICT_PREVIOUS, // motors
+    FRAME_CODEC_PREDICT_PREVIOUS, // flags
+};
+
+static const FrameCodecConfigType sCodecConfig = { BLACKBOX_NUM_OF_FIELDS, sPredictors, BLACKBOX_KEYFRAME_INTERVAL };
+
+/*
+ * Code
+ */
+
+static int32_t Quantise(float value, float scale)
+{
+    float scaled = value * scale;
+    if (!(scaled > -QUANTISE_LIMIT)) return (int32_t) -QUANTISE_LIMIT; // also NaN
+    if (scaled > QUANTISE_LIMIT) return (int32_t) QUANTISE_LIMIT;
+    return (int32_t) floorf(scaled + 0.5f);
+}
+
+static void QuantiseAtt(const FCAttType& att, float scale, int32_t* pFields)
+{
+    pFields[0] = Quantise(att.yaw, scale);
+    pFields[1] = Quantise(att.pitch, scale);
+    pFields[2] = Quantise(att.roll, scale);
+}
+
+static void RestoreAtt(const int32_t* pFields, float scale, FCAttType& att)
+{
+    att.yaw = pFields[0] / scale;
+    att.pitch = pFields[1] / scale;
+    att.roll = pFields[2] / scale;
+}
+
+uint16_t Blackbox_Checksum(const uint8_t* pData, int size)
+{
+    // Fletcher-16
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (int i = 0; i < size; ++i) {
+        sum1 = (uint16_t) ((sum1 + pData[i]) % 255);
+        sum2 = (uint16_t) ((sum2 + sum1) % 255);
+    }
+    return (uint16_t) ((sum2 << 8) | sum1);
+}
+
+const FrameCodecConfigType* Blackbox_GetCodecConfig()
+{
+    return &sCodecConfig;
+}
+
+bool Blackbox_InitCodec(BlackboxCodecType* pCodec)
+{
+    pCodec->count = 0;
+    return FrameCodec_Init(&pCodec->codec, &sCodecConfig);
+}
+
+void Blackbox_FrameToFields(const BlackboxFrameType& frame, int32_t* pFields)
+{
+    pFields[BLACKBOX_FIELD_TIME_US] = (int32_t) frame.timeUs;
+    pFields[BLACKBOX_FIELD_SEQ] = (int32_t) frame.seq;
+    pFields[BLACKBOX_FIELD_GYRO + 0] = Quantise(frame.meas.gyroData.x, BLACKBOX_SCALE_GYRO);
+    pFields[BLACKBOX_FIELD_GYRO + 1] = Quantise(frame.meas.gyroData.y, BLACKBOX_SCALE_GYRO);
+    pFields[BLACKBOX_FIELD_GYRO + 2] = Quantise(frame.meas.gyroData.z, BLACKBOX_SCALE_GYRO);
+    pFields[BLACKBOX_FIELD_ACC + 0] = Quantise(frame.meas.accData.x, BLACKBOX_SCALE_ACC);
+    pFields[BLACKBOX_FIELD_ACC + 1] = Quantise(frame.meas.accData.y, BLACKBOX_SCALE_ACC);
+    pFields[BLACKBOX_FIELD_ACC + 2] = Quantise(frame.meas.accData.z, BLACKBOX_SCALE_ACC);
+    QuantiseAtt(frame.state.att, BLACKBOX_SCALE_ANGLE, &pFields[BLACKBOX_FIELD_ATT]);
+    QuantiseAtt(frame.state.attRate, BLACKBOX_SCALE_ANGLE, &pFields[BLACKBOX_FIELD_ATT_RATE]);
+    QuantiseAtt(frame.attSetpoint, BLACKBOX_SCALE_ANGLE, &pFields[BLACKBOX_FIELD_ATT_SETPOINT]);
+    QuantiseAtt(frame.attRateSetpoint, BLACKBOX_SCALE_ANGLE, &pFields[BLACKBOX_FIELD_ATT_RATE_SETPOINT]);
+    for (int i = 0; i < 3; ++i) {
+        pFields[BLACKBOX_FIELD_PID + 3 * i + 0] = Quantise(frame.attRatePID[i].p, BLACKBOX_SCALE_PID);
+        pFields[BLACKBOX_FIELD_PID + 3 * i + 1] = Quantise(frame.attRatePID[i].i, BLACKBOX_SCALE_PID);
+        pFields[BLACKBOX_FIELD_PID + 3 * i + 2] = Quantise(frame.attRatePID[i].d, BLACKBOX_SCALE_PID);
+    }
+    for (int i = 0; i < 4; ++i) {
+        pFields[BLACKBOX_FIELD_MOTOR + i] = frame.motorPWM[i];
+    }
+    pFields[BLACKBOX_FIELD_FLAGS] = frame.flags;
+}
+
+void Blackbox_FieldsToFrame(const int32_t* pFields, BlackboxFrameType& frame)
+{
+    memset(&frame, 0, sizeof(BlackboxFrameType));
+    frame.sync[0] = BLACKBOX_SYNC_0;
+    frame.sync[1] = BLACKBOX_SYNC_1;
+    frame.version = BLACKBOX_FRAME_VERSION;
+    frame.size = (uint8_t) sizeof(BlackboxFrameType);
+    frame.timeUs = (uint32_t) pFields[BLACKBOX_FIELD_TIME_US];
+    frame.seq = (uint32_t) pFields[BLACKBOX_FIELD_SEQ];
+    frame.meas.gyroData.x = pFields[BLACKBOX_FIELD_GYRO + 0] / BLACKBOX_SCALE_GYRO;
+    frame.meas.gyroData.y = pFields[BLACKBOX_FIELD_GYRO + 1] / BLACKBOX_SCALE_GYRO;
+    frame.meas.gyroData.z = pFields[BLACKBOX_FIELD_GYRO + 2] / BLACKBOX_SCALE_GYRO;
+    frame.meas.accData.x = pFields[BLACKBOX_FIELD_ACC + 0] / BLACKBOX_SCALE_ACC;
+    frame.meas.accData.y = pFields[BLACKBOX_FIELD_ACC + 1] / BLACKBOX_SCALE_ACC;
+    frame.meas.accData.z = pFields[BLACKBOX_FIELD_ACC + 2] / BLACKBOX_SCALE_ACC;
+    RestoreAtt(&pFields[BLACKBOX_FIELD_ATT], BLACKBOX_SCALE_ANGLE, frame.state.att);
+    RestoreAtt(&pFields[BLACKBOX_FIELD_ATT_RATE], BLACKBOX_SCALE_ANGLE, frame.state.attRate);
+    RestoreAtt(&pFields[BLACKBOX_FIELD_ATT_SETPOINT], BLACKBOX_SCALE_ANGLE, frame.attSetpoint);
+    RestoreAtt(&pFields[BLACKBOX_FIELD_ATT_RATE_SETPOINT], BLACKBOX_SCALE_ANGLE, frame.attRateSetpoint);
+    for (int i = 0; i < 3; ++i) {
+        frame.attRatePID[i].p = pFields[BLACKBOX_FIELD_PID + 3 * i + 0] / BLACKBOX_SCALE_PID;
+        frame.attRatePID[i].i = pFields[BLACKBOX_FIELD_PID + 3 * i + 1] / BLACKBOX_SCALE_PID;
+        frame.attRatePID[i].d = pFields[BLACKBOX_FIELD_PID + 3 * i + 2] / BLACKBOX_SCALE_PID;
+    }
+    for (int i = 0; i < 4; ++i) {
+        frame.motorPWM[i] = (uint16_t) pFields[BLACKBOX_FIELD_MOTOR + i];
+    }
+    frame.flags = (uint16_t) pFields[BLACKBOX_FIELD_FLAGS];
+}
+
+int Blackbox_EncodePacket(BlackboxCodecType* pCodec, const BlackboxFrameType& frame, uint8_t* pOut, int outSize)
+{
+    int32_t fields[BLACKBOX_NUM_OF_FIELDS];
+    Blackbox_FrameToFields(frame, fields);
+    if (outSize < BLACKBOX_ENCODED_MAX_LEN) return 0;
+
+    int len = FrameCodec_Encode(&pCodec->codec, fields, &pOut[BLACKBOX_ENCODED_HEADER_LEN],
+                                outSize - BLACKBOX_ENCODED_HEADER_LEN - 2);
+    if (len == 0) return 0;
+    pOut[0] = BLACKBOX_SYNC_0;
+    pOut[1] = BLACKBOX_SYNC_1_ENCODED;
+    pOut[2] = BLACKBOX_ENCODED_VERSION;
+    pOut[3] = pCodec->count++;
+    pOut[4] = (uint8_t) len;
+    len += BLACKBOX_ENCODED_HEADER_LEN;
+    uint16_t checksum = Blackbox_Checksum(&pOut[2], len - 2);
+    pOut[len++] = (uint8_t) checksum;
+    pOut[len++] = (uint8_t) (checksum >> 8);
+    return len;
+}
+
+static BlackboxParseResultType ParseRaw(const uint8_t* pData, int size, BlackboxFrameType& frame, int* pLen)
+{
+    const int frameLen = (int) sizeof(BlackboxFrameType);
+    if (size < frameLen) return BLACKBOX_PARSE_NEED_MORE;
+    memcpy(&frame, pData, frameLen);
+    if (frame.version != BLACKBOX_FRAME_VERSION || frame.size != frameLen
+        || frame.checksum != Blackbox_Checksum(pData + 2, frameLen - 4)) {
+        return BLACKBOX_PARSE_NO_FRAME;
+    }
+    *pLen = frameLen;
+    return BLACKBOX_PARSE_FRAME;
+}
+
+static BlackboxParseResultType ParseEncoded(BlackboxCodecType* pCodec, const uint8_t* pData, int size,
+                                            BlackboxFrameType& frame, int* pLen)
+{
+    if (size < BLACKBOX_ENCODED_HEADER_LEN) return BLACKBOX_PARSE_NEED_MORE;
+    int codecLen = pData[4];
+    if (pData[2] != BLACKBOX_ENCODED_VERSION || codecLen > FRAME_CODEC_MAX_LEN(BLACKBOX_NUM_OF_FIELDS)) {
+        return BLACKBOX_PARSE_NO_FRAME;
+    }
+    int packetLen = BLACKBOX_ENCODED_HEADER_LEN + codecLen + 2;
+    if (size < packetLen) return BLACKBOX_PARSE_NEED_MORE;
+    uint16_t checksum = (uint16_t) (pData[packetLen - 2] | (pData[packetLen - 1] << 8));
+    if (checksum != Blackbox_Checksum(&pData[2], packetLen - 4)) return BLACKBOX_PARSE_NO_FRAME;
+
+    *pLen = packetLen;
+    // a delta frame only decodes against the packet right before it
+    if (pData[3] != pCodec->count) FrameCodec_Reset(&pCodec->codec);
+    pCodec->count = (uint8_t) (pData[3] + 1);
+    int32_t fields[BLACKBOX_NUM_OF_FIELDS];
+    if (FrameCodec_Decode(&pCodec->codec, &pData[BLACKBOX_ENCODED_HEADER_LEN], codecLen, fields) != codecLen) {
+        return BLACKBOX_PARSE_NO_KEYFRAME;
+    }
+    Blackbox_FieldsToFrame(fields, frame);
+    return BLACKBOX_PARSE_FRAME;
+}
+
+BlackboxParseResultType Blackbox_ParsePacket(BlackboxCodecType* pCodec, const uint8_t* pData, int size,
+                                             BlackboxFrameType& frame, int* pLen)
+{
+    if (size < 2) return BLACKBOX_PARSE_NEED_MORE;
+    if (pData[0] != BLACKBOX_SYNC_0) return BLACKBOX_PARSE_NO_FRAME;
+    if (pData[1] == BLACKBOX_SYNC_1) return ParseRaw(pData, size, frame, pLen);
+    if (pData[1] == BLACKBOX_SYNC_1_ENCODED) return ParseEncoded(pCodec, pData, size, frame, pLen);
+    return BLACKBOX_PARSE_NO_FRAME;
+}
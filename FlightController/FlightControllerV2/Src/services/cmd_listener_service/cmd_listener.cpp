@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "stm32f1xx_hal.h"
 
 #include "cmd_listener.h"
@@ -6,8 +8,21 @@
 
 #define LOG_TAG ("CmdListener")
 
-CmdListener::CmdListener()
-{}
+/*
+ * Defines
+ */
+
+#define CMD_NUM_OF_CHANNELS (4)
+
+/*
+ * Code
+ */
+
+CmdListener::CmdListener() : mLatencyHead(0), mLatencyCnt(0)
+{
+    memset(&mCmd, 0, sizeof(mCmd));
+    ResetLatencyStats();
+}
 
 CmdListener& CmdListener::GetInstance()
 {
@@ -20,6 +35,11 @@ bool CmdListener::Init()
     Receiver& receiver = Receiver::GetInstance();
     if (!receiver.Init()) return false;
 
+    if (!RcSmoothing_Init(&mSmoothing, (RcSmoothingModeType) UAV_RC_SMOOTHING, CMD_NUM_OF_CHANNELS,
+                          UAV_RC_SMOOTHING_CUTOFF_HZ)) {
+        LOGE("invalid rc smoothing config\r\n");
+        return false;
+    }
     return true;
 }
 
@@ -36,7 +56,121 @@ bool CmdListener::Start()
     return true;
 }
 
+bool CmdListener::BeginStart()
+{
+    return Receiver::GetInstance().BeginStart();
+}
+
+ReceiverStartStatusType CmdListener::PollStart()
+{
+    return Receiver::GetInstance().PollStart();
+}
+
+bool CmdListener::SetFrameCb(ReceiverFrameCb cb)
+{
+    return Receiver::GetInstance().SetFrameCb(cb);
+}
+
 ReceiverStatus CmdListener::GetCmd(FCCmdType& cmd)
 {
     return Receiver::GetInstance().GetCmd(cmd);
-}
\ No newline at end of file
+}
+
+void CmdListener::CmdToChannels(const FCCmdType& cmd, float* pChannels)
+{
+#if UAV_CMD_ATT_RATE
+    pChannels[0] = cmd.desiredAccZ;
+    pChannels[1] = cmd.desiredAttRate.roll;
+    pChannels[2] = cmd.desiredAttRate.pitch;
+    pChannels[3] = cmd.desiredAttRate.yaw;
+#elif UAV_CMD_ACC
+    pChannels[0] = cmd.desiredAcc.z;
+    pChannels[1] = cmd.desiredAcc.y;
+    pChannels[2] = cmd.desiredAcc.x;
+    pChannels[3] = cmd.desiredYawRate;
+#elif UAV_CMD_ATT
+    pChannels[0] = cmd.desiredAccZ;
+    pChannels[1] = cmd.desiredRoll;
+    pChannels[2] = cmd.desiredPitch;
+    pChannels[3] = cmd.desiredYawRate;
+#endif
+}
+
+void CmdListener::ChannelsToCmd(const float* pChannels, FCCmdType& cmd)
+{
+#if UAV_CMD_ATT_RATE
+    cmd.desiredAccZ = pChannels[0];
+    cmd.desiredAttRate.roll = pChannels[1];
+    cmd.desiredAttRate.pitch = pChannels[2];
+    cmd.desiredAttRate.yaw = pChannels[3];
+#elif UAV_CMD_ACC
+    cmd.desiredAcc.z = pChannels[0];
+    cmd.desiredAcc.y = pChannels[1];
+    cmd.desiredAcc.x = pChannels[2];
+    cmd.desiredYawRate = pChannels[3];
+#elif UAV_CMD_ATT
+    cmd.desiredAccZ = pChannels[0];
+    cmd.desiredRoll = pChannels[1];
+    cmd.desiredPitch = pChannels[2];
+    cmd.desiredYawRate = pChannels[3];
+#endif
+}
+
+void CmdListener::SetSetpointTarget(const FCCmdType& cmd)
+{
+    float channels[CMD_NUM_OF_CHANNELS];
+    CmdToChannels(cmd, channels);
+    RcSmoothing_SetTarget(&mSmoothing, channels, cmd.frameTimeUs);
+    mCmd = cmd;
+
+    if (mLatencyCnt == CMD_LATENCY_QUEUE_LEN) {
+        // no output for a long time, e.g. disarmed, the oldest is not worth a sample
+        mLatencyHead = (mLatencyHead + 1) % CMD_LATENCY_QUEUE_LEN;
+        --mLatencyCnt;
+    }
+    mLatencyQueue[(mLatencyHead + mLatencyCnt) % CMD_LATENCY_QUEUE_LEN] = cmd.frameTimeUs;
+    ++mLatencyCnt;
+}
+
+void CmdListener::ResetSetpoint()
+{
+    RcSmoothing_Reset(&mSmoothing);
+    mLatencyCnt = 0;
+}
+
+bool CmdListener::GetSetpoint(FCCmdType& cmd, uint64_t nowUs)
+{
+    float channels[CMD_NUM_OF_CHANNELS];
+    if (!RcSmoothing_Get(&mSmoothing, nowUs, channels)) return false;
+    cmd = mCmd;
+    ChannelsToCmd(channels, cmd);
+    return true;
+}
+
+void CmdListener::RecordLatency(uint64_t frameTimeUs, uint64_t nowUs)
+{
+    // the frames up to frameTimeUs reached the motors now, those skipped by a
+    // slower loop too, through a later frame
+    while (mLatencyCnt && mLatencyQueue[mLatencyHead] <= frameTimeUs) {
+        uint64_t arrivalUs = mLatencyQueue[mLatencyHead];
+        mLatencyHead = (mLatencyHead + 1) % CMD_LATENCY_QUEUE_LEN;
+        --mLatencyCnt;
+        if (nowUs < arrivalUs) continue;
+        uint32_t latencyUs = (uint32_t) (nowUs - arrivalUs);
+        if (latencyUs < mLatency.minUs) mLatency.minUs = latencyUs;
+        if (latencyUs > mLatency.maxUs) mLatency.maxUs = latencyUs;
+        mLatency.totalUs += latencyUs;
+        ++mLatency.samples;
+    }
+}
+
+void CmdListener::GetLatencyStats(CmdLatencyStatsType& stats)
+{
+    stats = mLatency;
+}
+
+void CmdListener::ResetLatencyStats()
+{
+    memset(&mLatency, 0, sizeof(mLatency));
+    mLatency.minUs = UINT32_MAX;
+}
@@ -164,4 +164,24 @@ bool Controller::SetYawRateSetpoint(float yawRate)
 {
     mAttRateSetpoint.yaw = yawRate;
     return true;
+}
+
+bool Controller::GetAttSetpoint(FCAttType& attSetpoint)
+{
+    attSetpoint = mAttSetpoint;
+    return true;
+}
+
+bool Controller::GetAttRateSetpoint(FCAttRateType& attRateSetpoint)
+{
+    attRateSetpoint = mAttRateSetpoint;
+    return true;
+}
+
+bool Controller::GetAttRatePIDTerms(FCPIDTermsType& pitch, FCPIDTermsType& roll, FCPIDTermsType& yaw)
+{
+    mAttRateController_pitch.GetPIDTerms(pitch);
+    mAttRateController_roll.GetPIDTerms(roll);
+    mAttRateController_yaw.GetPIDTerms(yaw);
+    return true;
 }
\ No newline at end of file
@@ -95,3 +95,11 @@ float AttRateController::GetKi()
 {
     return mKi;
 }
+
+bool AttRateController::GetPIDTerms(FCPIDTermsType& terms)
+{
+    terms.p = mAttRatePID.GetPTerm();
+    terms.i = mAttRatePID.GetITerm();
+    terms.d = mAttRatePID.GetDTerm();
+    return true;
+}
@@ -1,12 +1,13 @@
 #include "device_ctrl.h"
 
-#include "i2c.h"
+#include "imu_bus.h"
 #include "IMU.h"
 #include "logging.h"
 #include "uart.h"
 #include "sbus.h"
 #include "pwm.h"
 #include "led.h"
+#include "boot_seq.h"
 
 #include "state_estimator.h"
 #include "cmd_listener.h"
@@ -16,102 +17,161 @@
 #define LOG_TAG ("DeviceCtrl")
 
 /*
-* Static
+* Defines
 */
 
+// the IMU gets a second try a second later, as the whole init did before;
+// the receiver search goes on until a receiver shows up
+#define BOOT_IMU_RETRIES (1)
+#define BOOT_IMU_RETRY_DELAY_MS (1000)
+#define BOOT_IMU_CALIB_TIMEOUT_MS (3000) // 100 samples at 100 Hz, with margin
+#define BOOT_RECEIVER_RETRY_DELAY_MS (1000)
+
+// boot steps, a step may only depend on steps listed before it. The
+// receiver search comes first, so it waits while the IMU is set up.
+enum {
+    BOOT_UART,
+    BOOT_RECEIVER_INIT,
+    BOOT_RECEIVER,
+    BOOT_PWM,
+    BOOT_LED,
+    BOOT_ESTIMATOR,
+    BOOT_CONTROLLER,
+    BOOT_IMU_BUS,
+    BOOT_IMU,
+    BOOT_IMU_CALIB,
+    NUM_OF_BOOT_STEPS
+};
+
 /*
 * Code
 */
 
-static bool InitDrivers()
+static bool StartUart()
 {
-    // Init uart driver
     if (!UART_Init()) {
         LOGE("UART Init failed\r\n");
         return false;
-    } else {
-        LOGI("UART Init success\r\n");
-    };
-    // Init i2c driver
-    if (!I2C_Init()) {
-        LOGE("I2C Init failed\r\n");
+    }
+    LOGI("UART Init success\r\n");
+    return true;
+}
+
+static bool StartReceiverInit()
+{
+    if (!CmdListener::GetInstance().Init()) {
+        LOGE("CmdListener Init failed\r\n");
         return false;
-    } else {
-        LOGI("I2C Init success\r\n");
     }
-    // Init SBUS driver
-//    if (!SBUS_Init()) {
-//        LOGE("SBUS Init failed\r\n");
-//        return false;
-//    } else {
-//        LOGI("SBUS Init success\r\n");
-//    }
-    // Init PWM driver
+    return true;
+}
+
+static bool StartReceiver()
+{
+    return CmdListener::GetInstance().BeginStart();
+}
+
+static BootStepStatusType PollReceiver()
+{
+    switch (CmdListener::GetInstance().PollStart()) {
+    case RECEIVER_START_DONE: return BOOT_STEP_DONE;
+    case RECEIVER_START_FAILED: return BOOT_STEP_FAILED;
+    default: return BOOT_STEP_PENDING;
+    }
+}
+
+static bool StartPwm()
+{
     if (!PWM_Init()) {
         LOGE("PWM Init failed\r\n");
         return false;
-    } else {
-        PWM_Start();
-        LOGI("PWM Init success\r\n");
     }
-    // Init LED driver
+    PWM_Start();
+    LOGI("PWM Init success\r\n");
+    return true;
+}
+
+static bool StartLed()
+{
     if (!LED_Init()) {
         LOGE("LED Init failed\r\n");
         return false;
-    } else {
-        LOGI("PWM Init success\r\n");
     }
-
+    LOGI("LED Init success\r\n");
     return true;
 }
 
-static bool InitServices()
+static bool StartEstimator()
 {
     if (!StateEstimator::GetInstance().Init()) {
         LOGE("StateEstimator Init failed\r\n");
         return false;
     }
-    if (!SensorReader::GetInstance().Init()) {
-        LOGE("SensorReader Init failed\r\n");
-        return false;
-    }
+    return true;
+}
+
+static bool StartController()
+{
     if (!Controller::GetInstance().Init()) {
         LOGE("Controller Init failed\r\n");
         return false;
     }
-    if (!CmdListener::GetInstance().Init()) {
-        LOGE("CmdListener Init failed\r\n");
-        return false;
-    }
-
     return true;
 }
 
-static bool StartServices()
+// the bus to the IMU, I2C or SPI
+static bool StartImuBus()
 {
-    if (!CmdListener::GetInstance().Start()) {
-        LOGE("CmdListener Start failed\r\n");
+    if (!ImuBus_Init()) {
+        LOGE("ImuBus Init failed\r\n");
         return false;
     }
+    LOGI("ImuBus Init success\r\n");
     return true;
 }
 
-bool DeviceInit()
+static bool StartImu()
 {
-    if (!InitDrivers()) {
-        LOGE("DriversInit failed\r\n");
-        return false;
-    }
-    if (!InitServices()) {
-        LOGE("ProductInit failed\r\n");
-        return false;
-    }
-    if (!StartServices()) {
-        LOGE("ProductStart failed\r\n");
+    if (!SensorReader::GetInstance().Init()) {
+        LOGE("SensorReader Init failed\r\n");
         return false;
     }
+    return true;
+}
 
+static bool StartImuCalib()
+{
+    SensorReader::GetInstance().BeginCalibration();
     return true;
 }
 
+static BootStepStatusType PollImuCalib()
+{
+    return SensorReader::GetInstance().PollCalibration() ? BOOT_STEP_DONE : BOOT_STEP_PENDING;
+}
+
+static const BootStepConfigType sBootSteps[NUM_OF_BOOT_STEPS] = {
+    { "Uart", StartUart, NULL, 0, 0, 0, 0 },
+    { "ReceiverInit", StartReceiverInit, NULL, 0, 0, 0, 0 },
+    { "Receiver", StartReceiver, PollReceiver, 0, BOOT_RECEIVER_RETRY_DELAY_MS, BOOT_STEP_RETRY_FOREVER,
+      BOOT_STEP_BIT(BOOT_RECEIVER_INIT) },
+    { "Pwm", StartPwm, NULL, 0, 0, 0, 0 },
+    { "Led", StartLed, NULL, 0, 0, 0, 0 },
+    { "Estimator", StartEstimator, NULL, 0, 0, 0, 0 },
+    { "Controller", StartController, NULL, 0, 0, 0, 0 },
+    { "ImuBus", StartImuBus, NULL, 0, 0, 0, 0 },
+    { "Imu", StartImu, NULL, 0, BOOT_IMU_RETRY_DELAY_MS, BOOT_IMU_RETRIES, BOOT_STEP_BIT(BOOT_IMU_BUS) },
+    { "ImuCalib", StartImuCalib, PollImuCalib, BOOT_IMU_CALIB_TIMEOUT_MS, 0, BOOT_IMU_RETRIES,
+      BOOT_STEP_BIT(BOOT_IMU) },
+};
 
+bool DeviceInit()
+{
+    if (!BootSeq_Init(sBootSteps, NUM_OF_BOOT_STEPS)) return false;
+    if (!BootSeq_Run()) {
+        LOGE("DeviceInit failed\r\n");
+        BootSeq_PrintStats();
+        return false;
+    }
+    return true;
+}
@@ -19,6 +19,10 @@
 MotorCtrl::MotorCtrl()
 {
     mToClampThrust = true;
+    mMotorPWM.motor1PWM = 0;
+    mMotorPWM.motor2PWM = 0;
+    mMotorPWM.motor3PWM = 0;
+    mMotorPWM.motor4PWM = 0;
 }
 
 MotorCtrl& MotorCtrl::GetInstance()
@@ -30,6 +34,10 @@ MotorCtrl& MotorCtrl::GetInstance()
 bool MotorCtrl::StopMotor()
 {
     PWM_Stop();
+    mMotorPWM.motor1PWM = 0;
+    mMotorPWM.motor2PWM = 0;
+    mMotorPWM.motor3PWM = 0;
+    mMotorPWM.motor4PWM = 0;
     return true;
 }
 
@@ -66,6 +74,11 @@ bool MotorCtrl::OutputMotor(float pitchThrust, float rollThrust, float yawThrust
 
     LOGI("motorPWM: 1 %d , 2 %d, 3 %d, 4 %d\r\n", motorPWM[0], motorPWM[1], motorPWM[2], motorPWM[3]);
 
+    mMotorPWM.motor1PWM = motorPWM[0];
+    mMotorPWM.motor2PWM = motorPWM[1];
+    mMotorPWM.motor3PWM = motorPWM[2];
+    mMotorPWM.motor4PWM = motorPWM[3];
+
 #if UAV_ENABLE_MOTORS
     PWM_SetDutyCycle(PWM_CHANNEL_1, motorPWM[0]);
     PWM_SetDutyCycle(PWM_CHANNEL_2, motorPWM[1]);
@@ -73,4 +86,10 @@ bool MotorCtrl::OutputMotor(float pitchThrust, float rollThrust, float yawThrust
     PWM_SetDutyCycle(PWM_CHANNEL_4, motorPWM[3]);
 #endif
     return true;
-}
\ No newline at end of file
+}
+
+bool MotorCtrl::GetMotorPWM(FCMotorPWMType& motorPWM)
+{
+    motorPWM = mMotorPWM;
+    return true;
+}
@@ -1,12 +1,39 @@
+#include <string.h>
+
 #include "sensor_reader.h"
 
-#include "IMU.h"
+#include "clock.h"
 #include "logging.h"
 
 #define LOG_TAG ("SensorReader")
 
+#if UAV_IMU_FIFO
+#define SENSOR_DECIMATOR_CHANNELS (6) // gyro xyz, acc xyz
+#endif
+
 SensorReader::SensorReader()
 {
+    mCalibrated = false;
+#if USE_INTERRUPT
+    mReadPending = false;
+    mReadPolled = false;
+    mReadTimeUs = 0;
+    mReadDoneCb = NULL;
+    mSkippedReads = 0;
+#endif
+#if UAV_IMU_FIFO
+    mFifoCount[0] = mFifoCount[1] = 0;
+    mFifoEdges = 0;
+    mFifoSynced = false;
+#if UAV_IMU_DMP
+    mFifoCorrupt = false;
+#endif
+    mFifoRecordLen = MPU9250_FIFO_MOTION6_LEN;
+    mFifoDecimation = SENSOR_FIFO_DECIMATION;
+    mFifoMaxSamples = SENSOR_FIFO_MAX_SAMPLES;
+    mFifoSamplePeriodUs = SENSOR_FIFO_SAMPLE_PERIOD_US;
+    ResetFifoStats();
+#endif
 }
 
 SensorReader& SensorReader::GetInstance()
@@ -17,11 +44,21 @@ SensorReader& SensorReader::GetInstance()
 
 bool SensorReader::Init()
 {
+#if UAV_IMU_FIFO
+    if (!Decimator_Init(&mDecimator, SENSOR_DECIMATOR_CHANNELS, UAV_IMU_FIFO_RATE_HZ, SENSOR_FIFO_DECIMATION,
+                        UAV_IMU_DECIMATOR_CUTOFF_HZ, UAV_IMU_DECIMATOR_STAGES)) {
+        LOGE("decimator init failed\r\n");
+        return false;
+    }
+#endif
     IMU& imu = IMU::GetInstance();
     if (!imu.Init()) {
         LOGE("IMU init failed\r\n");
         return false;
     }
+    // a few samples against the record of an earlier boot instead of a
+    // second of standing still
+    mCalibrated = imu.LoadCalibration();
 
     // start IMU
     if (!imu.Start()) {
@@ -29,16 +66,266 @@ bool SensorReader::Init()
         return false;
     }
     LOGI("IMU start success\r\n");
+#if UAV_IMU_DMP
+    if (imu.IsDmpActive()) {
+        mFifoRecordLen = MPU9250_FIFO_DMP_LEN;
+        mFifoDecimation = SENSOR_DMP_DECIMATION;
+        mFifoMaxSamples = SENSOR_DMP_MAX_SAMPLES;
+        mFifoSamplePeriodUs = SENSOR_DMP_SAMPLE_PERIOD_US;
+    }
+#endif
+    return true;
+}
+
+void SensorReader::BeginCalibration()
+{
+    if (!mCalibrated) IMU::GetInstance().BeginSensorBiasCalibration();
+}
 
-    imu.CalibrateSensorBias();
+bool SensorReader::PollCalibration()
+{
+    if (mCalibrated) return true;
+    IMU& imu = IMU::GetInstance();
+    if (!imu.PollSensorBiasCalibration()) return false;
     LOGI("IMU calibrate success\r\n");
+    imu.SaveCalibration();
+    mCalibrated = true;
     return true;
 }
 
-bool SensorReader::GetSensorMeas(FCSensorMeasType& meas)
+#if USE_INTERRUPT
+bool SensorReader::StartRead(bool polled)
+{
+#if UAV_IMU_FIFO
+    // the FIFO keeps the samples in between
+    if (!polled && ++mFifoEdges < mFifoDecimation) return true;
+    mFifoEdges = 0;
+#endif
+    if (mReadPending) {
+        // the previous sample is still on the bus
+        ++mSkippedReads;
+        return false;
+    }
+    IMU& imu = IMU::GetInstance();
+    mReadPending = true;
+    mReadPolled = polled;
+#if UAV_IMU_FIFO
+    // FIFO_COUNT first, OnFifoCount() goes on from there
+    bool ok = imu.StartFifoCountRead(mFifoCount, OnFifoCount, this);
+#else
+    // the sample was taken at the data-ready edge, or is the newest one when polled
+    mReadTimeUs = polled ? Clock_GetUs() : Clock_GetUs() - Clock_CyclesToUs(Clock_GetCycles() - imu.mDataReadyCycles);
+    bool ok = imu.StartMotionRead(mBursts.BeginWrite()->data, OnReadDone, this);
+#endif
+    if (!ok) {
+        mReadPending = false;
+        ++mSkippedReads;
+        return false;
+    }
+    return true;
+}
+
+#if UAV_IMU_FIFO
+// IMU bus interrupt context
+void SensorReader::OnFifoCount(bool ok, void* pArg)
+{
+    SensorReader* pReader = (SensorReader*) pArg;
+    if (!ok) {
+        pReader->mReadPending = false;
+        return;
+    }
+    IMU& imu = IMU::GetInstance();
+    uint16_t count = MPU9250::parseFifoCount(pReader->mFifoCount);
+    // the chip adds whole records, a count that is not a multiple of one
+    // after a failed drain means part of a record was popped
+    bool overflow = count >= MPU9250_FIFO_SIZE;
+    bool resync = !pReader->mFifoSynced && count % pReader->mFifoRecordLen;
+#if UAV_IMU_DMP
+    resync = resync || pReader->mFifoCorrupt;
+#endif
+    if (overflow || resync) {
+        // the oldest samples were overwritten, and with them the record
+        // boundaries, or the drain lost them; start over from an empty FIFO
+        // before the first drain it only filled up since IMU::Start()
+        if (overflow && pReader->mFifoStats.reads) ++pReader->mFifoStats.overflows;
+        pReader->mFifoSynced = false;
+        if (!imu.StartFifoReset(OnFifoReset, pArg)) pReader->mReadPending = false;
+        return;
+    }
+    pReader->mFifoSynced = true;
+
+    // whole decimation groups only, so every drain ends on an output sample;
+    // a partial group stays in the FIFO for the next drain
+    uint16_t available = count / pReader->mFifoRecordLen;
+    uint16_t num = available - available % pReader->mFifoDecimation;
+    if (num > pReader->mFifoMaxSamples) num = pReader->mFifoMaxSamples;
+    if (num == 0) {
+        ++pReader->mFifoStats.shortReads;
+        pReader->mReadPending = false;
+        return;
+    }
+    // the newest record in the FIFO is the sample of the last data-ready
+    // edge, or about now when polled; when the drain is behind, the ones it
+    // reads are older
+    uint64_t newestUs = Clock_GetUs();
+    if (!pReader->mReadPolled) newestUs -= Clock_CyclesToUs(Clock_GetCycles() - imu.mDataReadyCycles);
+    pReader->mReadTimeUs = newestUs - (uint64_t) (available - num) * pReader->mFifoSamplePeriodUs;
+    SensorFifoBurstType* pBurst = pReader->mFifoBursts.BeginWrite();
+    pBurst->numOfSamples = num;
+    if (!imu.StartFifoRead(pBurst->data, num * pReader->mFifoRecordLen, OnReadDone, pArg)) {
+        pReader->mReadPending = false;
+        ++pReader->mSkippedReads;
+    }
+}
+
+// IMU bus interrupt context
+void SensorReader::OnFifoReset(bool ok, void* pArg)
+{
+    SensorReader* pReader = (SensorReader*) pArg;
+    pReader->mReadPending = false;
+    // the next drain counts from here
+    pReader->mFifoEdges = 0;
+    pReader->mFifoSynced = ok;
+#if UAV_IMU_DMP
+    if (ok) pReader->mFifoCorrupt = false;
+#endif
+}
+#endif
+
+// IMU bus interrupt context
+void SensorReader::OnReadDone(bool ok, void* pArg)
+{
+    SensorReader* pReader = (SensorReader*) pArg;
+    pReader->mReadPending = false;
+#if UAV_IMU_FIFO
+    if (!ok) {
+        // part of a record may be gone, the next FIFO_COUNT tells
+        pReader->mFifoSynced = false;
+        return;
+    }
+    SensorFifoStatsType& stats = pReader->mFifoStats;
+    uint16_t num = pReader->mFifoBursts.BeginWrite()->numOfSamples;
+    ++stats.reads;
+    stats.samples += num;
+    if (num < stats.minSamples) stats.minSamples = num;
+    if (num > stats.maxSamples) stats.maxSamples = num;
+    pReader->mFifoBursts.EndWrite(pReader->mReadTimeUs);
+#else
+    // a failed read leaves the slot unpublished, the error is in ImuBus_GetStats()
+    if (!ok) return;
+    pReader->mBursts.EndWrite(pReader->mReadTimeUs);
+#endif
+    if (pReader->mReadDoneCb) pReader->mReadDoneCb(pReader->mReadTimeUs);
+}
+
+void SensorReader::SetReadDoneCb(SensorReadDoneCb cb)
+{
+    mReadDoneCb = cb;
+}
+
+uint32_t SensorReader::GetSkippedReads()
+{
+    return mSkippedReads;
+}
+
+#if UAV_IMU_FIFO
+void SensorReader::GetFifoStats(SensorFifoStatsType* pStats)
 {
+    // the IMU bus interrupt updates the counters, take a consistent copy
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pStats = mFifoStats;
+    __set_PRIMASK(primask);
+}
+
+void SensorReader::ResetFifoStats()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&mFifoStats, 0, sizeof(mFifoStats));
+    mFifoStats.minSamples = UINT16_MAX;
+    __set_PRIMASK(primask);
+}
+
+#if UAV_IMU_DMP
+// the DMP fused the packets already, each one is a measurement
+bool SensorReader::ReadDmpMeas(const LatestValue<SensorFifoBurstType>::SlotType& burst)
+{
+    IMU& imu = IMU::GetInstance();
+    int num = burst.value.numOfSamples;
+    bool published = false;
+    for (int i = 0; i < num; ++i) {
+        FCSensorMeasType* pMeas = mMeas.BeginWrite();
+        if (!imu.GetFifoDmpData(&burst.value.data[i * MPU9250_FIFO_DMP_LEN], &(pMeas->gyroData), &(pMeas->accData),
+                                &(pMeas->quat))) {
+            // the rest of the burst is out of step as well
+            ++mFifoStats.corrupt;
+            mFifoCorrupt = true;
+            break;
+        }
+        pMeas->quatValid = true;
+        mMeas.EndWrite(burst.timeUs - (uint64_t) (num - 1 - i) * SENSOR_DMP_SAMPLE_PERIOD_US);
+        published = true;
+    }
+    return published;
+}
+#endif
+
+bool SensorReader::ReadSensorMeas()
+{
+    if (!mFifoBursts.Update()) return false;
+    const LatestValue<SensorFifoBurstType>::SlotType& burst = mFifoBursts.Latest();
+#if UAV_IMU_DMP
+    if (mFifoRecordLen == MPU9250_FIFO_DMP_LEN) return ReadDmpMeas(burst);
+#endif
     IMU& imu = IMU::GetInstance();
-    imu.GetGyroData(&(meas.gyroData));
-    imu.GetAccelData(&(meas.accData));
+    int num = burst.value.numOfSamples;
+    bool published = false;
+    for (int i = 0; i < num; ++i) {
+        FCSensorDataType gyro, acc;
+        imu.GetFifoMotionData(&burst.value.data[i * MPU9250_FIFO_MOTION6_LEN], &gyro, &acc);
+        float in[SENSOR_DECIMATOR_CHANNELS] = { gyro.x, gyro.y, gyro.z, acc.x, acc.y, acc.z };
+        float out[SENSOR_DECIMATOR_CHANNELS];
+        if (!Decimator_Put(&mDecimator, in, out)) continue;
+        FCSensorMeasType* pMeas = mMeas.BeginWrite();
+        pMeas->gyroData.x = out[0];
+        pMeas->gyroData.y = out[1];
+        pMeas->gyroData.z = out[2];
+        pMeas->accData.x = out[3];
+        pMeas->accData.y = out[4];
+        pMeas->accData.z = out[5];
+#if UAV_IMU_DMP
+        pMeas->quatValid = false;
+#endif
+        // one sample period between the records, the last one is burst.timeUs
+        mMeas.EndWrite(burst.timeUs - (uint64_t) (num - 1 - i) * SENSOR_FIFO_SAMPLE_PERIOD_US);
+        published = true;
+    }
+    return published;
+}
+#else
+bool SensorReader::ReadSensorMeas()
+{
+    if (!mBursts.Update()) return false;
+    const LatestValue<SensorBurstType>::SlotType& burst = mBursts.Latest();
+    // convert straight into the channel's write slot
+    FCSensorMeasType* pMeas = mMeas.BeginWrite();
+    IMU::GetInstance().GetMotionData(burst.value.data, &(pMeas->gyroData), &(pMeas->accData));
+    mMeas.EndWrite(burst.timeUs);
     return true;
-}
\ No newline at end of file
+}
+#endif
+#else
+bool SensorReader::ReadSensorMeas()
+{
+    IMU& imu = IMU::GetInstance();
+    // read straight into the channel's write slot
+    FCSensorMeasType* pMeas = mMeas.BeginWrite();
+    // one timestamp for all axes: the MPU9250 holds its output registers for
+    // the burst, so the sample is as old as the start of the transfer
+    uint64_t timeUs = Clock_GetUs();
+    imu.GetMotionData(&(pMeas->gyroData), &(pMeas->accData));
+    mMeas.EndWrite(timeUs);
+    return true;
+}
+#endif
@@ -1,3 +1,5 @@
+#include <math.h>
+
 #include "stm32f1xx_hal.h"
 
 #include "logging.h"
@@ -10,11 +12,18 @@
 
 #define LOG_TAG ("StateEstimator")
 
+#if UAV_IMU_PIPELINE
+#define DEFAULT_FILTER_FREQ UAV_IMU_SAMPLE_RATE_HZ // runs on every sample
+#else
 #define DEFAULT_FILTER_FREQ 50 //hz
+#endif
 
 StateEstimator::StateEstimator() :
     mFilter()
 {
+#if UAV_IMU_DMP
+    mDmpUsed = false;
+#endif
     mState.att.roll = 0.0f;
     mState.att.yaw = 0.0f;
     mState.att.pitch = 0.0f;
@@ -33,14 +42,48 @@ bool StateEstimator::Init()
     return true;
 }
 
-bool StateEstimator::EstimateState(FCSensorMeasType& meas)
+const char* StateEstimator::GetBackendName()
+{
+#if UAV_IMU_DMP
+    if (mDmpUsed) return "dmp";
+#endif
+    return "madgwick";
+}
+
+#if UAV_IMU_DMP
+// The DMP's quaternion turns the sensor frame into its world frame. Madgwick
+// sees the sensor's up vector with z flipped and integrates the yaw rate the
+// other way round, the angles come out of the quaternion the same way.
+void StateEstimator::ConvertDmpQuat(const FCQuaternionType& quat)
+{
+    float w = quat.q1, x = quat.q2, y = quat.q3, z = quat.q4;
+    // world up in the sensor frame, z flipped as the accel goes to Madgwick
+    float upX = 2.0f * (x * z - w * y);
+    float upY = 2.0f * (w * x + y * z);
+    float upZ = -(w * w - x * x - y * y + z * z);
+    mState.att.roll = -atan2f(upY, upZ) * UAV_RADIANS_TO_DEGREE;
+    mState.att.pitch = asinf(fmaxf(-1.0f, fminf(1.0f, -upX))) * UAV_RADIANS_TO_DEGREE;
+    mState.att.yaw = -atan2f(2.0f * (x * y + w * z), 1.0f - 2.0f * (y * y + z * z)) * UAV_RADIANS_TO_DEGREE;
+}
+#endif
+
+bool StateEstimator::EstimateState(const FCSensorMeasType& meas)
 {
-    // All this flipping is because IMU is mounted upside down
-    mFilter.updateIMU(-meas.gyroData.x, -meas.gyroData.y, -meas.gyroData.z,
-                      meas.accData.x, meas.accData.y, -meas.accData.z);
-    mState.att.roll = -mFilter.getRoll();
-    mState.att.pitch = mFilter.getPitch();
-    mState.att.yaw = mFilter.getYaw();
+#if UAV_IMU_DMP
+    if (meas.quatValid) {
+        // fused on the MPU9250 already
+        ConvertDmpQuat(meas.quat);
+        mDmpUsed = true;
+    } else
+#endif
+    {
+        // All this flipping is because IMU is mounted upside down
+        mFilter.updateIMU(-meas.gyroData.x, -meas.gyroData.y, -meas.gyroData.z,
+                          meas.accData.x, meas.accData.y, -meas.accData.z);
+        mState.att.roll = -mFilter.getRoll();
+        mState.att.pitch = mFilter.getPitch();
+        mState.att.yaw = mFilter.getYaw();
+    }
     mState.attRate.roll = meas.gyroData.x;
     mState.attRate.pitch = -meas.gyroData.y;
     mState.attRate.yaw = -meas.gyroData.z;
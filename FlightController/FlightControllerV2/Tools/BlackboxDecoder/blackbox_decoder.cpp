@@ -0,0 +1,119 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "blackbox.h"
+
+/*
+ * Host side of the flight data recorder (see blackbox.h).
+ *
+ *     fc_blackbox_decoder [recording.bin] > flight.csv
+ *
+ * Picks the raw or encoded frames out of a recording or a USART2 capture
+ * (stdin if no file), skipping anything in between such as log output, and
+ * writes one CSV row per frame. Sequence gaps are frames that were dropped
+ * in the firmware or lost on the way.
+ */
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t frames;
+    uint32_t lostFrames;
+    uint32_t noKeyframe;
+    uint32_t skippedBytes;
+} DecodeStatsType;
+
+/*
+ * Code
+ */
+
+static void PrintHeader()
+{
+    printf("time_us,seq,gyro_x,gyro_y,gyro_z,acc_x,acc_y,acc_z,"
+           "yaw,pitch,roll,yaw_rate,pitch_rate,roll_rate,"
+           "sp_yaw,sp_pitch,sp_roll,sp_yaw_rate,sp_pitch_rate,sp_roll_rate,"
+           "pid_pitch_p,pid_pitch_i,pid_pitch_d,pid_roll_p,pid_roll_i,pid_roll_d,pid_yaw_p,pid_yaw_i,pid_yaw_d,"
+           "m1,m2,m3,m4,armed\n");
+}
+
+static void PrintFrame(const BlackboxFrameType& frame)
+{
+    printf("%u,%u,%g,%g,%g,%g,%g,%g,", frame.timeUs, frame.seq, frame.meas.gyroData.x, frame.meas.gyroData.y,
+           frame.meas.gyroData.z, frame.meas.accData.x, frame.meas.accData.y, frame.meas.accData.z);
+    printf("%g,%g,%g,%g,%g,%g,", frame.state.att.yaw, frame.state.att.pitch, frame.state.att.roll,
+           frame.state.attRate.yaw, frame.state.attRate.pitch, frame.state.attRate.roll);
+    printf("%g,%g,%g,%g,%g,%g,", frame.attSetpoint.yaw, frame.attSetpoint.pitch, frame.attSetpoint.roll,
+           frame.attRateSetpoint.yaw, frame.attRateSetpoint.pitch, frame.attRateSetpoint.roll);
+    for (int i = 0; i < 3; ++i) {
+        printf("%g,%g,%g,", frame.attRatePID[i].p, frame.attRatePID[i].i, frame.attRatePID[i].d);
+    }
+    printf("%u,%u,%u,%u,%u\n", frame.motorPWM[0], frame.motorPWM[1], frame.motorPWM[2], frame.motorPWM[3],
+           (frame.flags & BLACKBOX_FLAG_ARMED) ? 1 : 0);
+}
+
+static void Decode(const std::vector<uint8_t>& data, DecodeStatsType* pStats)
+{
+    BlackboxCodecType codec;
+    Blackbox_InitCodec(&codec);
+    bool first = true;
+    uint32_t nextSeq = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        BlackboxFrameType frame;
+        int len = 0;
+        BlackboxParseResultType result = Blackbox_ParsePacket(&codec, &data[pos], (int) (data.size() - pos), frame, &len);
+        if (result == BLACKBOX_PARSE_NO_FRAME || result == BLACKBOX_PARSE_NEED_MORE) {
+            // the whole input is here, a cut off packet is not one either
+            ++pStats->skippedBytes;
+            ++pos;
+            continue;
+        }
+        pos += len;
+        if (result == BLACKBOX_PARSE_NO_KEYFRAME) {
+            ++pStats->noKeyframe;
+            continue;
+        }
+
+        if (!first && frame.seq != nextSeq) {
+            fprintf(stderr, "seq %u..%u lost\n", nextSeq, frame.seq - 1);
+            pStats->lostFrames += frame.seq - nextSeq;
+        }
+        first = false;
+        nextSeq = frame.seq + 1;
+        ++pStats->frames;
+        PrintFrame(frame);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2) {
+        printf("usage: %s [recording.bin]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (argc == 2) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+
+    DecodeStatsType stats = {};
+    PrintHeader();
+    Decode(data, &stats);
+    fprintf(stderr, "%u frames, %u lost, %u waiting for a keyframe, %u bytes skipped\n", stats.frames,
+            stats.lostFrames, stats.noKeyframe, stats.skippedBytes);
+    return 0;
+}
@@ -0,0 +1,317 @@
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "crsf_decoder.h"
+
+/*
+ * Feeds a CRSF byte stream with injected corruption through the firmware's
+ * streaming decoder (crsf_decoder.h).
+ *
+ *     fc_crsf_replay [--corrupt <n>] [--seed <n>] [--rate <hz>] [--idle-miss <n>] [capture.bin]
+ *
+ * Takes the frames of a capture (e.g. from fc_sil --rc-protocol crsf
+ * --rc-out), or synthesises 60 s of RC frames at the packet rate with link
+ * statistics every 100 ms, and puts them back on a virtual 420 kbaud line
+ * with one in n frames damaged: a flipped bit, a lost byte, a stray byte, a
+ * damaged address or length byte, or a burst of noise before it. One in m
+ * idle lines between frames is left out, the CRC alone has to delimit them.
+ *
+ * Every decoded frame must be an undamaged frame that was sent, in order.
+ * CRC-8 catches every single bit flip and misses one in 256 of the other
+ * damage, so a frame made up of damaged bytes that passes it is counted,
+ * not failed; a flipped bit that passes fails the run. The summary shows how
+ * many undamaged frames were lost along with the damaged ones and how long
+ * an RC frame takes on the wire next to SBUS.
+ */
+
+/*
+ * Defines
+ */
+
+#define BYTE_TIME_NS (23810) // 10 bits at 420 kbaud: start, 8 data, stop
+#define SBUS_FRAME_WIRE_US (3000) // 25 bytes of 12 bits at 100 kbaud
+#define DEFAULT_RATE_HZ (250)
+#define LINK_STATS_PERIOD_US (100000)
+#define SYNTH_DURATION_S (60)
+#define NOISE_MAX_LEN (8)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    std::vector<uint8_t> data;
+    uint64_t startUs;
+} FrameType;
+
+typedef enum {
+    DAMAGE_NONE = 0,
+    DAMAGE_BIT_FLIP,
+    DAMAGE_LOST_BYTE,
+    DAMAGE_STRAY_BYTE,
+    DAMAGE_ADDRESS,
+    DAMAGE_LENGTH,
+    DAMAGE_NOISE,
+    NUM_OF_DAMAGE
+} DamageType;
+
+typedef struct {
+    int64_t start;      // index of the address byte on the line, -1 if the frame cannot decode
+    DamageType damage;
+} SentFrameType;
+
+/*
+ * Static
+ */
+
+static const char* sDamageNames[NUM_OF_DAMAGE] = {
+    "none", "bit flip", "lost byte", "stray byte", "address", "length", "noise before",
+};
+
+/*
+ * Code
+ */
+
+static FrameType MakeFrame(uint8_t type, const uint8_t* pPayload, int len, uint64_t startUs)
+{
+    FrameType frame;
+    frame.data.resize(CRSF_MAX_FRAME_LEN);
+    frame.data.resize(CRSF_BuildFrame(type, pPayload, len, frame.data.data()));
+    frame.startUs = startUs;
+    return frame;
+}
+
+static void Synthesise(std::vector<FrameType>* pFrames, uint32_t rateHz)
+{
+    uint32_t periodUs = 1000000 / rateHz;
+    uint64_t nextLinkStatsUs = periodUs / 2;
+    for (uint64_t us = 0; us < (uint64_t) SYNTH_DURATION_S * 1000000; us += periodUs) {
+        // slow sweeps, so neighbouring frames differ
+        uint16_t channels[CRSF_NUM_OF_CHANNELS];
+        uint32_t n = (uint32_t) (us / periodUs);
+        for (int ch = 0; ch < CRSF_NUM_OF_CHANNELS; ++ch) {
+            channels[ch] = (uint16_t) (CRSF_CHANNEL_MIN + (n * (ch + 1) * 7) % (CRSF_CHANNEL_MAX - CRSF_CHANNEL_MIN));
+        }
+        uint8_t payload[CRSF_RC_CHANNELS_PAYLOAD_LEN];
+        CRSF_PackChannels(channels, payload);
+        pFrames->push_back(MakeFrame(CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, sizeof(payload), us));
+        if (us + periodUs > nextLinkStatsUs) {
+            uint8_t link[CRSF_LINK_STATISTICS_PAYLOAD_LEN] = { 40, 41, (uint8_t) (100 - n % 7), 10, 0, 5, 3, 45, 100, 8 };
+            pFrames->push_back(MakeFrame(CRSF_FRAMETYPE_LINK_STATISTICS, link, sizeof(link), nextLinkStatsUs));
+            nextLinkStatsUs += LINK_STATS_PERIOD_US;
+        }
+    }
+}
+
+// the frames of a capture as the decoder finds them in the undamaged stream,
+// spaced as if they came at the packet rate
+static bool LoadCapture(const char* path, uint32_t rateHz, std::vector<FrameType>* pFrames,
+                        CRSFDecoderStatsType* pStats)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    uint32_t periodUs = 1000000 / rateHz;
+    uint64_t us = 0;
+    CRSFDecoderType dec;
+    CRSFDecoder_Init(&dec);
+    for (size_t i = 0; i < data.size(); ++i) {
+        const uint8_t* pFrame = CRSFDecoder_PutByte(&dec, data[i], 0);
+        for (; pFrame; pFrame = CRSFDecoder_Next(&dec, 0)) {
+            int len = pFrame[1] + 2;
+            FrameType frame;
+            frame.data.assign(pFrame, pFrame + len);
+            frame.startUs = us;
+            pFrames->push_back(frame);
+            us += pFrame[CRSF_FRAME_TYPE_INDEX] == CRSF_FRAMETYPE_RC_CHANNELS_PACKED ? periodUs : periodUs / 4;
+        }
+    }
+    *pStats = dec.stats;
+    return true;
+}
+
+static void Damage(std::vector<uint8_t>* pBytes, DamageType damage, std::mt19937* pRng)
+{
+    std::vector<uint8_t>& bytes = *pBytes;
+    switch (damage) {
+    case DAMAGE_BIT_FLIP:
+        // the address and length have their own damage
+        bytes[2 + (*pRng)() % (bytes.size() - 2)] ^= (uint8_t) (1 << ((*pRng)() % 8));
+        break;
+    case DAMAGE_LOST_BYTE:
+        bytes.erase(bytes.begin() + (*pRng)() % bytes.size());
+        break;
+    case DAMAGE_STRAY_BYTE:
+        bytes.insert(bytes.begin() + 1 + (*pRng)() % (bytes.size() - 1), (uint8_t) (*pRng)());
+        break;
+    case DAMAGE_ADDRESS:
+        bytes[0] ^= (uint8_t) (1 << ((*pRng)() % 8));
+        break;
+    case DAMAGE_LENGTH:
+        bytes[1] ^= (uint8_t) (1 << ((*pRng)() % 8));
+        break;
+    default:
+        break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t corruptOneInN = 10;
+    uint32_t seed = 1;
+    uint32_t rateHz = DEFAULT_RATE_HZ;
+    uint32_t idleMissOneInN = 4;
+    const char* pPath = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--corrupt") && i + 1 < argc) {
+            corruptOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rateHz = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--idle-miss") && i + 1 < argc) {
+            idleMissOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !pPath) {
+            pPath = argv[i];
+        } else {
+            printf("usage: %s [--corrupt <n>] [--seed <n>] [--rate <hz>] [--idle-miss <n>] [capture.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rateHz == 0) rateHz = DEFAULT_RATE_HZ;
+
+    std::vector<FrameType> frames;
+    if (pPath) {
+        CRSFDecoderStatsType captureStats;
+        if (!LoadCapture(pPath, rateHz, &frames, &captureStats)) {
+            fprintf(stderr, "cannot open %s\n", pPath);
+            return 1;
+        }
+        printf("%zu frames from %s (%u rc, %u link stats, %u crc errors, %u bytes skipped in the capture)\n",
+               frames.size(), pPath, captureStats.rcFrames, captureStats.linkStatsFrames, captureStats.crcErrors,
+               captureStats.skippedBytes);
+    } else {
+        Synthesise(&frames, rateHz);
+        printf("%zu frames of synthetic %u Hz CRSF\n", frames.size(), rateHz);
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<SentFrameType> sent(frames.size());
+    std::vector<int32_t> origin;  // per byte on the line: the frame it belongs to, -1 if damaged
+    std::vector<uint8_t> flipped; // per byte on the line: the address of a frame with a flipped bit
+    CRSFDecoderType dec;
+    CRSFDecoder_Init(&dec);
+    uint32_t damageCnt[NUM_OF_DAMAGE] = { 0 };
+    uint32_t idleCnt = 0;
+    std::vector<size_t> decodedStart;
+    uint32_t late = 0;        // frames found by a rescan after their last byte
+    uint32_t collisions = 0;  // frames made up by the damage that passed the CRC
+    uint32_t bad = 0;
+
+    for (size_t n = 0; n < frames.size(); ++n) {
+        DamageType damage = DAMAGE_NONE;
+        if (corruptOneInN && rng() % corruptOneInN == 0) {
+            damage = (DamageType) (1 + rng() % (NUM_OF_DAMAGE - 1));
+        }
+        ++damageCnt[damage];
+
+        std::vector<uint8_t> bytes;
+        int noiseLen = 0;
+        if (damage == DAMAGE_NOISE) {
+            // no idle line between the noise and the frame
+            noiseLen = 1 + (int) (rng() % NOISE_MAX_LEN);
+            for (int i = 0; i < noiseLen; ++i) {
+                bytes.push_back((uint8_t) rng());
+            }
+        }
+        bytes.insert(bytes.end(), frames[n].data.begin(), frames[n].data.end());
+        Damage(&bytes, damage, &rng);
+
+        bool intact = damage == DAMAGE_NONE || damage == DAMAGE_NOISE;
+        sent[n].damage = damage;
+        sent[n].start = intact ? (int64_t) (origin.size() + noiseLen) : -1;
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            origin.push_back(intact && (int) i >= noiseLen ? (int32_t) n : -1);
+            flipped.push_back(damage == DAMAGE_BIT_FLIP && i == 0);
+            uint64_t timeUs = frames[n].startUs + (i + 1) * BYTE_TIME_NS / 1000;
+            const uint8_t* pFrame = CRSFDecoder_PutByte(&dec, bytes[i], timeUs);
+            for (; pFrame; pFrame = CRSFDecoder_Next(&dec, timeUs)) {
+                // the decoder keeps the bytes after a frame a rescan found
+                size_t last = origin.size() - 1 - dec.len;
+                decodedStart.push_back(last + 1 - (pFrame[1] + 2));
+                if (last != origin.size() - 1) ++late;
+            }
+        }
+        if (idleMissOneInN && rng() % idleMissOneInN == 0) continue;
+        ++idleCnt;
+        CRSFDecoder_OnIdle(&dec);
+    }
+
+    std::vector<bool> received(frames.size(), false);
+    int32_t prev = -1;
+    for (size_t i = 0; i < decodedStart.size(); ++i) {
+        size_t start = decodedStart[i];
+        int32_t n = origin[start];
+        if (n >= 0 && sent[n].start == (int64_t) start) {
+            if (received[n] || n < prev) {
+                if (bad < 5) printf("frame %d: out of order or repeated\n", n);
+                ++bad;
+            }
+            received[n] = true;
+            prev = n;
+        } else if (flipped[start]) {
+            if (bad < 5) printf("frame from byte %zu: a flipped bit passed the CRC\n", start);
+            ++bad;
+        } else {
+            ++collisions;
+        }
+    }
+
+    // undamaged frames lost with a damaged neighbour, by the damage
+    uint32_t collateral[NUM_OF_DAMAGE] = { 0 };
+    uint32_t intactCnt = 0;
+    uint32_t intactLost = 0;
+    for (size_t n = 0; n < sent.size(); ++n) {
+        if (sent[n].start < 0) continue;
+        ++intactCnt;
+        if (received[n]) continue;
+        ++intactLost;
+        DamageType cause = DAMAGE_NONE;
+        if (n + 1 < sent.size() && sent[n + 1].damage != DAMAGE_NONE) cause = sent[n + 1].damage;
+        if (sent[n].damage != DAMAGE_NONE) cause = sent[n].damage;
+        if (n > 0 && sent[n - 1].damage != DAMAGE_NONE) cause = sent[n - 1].damage;
+        ++collateral[cause];
+    }
+
+    const CRSFDecoderStatsType& stats = dec.stats;
+    printf("corrupt 1 in %u, seed %u, %u idle lines (1 in %u missed)\n", corruptOneInN, seed, idleCnt,
+           idleMissOneInN);
+    printf("damaged frames  :");
+    for (int d = DAMAGE_BIT_FLIP; d < NUM_OF_DAMAGE; ++d) {
+        printf(" %u %s%s", damageCnt[d], sDamageNames[d], d + 1 < NUM_OF_DAMAGE ? "," : "\n");
+    }
+    printf("decoded         : %u of %u intact frames (%u after a rescan), %u made up by the damage passed the crc, %u bad\n",
+           intactCnt - intactLost, intactCnt, late, collisions, bad);
+    printf("intact lost     : %u (", intactLost);
+    for (int d = DAMAGE_NONE; d < NUM_OF_DAMAGE; ++d) {
+        printf("%u next to %s%s", collateral[d], sDamageNames[d], d + 1 < NUM_OF_DAMAGE ? ", " : ")\n");
+    }
+    printf("decoder         : %u frames, %u rc at %.1f Hz, period %u..%u us, %u link stats, %u crc errors, "
+           "%u bad lengths, %u partial, %u bytes skipped\n", stats.frames, stats.rcFrames,
+           CRSFDecoder_GetRcFrameRateHz(&stats), stats.minPeriodUs, stats.maxPeriodUs, stats.linkStatsFrames,
+           stats.crcErrors, stats.badLengths, stats.partialFrames, stats.skippedBytes);
+    int rcLen = CRSF_RC_CHANNELS_PAYLOAD_LEN + 4;
+    printf("rc frame        : %d bytes, %u us on the wire every %u us (SBUS: %u us every 14000 us)\n", rcLen,
+           (uint32_t) (rcLen * BYTE_TIME_NS / 1000), 1000000 / rateHz, SBUS_FRAME_WIRE_US);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,307 @@
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "filter_bank.h"
+
+/*
+ * Cost and response of the filter bank.
+ *
+ *     fc_filter_bank_bench
+ *
+ * Runs SAMPLES three-axis samples of synthetic gyro counts (slow manoeuvres,
+ * a motor line at NOTCH_HZ and noise, at the FIFO rate) through a few stage
+ * set-ups, in float (FilterBankType), in fixed point (FilterBankQType) and,
+ * for reference, in float one axis per call as separate filters would. It
+ * prints host cycles (TSC) per three-axis sample, the gain at a few
+ * frequencies and how far the fixed point output strays from the float one,
+ * and fails if that is more than MAX_Q_ERROR_COUNTS. Host cycles say
+ * nothing about the M3, which has no FPU; compare them between variants and
+ * commits.
+ */
+
+/*
+ * Defines
+ */
+
+#define SAMPLES (1 << 20)
+#define RATE_HZ (1000.0f)
+#define NOTCH_HZ (150.0f)
+#define CUTOFF_HZ (40.0f)
+#define GAIN_SAMPLES (4000)          // per frequency, the first half settles
+#define MAX_Q_ERROR_COUNTS (1.0)
+#define COUNTS_PER_DPS (16.4f)       // +-2000 dps
+#define RETUNES (1 << 16)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    FilterKindType kind;
+    float hz;
+    float q;
+} BenchStageType;
+
+typedef struct {
+    const char* name;
+    int numOfStages;
+    BenchStageType stage[FILTER_BANK_MAX_STAGES];
+} BenchConfigType;
+
+// one axis of one stage, as a filter object per axis would keep it
+typedef struct {
+    FilterKindType kind;
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+} AxisStageType;
+
+/*
+ * Static
+ */
+
+static const BenchConfigType sConfigs[] = {
+    { "PT1 40 Hz", 1, { { FILTER_PT1, CUTOFF_HZ, 0.0f } } },
+    { "PT2 40 Hz", 1, { { FILTER_PT2, CUTOFF_HZ, 0.0f } } },
+    { "biquad LPF 40 Hz", 1, { { FILTER_BIQUAD_LPF, CUTOFF_HZ, 0.0f } } },
+    { "notch 150 Hz Q3", 1, { { FILTER_NOTCH, NOTCH_HZ, 3.0f } } },
+    { "notch + biquad LPF", 2, { { FILTER_NOTCH, NOTCH_HZ, 3.0f }, { FILTER_BIQUAD_LPF, CUTOFF_HZ, 0.0f } } },
+};
+static const float sGainHz[] = { 5.0f, 20.0f, 40.0f, 100.0f, NOTCH_HZ, 300.0f };
+
+static volatile int64_t sSink;
+
+/*
+ * Code
+ */
+
+static uint64_t GetCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static bool SetUp(const BenchConfigType& config, FilterBankType* pBank, FilterBankQType* pBankQ)
+{
+    if (!FilterBank_Init(pBank, RATE_HZ) || !FilterBankQ_Init(pBankQ, RATE_HZ)) return false;
+    for (int k = 0; k < config.numOfStages; ++k) {
+        const BenchStageType& stage = config.stage[k];
+        if (FilterBank_AddStage(pBank, stage.kind, stage.hz, stage.q) < 0) return false;
+        if (FilterBankQ_AddStage(pBankQ, stage.kind, stage.hz, stage.q) < 0) return false;
+    }
+    return true;
+}
+
+// gyro counts of a quad in flight: manoeuvres, one motor line, white noise
+static std::vector<int16_t> Synthesise()
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.3f * COUNTS_PER_DPS);
+    std::vector<int16_t> samples(SAMPLES * FILTER_BANK_AXES);
+    for (int n = 0; n < SAMPLES; ++n) {
+        float t = n / RATE_HZ;
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            float dps = 200.0f * sinf(2.0f * (float) M_PI * (0.5f + i) * t) + 10.0f * sinf(2.0f * (float) M_PI * NOTCH_HZ * t + i);
+            float counts = dps * COUNTS_PER_DPS + noise(rng);
+            samples[n * FILTER_BANK_AXES + i] = (int16_t) lrintf(counts);
+        }
+    }
+    return samples;
+}
+
+static void BenchFloat(FilterBankType* pBank, const std::vector<int16_t>& samples, double* pCycles)
+{
+    float in[FILTER_BANK_AXES], out[FILTER_BANK_AXES];
+    float checksum = 0.0f;
+    uint64_t start = GetCycles();
+    for (int n = 0; n < SAMPLES; ++n) {
+        const int16_t* pSample = &samples[n * FILTER_BANK_AXES];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) in[i] = pSample[i];
+        FilterBank_Apply(pBank, in, out);
+        checksum += out[0];
+    }
+    *pCycles = (double) (GetCycles() - start) / SAMPLES;
+    sSink = (int64_t) checksum;
+}
+
+static void BenchQ(FilterBankQType* pBank, const std::vector<int16_t>& samples, double* pCycles)
+{
+    int32_t in[FILTER_BANK_AXES], out[FILTER_BANK_AXES];
+    int64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (int n = 0; n < SAMPLES; ++n) {
+        const int16_t* pSample = &samples[n * FILTER_BANK_AXES];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) in[i] = pSample[i] * (1 << FILTER_BANK_Q_SAMPLE_SHIFT);
+        FilterBankQ_Apply(pBank, in, out);
+        checksum += out[0];
+    }
+    *pCycles = (double) (GetCycles() - start) / SAMPLES;
+    sSink = checksum;
+}
+
+__attribute__((noinline)) static float ApplyAxisStage(AxisStageType* pStage, float x)
+{
+    switch (pStage->kind) {
+    case FILTER_PT1:
+        pStage->z1 += pStage->b0 * (x - pStage->z1);
+        return pStage->z1;
+    case FILTER_PT2:
+        pStage->z1 += pStage->b0 * (x - pStage->z1);
+        pStage->z2 += pStage->b0 * (pStage->z1 - pStage->z2);
+        return pStage->z2;
+    default: {
+        float y = pStage->b0 * x + pStage->z1;
+        pStage->z1 = pStage->b1 * x - pStage->a1 * y + pStage->z2;
+        pStage->z2 = pStage->b2 * x - pStage->a2 * y;
+        return y;
+    }
+    }
+}
+
+// the same coefficients, a filter per axis and stage, starting from zero
+static void BenchPerAxis(const FilterBankType* pBank, const std::vector<int16_t>& samples, double* pCycles)
+{
+    AxisStageType stages[FILTER_BANK_AXES][FILTER_BANK_MAX_STAGES];
+    memset(stages, 0, sizeof(stages));
+    for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+        for (int k = 0; k < pBank->numOfStages; ++k) {
+            const FilterStageType* pStage = &pBank->stage[k];
+            AxisStageType* pAxis = &stages[i][k];
+            pAxis->kind = pStage->kind;
+            pAxis->b0 = pStage->b0;
+            pAxis->b1 = pStage->b1;
+            pAxis->b2 = pStage->b2;
+            pAxis->a1 = pStage->a1;
+            pAxis->a2 = pStage->a2;
+        }
+    }
+    float checksum = 0.0f;
+    uint64_t start = GetCycles();
+    for (int n = 0; n < SAMPLES; ++n) {
+        const int16_t* pSample = &samples[n * FILTER_BANK_AXES];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            float y = pSample[i];
+            for (int k = 0; k < pBank->numOfStages; ++k) {
+                y = ApplyAxisStage(&stages[i][k], y);
+            }
+            if (i == 0) checksum += y;
+        }
+    }
+    *pCycles = (double) (GetCycles() - start) / SAMPLES;
+    sSink = (int64_t) checksum;
+}
+
+// largest difference between the float and the fixed point output, in counts
+static double CompareQ(const BenchConfigType& config, const std::vector<int16_t>& samples)
+{
+    FilterBankType bank;
+    FilterBankQType bankQ;
+    SetUp(config, &bank, &bankQ);
+    double maxError = 0.0;
+    for (int n = 0; n < SAMPLES; ++n) {
+        const int16_t* pSample = &samples[n * FILTER_BANK_AXES];
+        float in[FILTER_BANK_AXES], out[FILTER_BANK_AXES];
+        int32_t inQ[FILTER_BANK_AXES], outQ[FILTER_BANK_AXES];
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            in[i] = pSample[i];
+            inQ[i] = pSample[i] * (1 << FILTER_BANK_Q_SAMPLE_SHIFT);
+        }
+        FilterBank_Apply(&bank, in, out);
+        FilterBankQ_Apply(&bankQ, inQ, outQ);
+        for (int i = 0; i < FILTER_BANK_AXES; ++i) {
+            double error = fabs((double) outQ[i] / (1 << FILTER_BANK_Q_SAMPLE_SHIFT) - out[i]);
+            if (error > maxError) maxError = error;
+        }
+    }
+    return maxError;
+}
+
+// output over input amplitude of a sine, dB, after the filter settled
+static double MeasureGainDb(const BenchConfigType& config, float hz)
+{
+    FilterBankType bank;
+    FilterBankQType bankQ;
+    SetUp(config, &bank, &bankQ);
+    double inSq = 0.0, outSq = 0.0;
+    for (int n = 0; n < GAIN_SAMPLES; ++n) {
+        float x = 1000.0f * sinf(2.0f * (float) M_PI * hz * n / RATE_HZ);
+        float in[FILTER_BANK_AXES] = { x, x, x };
+        float out[FILTER_BANK_AXES];
+        FilterBank_Apply(&bank, in, out);
+        if (n < GAIN_SAMPLES / 2) continue;
+        inSq += (double) x * x;
+        outSq += (double) out[0] * out[0];
+    }
+    return 10.0 * log10(outSq / inSq);
+}
+
+// a notch following the motor speed retunes on every sample at worst
+static void BenchRetune()
+{
+    FilterBankType bank;
+    FilterBankQType bankQ;
+    FilterBank_Init(&bank, RATE_HZ);
+    FilterBankQ_Init(&bankQ, RATE_HZ);
+    int stageId = FilterBank_AddStage(&bank, FILTER_NOTCH, NOTCH_HZ, 3.0f);
+    int stageIdQ = FilterBankQ_AddStage(&bankQ, FILTER_NOTCH, NOTCH_HZ, 3.0f);
+    uint64_t start = GetCycles();
+    for (int n = 0; n < RETUNES; ++n) {
+        FilterBank_SetStage(&bank, stageId, 100.0f + (n & 255), 3.0f);
+    }
+    double cycles = (double) (GetCycles() - start) / RETUNES;
+    start = GetCycles();
+    for (int n = 0; n < RETUNES; ++n) {
+        FilterBankQ_SetStage(&bankQ, stageIdQ, 100.0f + (n & 255), 3.0f);
+    }
+    double cyclesQ = (double) (GetCycles() - start) / RETUNES;
+    sSink = (int64_t) bank.stage[0].b1 + bankQ.stage[0].b1;
+    printf("notch retune: float %.1f, fixed %.1f host cycles\n", cycles, cyclesQ);
+}
+
+int main()
+{
+    std::vector<int16_t> samples = Synthesise();
+    printf("%u three-axis samples at %.0f Hz, host cycles per sample\n\n", SAMPLES, RATE_HZ);
+    printf("%-20s %10s %10s %10s %12s\n", "stages", "float", "fixed", "per axis", "fixed error");
+
+    bool ok = true;
+    for (const BenchConfigType& config : sConfigs) {
+        FilterBankType bank;
+        FilterBankQType bankQ;
+        if (!SetUp(config, &bank, &bankQ)) {
+            printf("%-20s set-up failed\n", config.name);
+            ok = false;
+            continue;
+        }
+        double cycles, cyclesQ, cyclesPerAxis;
+        BenchFloat(&bank, samples, &cycles);
+        BenchQ(&bankQ, samples, &cyclesQ);
+        BenchPerAxis(&bank, samples, &cyclesPerAxis);
+        double error = CompareQ(config, samples);
+        if (error > MAX_Q_ERROR_COUNTS) ok = false;
+        printf("%-20s %10.1f %10.1f %10.1f %9.3f %s\n", config.name, cycles, cyclesQ, cyclesPerAxis, error,
+               error > MAX_Q_ERROR_COUNTS ? "FAIL" : "");
+    }
+
+    printf("\ngain, dB\n%-20s", "stages");
+    for (float hz : sGainHz) printf(" %6.0f Hz", hz);
+    printf("\n");
+    for (const BenchConfigType& config : sConfigs) {
+        printf("%-20s", config.name);
+        for (float hz : sGainHz) printf(" %9.1f", MeasureGainDb(config, hz));
+        printf("\n");
+    }
+    printf("\n");
+    BenchRetune();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "blackbox.h"
+#include "frame_codec.h"
+
+/*
+ * Compression ratio and encode cost of the blackbox frame codec.
+ *
+ *     fc_frame_codec_bench [recording.bin]
+ *
+ * Takes the frames of a blackbox recording (raw or encoded, e.g. from
+ * fc_sil --blackbox), or synthesises 10 s of 500 Hz flight data, and
+ * encodes them with a few predictor and keyframe settings. Every run is
+ * decoded again and must reproduce the quantised fields bit for bit.
+ * Cycles are host cycles (TSC), compare them between settings and commits;
+ * the firmware's own cost shows up as the Blackbox::Encode profile point.
+ */
+
+/*
+ * Defines
+ */
+
+#define SYNTH_RATE_HZ (500)
+#define SYNTH_DURATION_S (10)
+#define RAW_FRAME_LEN ((int) sizeof(BlackboxFrameType))
+#define PACKET_OVERHEAD (BLACKBOX_ENCODED_HEADER_LEN + 2)
+#define UART_BYTES_PER_S(baud) ((baud) / 10)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    const char* name;
+    int predictor;               // FrameCodecPredictorType for all fields, -1 for the blackbox table
+    uint32_t keyframeInterval;
+} BenchConfigType;
+
+/*
+ * Static
+ */
+
+static const BenchConfigType sConfigs[] = {
+    { "varint only", FRAME_CODEC_PREDICT_NONE, 1 },
+    { "previous, key/32", FRAME_CODEC_PREDICT_PREVIOUS, 32 },
+    { "linear, key/32", FRAME_CODEC_PREDICT_LINEAR, 32 },
+    { "blackbox, key/8", -1, 8 },
+    { "blackbox, key/32", -1, BLACKBOX_KEYFRAME_INTERVAL },
+    { "blackbox, key/128", -1, 128 },
+};
+
+/*
+ * Code
+ */
+
+static uint64_t GetCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static bool LoadRecording(const char* pPath, std::vector<BlackboxFrameType>* pFrames)
+{
+    std::ifstream file(pPath, std::ios::binary);
+    if (!file) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    BlackboxCodecType codec;
+    Blackbox_InitCodec(&codec);
+    size_t pos = 0;
+    while (pos < data.size()) {
+        BlackboxFrameType frame;
+        int len = 0;
+        BlackboxParseResultType result = Blackbox_ParsePacket(&codec, &data[pos], (int) (data.size() - pos), frame, &len);
+        if (result == BLACKBOX_PARSE_NO_FRAME || result == BLACKBOX_PARSE_NEED_MORE) {
+            ++pos;
+            continue;
+        }
+        pos += len;
+        if (result == BLACKBOX_PARSE_FRAME) pFrames->push_back(frame);
+    }
+    return true;
+}
+
+// slow sweeps on all axes plus sensor noise, roughly what the rig sees
+static void Synthesise(std::vector<BlackboxFrameType>* pFrames)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<float> gyroNoise(0.0f, 0.05f);
+    std::normal_distribution<float> accNoise(0.0f, 0.002f);
+    const float dt = 1.0f / SYNTH_RATE_HZ;
+    FCAttType att = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < SYNTH_RATE_HZ * SYNTH_DURATION_S; ++i) {
+        float t = i * dt;
+        BlackboxFrameType frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.timeUs = 4000000 + i * (1000000 / SYNTH_RATE_HZ);
+        frame.seq = i;
+        FCAttRateType rate = { 5.0f * sinf(0.7f * t), 30.0f * sinf(2.1f * t), 25.0f * cosf(1.7f * t) };
+        att.yaw += rate.yaw * dt;
+        att.pitch += rate.pitch * dt;
+        att.roll += rate.roll * dt;
+        frame.meas.gyroData.x = rate.roll + gyroNoise(rng);
+        frame.meas.gyroData.y = rate.pitch + gyroNoise(rng);
+        frame.meas.gyroData.z = rate.yaw + gyroNoise(rng);
+        frame.meas.accData.x = sinf(att.pitch * 0.01745f) + accNoise(rng);
+        frame.meas.accData.y = -sinf(att.roll * 0.01745f) + accNoise(rng);
+        frame.meas.accData.z = -1.0f + accNoise(rng);
+        frame.state.att = att;
+        frame.state.attRate = rate;
+        frame.attSetpoint.pitch = (i / 1000) % 2 ? 10.0f : -10.0f;
+        frame.attRateSetpoint = rate;
+        for (int axis = 0; axis < 3; ++axis) {
+            frame.attRatePID[axis].p = 0.01f * gyroNoise(rng);
+            frame.attRatePID[axis].i = 0.02f * sinf(0.3f * t + axis);
+            frame.attRatePID[axis].d = 0.005f * gyroNoise(rng);
+        }
+        for (int motor = 0; motor < 4; ++motor) {
+            frame.motorPWM[motor] = (uint16_t) (400 + 20 * sinf(2.1f * t + motor));
+        }
+        frame.flags = BLACKBOX_FLAG_ARMED;
+        pFrames->push_back(frame);
+    }
+}
+
+static bool RunConfig(const BenchConfigType& bench, const std::vector<int32_t>& fields, int numOfFrames)
+{
+    uint8_t predictors[BLACKBOX_NUM_OF_FIELDS];
+    FrameCodecConfigType config = *Blackbox_GetCodecConfig();
+    if (bench.predictor >= 0) {
+        memset(predictors, bench.predictor, sizeof(predictors));
+        config.pPredictors = predictors;
+    }
+    config.keyframeInterval = bench.keyframeInterval;
+
+    std::vector<uint8_t> encoded((size_t) numOfFrames * FRAME_CODEC_MAX_LEN(BLACKBOX_NUM_OF_FIELDS));
+    std::vector<int> lens(numOfFrames);
+    FrameCodecStateType encoder;
+    FrameCodec_Init(&encoder, &config);
+    size_t total = 0;
+    uint64_t start = GetCycles();
+    for (int i = 0; i < numOfFrames; ++i) {
+        lens[i] = FrameCodec_Encode(&encoder, &fields[(size_t) i * BLACKBOX_NUM_OF_FIELDS], &encoded[total],
+                                    FRAME_CODEC_MAX_LEN(BLACKBOX_NUM_OF_FIELDS));
+        total += lens[i];
+    }
+    uint64_t encodeCycles = GetCycles() - start;
+
+    FrameCodecStateType decoder;
+    FrameCodec_Init(&decoder, &config);
+    int32_t decoded[BLACKBOX_NUM_OF_FIELDS];
+    size_t pos = 0;
+    start = GetCycles();
+    for (int i = 0; i < numOfFrames; ++i) {
+        if (FrameCodec_Decode(&decoder, &encoded[pos], lens[i], decoded) != lens[i]
+            || memcmp(decoded, &fields[(size_t) i * BLACKBOX_NUM_OF_FIELDS], sizeof(decoded)) != 0) {
+            printf("%-20s decode mismatch at frame %d\n", bench.name, i);
+            return false;
+        }
+        pos += lens[i];
+    }
+    uint64_t decodeCycles = GetCycles() - start;
+
+    double bytesPerFrame = (double) total / numOfFrames + PACKET_OVERHEAD;
+    printf("%-20s %8.1f %7.1fx %10.0f %10.0f %9.0f %9.0f\n", bench.name, bytesPerFrame, RAW_FRAME_LEN / bytesPerFrame,
+           (double) encodeCycles / numOfFrames, (double) decodeCycles / numOfFrames,
+           UART_BYTES_PER_S(115200) / bytesPerFrame, UART_BYTES_PER_S(460800) / bytesPerFrame);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<BlackboxFrameType> frames;
+    if (argc == 2) {
+        if (!LoadRecording(argv[1], &frames)) {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+    } else if (argc == 1) {
+        Synthesise(&frames);
+    } else {
+        printf("usage: %s [recording.bin]\n", argv[0]);
+        return 1;
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    int numOfFrames = (int) frames.size();
+    std::vector<int32_t> fields((size_t) numOfFrames * BLACKBOX_NUM_OF_FIELDS);
+    for (int i = 0; i < numOfFrames; ++i) {
+        Blackbox_FrameToFields(frames[i], &fields[(size_t) i * BLACKBOX_NUM_OF_FIELDS]);
+    }
+
+    printf("%d frames from %s, raw frame %d bytes, packet overhead %d bytes\n", numOfFrames,
+           argc == 2 ? argv[1] : "synthetic 500 Hz data", RAW_FRAME_LEN, PACKET_OVERHEAD);
+    printf("%-20s %8s %8s %10s %10s %9s %9s\n", "predictor", "B/frame", "ratio", "enc cyc", "dec cyc",
+           "Hz@115k2", "Hz@460k8");
+    printf("%-20s %8d %7.1fx %10s %10s %9.0f %9.0f\n", "raw", RAW_FRAME_LEN, 1.0, "-", "-",
+           UART_BYTES_PER_S(115200) / (double) RAW_FRAME_LEN, UART_BYTES_PER_S(460800) / (double) RAW_FRAME_LEN);
+    bool exact = true;
+    for (const BenchConfigType& config : sConfigs) {
+        exact &= RunConfig(config, fields, numOfFrames);
+    }
+
+    // what Flush() runs per frame: quantise, encode, checksum
+    BlackboxCodecType codec;
+    Blackbox_InitCodec(&codec);
+    uint8_t packet[BLACKBOX_ENCODED_MAX_LEN];
+    uint64_t start = GetCycles();
+    for (int i = 0; i < numOfFrames; ++i) {
+        Blackbox_EncodePacket(&codec, frames[i], packet, sizeof(packet));
+    }
+    printf("Blackbox_EncodePacket: %.0f cycles/frame\n", (double) (GetCycles() - start) / numOfFrames);
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "log_token.h"
+
+/*
+ * Host side of the tokenized logging (UAV_LOG_TOKENIZED, see log_token.h).
+ *
+ *     fc_log_decoder --gen <dir|file>... > log_tokens.tsv
+ *         scans the firmware sources for LOGx/PRINT call sites and writes the
+ *         token table, one "token<TAB>tag<TAB>format" line per call site
+ *
+ *     fc_log_decoder --table log_tokens.tsv [capture.bin]
+ *         turns a USART2 capture (stdin if no file) back into the text the
+ *         firmware would have printed
+ */
+
+/*
+ * Defines
+ */
+
+#define LEVEL_CHARS "EWIV"
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    std::string tag;
+    std::string fmt;
+} TokenEntryType;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t unknownTokens;
+    uint32_t badFrames;
+    uint32_t skippedBytes;
+} DecodeStatsType;
+
+/*
+ * Code
+ */
+
+static std::string Unescape(const std::string& str)
+{
+    std::string out;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] != '\\' || i + 1 == str.size()) {
+            out += str[i];
+            continue;
+        }
+        char c = str[++i];
+        switch (c) {
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case '0': out += '\0'; break;
+        case 'x': {
+            size_t end = i + 1;
+            while (end < str.size() && isxdigit((unsigned char) str[end]) && end < i + 3) ++end;
+            out += (char) strtol(str.substr(i + 1, end - i - 1).c_str(), NULL, 16);
+            i = end - 1;
+            break;
+        }
+        default: out += c; break; // \\ \" \'
+        }
+    }
+    return out;
+}
+
+static std::string Escape(const std::string& str)
+{
+    std::string out;
+    for (char c : str) {
+        switch (c) {
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\\': out += "\\\\"; break;
+        default: out += c; break;
+        }
+    }
+    return out;
+}
+
+static uint32_t Token(const std::string& tag, const std::string& fmt)
+{
+    return LogToken(tag.c_str(), fmt.c_str());
+}
+
+/*------------------------------------------*
+* Table generation
+*------------------------------------------*/
+
+static void ScanFile(const std::filesystem::path& path, std::map<uint32_t, TokenEntryType>* pTable)
+{
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string src = text.str();
+
+    static const std::regex sTagRe("#define\\s+LOG_TAG\\s+\\(\\s*\"([^\"]*)\"\\s*\\)");
+    std::smatch tagMatch;
+    std::string tag = std::regex_search(src, tagMatch, sTagRe) ? tagMatch[1].str() : "";
+
+    // the format is the first argument, possibly split into adjacent literals;
+    // LOG and log_i/log_e are the per-file aliases of LOGI/LOGE
+    static const std::regex sCallRe("\\b(LOG[EWIV]?|PRINT|log_[ie])\\s*\\(\\s*((\"(?:[^\"\\\\]|\\\\.)*\"\\s*)+)");
+    static const std::regex sLiteralRe("\"((?:[^\"\\\\]|\\\\.)*)\"");
+    for (std::sregex_iterator it(src.begin(), src.end(), sCallRe), end; it != end; ++it) {
+        std::string literals = (*it)[2].str();
+        std::string fmt;
+        for (std::sregex_iterator lit(literals.begin(), literals.end(), sLiteralRe); lit != end; ++lit) {
+            fmt += Unescape((*lit)[1].str());
+        }
+        std::string callTag = (*it)[1].str() == "PRINT" ? "" : tag;
+        uint32_t token = Token(callTag, fmt);
+        auto found = pTable->find(token);
+        if (found != pTable->end() && (found->second.tag != callTag || found->second.fmt != fmt)) {
+            fprintf(stderr, "%s: token 0x%08x collides with \"%s\"\n", path.string().c_str(), token, found->second.fmt.c_str());
+            continue;
+        }
+        (*pTable)[token] = { callTag, fmt };
+    }
+}
+
+static int GenerateTable(const std::vector<std::string>& paths)
+{
+    std::map<uint32_t, TokenEntryType> table;
+    for (const std::string& arg : paths) {
+        std::filesystem::path path(arg);
+        if (std::filesystem::is_regular_file(path)) {
+            ScanFile(path, &table);
+            continue;
+        }
+        if (!std::filesystem::is_directory(path)) {
+            fprintf(stderr, "cannot open %s\n", arg.c_str());
+            return 1;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".c" || ext == ".cpp" || ext == ".h")) {
+                ScanFile(entry.path(), &table);
+            }
+        }
+    }
+    for (const auto& entry : table) {
+        printf("%08x\t%s\t%s\n", entry.first, entry.second.tag.c_str(), Escape(entry.second.fmt).c_str());
+    }
+    return 0;
+}
+
+/*------------------------------------------*
+* Decoding
+*------------------------------------------*/
+
+static bool LoadTable(const char* pPath, std::map<uint32_t, TokenEntryType>* pTable)
+{
+    std::ifstream file(pPath);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t tab1 = line.find('\t');
+        size_t tab2 = tab1 == std::string::npos ? tab1 : line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos) continue;
+        uint32_t token = (uint32_t) strtoul(line.substr(0, tab1).c_str(), NULL, 16);
+        (*pTable)[token] = { line.substr(tab1 + 1, tab2 - tab1 - 1), Unescape(line.substr(tab2 + 1)) };
+    }
+    return true;
+}
+
+class ArgReader
+{
+public:
+    ArgReader(const uint8_t* pData, int len) : mData(pData), mLen(len), mPos(0) {}
+
+    bool Read(void* pValue, int size)
+    {
+        if (mPos + size > mLen) return false;
+        memcpy(pValue, mData + mPos, size);
+        mPos += size;
+        return true;
+    }
+
+    bool ReadString(std::string* pStr)
+    {
+        uint8_t len;
+        if (!Read(&len, 1) || mPos + len > mLen) return false;
+        pStr->assign((const char*) mData + mPos, len);
+        mPos += len;
+        return true;
+    }
+
+private:
+    const uint8_t* mData;
+    int mLen;
+    int mPos;
+};
+
+// printf with the packed arguments, mirroring PackArgs() in logging.c
+static std::string Format(const std::string& fmt, ArgReader* pArgs)
+{
+    std::string out;
+    char buf[256];
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] != '%') {
+            out += fmt[i];
+            continue;
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+            out += '%';
+            ++i;
+            continue;
+        }
+
+        std::string spec = "%";
+        size_t p = i + 1;
+        while (p < fmt.size() && strchr("-+ #0", fmt[p])) spec += fmt[p++];
+        for (int field = 0; field < 2; ++field) {
+            if (field == 1) {
+                if (p >= fmt.size() || fmt[p] != '.') break;
+                spec += fmt[p++];
+            }
+            if (p < fmt.size() && fmt[p] == '*') {
+                int32_t value;
+                if (!pArgs->Read(&value, sizeof(value))) return out + "<missing args>";
+                spec += std::to_string(value);
+                ++p;
+            }
+            while (p < fmt.size() && isdigit((unsigned char) fmt[p])) spec += fmt[p++];
+        }
+        int longs = 0;
+        while (p < fmt.size() && strchr("hlLzjt", fmt[p])) {
+            if (fmt[p] == 'l') ++longs;
+            ++p;
+        }
+        if (p >= fmt.size()) break;
+        char conv = fmt[p];
+        i = p;
+
+        bool ok = true;
+        if (strchr("diuoxXc", conv)) {
+            if (longs >= 2) {
+                int64_t value = 0;
+                ok = pArgs->Read(&value, sizeof(value));
+                if (conv == 'd' || conv == 'i') {
+                    snprintf(buf, sizeof(buf), (spec + "lld").c_str(), (long long) value);
+                } else {
+                    snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), (unsigned long long) value);
+                }
+            } else {
+                int32_t value = 0;
+                ok = pArgs->Read(&value, sizeof(value));
+                if (conv == 'd' || conv == 'i' || conv == 'c') {
+                    snprintf(buf, sizeof(buf), (spec + conv).c_str(), value);
+                } else {
+                    snprintf(buf, sizeof(buf), (spec + conv).c_str(), (uint32_t) value);
+                }
+            }
+        } else if (strchr("fFeEgGaA", conv)) {
+            float value = 0.0f;
+            ok = pArgs->Read(&value, sizeof(value));
+            snprintf(buf, sizeof(buf), (spec + conv).c_str(), (double) value);
+        } else if (conv == 's') {
+            std::string value;
+            ok = pArgs->ReadString(&value);
+            snprintf(buf, sizeof(buf), (spec + 's').c_str(), value.c_str());
+        } else if (conv == 'p') {
+            uint32_t value = 0;
+            ok = pArgs->Read(&value, sizeof(value));
+            snprintf(buf, sizeof(buf), "0x%08x", value);
+        } else {
+            return out + "<unsupported %" + conv + ">";
+        }
+        if (!ok) return out + "<missing args>";
+        out += buf;
+    }
+    return out;
+}
+
+static void Decode(const std::vector<uint8_t>& data, const std::map<uint32_t, TokenEntryType>& table, DecodeStatsType* pStats)
+{
+    size_t pos = 0;
+    while (pos + LOG_TOKEN_HEADER_LEN + 1 <= data.size()) {
+        const uint8_t* pFrame = &data[pos];
+        uint8_t argsLen = pFrame[2];
+        size_t frameLen = LOG_TOKEN_HEADER_LEN + argsLen + 1;
+        if (pFrame[0] != LOG_TOKEN_SYNC || argsLen > LOG_TOKEN_MAX_ARGS_LEN) {
+            ++pStats->skippedBytes;
+            ++pos;
+            continue;
+        }
+        if (pos + frameLen > data.size()) break;
+
+        uint8_t checksum = 0;
+        for (size_t i = 1; i < frameLen - 1; ++i) {
+            checksum += pFrame[i];
+        }
+        if (checksum != pFrame[frameLen - 1]) {
+            // not a frame start after all, resync on the next byte
+            ++pStats->badFrames;
+            ++pos;
+            continue;
+        }
+        ++pStats->frames;
+        pos += frameLen;
+
+        uint8_t level = pFrame[1];
+        uint32_t token;
+        memcpy(&token, &pFrame[3], sizeof(token));
+        auto found = table.find(token);
+        if (found == table.end()) {
+            ++pStats->unknownTokens;
+            printf("?|token %08x, %u argument bytes\r\n", token, argsLen);
+            continue;
+        }
+        ArgReader args(&pFrame[LOG_TOKEN_HEADER_LEN], argsLen);
+        std::string msg = Format(found->second.fmt, &args);
+        if (level < sizeof(LEVEL_CHARS) - 1) {
+            printf("%c|%-12.12s: %s", LEVEL_CHARS[level], found->second.tag.c_str(), msg.c_str());
+        } else {
+            printf("%s", msg.c_str());
+        }
+    }
+    pStats->skippedBytes += (uint32_t) (data.size() - pos);
+}
+
+static void PrintUsage(const char* pName)
+{
+    printf("usage: %s --gen <dir|file>...\n", pName);
+    printf("       %s --table <log_tokens.tsv> [capture.bin]\n", pName);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && !strcmp(argv[1], "--gen")) {
+        return GenerateTable(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if ((argc != 3 && argc != 4) || strcmp(argv[1], "--table")) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::map<uint32_t, TokenEntryType> table;
+    if (!LoadTable(argv[2], &table)) {
+        fprintf(stderr, "cannot open %s\n", argv[2]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (argc == 4) {
+        std::ifstream file(argv[3], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", argv[3]);
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+
+    DecodeStatsType stats = {};
+    Decode(data, table, &stats);
+    fprintf(stderr, "%u frames, %u unknown tokens, %u bad frames, %u bytes skipped\n", stats.frames, stats.unknownTokens,
+            stats.badFrames, stats.skippedBytes);
+    return 0;
+}
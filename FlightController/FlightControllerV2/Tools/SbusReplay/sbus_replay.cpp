@@ -0,0 +1,317 @@
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "sbus_decoder.h"
+
+/*
+ * Feeds an SBUS byte stream with injected corruption through the firmware's
+ * streaming decoder (sbus_decoder.h).
+ *
+ *     fc_sbus_replay [--corrupt <n>] [--seed <n>] [--idle-miss <n>] [capture.bin]
+ *
+ * Takes the frames of a capture (e.g. from fc_sil --rc-out), or
+ * synthesises 60 s of 70 Hz frames, and puts them back on a virtual line
+ * with one in n frames damaged: a lost byte, a stray byte, a damaged header
+ * or end byte, or a burst of noise before it. Single bit flips in the data
+ * are left out, on target the UART's parity check catches those. The line
+ * goes idle between frames, and one in m idle interrupts is skipped so the
+ * decoder also has to confirm frames by the next header alone.
+ *
+ * Every decoded frame must be an undamaged frame that was sent, in order
+ * and with the time stamp of its last byte; anything else is a false frame
+ * and fails the run. The summary shows how many undamaged frames were lost
+ * along with the damaged ones, i.e. how fast the decoder recovers.
+ */
+
+/*
+ * Defines
+ */
+
+#define BYTE_TIME_US (120) // 12 bits at 100 kbaud: start, 8 data, parity, 2 stop
+#define FRAME_PERIOD_US (14000)
+#define SYNTH_DURATION_S (60)
+#define NOISE_MAX_LEN (8)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint8_t data[SBUS_FRAME_LEN];
+} FrameType;
+
+typedef enum {
+    DAMAGE_NONE = 0,
+    DAMAGE_LOST_BYTE,
+    DAMAGE_STRAY_BYTE,
+    DAMAGE_HEADER,
+    DAMAGE_END_BYTE,
+    DAMAGE_NOISE,
+    NUM_OF_DAMAGE
+} DamageType;
+
+typedef struct {
+    int64_t start;      // index of the header on the line, -1 if the frame cannot decode
+    DamageType damage;
+} SentFrameType;
+
+typedef struct {
+    size_t start;       // index of the first byte on the line
+    uint64_t timeUs;    // as the decoder stamped it
+    uint64_t expectedUs;
+} DecodedFrameType;
+
+typedef struct {
+    SBUSDecoderType dec;
+    const std::vector<int32_t>* pOrigin;
+    std::vector<DecodedFrameType> decoded;
+    uint64_t lastUs;     // time of the last byte fed
+    uint32_t misaligned; // frames the damage made up, undetectable
+    uint32_t bad;        // frames the decoder should not have returned
+} ReplayType;
+
+/*
+ * Static
+ */
+
+static const char* sDamageNames[NUM_OF_DAMAGE] = {
+    "none", "lost byte", "stray byte", "header", "end byte", "noise before",
+};
+
+/*
+ * Code
+ */
+
+static void Synthesise(std::vector<FrameType>* pFrames)
+{
+    int num = SYNTH_DURATION_S * 1000000 / FRAME_PERIOD_US;
+    for (int n = 0; n < num; ++n) {
+        FrameType frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.data[0] = SBUS_FRAME_HEADER;
+        // slow sweeps, so neighbouring frames differ
+        for (int i = 1; i <= 22; ++i) {
+            frame.data[i] = (uint8_t) (n * (i + 1) + i);
+        }
+        if (n % 97 == 0) frame.data[SBUS_FRAME_FLAGS_BYTE] = SBUS_FLAG_LOST_FRAME;
+        pFrames->push_back(frame);
+    }
+}
+
+// the frames of a capture, as the decoder finds them in the undamaged stream
+static bool LoadCapture(const char* path, std::vector<FrameType>* pFrames, SBUSDecoderStatsType* pStats)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    SBUSDecoderType dec;
+    SBUSDecoder_Init(&dec);
+    FrameType frame;
+    for (size_t i = 0; i < data.size(); ++i) {
+        const uint8_t* pFrame = SBUSDecoder_PutByte(&dec, data[i], i * BYTE_TIME_US);
+        if (!pFrame) continue;
+        memcpy(frame.data, pFrame, SBUS_FRAME_LEN);
+        pFrames->push_back(frame);
+    }
+    const uint8_t* pFrame = SBUSDecoder_OnIdle(&dec);
+    if (pFrame) {
+        memcpy(frame.data, pFrame, SBUS_FRAME_LEN);
+        pFrames->push_back(frame);
+    }
+    *pStats = dec.stats;
+    return true;
+}
+
+static void Damage(std::vector<uint8_t>* pBytes, DamageType damage, std::mt19937* pRng)
+{
+    std::vector<uint8_t>& bytes = *pBytes;
+    switch (damage) {
+    case DAMAGE_LOST_BYTE:
+        bytes.erase(bytes.begin() + (*pRng)() % bytes.size());
+        break;
+    case DAMAGE_STRAY_BYTE:
+        bytes.insert(bytes.begin() + 1 + (*pRng)() % (bytes.size() - 1), (uint8_t) (*pRng)());
+        break;
+    case DAMAGE_HEADER:
+        bytes[0] ^= (uint8_t) (1 << ((*pRng)() % 8));
+        break;
+    case DAMAGE_END_BYTE:
+    {
+        // any bit but 0x04, which turns 0x00 into an SBUS2 end byte
+        static const uint8_t bits[] = { 0x01, 0x02, 0x08, 0x10, 0x20, 0x40, 0x80 };
+        bytes[SBUS_FRAME_LEN - 1] ^= bits[(*pRng)() % sizeof(bits)];
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// pFrame as returned by the decoder, last is the index of the byte it must end with
+static void Check(ReplayType* pReplay, const uint8_t* pFrame, size_t last, uint64_t lastUs)
+{
+    if (!pFrame) return;
+    DecodedFrameType frame;
+    frame.start = last + 1 - SBUS_FRAME_LEN;
+    frame.timeUs = SBUSDecoder_GetFrameTimeUs(&pReplay->dec);
+    frame.expectedUs = lastUs;
+    pReplay->decoded.push_back(frame);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t corruptOneInN = 10;
+    uint32_t seed = 1;
+    uint32_t idleMissOneInN = 4;
+    const char* pPath = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--corrupt") && i + 1 < argc) {
+            corruptOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--idle-miss") && i + 1 < argc) {
+            idleMissOneInN = (uint32_t) atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !pPath) {
+            pPath = argv[i];
+        } else {
+            printf("usage: %s [--corrupt <n>] [--seed <n>] [--idle-miss <n>] [capture.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<FrameType> frames;
+    if (pPath) {
+        SBUSDecoderStatsType captureStats;
+        if (!LoadCapture(pPath, &frames, &captureStats)) {
+            fprintf(stderr, "cannot open %s\n", pPath);
+            return 1;
+        }
+        printf("%zu frames from %s (%u resyncs, %u bytes skipped in the capture)\n", frames.size(), pPath,
+               captureStats.resyncs, captureStats.skippedBytes);
+    } else {
+        Synthesise(&frames);
+        printf("%zu frames of synthetic %.1f Hz SBUS\n", frames.size(), 1e6 / FRAME_PERIOD_US);
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<SentFrameType> sent(frames.size());
+    std::vector<int32_t> origin;  // per byte on the line: the frame it belongs to, -1 if damaged
+    ReplayType replay;
+    SBUSDecoder_Init(&replay.dec);
+    replay.pOrigin = &origin;
+    uint32_t damageCnt[NUM_OF_DAMAGE] = { 0 };
+    uint32_t idleCnt = 0;
+
+    for (size_t n = 0; n < frames.size(); ++n) {
+        uint64_t startUs = (uint64_t) n * FRAME_PERIOD_US;
+        DamageType damage = DAMAGE_NONE;
+        if (corruptOneInN && rng() % corruptOneInN == 0) {
+            damage = (DamageType) (1 + rng() % (NUM_OF_DAMAGE - 1));
+        }
+        ++damageCnt[damage];
+
+        std::vector<uint8_t> bytes;
+        int noiseLen = 0;
+        if (damage == DAMAGE_NOISE) {
+            // no idle line between the noise and the frame
+            noiseLen = 1 + (int) (rng() % NOISE_MAX_LEN);
+            for (int i = 0; i < noiseLen; ++i) {
+                bytes.push_back((uint8_t) rng());
+            }
+        }
+        bytes.insert(bytes.end(), frames[n].data, frames[n].data + SBUS_FRAME_LEN);
+        Damage(&bytes, damage, &rng);
+
+        // noise before the frame leaves the frame itself intact
+        bool intact = damage == DAMAGE_NONE || damage == DAMAGE_NOISE;
+        sent[n].damage = damage;
+        sent[n].start = intact ? (int64_t) (origin.size() + noiseLen) : -1;
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            origin.push_back(intact && (int) i >= noiseLen ? (int32_t) n : -1);
+            // a frame comes out with the byte after its last one
+            uint64_t prevUs = i ? startUs + (i - 1) * BYTE_TIME_US : replay.lastUs;
+            Check(&replay, SBUSDecoder_PutByte(&replay.dec, bytes[i], startUs + i * BYTE_TIME_US), origin.size() - 2,
+                  prevUs);
+        }
+        replay.lastUs = startUs + (bytes.size() - 1) * BYTE_TIME_US;
+        if (idleMissOneInN && rng() % idleMissOneInN == 0) continue;
+        ++idleCnt;
+        Check(&replay, SBUSDecoder_OnIdle(&replay.dec), origin.size() - 1, replay.lastUs);
+    }
+    // the stream ends with an idle line
+    Check(&replay, SBUSDecoder_OnIdle(&replay.dec), origin.size() - 1, replay.lastUs);
+
+    std::vector<bool> received(frames.size(), false);
+    for (size_t i = 0; i < replay.decoded.size(); ++i) {
+        const DecodedFrameType& frame = replay.decoded[i];
+        int32_t n = origin[frame.start];
+        if (frame.timeUs != frame.expectedUs) {
+            if (replay.bad < 5) printf("frame %d: time stamp %llu us, last byte at %llu us\n", n,
+                                       (unsigned long long) frame.timeUs, (unsigned long long) frame.expectedUs);
+            ++replay.bad;
+        } else if (n >= 0 && sent[n].start == (int64_t) frame.start) {
+            if (received[n] || (i > 0 && origin[replay.decoded[i - 1].start] > n)) {
+                if (replay.bad < 5) printf("frame %d: out of order or repeated\n", n);
+                ++replay.bad;
+            }
+            received[n] = true;
+        } else {
+            bool damaged = false;
+            for (uint32_t b = 0; b < SBUS_FRAME_LEN; ++b) {
+                damaged |= origin[frame.start + b] < 0;
+            }
+            if (damaged) {
+                // a header in the data of a damaged frame and a valid end byte
+                // where one is expected, SBUS cannot tell this from a frame
+                ++replay.misaligned;
+            } else {
+                if (replay.bad < 5) printf("frame from byte %zu: not a sent frame\n", frame.start);
+                ++replay.bad;
+            }
+        }
+    }
+
+    // undamaged frames lost with a damaged neighbour, by the damage
+    uint32_t collateral[NUM_OF_DAMAGE] = { 0 };
+    uint32_t intactCnt = 0;
+    uint32_t intactLost = 0;
+    for (size_t n = 0; n < sent.size(); ++n) {
+        if (sent[n].start < 0) continue;
+        ++intactCnt;
+        if (received[n]) continue;
+        ++intactLost;
+        DamageType cause = DAMAGE_NONE;
+        if (n + 1 < sent.size() && sent[n + 1].damage != DAMAGE_NONE) cause = sent[n + 1].damage;
+        if (sent[n].damage != DAMAGE_NONE) cause = sent[n].damage;
+        if (n > 0 && sent[n - 1].damage != DAMAGE_NONE) cause = sent[n - 1].damage;
+        ++collateral[cause];
+    }
+
+    const SBUSDecoderStatsType& stats = replay.dec.stats;
+    printf("corrupt 1 in %u, seed %u, %u idle lines (1 in %u missed)\n", corruptOneInN, seed, idleCnt,
+           idleMissOneInN);
+    printf("damaged frames  :");
+    for (int d = DAMAGE_LOST_BYTE; d < NUM_OF_DAMAGE; ++d) {
+        printf(" %u %s%s", damageCnt[d], sDamageNames[d], d + 1 < NUM_OF_DAMAGE ? "," : "\n");
+    }
+    printf("decoded         : %u of %u intact frames, %u made up by the damage, %u bad\n", intactCnt - intactLost,
+           intactCnt, replay.misaligned, replay.bad);
+    printf("intact lost     : %u (", intactLost);
+    for (int d = DAMAGE_NONE; d < NUM_OF_DAMAGE; ++d) {
+        printf("%u next to %s%s", collateral[d], sDamageNames[d], d + 1 < NUM_OF_DAMAGE ? ", " : ")\n");
+    }
+    printf("decoder         : %u frames at %.1f Hz, period %u..%u us, %u resyncs, %u partial, %u bytes skipped, "
+           "%u lost-frame flags\n", stats.frames, SBUSDecoder_GetFrameRateHz(&stats), stats.minPeriodUs,
+           stats.maxPeriodUs, stats.resyncs, stats.partialFrames, stats.skippedBytes, stats.lostFrames);
+    return replay.bad ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ring_buffer.h"
+#include "spsc_ring.h"
+
+/*
+ * Throughput of SpscRing against the byte ring_buffer (ringbuf_t).
+ *
+ *     fc_spsc_ring_bench
+ *
+ * Pushes and pops ITEMS items through rings of RING_SIZE items, one at a
+ * time, in BULK_LEN bursts and (SpscRing only) in place with peek/commit,
+ * for a byte and for a 16 byte sample, and
+ * prints host cycles (TSC) per item. Both sides run on one thread, so this
+ * is the cost of the ring itself. A second run moves the items between two
+ * threads through SpscRing (yielding when full or empty, so it also works on
+ * a single core) and checks that every item arrives once and in
+ * order, which the acquire/release publication has to guarantee.
+ */
+
+/*
+ * Defines
+ */
+
+#define ITEMS (1 << 22)
+#define RING_SIZE (256)
+#define BULK_LEN (32)
+#define THREADED_ITEMS (1 << 18)
+
+/*
+ * Struct
+ */
+
+typedef struct {
+    uint32_t seq;
+    int16_t gyro[3];
+    int16_t acc[3];
+} SampleType;
+
+/*
+ * Code
+ */
+
+static uint64_t GetCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static volatile uint64_t sSink;
+
+// a whole field, so neither ring pays for a byte store forwarded into a wider load
+static void Stamp(uint8_t& item, uint32_t i) { item = (uint8_t) i; }
+static void Stamp(SampleType& item, uint32_t i) { item.seq = i; }
+static uint32_t GetStamp(const uint8_t& item) { return item; }
+static uint32_t GetStamp(const SampleType& item) { return item.seq; }
+
+static void Report(const char* pName, uint64_t cycles, uint64_t checksum)
+{
+    // the checksum keeps the compiler from dropping the loops
+    sSink = checksum;
+    printf("%-32s %8.2f\n", pName, (double) cycles / ITEMS);
+}
+
+template <typename T>
+static void BenchSpscSingle(const char* pName)
+{
+    static SpscRing<T, RING_SIZE> ring;
+    T item;
+    memset(&item, 0, sizeof(item));
+    uint64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (uint32_t i = 0; i < ITEMS; ++i) {
+        Stamp(item, i);
+        ring.Push(item);
+        ring.Pop(item);
+        checksum += GetStamp(item);
+    }
+    Report(pName, GetCycles() - start, checksum);
+}
+
+template <typename T>
+static void BenchSpscBulk(const char* pName)
+{
+    static SpscRing<T, RING_SIZE> ring;
+    T items[BULK_LEN];
+    memset(items, 0, sizeof(items));
+    uint64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (uint32_t i = 0; i < ITEMS; i += BULK_LEN) {
+        Stamp(items[0], i);
+        ring.PushBulk(items, BULK_LEN);
+        ring.PopBulk(items, BULK_LEN);
+        checksum += GetStamp(items[0]);
+    }
+    Report(pName, GetCycles() - start, checksum);
+}
+
+// fills and reads the slots in place, no copy in or out
+template <typename T>
+static void BenchSpscZeroCopy(const char* pName)
+{
+    static SpscRing<T, RING_SIZE> ring;
+    uint64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (uint32_t i = 0; i < ITEMS; ++i) {
+        Stamp(*ring.PeekWrite(), i);
+        ring.CommitWrite();
+        checksum += GetStamp(*ring.Peek());
+        ring.CommitRead();
+    }
+    Report(pName, GetCycles() - start, checksum);
+}
+
+template <typename T>
+static void BenchRingbufSingle(const char* pName)
+{
+    ringbuf_t* pRing = ringbuf_new(RING_SIZE * sizeof(T));
+    T item;
+    memset(&item, 0, sizeof(item));
+    uint64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (uint32_t i = 0; i < ITEMS; ++i) {
+        Stamp(item, i);
+        ringbuf_memcpy_into(pRing, &item, sizeof(T));
+        ringbuf_memcpy_from(&item, pRing, sizeof(T));
+        checksum += GetStamp(item);
+    }
+    Report(pName, GetCycles() - start, checksum);
+    ringbuf_free(pRing);
+}
+
+template <typename T>
+static void BenchRingbufBulk(const char* pName)
+{
+    ringbuf_t* pRing = ringbuf_new(RING_SIZE * sizeof(T));
+    T items[BULK_LEN];
+    memset(items, 0, sizeof(items));
+    uint64_t checksum = 0;
+    uint64_t start = GetCycles();
+    for (uint32_t i = 0; i < ITEMS; i += BULK_LEN) {
+        Stamp(items[0], i);
+        ringbuf_memcpy_into(pRing, items, sizeof(items));
+        ringbuf_memcpy_from(items, pRing, sizeof(items));
+        checksum += GetStamp(items[0]);
+    }
+    Report(pName, GetCycles() - start, checksum);
+    ringbuf_free(pRing);
+}
+
+static bool RunThreaded()
+{
+    static SpscRing<SampleType, RING_SIZE> ring;
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([] {
+        SampleType sample;
+        memset(&sample, 0, sizeof(sample));
+        for (uint32_t i = 0; i < THREADED_ITEMS; ++i) {
+            sample.seq = i;
+            sample.gyro[0] = (int16_t) i;
+            while (!ring.Push(sample)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < THREADED_ITEMS; ++i) {
+        SampleType sample;
+        while (!ring.Pop(sample)) {
+            std::this_thread::yield();
+        }
+        if (sample.seq != i || sample.gyro[0] != (int16_t) i) ++errors;
+    }
+    producer.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("two threads, SpscRing<16 B>      %8.1f ns/item, %u out of order or torn\n", s * 1e9 / THREADED_ITEMS, errors);
+    return errors == 0;
+}
+
+int main()
+{
+    printf("%u items through %u item rings, host cycles per item\n", ITEMS, RING_SIZE);
+    BenchRingbufSingle<uint8_t>("ringbuf_t, 1 B, single");
+    BenchSpscSingle<uint8_t>("SpscRing<uint8_t>, single");
+    BenchSpscZeroCopy<uint8_t>("SpscRing<uint8_t>, peek/commit");
+    BenchRingbufBulk<uint8_t>("ringbuf_t, 1 B, bulk");
+    BenchSpscBulk<uint8_t>("SpscRing<uint8_t>, bulk");
+    BenchRingbufSingle<SampleType>("ringbuf_t, 16 B, single");
+    BenchSpscSingle<SampleType>("SpscRing<16 B>, single");
+    BenchSpscZeroCopy<SampleType>("SpscRing<16 B>, peek/commit");
+    BenchRingbufBulk<SampleType>("ringbuf_t, 16 B, bulk");
+    BenchSpscBulk<SampleType>("SpscRing<16 B>, bulk");
+    return RunThreaded() ? 0 : 1;
+}